@@ -110,6 +110,14 @@ typedef struct APU {
 
 void apu_init(APU *apu, APU_MMIO *apu_mmio);
 void apu_execute(APU *apu);
+
+// apu_execute calls until the frame counter's next step, counting the one
+// that clocks it. -1 if the sequence has stopped.
+int apu_cycles_until_frame_step(APU *apu);
+
+// apu_execute calls until the frame counter raises its IRQ. -1 if it won't
+// without another $4017 write.
+int apu_cycles_until_frame_irq(APU *apu);
 void apu_update_parameters(APU *apu);
 
 int apu_sweep_clocked(Pulse *pulse, uint8_t one_comp);
@@ -1,14 +1,31 @@
 #ifndef APU_MMIO_H
 #define APU_MMIO_H
 
+#include "cpu/irq.h"
+
 #include <stdint.h>
 
 typedef struct APU_MMIO {
   uint32_t apu_mmio_write_mask;
   uint8_t regs[0x18];
+
+  // Brings the APU up to the CPU before a register write lands, so the APU
+  // can run behind in batches. NULL if the APU is stepped in lockstep.
+  void (*sync)(void *ctx);
+  void *sync_ctx;
+
+  // Frame counter IRQ, bit 6 of $4015. NULL irq if nothing listens.
+  uint8_t frame_interrupt_flag;
+  IrqLine *irq;
 } APU_MMIO;
 
 void apu_mmio_init(APU_MMIO *apu_mmio);
 void write_apu_mmio(APU_MMIO *apu_mmio, uint16_t addr, uint8_t val);
 
+// $4015 read, acknowledges the frame IRQ
+uint8_t read_apu_status(APU_MMIO *apu_mmio);
+
+// Raised by the frame counter, cleared by reading $4015 or setting inhibit
+void apu_mmio_set_frame_irq(APU_MMIO *apu_mmio, uint8_t on);
+
 #endif
@@ -0,0 +1,44 @@
+#ifndef CDL_H
+#define CDL_H
+
+#include <stdint.h>
+
+/*
+ * Code/Data Logger (NES_CDL).
+ *
+ * One flag byte per PRG ROM byte and per CHR byte, saying how the game used
+ * it. Bus pages and the PPU hold a pointer to the flags of the memory they
+ * map, so every logged access is a single unconditional OR; anything that
+ * isn't ROM points at scratch flags of the CPU or PPU that are written but
+ * never read. Each machine has its own, so machines can run on separate
+ * threads.
+ *
+ * Log files are the PRG flags followed by the CHR flags, the layout FCEUX
+ * uses for .cdl files, with the bits below. Loading a log merges it, so
+ * coverage builds up over several sessions.
+ */
+
+// PRG flags
+#define CDL_OPCODE 0x01  // First byte of an executed instruction
+#define CDL_OPERAND 0x02 // Operand byte of an executed instruction
+#define CDL_DATA 0x04    // Read by an instruction or by OAM DMA
+
+// CHR flags
+#define CDL_BG 0x01     // Fetched to draw the background
+#define CDL_SPRITE 0x02 // Fetched to draw a sprite
+
+typedef struct Cdl {
+  uint8_t *prg;
+  int prg_size;
+  uint8_t *chr;
+  int chr_size;
+} Cdl;
+
+Cdl *cdl_create(int prg_size, int chr_size);
+void cdl_destroy(Cdl *cdl);
+
+// Returns 0 if the file can't be read or was logged from another ROM size
+int cdl_load(Cdl *cdl, const char *filename);
+int cdl_save(const Cdl *cdl, const char *filename);
+
+#endif
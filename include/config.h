@@ -6,8 +6,81 @@
 #define NES_HEADER_SIZE 16
 #endif
 
-#ifndef NES_TEST_ROM
-#define NES_TEST_ROM 0
+// CPU dispatch core
+// 1 = fused per-opcode handlers (computed goto, switch fallback)
+// 0 = table-driven dispatch through lookup_table
+#ifndef CPU_FUSED_DISPATCH
+#define CPU_FUSED_DISPATCH 1
+#endif
+
+// Execute PRG code from pre-decoded basic blocks (see cpu/block_cache.h)
+#ifndef CPU_BLOCK_CACHE
+#define CPU_BLOCK_CACHE 1
+#endif
+
+// Translate hot blocks to native x86-64 code (see cpu/jit.h)
+// Needs CPU_BLOCK_CACHE. Build with `make JIT=1`.
+#ifndef CPU_JIT
+#define CPU_JIT 0
+#endif
+
+#if CPU_JIT && !CPU_BLOCK_CACHE
+#error "CPU_JIT requires CPU_BLOCK_CACHE"
+#endif
+
+// Link a PRG translation generated by tools/recompile.c (see cpu/recomp.h)
+// Build with `make RECOMP=path/to/game.c`.
+#ifndef CPU_RECOMP
+#define CPU_RECOMP 0
+#endif
+
+// Put every bus access an instruction or interrupt makes on the master clock
+// as it happens, dummy reads and writes included, so PPU and APU registers
+// are read and written on the right dot.
+// Slower; 0 keeps the batched core that accounts for the whole instruction
+// when it retires. Build with `make ACCURATE=1`.
+#ifndef CPU_CYCLE_ACCURATE
+#define CPU_CYCLE_ACCURATE 0
+#endif
+
+#if CPU_CYCLE_ACCURATE && (CPU_JIT || CPU_RECOMP)
+#error "CPU_CYCLE_ACCURATE can't be combined with CPU_JIT or CPU_RECOMP"
+#endif
+
+// Fast-forward side-effect-free wait loops to the next PPU event
+// (see cpu/idle.h)
+#ifndef CPU_IDLE_SKIP
+#define CPU_IDLE_SKIP 1
+#endif
+
+// Build in the per-PC and per-subroutine cycle profiler (see cpu/profile.h).
+// Profiled runs interpret every instruction. Build with `make PROFILE=1`.
+#ifndef CPU_PROFILE
+#define CPU_PROFILE 0
+#endif
+
+// Build in the opcode, page-cross and branch counters (see cpu/stats.h).
+// Build with `make STATS=1`.
+#ifndef CPU_STATS
+#define CPU_STATS 0
+#endif
+
+// Build in the Code/Data Logger for PRG and CHR (see cdl.h). Logged runs
+// interpret every instruction. Build with `make CDL=1`.
+#ifndef NES_CDL
+#define NES_CDL 0
+#endif
+
+// Build in breakpoints and watchpoints (see cpu/debug.h). Debugged runs
+// interpret every instruction. Build with `make DEBUGGER=1`.
+#ifndef NES_DEBUGGER
+#define NES_DEBUGGER 0
+#endif
+
+// Add the rows of the test ROMs in rom/tests to the game database (see
+// romdb.c). Only bin/test_roms is built with them.
+#ifndef ROMDB_TEST_ROMS
+#define ROMDB_TEST_ROMS 0
 #endif
 
 #define TILE_SIZE 8
@@ -0,0 +1,91 @@
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include "cpu/cpu.h"
+#include <stdint.h>
+
+/*
+ * Pre-decoded basic-block cache.
+ *
+ * Straight-line runs of code are decoded once into an array of micro-ops
+ * holding the opcode and its operand, so cpu_execute does not re-fetch and
+ * re-decode the same bytes every time a game loop comes around. A block ends
+ * at the first branch, jump, subroutine call/return or BRK, or at an opcode
+ * the fused handlers do not cover.
+ *
+ * Each page of the address space has a generation number that blocks record
+ * when they are decoded. Pages that hold cached code and are writable through
+ * the page table have their direct write pointer swapped for a handler, so
+ * the first write to such a page bumps its generation and drops every block
+ * that was decoded from it.
+ */
+
+#define BLOCK_CACHE_SLOTS 8192 // Direct-mapped on the block's start PC
+#define BLOCK_MAX_UOPS 16
+
+// Operand bytes fetched by each addressing mode
+#define UOP_BYTES_NULL 0
+#define UOP_BYTES_addr_imm 1
+#define UOP_BYTES_addr_zpg 1
+#define UOP_BYTES_addr_zpg_X 1
+#define UOP_BYTES_addr_zpg_Y 1
+#define UOP_BYTES_addr_X_ind 1
+#define UOP_BYTES_addr_ind_Y 1
+#define UOP_BYTES_addr_abs 2
+#define UOP_BYTES_addr_abs_X 2
+#define UOP_BYTES_addr_abs_Y 2
+#define UOP_BYTES_addr_ind 2
+#define UOP_BYTES_addr_ind_jmp 2
+#define UOP_BYTES_addr_jsr 2
+
+typedef struct Uop {
+  uint16_t pc;
+  uint16_t operand;
+  uint8_t opcode;
+  uint8_t len; // Instruction length in bytes, 0 terminates the block
+} Uop;
+
+typedef struct Block {
+  uint16_t pc;
+  uint8_t first_page;
+  uint8_t last_page;
+  uint32_t first_gen;
+  uint32_t last_gen;
+
+  // 0 marks an empty slot
+  uint8_t count;
+  Uop uops[BLOCK_MAX_UOPS + 1];
+
+  // Translated code (CPU_JIT), dropped whenever the block is re-decoded
+  uint16_t hits;
+  void *native;
+} Block;
+
+typedef struct BlockCache {
+  uint32_t page_gen[256];
+
+  // Original write side of pages that currently hold cached code
+  uint8_t *code_write_ptr[256];
+  BusWrite code_write[256];
+  uint8_t code_page[256];
+
+  Block blocks[BLOCK_CACHE_SLOTS];
+} BlockCache;
+
+BlockCache *block_cache_create(void);
+void block_cache_destroy(BlockCache *cache);
+
+const Uop *block_cache_lookup(Cpu6502 *cpu, uint16_t pc);
+void block_cache_invalidate_page(Cpu6502 *cpu, uint8_t page);
+
+// Micro-op for the instruction at PC, or NULL if it can't be cached
+static inline const Uop *block_cache_fetch(Cpu6502 *cpu) {
+  const Uop *uop = cpu->uop;
+
+  if (uop && uop->len && uop->pc == cpu->PC)
+    return uop;
+
+  return block_cache_lookup(cpu, cpu->PC);
+}
+
+#endif
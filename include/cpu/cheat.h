@@ -0,0 +1,56 @@
+#ifndef CHEAT_H
+#define CHEAT_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Game Genie codes and frozen RAM.
+ *
+ * A cheat replaces what the CPU reads at one address:
+ *
+ *   Game Genie codes, 6 or 8 letters, patch PRG ROM at $8000-$FFFF. An 8
+ *   letter code only replaces the byte while the ROM holds its compare
+ *   value, so it leaves other banks of a switched ROM alone.
+ *   Raw codes are AAAA:VV or AAAA:VV:CC in hex, CC being the compare value.
+ *   Below $8000 they freeze the address, through every mirror of it: the
+ *   game still writes there, but reads always see VV.
+ *
+ * Cheats only touch the pages they are on. Such a page is taken off the
+ * direct path, its read_ptr set to NULL and its reads routed through the
+ * cheat table, the same way the block cache takes writes to code pages. Every
+ * other page keeps its pointer, so with no cheats there is nothing to test
+ * and pages without cheats run as before. Code on a patched page is
+ * interpreted from what the cheats make of it; the block cache, the wait-loop
+ * detector and recompiled PRG don't look through cheat pages.
+ */
+
+// Cheats active at once
+#define CHEAT_MAX 64
+
+struct Cpu6502;
+struct Cheats;
+
+// Adds a cheat to cpu. Returns its number, -1 if the code doesn't parse or
+// none are left. A code for an address that already has one replaces it.
+int cheat_add(struct Cpu6502 *cpu, const char *code);
+
+// One code per line, then an optional description. Blank lines and lines
+// starting with # are skipped. Returns the number of cheats added, with the
+// first line that didn't add one in *bad_line (0 if all did).
+int cheat_load(struct Cpu6502 *cpu, FILE *file, int *bad_line);
+
+void cheat_remove(struct Cpu6502 *cpu, int cheat);
+
+// Removes every cheat and puts the pages back
+void cheat_clear(struct Cpu6502 *cpu);
+
+// The page was remapped (cpu_bus_map), take it again if it has cheats
+void cheat_map_page(struct Cpu6502 *cpu, int page);
+
+// Decodes a Game Genie code. Returns 0 if it isn't one; compare is -1 for 6
+// letter codes.
+int cheat_decode_genie(const char *code, uint16_t *addr, uint8_t *value,
+                       int *compare);
+
+#endif
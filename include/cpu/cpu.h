@@ -2,11 +2,75 @@
 #define CPU_H
 
 #include "apu/apu_mmio.h"
+#include "cdl.h"
+#include "cpu/irq.h"
 #include "ppu.h"
+#include "scheduler.h"
 #include <stdint.h>
 #include <stdio.h>
 #include <sys/types.h>
 
+#define CPU_RAM_SIZE 0x800  // 2 KB internal RAM, mirrored up to $1FFF
+#define PRG_RAM_SIZE 0x2000 // 8 KB cartridge RAM at $6000-$7FFF
+
+// Status register flags
+#define FLAG_C 0x01
+#define FLAG_Z 0x02
+#define FLAG_I 0x04
+#define FLAG_D 0x08
+#define FLAG_B 0x10
+#define FLAG_U 0x20
+#define FLAG_V 0x40
+#define FLAG_N 0x80
+
+struct Cpu6502;
+struct BlockCache;
+struct Uop;
+struct Jit;
+struct Trace;
+struct Debugger;
+struct Cheats;
+struct Mapper;
+
+typedef uint8_t (*BusRead)(struct Cpu6502 *cpu, uint16_t addr);
+typedef void (*BusWrite)(struct Cpu6502 *cpu, uint16_t addr, uint8_t val);
+
+// One entry per 256-byte page of the CPU address space. A page is either
+// backed by host memory (read_ptr/write_ptr point at the start of the page)
+// or, when the pointer is NULL, routed to its read/write handler.
+typedef struct BusPage {
+  const uint8_t *read_ptr;
+  uint8_t *write_ptr;
+  BusRead read;
+  BusWrite write;
+
+  // Code/Data Logger flags for the page, the CPU's cdl_scratch unless it is
+  // PRG ROM
+  uint8_t *cdl;
+
+  // Debugger watch flags of any address in the page, 0 when none is armed
+  uint8_t watch;
+} BusPage;
+
+// Wait-loop detector state (see cpu/idle.h). Addresses are -1 when unset.
+typedef struct IdleLoop {
+  int head;     // First instruction of the loop being watched
+  int end;      // Its closing branch or jump
+  int length;   // Instructions per iteration
+  int polls_ppu; // The body reads PPUSTATUS
+  int rejected; // Last candidate that failed the scan
+  int last_pc;  // PC at the previous call
+
+  // State the last time the loop came around
+  int valid;
+  uint8_t A, X, Y, S, P;
+  uint16_t nz;
+  uint8_t ppu_status;
+  int event_dots; // Dots left until the next scheduled event
+  uint64_t cycle;
+  int instr_num;
+} IdleLoop;
+
 typedef struct Cpu6502 {
 
   int cycles;
@@ -36,8 +100,12 @@ typedef struct Cpu6502 {
   Bit 2 - I: Interrupt
   Bit 1 - Z: Zero
   Bit 0 - C: Carry
+
+  N and Z are not kept in P. They are derived lazily from nz, the last
+  result byte, and only materialized by cpu_get_status.
   **/
-  unsigned char P[8];
+  uint8_t P;
+  uint16_t nz;
 
   PPU *ppu;
 
@@ -49,22 +117,111 @@ typedef struct Cpu6502 {
 
   APU_MMIO *apu_mmio;
 
-  int cpu_cycle_count;
+  uint64_t cpu_cycle_count;
+
+  // Master clock and timed events (see scheduler.h). The PPU has been run up
+  // to ppu_time and is caught up to sched.now when the CPU looks at it.
+  Scheduler sched;
+  uint64_t ppu_time;
+
+  // IRQ input, shared by the APU and the cartridge (see cpu/irq.h)
+  IrqLine irq;
+
+  // Internal RAM, and the cartridge's RAM and PRG ROM. ROM is the loaded
+  // image itself, never written through the bus.
+  uint8_t ram[CPU_RAM_SIZE];
+  uint8_t prg_ram[PRG_RAM_SIZE];
+  const uint8_t *prg_rom;
+  int prg_size;
+
+  // Page table for every CPU access, filled in by cpu_bus_init
+  BusPage bus[256];
+
+  // Pre-decoded blocks and the next micro-op of the running block
+  struct BlockCache *block_cache;
+  const struct Uop *uop;
+
+  // Native code backend, NULL when translation is off (see cpu/jit.h)
+  struct Jit *jit;
+
+  // Statically recompiled PRG (see cpu/recomp.h), NULL if none is attached
+  int (*recomp)(struct Cpu6502 *cpu);
+
+  // Wait-loop fast-forwarding
+  IdleLoop idle;
+
+  // Per-instruction timing state
+  int bus_cycles; // Already on the clock (CPU_CYCLE_ACCURATE)
+  int page_crossed;
+  int branch_instr;
+  int branch_cycles;
+
+  // OAM DMA stall, charged as one block when the writing instruction retires
+  unsigned char dma_active_flag;
+  int dma_cycles;
+
+  int instr_num;
+
+  // Binary instruction trace (see cpu/trace.h), NULL when not tracing
+  struct Trace *trace;
+
+  // Cycle profiler (see cpu/profile.h), NULL when not profiling
+  struct Profile *profile;
+
+  // Opcode counters (see cpu/stats.h), NULL when not counting
+  struct CpuStats *stats;
+
+  // Code/Data Logger (see cdl.h), NULL when not logging
+  Cdl *cdl;
+
+  // Flags of the pages that aren't logged, written but never read
+  uint8_t cdl_scratch[0x100];
+
+  // Breakpoints and watchpoints (see cpu/debug.h), NULL when not debugging
+  struct Debugger *debug;
+
+  // Game Genie codes and frozen RAM (see cpu/cheat.h), NULL when none
+  struct Cheats *cheats;
+
+  // Cartridge board (see mapper/mapper.h), NULL for a fixed PRG image
+  struct Mapper *mapper;
 } Cpu6502;
 
 void cpu_init(Cpu6502 *cpu);
 
-void load_cpu_memory(Cpu6502 *cpu, unsigned char *prg_rom, int prg_size);
+// Maps prg_rom in place, it must outlive the CPU
+void load_cpu_memory(Cpu6502 *cpu, const uint8_t *prg_rom, int prg_size);
 
 // void load_cpu_mem(Cpu6502 *cpu, char *filename);
 void load_test_rom(Cpu6502 *cpu);
 void cpu_execute(Cpu6502 *cpu);
 
-void push_stack(uint8_t lower_addr, uint8_t val);
+// Run the PPU up to the master clock
+void cpu_ppu_sync(Cpu6502 *cpu);
+
+void cpu_nmi_triggered(Cpu6502 *cpu);
+void cpu_irq_triggered(Cpu6502 *cpu);
+void cpu_reset(Cpu6502 *cpu);
+
+void push_stack(Cpu6502 *cpu, uint8_t lower_addr, uint8_t val);
+
+// Bus
+uint8_t read_instr(Cpu6502 *cpu, uint16_t addr);
+void memory_write(Cpu6502 *cpu, uint16_t addr, uint8_t value);
+void cpu_bus_init(Cpu6502 *cpu);
+void cpu_bus_map(Cpu6502 *cpu, int first_page, int last_page,
+                 const uint8_t *read_base, uint8_t *write_base, BusRead read,
+                 BusWrite write);
+
+// Start logging PRG accesses and the PPU's CHR fetches to cdl
+void cpu_cdl_attach(Cpu6502 *cpu, Cdl *cdl);
 void dump_log(Cpu6502 *cpu, FILE *log);
 
 void cpu_cleanup(Cpu6502 *cpu);
 
+uint8_t cpu_get_status(Cpu6502 *cpu);
+void cpu_set_status(Cpu6502 *cpu, uint8_t status);
+
 // Address modes
 uint16_t addr_abs(Cpu6502 *cpu);
 uint16_t addr_abs_X(Cpu6502 *cpu);
@@ -73,6 +230,7 @@ uint16_t addr_imm(Cpu6502 *cpu);
 uint16_t addr_ind(Cpu6502 *cpu);
 uint16_t addr_X_ind(Cpu6502 *cpu);
 uint16_t addr_ind_Y(Cpu6502 *cpu);
+uint16_t addr_jsr(Cpu6502 *cpu);
 uint16_t addr_zpg(Cpu6502 *cpu);
 uint16_t addr_zpg_X(Cpu6502 *cpu);
 uint16_t addr_zpg_Y(Cpu6502 *cpu);
@@ -154,6 +312,7 @@ void instr_CLV(Cpu6502 *cpu);
 
 // Other
 void instr_NOP(Cpu6502 *cpu);
+void instr_IGN(Cpu6502 *cpu, uint16_t addr);
 
 // illegal opcodes
 void instr_LAX(Cpu6502 *cpu, uint8_t val);
@@ -195,4 +354,12 @@ typedef struct Opcode {
   InstrType instr_type;
 } Opcode;
 
+extern const Opcode lookup_table[256];
+
+// Support for statically recompiled code
+void cpu_exec_decoded(Cpu6502 *cpu, uint8_t opcode, uint16_t pc,
+                      uint16_t operand);
+void cpu_bus_modify(Cpu6502 *cpu, uint16_t addr, InstrMem fn);
+int cpu_retire_instr(Cpu6502 *cpu);
+
 #endif
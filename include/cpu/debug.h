@@ -0,0 +1,67 @@
+#ifndef DEBUG_H
+#define DEBUG_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Breakpoints and watchpoints.
+ *
+ * Built in with NES_DEBUGGER (`make DEBUGGER=1`); without it the hooks
+ * compile out. Every point is folded into per-address flags, and those
+ * into one flag byte per 256-byte page: the CPU's in BusPage.watch, the
+ * PPU's here. An access only looks further when its page is flagged, so a
+ * run with nothing armed on a page pays a single test per access.
+ *
+ *   PC breakpoints and execute watchpoints stop before the instruction runs.
+ *   Read and write watchpoints on the CPU bus cover the data accesses
+ *   instructions make; on the PPU bus they cover $2007 accesses. They stop
+ *   once the instruction that made the access retires.
+ *   Scanline/dot breakpoints are a scheduled event and stop at the end of
+ *   the instruction during which the PPU reached the dot.
+ *
+ * The CPU interprets every instruction while a debugger is attached.
+ */
+
+#define WATCH_EXEC 0x01
+#define WATCH_READ 0x02
+#define WATCH_WRITE 0x04
+
+// Points armed at once, across every kind
+#define DEBUG_MAX_POINTS 64
+
+struct Cpu6502;
+struct Debugger;
+
+// Attaches a debugger to cpu. It starts stopped, at the reset vector.
+struct Debugger *debug_attach(struct Cpu6502 *cpu);
+void debug_detach(struct Cpu6502 *cpu);
+
+// Arms a point over [first, last]. Returns its number, -1 if none are left.
+int debug_watch(struct Cpu6502 *cpu, uint16_t first, uint16_t last,
+                uint8_t flags);
+int debug_watch_ppu(struct Cpu6502 *cpu, uint16_t first, uint16_t last,
+                    uint8_t flags);
+int debug_break_dot(struct Cpu6502 *cpu, int scanline, int dot);
+void debug_delete(struct Cpu6502 *cpu, int point);
+
+// Before every instruction while attached. Nonzero if the instruction at
+// PC must not run yet.
+int debug_exec(struct Cpu6502 *cpu);
+
+// Data access on a flagged CPU page
+void debug_access(struct Cpu6502 *cpu, uint16_t addr, uint8_t val,
+                  uint8_t flag);
+
+// $2007 access about to be made at the PPU's VRAM address, val is the byte
+// being written
+void debug_ppu_access(struct Cpu6502 *cpu, uint8_t val, uint8_t flag);
+
+// Called after every cpu_execute. Nonzero if a point was hit or a step
+// finished.
+int debug_stopped(struct Cpu6502 *cpu);
+
+// Reads commands until one resumes the CPU. Returns 0 on quit.
+int debug_prompt(struct Cpu6502 *cpu, FILE *in, FILE *out);
+
+#endif
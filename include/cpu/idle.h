@@ -0,0 +1,37 @@
+#ifndef IDLE_H
+#define IDLE_H
+
+#include "cpu/cpu.h"
+
+/*
+ * Wait-loop fast-forwarding (CPU_IDLE_SKIP).
+ *
+ * Games spend much of each frame spinning on loops like `LDA $2002 / BPL`
+ * or polling a RAM flag the NMI handler sets. A short backward jump makes
+ * cpu_execute scan the loop it closes. The loop qualifies if it is
+ * straight-line code that writes nothing, touches no stack, and reads only
+ * host-memory pages or PPUSTATUS. Its branches either close the loop or
+ * leave it.
+ *
+ * Such a loop can only change course when the PPU changes what it reads,
+ * which it only does on its own at VBlank, or for sprite overflow while it
+ * renders the visible lines. Loops polling PPUSTATUS aren't skipped while
+ * overflow can still be set this frame. Otherwise, if one full iteration
+ * brings every register back to the same values, each later iteration
+ * repeats it exactly until the next scheduled event. So the CPU moves the master clock
+ * over whole iterations that end before that event and leaves the PPU to
+ * catch up later. Cycle and instruction counts come out the same as
+ * interpreting, and the event itself is always interpreted.
+ */
+
+// Longest loop body that is considered, in bytes and instructions
+#define IDLE_MAX_BYTES 32
+#define IDLE_MAX_INSTRS 8
+
+void idle_loop_reset(Cpu6502 *cpu);
+
+// Called by cpu_execute for every instruction it starts. Returns 1 if it
+// fast-forwarded a wait loop; cpu->cycles then holds the cycles skipped.
+int idle_loop_skip(Cpu6502 *cpu);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef IRQ_H
+#define IRQ_H
+
+#include "scheduler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The shared, level-triggered IRQ line.
+ *
+ * Every source owns one bit and holds it for as long as it asserts the
+ * line; the CPU takes an IRQ between instructions while any bit is set and
+ * the I flag is clear. Nothing polls the line per instruction. Sources that
+ * run behind the CPU predict when they will next assert and schedule an
+ * event for it, so they are caught up in time. Raising the line, or the CPU
+ * clearing I while it is high, schedules SCHED_IRQ, and that is the only
+ * place the CPU looks at it.
+ */
+
+#define IRQ_APU_FRAME 0x01 // APU frame counter
+#define IRQ_MAPPER 0x04    // Cartridge hardware
+
+typedef struct IrqLine {
+  uint8_t sources;  // Bits of the sources asserting the line
+  Scheduler *sched; // Where the CPU is asked to check the line
+} IrqLine;
+
+static inline void irq_assert(IrqLine *irq, uint8_t source) {
+  if (!irq->sources)
+    sched_schedule(irq->sched, SCHED_IRQ, irq->sched->now);
+
+  irq->sources |= source;
+}
+
+static inline void irq_release(IrqLine *irq, uint8_t source) {
+  irq->sources &= ~source;
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "cpu/block_cache.h"
+#include "cpu/cpu.h"
+
+/*
+ * x86-64 translation of hot pre-decoded blocks (CPU_JIT).
+ *
+ * Once a block has started JIT_HOT_THRESHOLD times it is translated into a
+ * native function. Register transfers, flag operations, increments and
+ * immediate loads are emitted inline; everything else calls the same
+ * micro-op handlers the interpreter uses. Every instruction is retired
+ * through cpu_jit_retire, so the clock, cycles and events advance exactly as
+ * in cpu_execute. The block returns early when an NMI is taken, OAM DMA
+ * starts, or a write invalidates the block.
+ *
+ * The interpreter stays the reference: cpu->jit is NULL unless a caller
+ * creates one, and `make jit-check` runs both side by side.
+ */
+
+#define JIT_HOT_THRESHOLD 16
+#define JIT_CODE_SIZE (4 << 20)
+
+typedef void (*JitBlockFn)(Cpu6502 *cpu);
+
+// NULL if the backend is not compiled in or executable memory is unavailable
+struct Jit *jit_create(void);
+void jit_destroy(struct Jit *jit);
+
+// Run the block starting at uop as native code. Returns 0 if the caller
+// should interpret the instruction instead.
+int jit_execute(Cpu6502 *cpu, const Uop *uop);
+
+// Interpreter entry points used by translated code (cpu.c)
+void cpu_jit_exec_uop(Cpu6502 *cpu, const Uop *uop);
+int cpu_jit_retire(Cpu6502 *cpu);
+
+#endif
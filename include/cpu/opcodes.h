@@ -0,0 +1,253 @@
+#ifndef OPCODES_H
+#define OPCODES_H
+
+/*
+ * 6502 opcode definitions, one row per implemented opcode:
+ *
+ *   X(opcode, instr_type, addr_mode, instr, cycles, page_cycles, mnemonic)
+ *
+ * instr_type selects how the operand reaches the instruction (see InstrType):
+ *   NONE - implied, the instruction fetches its own operand (branches, BRK)
+ *   ADDR - the effective address is passed
+ *   VAL  - the byte at the effective address is passed
+ *   MEM  - a pointer to the byte at the effective address is passed
+ *   ACC  - a pointer to the accumulator is passed
+ *
+ * cpu.c expands this list into lookup_table and into the fused dispatch core,
+ * so both paths are generated from the same definition.
+ */
+#define CPU_OPCODES(X)                                                         \
+  X(0x00, NONE, NULL, instr_BRK, 7, 0, "BRK")                                  \
+  X(0x01, VAL, addr_X_ind, instr_ORA, 6, 0, "ORA ind,X")                       \
+  X(0x03, MEM, addr_X_ind, instr_SLO, 8, 0, "SLO ind,X")                       \
+  X(0x04, ADDR, addr_zpg, instr_IGN, 3, 0, "NOP zpg")                          \
+  X(0x05, VAL, addr_zpg, instr_ORA, 3, 0, "ORA zpg")                           \
+  X(0x06, MEM, addr_zpg, instr_ASL, 5, 0, "ASL zpg")                           \
+  X(0x07, MEM, addr_zpg, instr_SLO, 5, 0, "SLO zpg")                           \
+  X(0x08, NONE, NULL, instr_PHP, 3, 0, "PHP impl")                             \
+  X(0x09, VAL, addr_imm, instr_ORA, 2, 0, "ORA #")                             \
+  X(0x0A, ACC, NULL, instr_ASL, 2, 0, "ASL A")                                 \
+  X(0x0C, ADDR, addr_abs, instr_IGN, 4, 0, "NOP abs")                          \
+  X(0x0D, VAL, addr_abs, instr_ORA, 4, 0, "ORA abs")                           \
+  X(0x0E, MEM, addr_abs, instr_ASL, 6, 0, "ASL abs")                           \
+  X(0x0F, MEM, addr_abs, instr_SLO, 6, 0, "SLO abs")                           \
+  X(0x10, NONE, NULL, instr_BPL, 2, 1, "BPL rel")                              \
+  X(0x11, VAL, addr_ind_Y, instr_ORA, 5, 1, "ORA (ind),Y")                     \
+  X(0x13, MEM, addr_ind_Y, instr_SLO, 8, 0, "SLO (ind),Y")                     \
+  X(0x14, ADDR, addr_zpg_X, instr_IGN, 4, 0, "NOP zpg,X")                      \
+  X(0x15, VAL, addr_zpg_X, instr_ORA, 4, 0, "ORA zpg,X")                       \
+  X(0x16, MEM, addr_zpg_X, instr_ASL, 6, 0, "ASL zpg,X")                       \
+  X(0x17, MEM, addr_zpg_X, instr_SLO, 6, 0, "SLO zpg,X")                       \
+  X(0x18, NONE, NULL, instr_CLC, 2, 0, "CLC")                                  \
+  X(0x19, VAL, addr_abs_Y, instr_ORA, 4, 1, "ORA abs,Y")                       \
+  X(0x1A, NONE, NULL, instr_NOP, 2, 0, "NOP")                                  \
+  X(0x1B, MEM, addr_abs_Y, instr_SLO, 7, 0, "SLO abs,Y")                       \
+  X(0x1C, ADDR, addr_abs_X, instr_IGN, 4, 1, "NOP abs,X")                      \
+  X(0x1D, VAL, addr_abs_X, instr_ORA, 4, 1, "ORA abs,X")                       \
+  X(0x1E, MEM, addr_abs_X, instr_ASL, 7, 0, "ASL abs,X")                       \
+  X(0x1F, MEM, addr_abs_X, instr_SLO, 7, 0, "SLO abs,X")                       \
+  X(0x20, ADDR, addr_jsr, instr_JSR, 6, 0, "JSR")                              \
+  X(0x21, VAL, addr_X_ind, instr_AND, 6, 0, "AND")                             \
+  X(0x23, MEM, addr_X_ind, instr_RLA, 8, 0, "RLA")                             \
+  X(0x24, VAL, addr_zpg, instr_BIT, 3, 0, "BIT")                               \
+  X(0x25, VAL, addr_zpg, instr_AND, 3, 0, "AND")                               \
+  X(0x26, MEM, addr_zpg, instr_ROL, 5, 0, "ROL")                               \
+  X(0x27, MEM, addr_zpg, instr_RLA, 5, 0, "RLA")                               \
+  X(0x28, NONE, NULL, instr_PLP, 4, 0, "PLP")                                  \
+  X(0x29, VAL, addr_imm, instr_AND, 2, 0, "AND")                               \
+  X(0x2A, ACC, NULL, instr_ROL, 2, 0, "ROL A")                                 \
+  X(0x2C, VAL, addr_abs, instr_BIT, 4, 0, "BIT")                               \
+  X(0x2D, VAL, addr_abs, instr_AND, 4, 0, "AND")                               \
+  X(0x2E, MEM, addr_abs, instr_ROL, 6, 0, "ROL")                               \
+  X(0x2F, MEM, addr_abs, instr_RLA, 6, 0, "RLA")                               \
+  X(0x30, NONE, NULL, instr_BMI, 2, 1, "BMI rel")                              \
+  X(0x31, VAL, addr_ind_Y, instr_AND, 5, 1, "AND (ind),Y")                     \
+  X(0x33, MEM, addr_ind_Y, instr_RLA, 8, 0, "RLA (ind),Y")                     \
+  X(0x34, ADDR, addr_zpg_X, instr_IGN, 4, 0, "NOP zpg,X")                      \
+  X(0x35, VAL, addr_zpg_X, instr_AND, 4, 0, "AND zpg,X")                       \
+  X(0x36, MEM, addr_zpg_X, instr_ROL, 6, 0, "ROL zpg,X")                       \
+  X(0x37, MEM, addr_zpg_X, instr_RLA, 6, 0, "RLA zpg")                         \
+  X(0x38, NONE, NULL, instr_SEC, 2, 0, "SEC")                                  \
+  X(0x39, VAL, addr_abs_Y, instr_AND, 4, 1, "AND abs,Y")                       \
+  X(0x3A, NONE, NULL, instr_NOP, 2, 0, "NOP")                                  \
+  X(0x3B, MEM, addr_abs_Y, instr_RLA, 7, 0, "RLA abs,Y")                       \
+  X(0x3C, ADDR, addr_abs_X, instr_IGN, 4, 1, "NOP abs,X")                      \
+  X(0x3D, VAL, addr_abs_X, instr_AND, 4, 1, "AND abs,X")                       \
+  X(0x3E, MEM, addr_abs_X, instr_ROL, 7, 0, "ROL abs,X")                       \
+  X(0x3F, MEM, addr_abs_X, instr_RLA, 7, 0, "RLA abs,X")                       \
+  X(0x40, NONE, NULL, instr_RTI, 6, 0, "RTI")                                  \
+  X(0x41, VAL, addr_X_ind, instr_EOR, 6, 0, "EOR")                             \
+  X(0x43, MEM, addr_X_ind, instr_SRE, 8, 0, "SRE")                             \
+  X(0x44, ADDR, addr_zpg, instr_IGN, 3, 0, "NOP")                              \
+  X(0x45, VAL, addr_zpg, instr_EOR, 3, 0, "EOR")                               \
+  X(0x46, MEM, addr_zpg, instr_LSR, 5, 0, "LSR")                               \
+  X(0x47, MEM, addr_zpg, instr_SRE, 5, 0, "SRE")                               \
+  X(0x48, NONE, NULL, instr_PHA, 3, 0, "PHA")                                  \
+  X(0x49, VAL, addr_imm, instr_EOR, 2, 0, "EOR")                               \
+  X(0x4A, ACC, NULL, instr_LSR, 2, 0, "LSR A")                                 \
+  X(0x4B, MEM, addr_abs_Y, instr_SRE, 7, 0, "SRE")                             \
+  X(0x4C, ADDR, addr_abs, instr_JMP, 3, 0, "JMP")                              \
+  X(0x4D, VAL, addr_abs, instr_EOR, 4, 0, "EOR")                               \
+  X(0x4E, MEM, addr_abs, instr_LSR, 6, 0, "LSR")                               \
+  X(0x4F, MEM, addr_abs, instr_SRE, 6, 0, "SRE")                               \
+  X(0x50, NONE, NULL, instr_BVC, 2, 0, "BVC")                                  \
+  X(0x51, VAL, addr_ind_Y, instr_EOR, 5, 1, "EOR")                             \
+  X(0x53, MEM, addr_ind_Y, instr_SRE, 8, 0, "SRE")                             \
+  X(0x54, ADDR, addr_zpg_X, instr_IGN, 4, 0, "NOP zpg,X")                      \
+  X(0x55, VAL, addr_zpg_X, instr_EOR, 4, 0, "EOR")                             \
+  X(0x56, MEM, addr_zpg_X, instr_LSR, 6, 0, "LSR")                             \
+  X(0x57, MEM, addr_zpg_X, instr_SRE, 6, 0, "SRE")                             \
+  X(0x58, NONE, NULL, instr_CLI, 2, 0, "CLI")                                  \
+  X(0x59, VAL, addr_abs_Y, instr_EOR, 4, 1, "EOR")                             \
+  X(0x5A, NONE, NULL, instr_NOP, 2, 0, "NOP")                                  \
+  X(0x5B, MEM, addr_abs_Y, instr_SRE, 7, 0, "SRE")                             \
+  X(0x5C, ADDR, addr_abs_X, instr_IGN, 4, 1, "NOP abs,X")                      \
+  X(0x5D, VAL, addr_abs_X, instr_EOR, 4, 1, "EOR")                             \
+  X(0x5E, MEM, addr_abs_X, instr_LSR, 7, 0, "LSR")                             \
+  X(0x5F, MEM, addr_abs_X, instr_SRE, 7, 0, "SRE")                             \
+  X(0x60, NONE, NULL, instr_RTS, 6, 0, "RTS")                                  \
+  X(0x61, VAL, addr_X_ind, instr_ADC, 6, 0, "ADC")                             \
+  X(0x63, MEM, addr_X_ind, instr_RRA, 8, 0, "RRA")                             \
+  X(0x64, ADDR, addr_zpg, instr_IGN, 3, 0, "NOP")                              \
+  X(0x65, VAL, addr_zpg, instr_ADC, 3, 0, "ADC")                               \
+  X(0x66, MEM, addr_zpg, instr_ROR, 5, 0, "ROR")                               \
+  X(0x67, MEM, addr_zpg, instr_RRA, 5, 0, "RRA")                               \
+  X(0x68, NONE, NULL, instr_PLA, 4, 0, "PLA")                                  \
+  X(0x69, VAL, addr_imm, instr_ADC, 2, 0, "ADC")                               \
+  X(0x6A, ACC, NULL, instr_ROR, 2, 0, "ROR")                                   \
+  X(0x6C, ADDR, addr_ind_jmp, instr_JMP, 5, 0, "JMP")                          \
+  X(0x6D, VAL, addr_abs, instr_ADC, 4, 0, "ADC")                               \
+  X(0x6E, MEM, addr_abs, instr_ROR, 6, 0, "ROR")                               \
+  X(0x6F, MEM, addr_abs, instr_RRA, 6, 0, "RRA")                               \
+  X(0x70, NONE, NULL, instr_BVS, 2, 0, "BVS")                                  \
+  X(0x71, VAL, addr_ind_Y, instr_ADC, 5, 1, "ADC")                             \
+  X(0x73, MEM, addr_ind_Y, instr_RRA, 8, 0, "RRA")                             \
+  X(0x74, ADDR, addr_zpg_X, instr_IGN, 4, 0, "NOP")                            \
+  X(0x75, VAL, addr_zpg_X, instr_ADC, 4, 0, "ADC")                             \
+  X(0x76, MEM, addr_zpg_X, instr_ROR, 6, 0, "ROR")                             \
+  X(0x77, MEM, addr_zpg_X, instr_RRA, 6, 0, "RRA")                             \
+  X(0x78, NONE, NULL, instr_SEI, 2, 0, "SEI")                                  \
+  X(0x79, VAL, addr_abs_Y, instr_ADC, 4, 1, "ADC")                             \
+  X(0x7A, NONE, NULL, instr_NOP, 2, 0, "NOP")                                  \
+  X(0x7B, MEM, addr_abs_X, instr_RRA, 7, 0, "RRA")                             \
+  X(0x7C, ADDR, addr_abs_X, instr_IGN, 4, 1, "NOP")                            \
+  X(0x7D, VAL, addr_abs_X, instr_ADC, 4, 1, "ADC")                             \
+  X(0x7E, MEM, addr_abs_X, instr_ROR, 7, 0, "ROR")                             \
+  X(0x7F, MEM, addr_abs_X, instr_RRA, 7, 0, "RRA")                             \
+  X(0x80, ADDR, addr_imm, instr_IGN, 2, 0, "NOP")                              \
+  X(0x81, ADDR, addr_X_ind, instr_STA, 6, 0, "STA")                            \
+  X(0x82, ADDR, addr_imm, instr_IGN, 2, 0, "NOP")                              \
+  X(0x83, ADDR, addr_X_ind, instr_SAX, 6, 0, "SAX")                            \
+  X(0x84, ADDR, addr_zpg, instr_STY, 3, 0, "STY")                              \
+  X(0x85, ADDR, addr_zpg, instr_STA, 3, 0, "STA")                              \
+  X(0x86, ADDR, addr_zpg, instr_STX, 3, 0, "STX")                              \
+  X(0x87, ADDR, addr_zpg, instr_SAX, 3, 0, "SAX")                              \
+  X(0x88, NONE, NULL, instr_DEY, 2, 0, "DEY")                                  \
+  X(0x89, ADDR, addr_imm, instr_IGN, 2, 0, "NOP #")                            \
+  X(0x8A, NONE, NULL, instr_TXA, 2, 0, "TXA")                                  \
+  X(0x8C, ADDR, addr_abs, instr_STY, 4, 0, "STY abs")                          \
+  X(0x8D, ADDR, addr_abs, instr_STA, 4, 0, "STA abs")                          \
+  X(0x8E, ADDR, addr_abs, instr_STX, 4, 0, "STX abs")                          \
+  X(0x8F, ADDR, addr_abs, instr_SAX, 4, 0, "SAX abs")                          \
+  X(0x90, NONE, NULL, instr_BCC, 2, 1, "BCC rel")                              \
+  X(0x91, ADDR, addr_ind_Y, instr_STA, 6, 0, "STA ind,Y")                      \
+  X(0x94, ADDR, addr_zpg_X, instr_STY, 4, 0, "STY zpg,X")                      \
+  X(0x95, ADDR, addr_zpg_X, instr_STA, 4, 0, "STA zpg,X")                      \
+  X(0x96, ADDR, addr_zpg_Y, instr_STX, 4, 0, "STX zpg,Y")                      \
+  X(0x97, ADDR, addr_zpg_Y, instr_SAX, 4, 0, "SAX zpg,Y")                      \
+  X(0x98, NONE, NULL, instr_TYA, 2, 0, "TYA")                                  \
+  X(0x99, ADDR, addr_abs_Y, instr_STA, 5, 0, "STA abs,Y")                      \
+  X(0x9A, NONE, NULL, instr_TXS, 2, 0, "TXS")                                  \
+  X(0x9D, ADDR, addr_abs_X, instr_STA, 5, 0, "STA abs,X")                      \
+  X(0xA0, ADDR, addr_imm, instr_LDY, 2, 0, "LDY #")                            \
+  X(0xA1, ADDR, addr_X_ind, instr_LDA, 6, 0, "LDA ind,X")                      \
+  X(0xA2, ADDR, addr_imm, instr_LDX, 2, 0, "LDX #")                            \
+  X(0xA3, VAL, addr_X_ind, instr_LAX, 6, 0, "LAX ind,X")                       \
+  X(0xA4, ADDR, addr_zpg, instr_LDY, 3, 0, "LDY zpg")                          \
+  X(0xA5, ADDR, addr_zpg, instr_LDA, 3, 0, "LDA zpg")                          \
+  X(0xA6, ADDR, addr_zpg, instr_LDX, 3, 0, "LDX zpg")                          \
+  X(0xA7, VAL, addr_zpg, instr_LAX, 3, 0, "LAX zpg")                           \
+  X(0xA8, NONE, NULL, instr_TAY, 2, 0, "TAY impl")                             \
+  X(0xA9, ADDR, addr_imm, instr_LDA, 2, 0, "LDA #")                            \
+  X(0xAA, NONE, NULL, instr_TAX, 2, 0, "TAX impl")                             \
+  X(0xAC, ADDR, addr_abs, instr_LDY, 4, 1, "LDY abs")                          \
+  X(0xAD, ADDR, addr_abs, instr_LDA, 4, 1, "LDA abs")                          \
+  X(0xAE, ADDR, addr_abs, instr_LDX, 4, 1, "LDX abs")                          \
+  X(0xAF, VAL, addr_abs, instr_LAX, 4, 1, "LAX abs")                           \
+  X(0xB0, NONE, NULL, instr_BCS, 2, 0, "BCS")                                  \
+  X(0xB1, ADDR, addr_ind_Y, instr_LDA, 5, 1, "LDA (ind),Y")                    \
+  X(0xB3, VAL, addr_ind_Y, instr_LAX, 5, 1, "LAX (ind),Y")                     \
+  X(0xB4, ADDR, addr_zpg_X, instr_LDY, 4, 0, "LDY zpg,X")                      \
+  X(0xB5, ADDR, addr_zpg_X, instr_LDA, 4, 0, "LDA zpg,X")                      \
+  X(0xB6, ADDR, addr_zpg_Y, instr_LDX, 4, 0, "LDX zpg,Y")                      \
+  X(0xB7, VAL, addr_zpg_Y, instr_LAX, 4, 0, "LAX zpg,Y")                       \
+  X(0xB8, NONE, NULL, instr_CLV, 2, 0, "CLV")                                  \
+  X(0xB9, ADDR, addr_abs_Y, instr_LDA, 4, 1, "LDA abs,Y")                      \
+  X(0xBA, NONE, NULL, instr_TSX, 2, 0, "TSX")                                  \
+  X(0xBC, ADDR, addr_abs_X, instr_LDY, 4, 1, "LDY abs,X")                      \
+  X(0xBD, ADDR, addr_abs_X, instr_LDA, 4, 1, "LDA abs,X")                      \
+  X(0xBE, ADDR, addr_abs_Y, instr_LDX, 4, 1, "LDX abs,Y")                      \
+  X(0xBF, VAL, addr_abs_Y, instr_LAX, 4, 1, "LAX abs,Y")                       \
+  X(0xC0, VAL, addr_imm, instr_CPY, 2, 0, "CPY #")                             \
+  X(0xC1, VAL, addr_X_ind, instr_CMP, 6, 0, "CMP X,ind")                       \
+  X(0xC2, ADDR, addr_imm, instr_IGN, 2, 0, "NOP #")                            \
+  X(0xC3, MEM, addr_X_ind, instr_DCP, 8, 0, "DCP X,ind")                       \
+  X(0xC4, VAL, addr_zpg, instr_CPY, 3, 0, "CPY zpg")                           \
+  X(0xC5, VAL, addr_zpg, instr_CMP, 3, 0, "CMP zpg")                           \
+  X(0xC6, MEM, addr_zpg, instr_DEC, 5, 0, "DEC zpg")                           \
+  X(0xC7, MEM, addr_zpg, instr_DCP, 5, 0, "DCP zpg")                           \
+  X(0xC8, NONE, NULL, instr_INY, 2, 0, "INY")                                  \
+  X(0xC9, VAL, addr_imm, instr_CMP, 2, 0, "CMP #")                             \
+  X(0xCA, NONE, NULL, instr_DEX, 2, 0, "DEX")                                  \
+  X(0xCC, VAL, addr_abs, instr_CPY, 4, 0, "CPY abs")                           \
+  X(0xCD, VAL, addr_abs, instr_CMP, 4, 0, "CMP abs")                           \
+  X(0xCE, MEM, addr_abs, instr_DEC, 6, 0, "DEC abs")                           \
+  X(0xCF, MEM, addr_abs, instr_DCP, 6, 0, "DCP abs")                           \
+  X(0xD0, NONE, NULL, instr_BNE, 2, 0, "BNE rel")                              \
+  X(0xD1, VAL, addr_ind_Y, instr_CMP, 5, 1, "CMP ind,Y")                       \
+  X(0xD3, MEM, addr_ind_Y, instr_DCP, 8, 0, "DCP ind,Y")                       \
+  X(0xD4, ADDR, addr_zpg_X, instr_IGN, 4, 0, "NOP")                            \
+  X(0xD5, VAL, addr_zpg_X, instr_CMP, 4, 0, "CMP zpg,X")                       \
+  X(0xD6, MEM, addr_zpg_X, instr_DEC, 6, 0, "DEC zpg,X")                       \
+  X(0xD7, MEM, addr_zpg_X, instr_DCP, 6, 0, "DCP zpg,X")                       \
+  X(0xD8, NONE, NULL, instr_CLD, 2, 0, "CLD")                                  \
+  X(0xD9, VAL, addr_abs_Y, instr_CMP, 4, 1, "CMP abs,Y")                       \
+  X(0xDA, NONE, NULL, instr_NOP, 2, 0, "NOP")                                  \
+  X(0xDB, MEM, addr_abs_Y, instr_DCP, 7, 0, "DCP abs,Y")                       \
+  X(0xDC, ADDR, addr_abs_X, instr_IGN, 4, 1, "NOP abs,X")                      \
+  X(0xDD, VAL, addr_abs_X, instr_CMP, 4, 1, "CMP abs,X")                       \
+  X(0xDE, MEM, addr_abs_X, instr_DEC, 7, 0, "DEC abs,X")                       \
+  X(0xDF, MEM, addr_abs_X, instr_DCP, 7, 0, "DCP abs,X")                       \
+  X(0xE0, VAL, addr_imm, instr_CPX, 2, 0, "CPX #")                             \
+  X(0xE1, VAL, addr_X_ind, instr_SBC, 6, 0, "SBC X,ind")                       \
+  X(0xE2, ADDR, addr_imm, instr_IGN, 2, 0, "NOP imm")                          \
+  X(0xE3, MEM, addr_X_ind, instr_ISC, 8, 0, "ISC X,ind")                       \
+  X(0xE4, VAL, addr_zpg, instr_CPX, 3, 0, "CPX zpg")                           \
+  X(0xE5, VAL, addr_zpg, instr_SBC, 3, 0, "SBC zpg")                           \
+  X(0xE6, MEM, addr_zpg, instr_INC, 5, 0, "INC zpg")                           \
+  X(0xE7, MEM, addr_zpg, instr_ISC, 5, 0, "ISC zpg")                           \
+  X(0xE8, NONE, NULL, instr_INX, 2, 0, "INX")                                  \
+  X(0xE9, VAL, addr_imm, instr_SBC, 2, 0, "SBC #")                             \
+  X(0xEA, NONE, NULL, instr_NOP, 2, 0, "NOP")                                  \
+  X(0xEB, VAL, addr_imm, instr_SBC, 2, 0, "USBC #")                            \
+  X(0xEC, VAL, addr_abs, instr_CPX, 4, 0, "CPX abs")                           \
+  X(0xED, VAL, addr_abs, instr_SBC, 4, 0, "SBC abs")                           \
+  X(0xEE, MEM, addr_abs, instr_INC, 6, 0, "INC abs")                           \
+  X(0xEF, MEM, addr_abs, instr_ISC, 6, 0, "ISC abs")                           \
+  X(0xF0, NONE, NULL, instr_BEQ, 2, 0, "BEQ rel")                              \
+  X(0xF1, VAL, addr_ind_Y, instr_SBC, 5, 1, "SBC ind,Y")                       \
+  X(0xF3, MEM, addr_ind_Y, instr_ISC, 8, 0, "ISC ind,Y")                       \
+  X(0xF4, ADDR, addr_zpg_X, instr_IGN, 4, 0, "NOP zpg,X")                      \
+  X(0xF5, VAL, addr_zpg_X, instr_SBC, 4, 0, "SBC zpg,X")                       \
+  X(0xF6, MEM, addr_zpg_X, instr_INC, 6, 0, "INC zpg,X")                       \
+  X(0xF7, MEM, addr_zpg_X, instr_ISC, 6, 0, "ISC zpg,X")                       \
+  X(0xF8, NONE, NULL, instr_SED, 2, 0, "SED")                                  \
+  X(0xF9, VAL, addr_abs_Y, instr_SBC, 4, 1, "SBC abs,Y")                       \
+  X(0xFA, NONE, NULL, instr_NOP, 2, 0, "NOP imp")                              \
+  X(0xFB, MEM, addr_abs_Y, instr_ISC, 7, 0, "ISC abs,Y")                       \
+  X(0xFC, ADDR, addr_abs_X, instr_IGN, 4, 1, "NOP abs,X")                      \
+  X(0xFD, VAL, addr_abs_X, instr_SBC, 4, 1, "SBC abs,X")                       \
+  X(0xFE, MEM, addr_abs_X, instr_INC, 7, 0, "INC abs,X")                       \
+  X(0xFF, MEM, addr_abs_X, instr_ISC, 7, 0, "ISC abs,X")
+
+#endif
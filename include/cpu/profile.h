@@ -0,0 +1,70 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * CPU cycle profiler.
+ *
+ * Built in with CPU_PROFILE (`make PROFILE=1`); without it the hooks compile
+ * out. Every retired instruction charges its cycles to its PC and to the
+ * subroutine on top of a shadow call stack. JSR, BRK, NMI and IRQ push a
+ * frame; RTS and RTI pop every frame whose stack pointer they return past,
+ * so code that unwinds the stack by hand or uses RTS as a jump doesn't
+ * leave the shadow stack out of step.
+ *
+ * Per PC it keeps exclusive cycles and, for JSR sites, inclusive cycles
+ * with the callee. Per subroutine it keeps exclusive and inclusive cycles
+ * and the call count. Cycles are also collected per distinct call stack and
+ * written in the folded format flamegraph.pl and speedscope read:
+ *   reset_C000;sub_C5F0;sub_C712 1234
+ * In per-frame mode each video frame's stacks are written separately under
+ * a frame_<n> root.
+ */
+
+#define PROFILE_MAX_DEPTH 256
+
+// Frame kinds, they name the frames in folded stacks
+typedef enum ProfileKind {
+  PROFILE_RESET,
+  PROFILE_CALL,
+  PROFILE_NMI,
+  PROFILE_IRQ,
+  PROFILE_BRK,
+} ProfileKind;
+
+struct Profile;
+
+// Profiles from the code at entry onwards, writing folded stacks to
+// filename. NULL if the file can't be created.
+struct Profile *profile_open(const char *filename, uint16_t entry,
+                             int per_frame);
+
+// Writes the session's stacks if they weren't written per frame
+void profile_close(struct Profile *profile);
+
+// Instruction at pc is about to run
+void profile_begin(struct Profile *profile, uint16_t pc);
+
+// It retired after the given cycles. Calls and returns it made take effect
+// here, so a JSR is charged to the caller and an RTS to the callee.
+void profile_retire(struct Profile *profile, int cycles);
+
+// Called by the instruction being retired. sp is S before the return
+// address was pushed, for a return S after it was pulled.
+void profile_call(struct Profile *profile, ProfileKind kind, uint16_t target,
+                  uint8_t sp);
+void profile_return(struct Profile *profile, uint8_t sp);
+
+// An interrupt taken between instructions, pushed right away
+void profile_interrupt(struct Profile *profile, ProfileKind kind,
+                       uint16_t target, uint8_t sp);
+
+// End of a video frame
+void profile_frame(struct Profile *profile);
+
+// Hottest PCs and subroutines, as text
+void profile_write_report(struct Profile *profile, FILE *out);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef RECOMP_H
+#define RECOMP_H
+
+#include "cpu/cpu.h"
+
+/*
+ * Ahead-of-time translated PRG (CPU_RECOMP).
+ *
+ * tools/recompile.c walks an NROM image from its vectors and any traced jump
+ * targets and writes a C file with one function per reachable instruction.
+ * Each calls the regular instr_* functions with its operand resolved at
+ * translation time and is retired through cpu_retire_instr, so timing matches
+ * cpu_execute exactly. Straight-line code tail-calls the next instruction;
+ * branches and jumps return to a small dispatcher indexed by PC.
+ *
+ * The generated code runs until an NMI is taken, OAM DMA starts, the slice
+ * budget is used up, or control reaches an address it has no translation for
+ * (RAM, indirect jumps that weren't traced). cpu_execute interprets from
+ * there.
+ */
+
+// Cycles run per call before returning to the main loop
+#define RECOMP_SLICE_CYCLES 1024
+
+// Checks the loaded PRG against the one the code was generated from and sets
+// cpu->recomp. Returns 0 if they differ.
+int recomp_attach(Cpu6502 *cpu);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Opcode execution counters (CPU_STATS).
+ *
+ * Built in with `make STATS=1`; otherwise the counting compiles out. Every
+ * retired instruction is counted under its lookup_table index, along with
+ * whether it paid the page-cross cycle and, for branches, whether it was
+ * taken. Iterations of fast-forwarded wait loops are counted as if they
+ * had been interpreted, except for page crosses by indexed reads.
+ */
+
+typedef struct CpuStats {
+  uint64_t executed[256];
+  uint64_t page_crossed[256];
+  uint64_t branch_taken[256];
+} CpuStats;
+
+// branch_cycles is 0 for anything but a branch
+static inline void cpu_stats_count(CpuStats *stats, uint8_t opcode,
+                                   int page_crossed, int branch_cycles) {
+  stats->executed[opcode]++;
+
+  // A taken branch is 3 cycles, 4 if it lands on another page
+  if (page_crossed || branch_cycles == 4)
+    stats->page_crossed[opcode]++;
+  if (branch_cycles > 2)
+    stats->branch_taken[opcode]++;
+}
+
+// Histograms by opcode and by addressing mode, most executed first
+void cpu_stats_write(const CpuStats *stats, FILE *out);
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Binary instruction trace.
+ *
+ * cpu_execute pushes one fixed-size TraceRecord per instruction to an
+ * in-memory ring buffer. A writer thread drains the ring in batches,
+ * delta-encodes each record and writes the result in large chunks, so the
+ * emulation thread only pays for a struct copy. Run tools/trace_decode.c on
+ * the file to get nestest-style text.
+ *
+ * File layout: TRACE_MAGIC, then one encoded record after another:
+ *   mask byte (TRACE_* bits below)
+ *   PC delta from the previous record, zigzag varint
+ *   cycle delta, varint
+ *   opcode and two operand bytes                        if TRACE_CODE
+ *   A, X, Y, S, P, each only if its bit is set
+ *   scanline (int16) and dot (uint16), little-endian    if TRACE_POS
+ *
+ * Code bytes are only stored when they differ from the last record at the
+ * same PC. The position is only stored when it differs from the previous one
+ * advanced by three dots per cycle.
+ */
+
+#define TRACE_MAGIC "NESTRC1"
+#define TRACE_MAGIC_SIZE 8
+
+// Mask bits, set for each field stored in an encoded record
+#define TRACE_CODE 0x01
+#define TRACE_A 0x02
+#define TRACE_X 0x04
+#define TRACE_Y 0x08
+#define TRACE_S 0x10
+#define TRACE_P 0x20
+#define TRACE_POS 0x40
+
+// Records buffered between the CPU and the writer thread (power of two)
+#define TRACE_RING_SIZE (1 << 16)
+
+// The writer is woken every this many records
+#define TRACE_BATCH 4096
+
+// State before the instruction at pc runs
+typedef struct TraceRecord {
+  uint64_t cycle;
+  uint16_t pc;
+  uint8_t opcode;
+  uint8_t operand[2];
+  uint8_t a, x, y, s, p;
+  int16_t scanline;
+  uint16_t dot;
+} TraceRecord;
+
+struct Trace;
+
+// Starts the writer thread. NULL if the file can't be created.
+struct Trace *trace_open(const char *filename);
+
+// Drains the ring, stops the writer and closes the file
+void trace_close(struct Trace *trace);
+
+void trace_push(struct Trace *trace, const TraceRecord *record);
+
+typedef struct TraceReader {
+  FILE *file;
+  TraceRecord prev;
+  uint8_t code[0x10000][3];
+} TraceReader;
+
+// Returns 0 if the file can't be opened or isn't a trace
+int trace_reader_open(TraceReader *reader, const char *filename);
+void trace_reader_close(TraceReader *reader);
+
+// Returns 1 and fills record, or 0 at the end of the file
+int trace_read(TraceReader *reader, TraceRecord *record);
+
+#endif
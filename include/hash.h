@@ -0,0 +1,30 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Checksums that identify ROM images: CRC-32 (the zlib polynomial) and
+ * SHA-1, the two that dump databases list.
+ *
+ * Both can be fed in pieces, so PRG and CHR hash as one image without being
+ * copied together.
+ */
+
+// Start with crc 0 and pass the result back in for the next piece
+uint32_t crc32_update(uint32_t crc, const void *data, size_t size);
+
+#define SHA1_SIZE 20
+
+typedef struct Sha1 {
+  uint32_t h[5];
+  uint64_t size; // Bytes hashed so far
+  uint8_t block[64];
+} Sha1;
+
+void sha1_init(Sha1 *sha1);
+void sha1_update(Sha1 *sha1, const void *data, size_t size);
+void sha1_final(Sha1 *sha1, uint8_t digest[SHA1_SIZE]);
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef MAPPER_H
+#define MAPPER_H
+
+#include "cpu/cpu.h"
+#include "rom.h"
+#include "scheduler.h"
+
+#include <stdint.h>
+
+/*
+ * Cartridge boards, by iNES mapper number.
+ *
+ * PRG is mapped into the CPU's page table in 8 KB banks and CHR into the
+ * PPU's eight 1 KB pattern banks, each pointing straight into the ROM image
+ * or the board's CHR RAM. A bank switch repoints the banks that changed and
+ * copies nothing; the CPU sees it on its next access, the PPU once it has
+ * been run up to the write. The $8000-$FFFF pages have no write pointer, so
+ * memory_write hands every write there to the board's registers.
+ *
+ *   0 NROM, 1 MMC1 (SxROM), 2 UxROM, 3 CNROM, 4 MMC3 (TxROM), 7 AxROM
+ *
+ * The MMC3 scanline counter is clocked by SCHED_MAPPER_IRQ at dot 260 of
+ * every rendered line, where the PPU fetches the sprite patterns, and raises
+ * IRQ_MAPPER.
+ */
+
+// Board registers, part of the machine state (see state.h)
+typedef struct Mmc1State {
+  uint8_t shift, count; // Serial port
+  uint8_t control;
+  uint8_t chr0, chr1;
+  uint8_t prg;
+} Mmc1State;
+
+typedef struct Mmc3State {
+  uint8_t select; // Bank register the next odd write goes to, and modes
+  uint8_t banks[8];
+  uint8_t mirroring;
+  uint8_t irq_latch, irq_counter, irq_reload, irq_enabled;
+} Mmc3State;
+
+typedef union MapperState {
+  uint8_t latch; // Boards with a single bank register
+  Mmc1State mmc1;
+  Mmc3State mmc3;
+} MapperState;
+
+typedef struct Mapper Mapper;
+
+typedef struct MapperBoard {
+  int number;
+  const char *name;
+
+  void (*power)(Mapper *mapper);  // Registers at power on
+  void (*update)(Mapper *mapper); // Maps what the registers select
+  void (*write)(Mapper *mapper, uint16_t addr, uint8_t val); // $8000-$FFFF
+
+  // Optional, called from cpu_init once the clock is set up
+  void (*start)(Mapper *mapper);
+} MapperBoard;
+
+struct Mapper {
+  const MapperBoard *board;
+  Cpu6502 *cpu;
+  MapperState state;
+
+  const uint8_t *prg;
+  int prg_size;
+
+  // CHR ROM, or chr_ram on boards without it
+  const uint8_t *chr;
+  int chr_size;
+  uint8_t *chr_ram;
+
+  // PRG offset mapped at each 8 KB slot, -1 before the first map
+  int prg_offset[4];
+};
+
+// Builds the board for rom and maps it into cpu and cpu->ppu. Call after
+// ppu_init and before cpu_init, which reads the reset vector through it.
+// Returns 0 if the board isn't supported, mapper_error says why.
+int mapper_attach(Cpu6502 *cpu, const Rom *rom);
+void mapper_error(const Rom *rom, char *buf, size_t size);
+void mapper_detach(Cpu6502 *cpu);
+
+// Maps every bank again, as after the registers were restored or a Code/Data
+// Logger was attached
+void mapper_remap(Cpu6502 *cpu);
+
+// Board events, see MapperBoard.start
+void mapper_start(Cpu6502 *cpu);
+
+/* For the boards */
+
+// Maps size bytes of PRG from bank (in units of size) at addr. Negative banks
+// count from the end of PRG, banks past it wrap around.
+void mapper_map_prg(Mapper *mapper, uint16_t addr, int size, int bank);
+
+// The same for CHR, in the PPU's pattern tables
+void mapper_map_chr(Mapper *mapper, uint16_t addr, int size, int bank);
+
+void mapper_set_mirroring(Mapper *mapper, int mirroring);
+
+extern const MapperBoard mapper_nrom, mapper_mmc1, mapper_uxrom, mapper_cnrom,
+    mapper_mmc3, mapper_axrom;
+
+#endif
@@ -4,15 +4,26 @@
 // === Project Includes ===
 #include "config.h"
 #include "pipeline.h"
+#include <stddef.h>
 
 // === Constants ===
-#define PPU_MEMORY_SIZE 0x4000 // 16 KB
+#define PPU_CHR_SIZE 0x2000       // Pattern tables, from the cartridge
+#define PPU_CHR_BANK_SIZE 0x400   // Granularity of CHR bank switching
+#define PPU_CHR_BANKS (PPU_CHR_SIZE / PPU_CHR_BANK_SIZE)
+#define PPU_VRAM_SIZE 0x800       // 2 KB of nametables, mirrored to 4 KB
+#define PPU_PALETTE_RAM_SIZE 0x20 // Palette indices at $3F00
 #define PALETTE_SIZE 64
 #define NES_HEADER_SIZE 16
 
 #define OAM_SIZE 0x100
 #define OAM_SECONDARY_SIZE 32
 
+// Nametable arrangements (nametable_mirror_flag)
+#define MIRROR_HORIZONTAL 0  // $2000 = $2400, $2800 = $2C00
+#define MIRROR_VERTICAL 1    // $2000 = $2800, $2400 = $2C00
+#define MIRROR_SINGLE_LOW 2  // All four are the first 1 KB of VRAM
+#define MIRROR_SINGLE_HIGH 3 // All four are the second
+
 #define NUM_DOTS 341
 #define NUM_SCANLINES 262
 
@@ -42,6 +53,13 @@ typedef struct PPU {
   uint8_t w;     // Write toggle
   uint8_t x;     // Fine X scroll
 
+  // Returns bus value
+  uint8_t open_bus;
+
+  // Nametable arrangement, one of the MIRROR_ values. The cartridge sets
+  // it, some boards switch it at run time.
+  unsigned char nametable_mirror_flag;
+
   // Internal flags
   unsigned char drawing_bg_flag;
   unsigned char vblank_flag;
@@ -53,8 +71,15 @@ typedef struct PPU {
   Pipeline bg_pipeline;
   Pipeline sprite_pipeline;
 
-  // Output buffer
-  uint32_t frame_buffer[SCREEN_HEIGHT_VIS][SCREEN_WIDTH_VIS];
+  // === OAM PPU Memory ===
+  // 256 seperate memoery dedicated to OAM
+  uint8_t oam_memory[OAM_SIZE];
+
+  // Buffer, holds up to 8 spirtes to be rendered on the next scanline
+  uint8_t oam_memory_secondary[OAM_SECONDARY_SIZE];
+
+  // Internal latches, holds actual rendering data
+  uint8_t oam_buffer_latches[OAM_SECONDARY_SIZE];
 
   // === Sprite Variables
   uint8_t sprite_evaluation_index;
@@ -71,27 +96,48 @@ typedef struct PPU {
   int scanline;
   int frame;
   int ppu_cycle_count;
-} PPU;
 
-// === Global PPU Memory ===
-extern uint8_t ppu_memory[PPU_MEMORY_SIZE];
-extern uint8_t nes_header[NES_HEADER_SIZE];
-extern uint8_t ppu_palette[PALETTE_SIZE * 3];
-extern uint8_t open_bus;
+  // === PPU Memory ===
+  uint8_t vram[PPU_VRAM_SIZE];
+  uint8_t palette_ram[PPU_PALETTE_RAM_SIZE];
 
-// === OAM PPU Memory ===
-extern uint8_t oam_memory[OAM_SIZE];
-extern uint8_t oam_memory_secondary[OAM_SECONDARY_SIZE];
-extern uint8_t oam_buffer_latches[OAM_SECONDARY_SIZE];
+  // Everything from here on is host side, not part of the machine state
+  // (see state.h)
+
+  // Output buffer
+  uint32_t frame_buffer[SCREEN_HEIGHT_VIS][SCREEN_WIDTH_VIS];
+
+  uint8_t nes_header[NES_HEADER_SIZE];
+  uint8_t ppu_palette[PALETTE_SIZE * 3];
+
+  // Pattern tables in 1 KB banks, pointing at the cartridge's CHR ROM or
+  // RAM. chr_write is NULL for banks that can't be written.
+  const uint8_t *chr[PPU_CHR_BANKS];
+  uint8_t *chr_write[PPU_CHR_BANKS];
+
+  // Code/Data Logger flags for each bank (see cdl.h). Banks that aren't
+  // logged share chr_cdl_scratch, which is written but never read.
+  uint8_t *chr_cdl[PPU_CHR_BANKS];
+  uint8_t chr_cdl_scratch[PPU_CHR_BANK_SIZE];
+} PPU;
+
+// The leading part of PPU that a machine snapshot copies
+#define PPU_STATE_SIZE offsetof(PPU, frame_buffer)
 
 // === Initialization and Loading ===
 void ppu_init(PPU *ppu);
-void load_ppu_memory(PPU *ppu, unsigned char *chr_rom, int chr_size);
-void load_ppu_oam_mem(PPU *ppu, uint8_t *dma_mem);
-void load_ppu_ines_header(unsigned char *header);
-void load_palette(uint8_t *palette);
+// Maps chr_rom in place, it must outlive the PPU
+void load_ppu_memory(PPU *ppu, const uint8_t *chr_rom, int chr_size);
+void load_ppu_oam_mem(PPU *ppu, const uint8_t *dma_mem);
+void load_ppu_ines_header(PPU *ppu, const uint8_t *header);
+void load_palette(PPU *ppu, uint8_t *palette);
 
 // === Memory Read/Write ===
+static inline uint8_t ppu_chr_read(const PPU *ppu, uint16_t addr) {
+  addr &= PPU_CHR_SIZE - 1;
+  return ppu->chr[addr / PPU_CHR_BANK_SIZE][addr % PPU_CHR_BANK_SIZE];
+}
+
 uint8_t read_mem(PPU *ppu, uint16_t addr);
 void write_mem(PPU *ppu, uint16_t addr, uint8_t val);
 
@@ -101,6 +147,14 @@ void ppu_exec_pre_render(PPU *ppu);
 void ppu_exec_visible_scanline(PPU *ppu);
 void ppu_exec_vblank(PPU *ppu);
 
+// Step the PPU by a number of dots, same result as calling ppu_execute_cycle
+// that many times
+void ppu_run(PPU *ppu, int dots);
+
+// Dots until the PPU has run the given dot, counting that dot. Used to
+// schedule VBlank and the end of the frame.
+int ppu_dots_until(PPU *ppu, int scanline, int dot);
+
 // === Rendering ===
 void ppu_render(PPU *ppu);
 
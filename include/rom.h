@@ -1,7 +1,24 @@
+#ifndef ROM_H
+#define ROM_H
+
+#include "hash.h"
 
 #include <stddef.h>
 #include <stdint.h>
 
+/*
+ * iNES and NES 2.0 images.
+ *
+ * The file is mapped read-only and PRG, CHR and the trainer point into the
+ * mapping, nothing is copied. The CPU and PPU bank those pointers in place,
+ * so the Rom has to stay loaded while a machine runs from it, and every
+ * machine running the same file shares the same pages.
+ *
+ * PRG and CHR are hashed on load and looked up in the game database
+ * (romdb.h). A known dump takes its mapper, mirroring, region and battery
+ * from there instead of from the header.
+ */
+
 #define ROM_OK 0
 #define ROM_ERR_NOFILE -1
 #define ROM_ERR_HEADER_MISMATCH -2
@@ -10,16 +27,47 @@
 
 #define ROM_MEM_ALLOC_FAIL -5
 
+#define ROM_TRAINER_SIZE 0x200 // Loaded at $7000
+
+// TV system the game was made for
+#define ROM_REGION_NTSC 0
+#define ROM_REGION_PAL 1
+#define ROM_REGION_MULTI 2 // Runs on either
+#define ROM_REGION_DENDY 3
+
 typedef struct Rom {
-  uint8_t *header;
-  uint8_t *prg_data;
-  uint8_t *chr_data;
+  const uint8_t *header;
+  const uint8_t *trainer; // NULL if there is none
+  const uint8_t *prg_data;
+  const uint8_t *chr_data;
   size_t prg_size;
   size_t chr_size;
+
+  int nes2;      // NES 2.0 header
+  int mapper;    // iNES mapper number (see mapper/mapper.h)
+  int submapper; // NES 2.0 only, 0 otherwise
+  int mirroring; // MIRROR_HORIZONTAL or MIRROR_VERTICAL (see ppu.h)
+  int four_screen; // Nametable VRAM on the cartridge, mapper_attach rejects it
+  int battery; // Cartridge RAM is kept across power offs
+  int region;
+
+  // Cartridge RAM, volatile and battery backed. iNES headers don't have
+  // these, they are taken as 8 KB of PRG RAM and 8 KB of CHR RAM when there
+  // is no CHR ROM.
+  size_t prg_ram_size, prg_nvram_size;
+  size_t chr_ram_size, chr_nvram_size;
+
+  // Of PRG and CHR together
+  uint32_t crc32;
+  uint8_t sha1[SHA1_SIZE];
+  const char *title; // From the game database, NULL if it isn't there
+
+  // The mapping of the file
+  void *map;
+  size_t map_size;
 } Rom;
 
-int rom_load_cartridge(Rom *rom, char *filename);
+int rom_load_cartridge(Rom *rom, const char *filename);
+void rom_unload(Rom *rom);
 
-void rom_load_cpu_mem();
-void rom_load_ppu_mem();
-void remo_destroy(Rom *rom);
+#endif
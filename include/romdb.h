@@ -0,0 +1,39 @@
+#ifndef ROMDB_H
+#define ROMDB_H
+
+#include "hash.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Game database.
+ *
+ * Known dumps by the CRC-32 of their PRG and CHR, the header left out, with
+ * the board details their header should have had. rom_load_cartridge looks
+ * every image up and the database wins over the header, which is often
+ * wrong in old dumps.
+ *
+ * The table is compiled in, sorted by CRC, and searched in place. A CRC
+ * match is confirmed with the SHA-1. bin/romdb prints the table with new
+ * dumps merged in (see tools/romdb.c).
+ */
+
+typedef struct RomDbEntry {
+  uint32_t crc32;
+  uint8_t sha1[SHA1_SIZE];
+  int mapper;
+  int submapper;
+  int mirroring; // MIRROR_HORIZONTAL or MIRROR_VERTICAL (see ppu.h)
+  int region;    // ROM_REGION_ value (see rom.h)
+  int battery;
+  const char *title;
+} RomDbEntry;
+
+extern const RomDbEntry romdb_games[];
+extern const size_t romdb_count;
+
+// NULL if the image isn't in the database
+const RomDbEntry *romdb_find(uint32_t crc32, const uint8_t sha1[SHA1_SIZE]);
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+/*
+ * Master clock and timed events.
+ *
+ * Time is counted in PPU dots (three per CPU cycle) from power on. The CPU
+ * moves the clock forward as it retires instructions; the PPU and APU run
+ * behind it and are only brought up to date when something can observe
+ * them: a register access, or one of the events below coming due. Events
+ * sit in a small min-heap keyed by the dot they happen on, so the CPU only
+ * compares the clock against the earliest one after each instruction.
+ *
+ * Each event type is pending at most once. Its handler runs after the event
+ * is removed from the heap and usually schedules the next occurrence.
+ */
+
+typedef enum SchedEventType {
+  SCHED_VBLANK,     // VBlank flag and NMI, scanline 241 dot 1
+  SCHED_FRAME_END,  // Last dot of scanline 260, the frame is ready
+  SCHED_APU_FRAME,  // Next APU frame counter step
+  SCHED_DMA_END,    // End of the OAM DMA stall
+  SCHED_IRQ,        // The IRQ line rose or I was cleared, check the line
+  SCHED_APU_IRQ,    // APU frame counter asserts its IRQ
+  SCHED_MAPPER_IRQ, // MMC3 scanline counter clock, dot 260 (mmc3.c)
+  SCHED_BREAK,      // Debugger scanline/dot breakpoint
+  SCHED_NUM_EVENTS
+} SchedEventType;
+
+#define SCHED_NEVER UINT64_MAX
+
+// Returns nonzero if it redirected the CPU (took an interrupt)
+typedef int (*SchedHandler)(void *ctx, uint64_t time);
+
+typedef struct SchedEvent {
+  uint64_t time;
+  SchedEventType type;
+} SchedEvent;
+
+typedef struct Scheduler {
+  uint64_t now;  // Master clock
+  uint64_t next; // Time of the earliest pending event, SCHED_NEVER if none
+
+  SchedEvent heap[SCHED_NUM_EVENTS];
+  int size;
+
+  // Heap index of each pending event type, -1 when it isn't scheduled
+  int slot[SCHED_NUM_EVENTS];
+
+  SchedHandler handler[SCHED_NUM_EVENTS];
+  void *ctx[SCHED_NUM_EVENTS];
+} Scheduler;
+
+void sched_init(Scheduler *sched);
+void sched_set_handler(Scheduler *sched, SchedEventType type,
+                       SchedHandler handler, void *ctx);
+
+// Schedules the event, or moves it if it is already pending
+void sched_schedule(Scheduler *sched, SchedEventType type, uint64_t time);
+void sched_cancel(Scheduler *sched, SchedEventType type);
+
+// SCHED_NEVER if the event isn't pending
+uint64_t sched_event_time(const Scheduler *sched, SchedEventType type);
+
+// Runs the handlers of every event due at the current time, earliest first.
+// Returns nonzero if any of them redirected the CPU.
+int sched_run(Scheduler *sched);
+
+static inline int sched_due(const Scheduler *sched) {
+  return sched->now >= sched->next;
+}
+
+#endif
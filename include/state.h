@@ -0,0 +1,66 @@
+#ifndef STATE_H
+#define STATE_H
+
+#include "cpu/cpu.h"
+#include "mapper/mapper.h"
+
+#include <stdint.h>
+
+/*
+ * Machine state snapshots.
+ *
+ * A MachineState is everything that decides what the machine does next:
+ * the CPU registers and internal RAM, the master clock and pending events,
+ * the APU registers, the board's bank registers and the PPU up to its
+ * memory (see PPU_STATE_SIZE). ROM, the frame buffer and whatever the host
+ * keeps for speed (page table, block cache, wait-loop detector) are left
+ * out, so a snapshot fits in a few KB and saving, restoring and hashing one
+ * is a handful of copies.
+ *
+ * Cartridge RAM at $6000 and CHR RAM belong to the cartridge, not to this
+ * block. Carts that use them snapshot cpu->prg_ram and the mapper's chr_ram
+ * next to it. The APU synthesizer isn't part of it either and carries on
+ * from where it was.
+ */
+
+typedef struct MachineState {
+  // CPU
+  uint16_t PC;
+  uint16_t nz;
+  uint8_t A, X, Y, S, P;
+  uint8_t instr;
+  uint8_t nmi_state;
+  uint8_t strobe;
+  uint8_t ctrl_latch_state;
+  uint8_t dma_active_flag;
+  uint8_t irq_sources;
+  int32_t ctrl_bit_index;
+  int32_t cycles;
+  int32_t dma_cycles;
+  int32_t instr_num;
+  uint64_t cpu_cycle_count;
+
+  // Master clock, the PPU's place on it and when each event is due
+  uint64_t now;
+  uint64_t ppu_time;
+  uint64_t events[SCHED_NUM_EVENTS];
+
+  // APU registers
+  uint32_t apu_write_mask;
+  uint8_t apu_regs[0x18];
+  uint8_t apu_frame_irq;
+
+  // Bank registers, mapped again on load
+  MapperState mapper;
+
+  uint8_t ram[CPU_RAM_SIZE];
+  uint8_t ppu[PPU_STATE_SIZE];
+} MachineState;
+
+void state_save(const Cpu6502 *cpu, MachineState *state);
+void state_load(Cpu6502 *cpu, const MachineState *state);
+
+// Equal states hash equal, whichever machine they were saved from
+uint64_t state_hash(const MachineState *state);
+
+#endif
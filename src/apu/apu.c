@@ -24,9 +24,9 @@ static const uint8_t triangle_sequence[32] = {
     0,  1,  2,  3,  4,  5,  6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
     15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5,  4,  3,  2,  1,  0};
 
-int length_table[32] = {10, 254, 20, 2,  40, 4,  80, 6,  160, 8,  60,
-                        10, 14,  12, 26, 14, 12, 24, 48, 72,  96, 192,
-                        16, 32,  14, 16, 18, 20, 22, 24, 26,  30};
+static const uint8_t length_table[32] = {
+    10, 254, 20, 2,  40, 4,  80, 6,  160, 8,  60, 10, 14, 12, 26, 14,
+    12, 24,  48, 72, 96, 192, 16, 32, 14, 16, 18, 20, 22, 24, 26, 30};
 
 void apu_init(APU *apu, APU_MMIO *apu_mmio) {
   memset(apu, 0, sizeof(APU));
@@ -288,6 +288,9 @@ void apu_update_parameters(APU *apu) {
     apu->frame_counter.mode = (val & 0x80) >> 7;
     apu->frame_counter.interrupt_inhibit_flag = (val & 0x40) >> 6;
     apu->frame_counter.initial_apu_cycle = apu->apu_cycles;
+
+    if (apu->frame_counter.interrupt_inhibit_flag)
+      apu_mmio_set_frame_irq(apu->apu_mmio, 0);
     break;
 
   default:
@@ -555,6 +558,9 @@ void apu_clock_frame_counter(APU *apu) {
       apu_envelope_clocked(apu->noise->envelope,
                            apu->noise->length_counter_halt_flag);
       apu->frame_counter.initial_apu_cycle = apu->apu_cycles;
+
+      if (!apu->frame_counter.interrupt_inhibit_flag)
+        apu_mmio_set_frame_irq(apu->apu_mmio, 1);
     }
     break;
 
@@ -592,6 +598,32 @@ void apu_clock_frame_counter(APU *apu) {
   }
 }
 
+int apu_cycles_until_frame_step(APU *apu) {
+  static const int steps[] = {3728 * 2, 7456 * 2, 11185 * 2, 14914 * 2,
+                              18640 * 2};
+  int num_steps = apu->frame_counter.mode ? 5 : 4;
+  int elapsed = apu->apu_cycles - apu->frame_counter.initial_apu_cycle;
+
+  for (int i = 0; i < num_steps; i++) {
+    if (steps[i] >= elapsed)
+      return steps[i] - elapsed + 1;
+  }
+
+  // Past the last step without a reset, the sequence has stopped
+  return -1;
+}
+
+int apu_cycles_until_frame_irq(APU *apu) {
+  if (apu->frame_counter.mode || apu->frame_counter.interrupt_inhibit_flag)
+    return -1;
+
+  int elapsed = apu->apu_cycles - apu->frame_counter.initial_apu_cycle;
+  if (elapsed > 14914 * 2)
+    return -1;
+
+  return 14914 * 2 - elapsed + 1;
+}
+
 void apu_execute(APU *apu) {
   apu->apu_cycle_count++;
   if (apu->apu_mmio->apu_mmio_write_mask)
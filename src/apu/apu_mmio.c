@@ -1,10 +1,15 @@
 #include "apu/apu_mmio.h"
 
+#include <stddef.h>
+
 void write_apu_mmio(APU_MMIO *apu_mmio, uint16_t addr, uint8_t val) {
   // Set a bit to 1 if the corresponding register was modified
   if (addr >= 0x4000 && addr <= 0x4017) {
     int reg = addr - 0x4000;
 
+    if (apu_mmio->sync)
+      apu_mmio->sync(apu_mmio->sync_ctx);
+
     // Update the MMIO register
     apu_mmio->regs[reg] = val;
 
@@ -13,4 +18,35 @@ void write_apu_mmio(APU_MMIO *apu_mmio, uint16_t addr, uint8_t val) {
   }
 }
 
-void apu_mmio_init(APU_MMIO *apu_mmio) { apu_mmio->apu_mmio_write_mask = 0; }
+void apu_mmio_set_frame_irq(APU_MMIO *apu_mmio, uint8_t on) {
+  apu_mmio->frame_interrupt_flag = on;
+
+  if (!apu_mmio->irq)
+    return;
+
+  if (on)
+    irq_assert(apu_mmio->irq, IRQ_APU_FRAME);
+  else
+    irq_release(apu_mmio->irq, IRQ_APU_FRAME);
+}
+
+uint8_t read_apu_status(APU_MMIO *apu_mmio) {
+  // The flag may have been raised since the APU was last run
+  if (apu_mmio->sync)
+    apu_mmio->sync(apu_mmio->sync_ctx);
+
+  // Channel status isn't tracked yet, report the enable bits instead
+  uint8_t status =
+      (apu_mmio->regs[0x15] & 0x1F) | apu_mmio->frame_interrupt_flag << 6;
+
+  apu_mmio_set_frame_irq(apu_mmio, 0);
+  return status;
+}
+
+void apu_mmio_init(APU_MMIO *apu_mmio) {
+  apu_mmio->apu_mmio_write_mask = 0;
+  apu_mmio->sync = NULL;
+  apu_mmio->sync_ctx = NULL;
+  apu_mmio->frame_interrupt_flag = 0;
+  apu_mmio->irq = NULL;
+}
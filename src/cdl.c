@@ -0,0 +1,66 @@
+#include "cdl.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+Cdl *cdl_create(int prg_size, int chr_size) {
+  Cdl *cdl = calloc(1, sizeof(Cdl));
+  if (!cdl)
+    return NULL;
+
+  // One allocation, CHR flags follow PRG like in the file
+  cdl->prg = calloc(prg_size + chr_size, 1);
+  if (!cdl->prg) {
+    free(cdl);
+    return NULL;
+  }
+
+  cdl->prg_size = prg_size;
+  cdl->chr = cdl->prg + prg_size;
+  cdl->chr_size = chr_size;
+  return cdl;
+}
+
+void cdl_destroy(Cdl *cdl) {
+  if (!cdl)
+    return;
+
+  free(cdl->prg);
+  free(cdl);
+}
+
+int cdl_load(Cdl *cdl, const char *filename) {
+  FILE *file = fopen(filename, "rb");
+  if (!file)
+    return 0;
+
+  long size = cdl->prg_size + cdl->chr_size;
+
+  // Checked up front so a mismatched log doesn't get half merged
+  if (fseek(file, 0, SEEK_END) != 0 || ftell(file) != size) {
+    fclose(file);
+    return 0;
+  }
+  rewind(file);
+
+  for (long i = 0; i < size; i++) {
+    int c = getc(file);
+    if (c == EOF)
+      break;
+    cdl->prg[i] |= c;
+  }
+
+  fclose(file);
+  return 1;
+}
+
+int cdl_save(const Cdl *cdl, const char *filename) {
+  FILE *file = fopen(filename, "wb");
+  if (!file)
+    return 0;
+
+  size_t size = cdl->prg_size + cdl->chr_size;
+  int ok = fwrite(cdl->prg, 1, size, file) == size;
+
+  return fclose(file) == 0 && ok;
+}
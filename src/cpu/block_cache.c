@@ -0,0 +1,183 @@
+#include "cpu/block_cache.h"
+#include "cpu/cpu.h"
+#include "cpu/opcodes.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define X(op, type, mode, fn, cyc, pcyc, mn) [op] = UOP_BYTES_##mode,
+
+static const uint8_t operand_bytes[256] = {CPU_OPCODES(X)};
+
+#undef X
+
+static int is_branch(const Opcode *op) {
+  if (op->instr_type != INSTR_NONE)
+    return 0;
+
+  InstrNone fn = op->instr_none;
+  return fn == instr_BCC || fn == instr_BCS || fn == instr_BEQ ||
+         fn == instr_BNE || fn == instr_BPL || fn == instr_BMI ||
+         fn == instr_BVC || fn == instr_BVS;
+}
+
+static int ends_block(const Opcode *op) {
+  if (is_branch(op))
+    return 1;
+
+  if (op->instr_type == INSTR_NONE)
+    return op->instr_none == instr_BRK || op->instr_none == instr_RTS ||
+           op->instr_none == instr_RTI;
+
+  if (op->instr_type == INSTR_ADDR)
+    return op->instr_addr == instr_JMP || op->instr_addr == instr_JSR;
+
+  return 0;
+}
+
+// Read a code byte without side effects. Only pages backed by host memory
+// can be decoded.
+static int code_byte(Cpu6502 *cpu, uint16_t addr, uint8_t *out) {
+  const uint8_t *page = cpu->bus[addr >> 8].read_ptr;
+
+  if (!page)
+    return 0;
+
+  *out = page[addr & 0xFF];
+  return 1;
+}
+
+static void bus_write_code(Cpu6502 *cpu, uint16_t addr, uint8_t val) {
+  block_cache_invalidate_page(cpu, addr >> 8);
+  memory_write(cpu, addr, val);
+}
+
+// Route writes to a page holding cached code through bus_write_code
+static void watch_one_page(Cpu6502 *cpu, int page) {
+  BlockCache *cache = cpu->block_cache;
+  BusPage *bus = &cpu->bus[page];
+
+  if (cache->code_page[page] || !bus->write_ptr)
+    return;
+
+  cache->code_page[page] = 1;
+  cache->code_write_ptr[page] = bus->write_ptr;
+  cache->code_write[page] = bus->write;
+
+  bus->write_ptr = NULL;
+  bus->write = bus_write_code;
+}
+
+// Internal RAM is mirrored, so the code can be written through any page
+// that maps the same memory
+static void watch_code_page(Cpu6502 *cpu, uint8_t page) {
+  const uint8_t *mem = cpu->bus[page].read_ptr;
+
+  watch_one_page(cpu, page);
+  for (int i = 0; mem && i < 0x100; i++) {
+    if (i != page && cpu->bus[i].read_ptr == mem)
+      watch_one_page(cpu, i);
+  }
+}
+
+BlockCache *block_cache_create(void) {
+  return calloc(1, sizeof(BlockCache));
+}
+
+void block_cache_destroy(BlockCache *cache) { free(cache); }
+
+static void invalidate_one_page(Cpu6502 *cpu, int page) {
+  BlockCache *cache = cpu->block_cache;
+
+  cache->page_gen[page]++;
+
+  if (cache->code_page[page]) {
+    cache->code_page[page] = 0;
+    cpu->bus[page].write_ptr = cache->code_write_ptr[page];
+    cpu->bus[page].write = cache->code_write[page];
+  }
+}
+
+void block_cache_invalidate_page(Cpu6502 *cpu, uint8_t page) {
+  const uint8_t *mem = cpu->bus[page].read_ptr;
+
+  // Blocks decoded through a mirror of the page are stale too
+  invalidate_one_page(cpu, page);
+  for (int i = 0; mem && i < 0x100; i++) {
+    if (i != page && cpu->bus[i].read_ptr == mem)
+      invalidate_one_page(cpu, i);
+  }
+
+  // The running block may have been decoded from this page
+  cpu->uop = NULL;
+}
+
+static int block_decode(Cpu6502 *cpu, Block *block, uint16_t pc) {
+  BlockCache *cache = cpu->block_cache;
+  uint32_t addr = pc;
+  int count = 0;
+
+  while (count < BLOCK_MAX_UOPS) {
+    uint8_t instr;
+    if (!code_byte(cpu, addr, &instr))
+      break;
+
+    // Opcodes outside CPU_OPCODES stay on the table path
+    const Opcode *op = &lookup_table[instr];
+    if (!op->mnemonic)
+      break;
+
+    int len = 1 + operand_bytes[instr] + is_branch(op);
+    if (addr + len > 0x10000)
+      break;
+
+    uint8_t lo = 0, hi = 0;
+    if (len > 1 && !code_byte(cpu, addr + 1, &lo))
+      break;
+    if (len > 2 && !code_byte(cpu, addr + 2, &hi))
+      break;
+
+    Uop *uop = &block->uops[count++];
+    uop->pc = addr;
+    uop->operand = hi << 8 | lo;
+    uop->opcode = instr;
+    uop->len = len;
+
+    addr += len;
+    if (ends_block(op))
+      break;
+  }
+
+  if (count == 0)
+    return 0;
+
+  block->uops[count].len = 0;
+  block->count = count;
+  block->hits = 0;
+  block->native = NULL;
+  block->pc = pc;
+  block->first_page = pc >> 8;
+  block->last_page = (addr - 1) >> 8;
+  block->first_gen = cache->page_gen[block->first_page];
+  block->last_gen = cache->page_gen[block->last_page];
+
+  watch_code_page(cpu, block->first_page);
+  watch_code_page(cpu, block->last_page);
+  return 1;
+}
+
+const Uop *block_cache_lookup(Cpu6502 *cpu, uint16_t pc) {
+  BlockCache *cache = cpu->block_cache;
+  Block *block = &cache->blocks[pc & (BLOCK_CACHE_SLOTS - 1)];
+
+  if (block->count == 0 || block->pc != pc ||
+      block->first_gen != cache->page_gen[block->first_page] ||
+      block->last_gen != cache->page_gen[block->last_page]) {
+    if (!block_decode(cpu, block, pc)) {
+      block->count = 0;
+      return NULL;
+    }
+  }
+
+  return block->uops;
+}
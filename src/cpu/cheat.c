@@ -0,0 +1,277 @@
+#include "cpu/cheat.h"
+#include "cpu/block_cache.h"
+#include "cpu/cpu.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct Cheat {
+  int used;
+  uint16_t addr;
+  uint8_t value;
+  int compare; // -1 when the value always replaces the byte
+} Cheat;
+
+// A page with cheats on it and where its reads went before
+typedef struct CheatPage {
+  int count; // Addresses on the page with a cheat
+  int taken;
+  const uint8_t *read_ptr;
+  BusRead read;
+} CheatPage;
+
+struct Cheats {
+  Cheat cheats[CHEAT_MAX];
+
+  // Cheat number + 1 at every address, 0 for none. A frozen address is
+  // filled in at each of its mirrors.
+  uint8_t slot[0x10000];
+  CheatPage pages[0x100];
+};
+
+_Static_assert(CHEAT_MAX < 0x100, "cheat numbers must fit in a slot");
+
+static uint8_t cheat_read(Cpu6502 *cpu, uint16_t addr) {
+  struct Cheats *cheats = cpu->cheats;
+  const CheatPage *page = &cheats->pages[addr >> 8];
+  uint8_t val =
+      page->read_ptr ? page->read_ptr[addr & 0xFF] : page->read(cpu, addr);
+  int slot = cheats->slot[addr];
+
+  if (slot) {
+    const Cheat *cheat = &cheats->cheats[slot - 1];
+    if (cheat->compare < 0 || cheat->compare == val)
+      return cheat->value;
+  }
+  return val;
+}
+
+/* Pages */
+
+static void take_page(Cpu6502 *cpu, int page) {
+  CheatPage *cheat_page = &cpu->cheats->pages[page];
+  BusPage *bus = &cpu->bus[page];
+
+  if (cheat_page->taken)
+    return;
+
+  // Blocks decoded from the page didn't see the cheats
+  if (cpu->block_cache)
+    block_cache_invalidate_page(cpu, page);
+
+  cheat_page->taken = 1;
+  cheat_page->read_ptr = bus->read_ptr;
+  cheat_page->read = bus->read;
+  bus->read_ptr = NULL;
+  bus->read = cheat_read;
+}
+
+static void release_page(Cpu6502 *cpu, int page) {
+  CheatPage *cheat_page = &cpu->cheats->pages[page];
+  BusPage *bus = &cpu->bus[page];
+
+  if (!cheat_page->taken)
+    return;
+
+  cheat_page->taken = 0;
+  bus->read_ptr = cheat_page->read_ptr;
+  bus->read = cheat_page->read;
+
+  if (cpu->block_cache)
+    block_cache_invalidate_page(cpu, page);
+}
+
+static void set_slot(Cpu6502 *cpu, uint16_t addr, int slot) {
+  struct Cheats *cheats = cpu->cheats;
+  CheatPage *page = &cheats->pages[addr >> 8];
+
+  if (!cheats->slot[addr] == !slot) {
+    cheats->slot[addr] = slot;
+    return;
+  }
+
+  cheats->slot[addr] = slot;
+  if (slot && page->count++ == 0)
+    take_page(cpu, addr >> 8);
+  else if (!slot && --page->count == 0)
+    release_page(cpu, addr >> 8);
+}
+
+// Memory the page reads from, whether or not it has been taken
+static const uint8_t *page_memory(Cpu6502 *cpu, int page) {
+  const CheatPage *cheat_page = &cpu->cheats->pages[page];
+  return cheat_page->taken ? cheat_page->read_ptr : cpu->bus[page].read_ptr;
+}
+
+/* Codes */
+
+// Letters in the order of the values they stand for
+static const char genie_letters[] = "APZLGITYEOXUKSVN";
+
+int cheat_decode_genie(const char *code, uint16_t *addr, uint8_t *value,
+                       int *compare) {
+  int len = strlen(code);
+  uint8_t n[8];
+
+  if (len != 6 && len != 8)
+    return 0;
+
+  for (int i = 0; i < len; i++) {
+    const char *letter = strchr(genie_letters, toupper((unsigned char)code[i]));
+    if (!letter)
+      return 0;
+    n[i] = letter - genie_letters;
+  }
+
+  *addr = 0x8000 | ((n[3] & 7) << 12) | ((n[5] & 7) << 8) | ((n[4] & 8) << 8) |
+          ((n[2] & 7) << 4) | ((n[1] & 8) << 4) | (n[4] & 7) | (n[3] & 8);
+  *value = ((n[1] & 7) << 4) | ((n[0] & 8) << 4) | (n[0] & 7);
+
+  // The last letter's high bit goes to the value, the sixth's moves to the
+  // compare value in 8 letter codes
+  if (len == 6) {
+    *value |= n[5] & 8;
+    *compare = -1;
+  } else {
+    *value |= n[7] & 8;
+    *compare = ((n[7] & 7) << 4) | ((n[6] & 8) << 4) | (n[6] & 7) | (n[5] & 8);
+  }
+  return 1;
+}
+
+// Exactly digits hex digits, then end or ':'
+static int parse_hex(const char **s, int digits, unsigned *out) {
+  *out = 0;
+  for (int i = 0; i < digits; i++, (*s)++) {
+    if (!isxdigit((unsigned char)**s))
+      return 0;
+    *out = *out << 4 | (isdigit((unsigned char)**s)
+                            ? **s - '0'
+                            : toupper((unsigned char)**s) - 'A' + 10);
+  }
+  return **s == '\0' || **s == ':';
+}
+
+// AAAA:VV or AAAA:VV:CC
+static int decode_raw(const char *code, uint16_t *addr, uint8_t *value,
+                      int *compare) {
+  unsigned a, v, c;
+
+  if (!parse_hex(&code, 4, &a) || *code++ != ':' || !parse_hex(&code, 2, &v))
+    return 0;
+
+  *compare = -1;
+  if (*code == ':') {
+    code++;
+    if (!parse_hex(&code, 2, &c) || *code)
+      return 0;
+    *compare = c;
+  }
+
+  *addr = a;
+  *value = v;
+  return 1;
+}
+
+// Points addr and, below $8000, every mirror of it at slot
+static void set_slot_mirrored(Cpu6502 *cpu, uint16_t addr, int slot) {
+  const uint8_t *mem = page_memory(cpu, addr >> 8);
+
+  set_slot(cpu, addr, slot);
+  for (int page = 0; mem && addr < 0x8000 && page < 0x80; page++) {
+    if (page != addr >> 8 && page_memory(cpu, page) == mem)
+      set_slot(cpu, page << 8 | (addr & 0xFF), slot);
+  }
+}
+
+int cheat_add(Cpu6502 *cpu, const char *code) {
+  uint16_t addr;
+  uint8_t value;
+  int compare;
+
+  if (!cheat_decode_genie(code, &addr, &value, &compare) &&
+      !decode_raw(code, &addr, &value, &compare))
+    return -1;
+
+  if (!cpu->cheats) {
+    cpu->cheats = calloc(1, sizeof(struct Cheats));
+    if (!cpu->cheats)
+      return -1;
+  }
+
+  struct Cheats *cheats = cpu->cheats;
+  int cheat = cheats->slot[addr] - 1;
+
+  for (int i = 0; cheat < 0 && i < CHEAT_MAX; i++) {
+    if (!cheats->cheats[i].used)
+      cheat = i;
+  }
+  if (cheat < 0)
+    return -1;
+
+  cheats->cheats[cheat] = (Cheat){.used = 1,
+                                  .addr = addr,
+                                  .value = value,
+                                  .compare = compare};
+  set_slot_mirrored(cpu, addr, cheat + 1);
+
+  // The instruction under way may have fetched from the old page
+  cpu->uop = NULL;
+  return cheat;
+}
+
+int cheat_load(Cpu6502 *cpu, FILE *file, int *bad_line) {
+  char line[256];
+  int added = 0;
+
+  *bad_line = 0;
+  for (int num = 1; fgets(line, sizeof(line), file); num++) {
+    // The code is the first word, anything after it describes the cheat
+    char *code = strtok(line, " \t\r\n");
+    if (!code || *code == '#')
+      continue;
+
+    if (cheat_add(cpu, code) >= 0)
+      added++;
+    else if (!*bad_line)
+      *bad_line = num;
+  }
+  return added;
+}
+
+void cheat_remove(Cpu6502 *cpu, int cheat) {
+  struct Cheats *cheats = cpu->cheats;
+
+  if (!cheats || cheat < 0 || cheat >= CHEAT_MAX || !cheats->cheats[cheat].used)
+    return;
+
+  // Mirrors may have been remapped since, so go by slot
+  for (int addr = 0; addr < 0x10000; addr++) {
+    if (cheats->slot[addr] == cheat + 1)
+      set_slot(cpu, addr, 0);
+  }
+  cheats->cheats[cheat].used = 0;
+  cpu->uop = NULL;
+}
+
+void cheat_clear(Cpu6502 *cpu) {
+  if (!cpu->cheats)
+    return;
+
+  for (int page = 0; page < 0x100; page++)
+    release_page(cpu, page);
+
+  free(cpu->cheats);
+  cpu->cheats = NULL;
+  cpu->uop = NULL;
+}
+
+void cheat_map_page(Cpu6502 *cpu, int page) {
+  CheatPage *cheat_page = &cpu->cheats->pages[page];
+
+  // What was saved is the old mapping
+  cheat_page->taken = 0;
+  if (cheat_page->count)
+    take_page(cpu, page);
+}
@@ -1,5 +1,15 @@
 #include "cpu/cpu.h"
 #include "config.h"
+#include "cpu/block_cache.h"
+#include "cpu/cheat.h"
+#include "cpu/debug.h"
+#include "cpu/idle.h"
+#include "cpu/jit.h"
+#include "cpu/opcodes.h"
+#include "cpu/profile.h"
+#include "cpu/stats.h"
+#include "cpu/trace.h"
+#include "mapper/mapper.h"
 
 #include <stdint.h>
 #include <stdio.h>
@@ -11,42 +21,126 @@
 
 #include "ppu.h"
 
-#define CPU_MEMORY_SIZE 0x10000 // 64 KB
-#define NES_HEADER_SIZE 16
 #define NES_TEST 0xC000
 
-uint8_t memory[CPU_MEMORY_SIZE] = {0};
-FILE *log_file;
+/**  Helper functions **/
 
-// int to hold status flags
-uint8_t status;
+#if NES_CDL
+// Instruction length by opcode, for logging its operand bytes. Relative
+// branches are the only opcodes of the form xxx10000.
+#define X(op, type, mode, fn, cyc, pcyc, mn)                                   \
+  [op] = 1 + UOP_BYTES_##mode + (((op) & 0x1F) == 0x10),
 
-// int to hold lower byte of memory address
-uint8_t LB, HB;
-uint16_t address, zpg_addr;
+static const uint8_t instr_bytes[256] = {CPU_OPCODES(X)};
 
-char new_carry;
+#undef X
 
-int instr_num = 0;
+static inline void cdl_exec(Cpu6502 *cpu, uint16_t pc, uint8_t instr) {
+  int len = instr_bytes[instr];
+  uint16_t pc1 = pc + 1, pc2 = pc + 2;
 
-unsigned char dma_active_flag;
-int page_crossed = 0;
-int branch_cycles = 0;
-int branch_instr = 0;
-int dma_cycles = 0;
+  cpu->bus[pc >> 8].cdl[pc & 0xFF] |= CDL_OPCODE;
+  cpu->bus[pc1 >> 8].cdl[pc1 & 0xFF] |= CDL_OPERAND & -(len > 1);
+  cpu->bus[pc2 >> 8].cdl[pc2 & 0xFF] |= CDL_OPERAND & -(len > 2);
+}
 
-/**  Helper functions **/
-static inline void ppu_exec(Cpu6502 *cpu) {
-  ppu_execute_cycle(cpu->ppu);
-  ppu_execute_cycle(cpu->ppu);
-  ppu_execute_cycle(cpu->ppu);
+// Data read by an instruction. The fused and table cores fetch immediate
+// operands through here too, always at the PC; those aren't data.
+static inline uint8_t cdl_read(Cpu6502 *cpu, uint16_t addr) {
+  cpu->bus[addr >> 8].cdl[addr & 0xFF] |= CDL_DATA & -(addr != cpu->PC);
+  return read_instr(cpu, addr);
+}
+
+#define LOGGED_READ(cpu, addr) cdl_read((cpu), (addr))
+#else
+#define LOGGED_READ(cpu, addr) read_instr((cpu), (addr))
+#endif
+
+#if NES_DEBUGGER
+// Only accesses to pages with a watchpoint armed go any further than the
+// flag test. Immediate operands are fetched at the PC and aren't data.
+static inline uint8_t watch_read(Cpu6502 *cpu, uint16_t addr) {
+  uint8_t val = LOGGED_READ(cpu, addr);
+
+  if (cpu->bus[addr >> 8].watch & WATCH_READ && addr != cpu->PC)
+    debug_access(cpu, addr, val, WATCH_READ);
+  return val;
 }
 
-inline void push_stack(uint8_t lower_addr, uint8_t val) {
-  memory[0x0100 | lower_addr] = val;
+static inline void watch_write(Cpu6502 *cpu, uint16_t addr, uint8_t val) {
+  if (cpu->bus[addr >> 8].watch & WATCH_WRITE)
+    debug_access(cpu, addr, val, WATCH_WRITE);
+  memory_write(cpu, addr, val);
 }
 
-uint16_t page_crossing(uint16_t addr, uint16_t oper) {
+#define BUS_READ(cpu, addr) watch_read((cpu), (addr))
+#define BUS_WRITE(cpu, addr, val) watch_write((cpu), (addr), (val))
+#define BUS_WATCHED(page) ((page)->watch)
+#else
+#define BUS_READ(cpu, addr) LOGGED_READ((cpu), (addr))
+#define BUS_WRITE(cpu, addr, val) memory_write((cpu), (addr), (val))
+#define BUS_WATCHED(page) 0
+#endif
+
+// Bus accesses made by instructions. Both cores are built from the same
+// instruction code through these: with CPU_CYCLE_ACCURATE every access first
+// takes its CPU cycle on the master clock, so a PPU or APU register sees it
+// on the right dot. Otherwise they are plain bus accesses and the whole
+// instruction is put on the clock when it retires.
+//
+// The 6502 is on the bus every cycle, so the cycles that do no useful work
+// still read or write something: the byte after a one-byte opcode, the
+// stack before a pull, the uncorrected address of an indexed access, the
+// old value of a read-modify-write. Only the cycle-accurate core makes
+// these, a register behind them sees them the way it would on hardware.
+#if CPU_CYCLE_ACCURATE
+static inline void cpu_tick(Cpu6502 *cpu, int cycles) {
+  cpu->sched.now += cycles * 3;
+  cpu->bus_cycles += cycles;
+}
+
+#define CPU_TICK(cpu, cycles) cpu_tick((cpu), (cycles))
+#define CPU_READ(cpu, addr) (cpu_tick((cpu), 1), BUS_READ((cpu), (addr)))
+#define CPU_WRITE(cpu, addr, val)                                              \
+  (cpu_tick((cpu), 1), BUS_WRITE((cpu), (addr), (val)))
+#define CPU_DUMMY_READ(cpu, addr) ((void)CPU_READ((cpu), (addr)))
+#define CPU_DUMMY_WRITE(cpu, addr, val) CPU_WRITE((cpu), (addr), (val))
+#else
+#define CPU_TICK(cpu, cycles) ((void)0)
+#define CPU_READ(cpu, addr) BUS_READ((cpu), (addr))
+#define CPU_WRITE(cpu, addr, val) BUS_WRITE((cpu), (addr), (val))
+#define CPU_DUMMY_READ(cpu, addr) ((void)(addr))
+#define CPU_DUMMY_WRITE(cpu, addr, val) ((void)(addr), (void)(val))
+#endif
+
+// Profiler hooks (see cpu/profile.h), gone unless CPU_PROFILE is set
+#if CPU_PROFILE
+#define PROFILE(cpu, hook)                                                     \
+  do {                                                                         \
+    if ((cpu)->profile)                                                        \
+      hook;                                                                    \
+  } while (0)
+#else
+#define PROFILE(cpu, hook) ((void)0)
+#endif
+
+// Counts the instruction about to retire, before its timing state is cleared
+#if CPU_STATS
+#define STATS_COUNT(cpu)                                                       \
+  do {                                                                         \
+    if ((cpu)->stats)                                                          \
+      cpu_stats_count((cpu)->stats, (cpu)->instr, (cpu)->page_crossed,         \
+                      (cpu)->branch_instr ? (cpu)->branch_cycles : 0);         \
+  } while (0)
+#else
+#define STATS_COUNT(cpu) ((void)0)
+#endif
+
+inline void push_stack(Cpu6502 *cpu, uint8_t lower_addr, uint8_t val) {
+  CPU_WRITE(cpu, 0x0100 | lower_addr, val);
+}
+
+uint16_t page_crossing(Cpu6502 *cpu, uint16_t addr, uint16_t oper) {
 
   uint16_t address = 0;
   address = addr + oper;
@@ -54,25 +148,35 @@ uint16_t page_crossing(uint16_t addr, uint16_t oper) {
   if (((addr + oper) & 0xFF00) != (addr & 0xFF00)) {
     // Keep the page from the addr to emulate bug
     address = (addr & 0xFF00) | (address & 0xFF);
-    page_crossed = 1;
+    cpu->page_crossed = 1;
   }
   return address;
 }
 
-void join_char_array(uint8_t *val, unsigned char arr[8]) {
+static inline void set_flag(Cpu6502 *cpu, uint8_t flag, int on) {
+  cpu->P = on ? (cpu->P | flag) : (cpu->P & ~flag);
+}
+
+static inline int flag_Z(Cpu6502 *cpu) { return (cpu->nz & 0xFF) == 0; }
 
-  *val = 0x0;
+static inline int flag_N(Cpu6502 *cpu) { return (cpu->nz & 0x8080) != 0; }
 
-  for (int i = 0; i < 8; i++) {
-    *val |= arr[i] << i;
-  }
+uint8_t cpu_get_status(Cpu6502 *cpu) {
+  uint8_t status = cpu->P & ~(FLAG_N | FLAG_Z);
+
+  if (flag_N(cpu))
+    status |= FLAG_N;
+  if (flag_Z(cpu))
+    status |= FLAG_Z;
+
+  return status;
 }
 
-void uint8_to_char_array(uint8_t val, unsigned char arr[8]) {
+void cpu_set_status(Cpu6502 *cpu, uint8_t status) {
+  cpu->P = status;
 
-  for (int i = 0; i < 8; i++) {
-    arr[i] = (val >> i) & 0x1;
-  }
+  // Encode N in bit 15 and Z in the low byte so both can be set at once
+  cpu->nz = ((status & FLAG_N) << 8) | !(status & FLAG_Z);
 }
 
 void emulate_6502_cycle(int cycle) {
@@ -84,11 +188,20 @@ void emulate_6502_cycle(int cycle) {
 
 /* PPU Functions */
 
+void cpu_ppu_sync(Cpu6502 *cpu) {
+  if (cpu->ppu_time < cpu->sched.now) {
+    ppu_run(cpu->ppu, cpu->sched.now - cpu->ppu_time);
+    cpu->ppu_time = cpu->sched.now;
+  }
+}
+
 void cpu_ppu_write(Cpu6502 *cpu, uint16_t addr, uint8_t val) {
+  cpu_ppu_sync(cpu);
   ppu_registers_write(cpu->ppu, addr, val);
 }
 
 uint8_t cpu_ppu_read(Cpu6502 *cpu, uint16_t addr) {
+  cpu_ppu_sync(cpu);
   return ppu_registers_read(cpu->ppu, addr);
 }
 
@@ -104,36 +217,272 @@ void ctrl1_write(Cpu6502 *cpu, uint8_t val) {
   }
 }
 
-void memory_write(Cpu6502 *cpu, uint16_t addr, uint8_t value) {
-  if (addr >= 0x2000 && addr <= 0x3FFF) {
-    // PPU register range (mirrored every 8 bytes)
-    uint16_t reg_addr = 0x2000 + (addr % 8);
-    cpu_ppu_write(cpu, reg_addr, value);
-  } else if (addr == 0x4014) {
-    // DMA
-    dma_active_flag = 1;
-    dma_cycles = (cpu->cycles % 2 == 0) ? 513 : 514;
-    uint8_t page_mem[0x100];
-    memcpy(page_mem, &memory[value << 8], 0x100);
-    load_ppu_oam_mem(cpu->ppu, page_mem);
+uint8_t ctrl1_read(Cpu6502 *cpu) {
+  uint8_t bit = (cpu->ctrl_latch_state >> cpu->ctrl_bit_index) & 1;
+  if (!cpu->strobe && cpu->ctrl_bit_index < 8)
+    cpu->ctrl_bit_index++;
+
+  return bit | 0x40;
+}
+
+/* Bus Functions */
+
+uint8_t bus_read_ppu(Cpu6502 *cpu, uint16_t addr) {
+#if NES_DEBUGGER
+  if (cpu->debug && (addr & 7) == 7)
+    debug_ppu_access(cpu, 0, WATCH_READ);
+#endif
+  // PPU register range (mirrored every 8 bytes)
+  return cpu_ppu_read(cpu, 0x2000 + (addr % 8));
+}
+
+void bus_write_ppu(Cpu6502 *cpu, uint16_t addr, uint8_t val) {
+#if NES_DEBUGGER
+  if (cpu->debug && (addr & 7) == 7)
+    debug_ppu_access(cpu, val, WATCH_WRITE);
+#endif
+  cpu_ppu_write(cpu, 0x2000 + (addr % 8), val);
+}
+
+uint8_t bus_read_io(Cpu6502 *cpu, uint16_t addr) {
+  if (addr == 0x4015)
+    return read_apu_status(cpu->apu_mmio);
+
+  if (addr == 0x4016)
+    return ctrl1_read(cpu);
+
+  // The other registers are write-only, the data bus still holds the high
+  // byte of the address
+  return addr >> 8;
+}
+
+void bus_write_io(Cpu6502 *cpu, uint16_t addr, uint8_t val) {
+  if (addr == 0x4014) {
+    // DMA. The stall starts once this instruction retires and takes an
+    // extra cycle to line up with a read cycle if it starts on an odd one.
+    cpu->dma_active_flag = 1;
+    cpu->dma_cycles = ((cpu->cpu_cycle_count + cpu->cycles) & 1) ? 514 : 513;
+
+    // The PPU sees the new OAM from here on
+    cpu_ppu_sync(cpu);
+
+    // One bulk copy from the source page, straight into OAM
+    const BusPage *page = &cpu->bus[val];
+#if NES_CDL
+    for (int i = 0; i < OAM_SIZE; i++)
+      page->cdl[i] |= CDL_DATA;
+#endif
+    if (page->read_ptr) {
+      load_ppu_oam_mem(cpu->ppu, page->read_ptr);
+    } else {
+      for (int i = 0; i < OAM_SIZE; i++)
+        cpu->ppu->oam_memory[i] = page->read(cpu, (val << 8) | i);
+    }
   } else if (addr == 0x4016) {
     // Controller 1
-    ctrl1_write(cpu, value);
-  } else if (addr >= 0x4000 && addr <= 0x4017) {
+    ctrl1_write(cpu, val);
+  } else if (addr <= 0x4017) {
     // APU/MMIO registers
-    write_apu_mmio(cpu->apu_mmio, addr, value);
+    write_apu_mmio(cpu->apu_mmio, addr, val);
   }
+}
 
-  // Always write to memory
-  memory[addr] = value;
+void bus_write_rom(Cpu6502 *cpu, uint16_t addr, uint8_t val) {
+  // Writes to PRG ROM are ignored
+  (void)cpu;
+  (void)addr;
+  (void)val;
 }
 
-uint8_t ctrl1_read(Cpu6502 *cpu) {
-  uint8_t bit = (cpu->ctrl_latch_state >> cpu->ctrl_bit_index) & 1;
-  if (!cpu->strobe && cpu->ctrl_bit_index < 8)
-    cpu->ctrl_bit_index++;
+// Nothing answers at $4100-$5FFF on a cartridge without expansion hardware
+uint8_t bus_read_open(Cpu6502 *cpu, uint16_t addr) {
+  (void)cpu;
+  return addr >> 8;
+}
 
-  return bit | 0x40;
+void bus_write_open(Cpu6502 *cpu, uint16_t addr, uint8_t val) {
+  (void)cpu;
+  (void)addr;
+  (void)val;
+}
+
+void cpu_bus_map(Cpu6502 *cpu, int first_page, int last_page,
+                 const uint8_t *read_base, uint8_t *write_base, BusRead read,
+                 BusWrite write) {
+  for (int page = first_page; page <= last_page; page++) {
+    int offset = (page - first_page) << 8;
+
+    // Blocks decoded from the old mapping are stale
+    if (cpu->block_cache)
+      block_cache_invalidate_page(cpu, page);
+
+    cpu->bus[page].read_ptr = read_base ? read_base + offset : NULL;
+    cpu->bus[page].write_ptr = write_base ? write_base + offset : NULL;
+    cpu->bus[page].read = read;
+    cpu->bus[page].write = write;
+    cpu->bus[page].cdl = cpu->cdl_scratch;
+
+    // Cheats on the page apply to whatever it maps now
+    if (cpu->cheats)
+      cheat_map_page(cpu, page);
+  }
+}
+
+// Point the PRG ROM pages at their Code/Data Logger flags
+static void cpu_cdl_map(Cpu6502 *cpu) {
+  Cdl *cdl = cpu->cdl;
+
+  if (!cdl || !cdl->prg_size)
+    return;
+
+  // Smaller PRG is mirrored up to $FFFF
+  for (int page = 0x80; page <= 0xFF; page++)
+    cpu->bus[page].cdl = cdl->prg + (((page - 0x80) << 8) % cdl->prg_size);
+}
+
+void cpu_cdl_attach(Cpu6502 *cpu, Cdl *cdl) {
+  cpu->cdl = cdl;
+
+  // Boards point each bank at its flags as they map it
+  if (cpu->mapper) {
+    mapper_remap(cpu);
+    return;
+  }
+
+  cpu_cdl_map(cpu);
+  for (int bank = 0; cdl->chr_size >= PPU_CHR_SIZE && bank < PPU_CHR_BANKS;
+       bank++)
+    cpu->ppu->chr_cdl[bank] = cdl->chr + bank * PPU_CHR_BANK_SIZE;
+}
+
+void cpu_bus_init(Cpu6502 *cpu) {
+  // Watch flags belong to addresses, not to what is mapped there, so mapping
+  // leaves them alone. Nothing is watched until a debugger arms it.
+  for (int page = 0; page < 0x100; page++)
+    cpu->bus[page].watch = 0;
+
+  // $0000-$1FFF: internal RAM, mirrored four times
+  for (int page = 0x00; page < 0x20; page += CPU_RAM_SIZE >> 8)
+    cpu_bus_map(cpu, page, page + (CPU_RAM_SIZE >> 8) - 1, cpu->ram, cpu->ram,
+                NULL, NULL);
+
+  // $2000-$3FFF: PPU registers
+  cpu_bus_map(cpu, 0x20, 0x3F, NULL, NULL, bus_read_ppu, bus_write_ppu);
+
+  // $4000-$40FF: APU, OAM DMA and controller registers
+  cpu_bus_map(cpu, 0x40, 0x40, NULL, NULL, bus_read_io, bus_write_io);
+
+  // $4100-$5FFF: expansion area
+  cpu_bus_map(cpu, 0x41, 0x5F, NULL, NULL, bus_read_open, bus_write_open);
+
+  // $6000-$7FFF: cartridge RAM
+  cpu_bus_map(cpu, 0x60, 0x7F, cpu->prg_ram, cpu->prg_ram, NULL, NULL);
+
+  // $8000-$FFFF: PRG ROM, a smaller image mirrored up to $FFFF
+  int prg_pages = cpu->prg_size >> 8;
+  if (!prg_pages) {
+    cpu_bus_map(cpu, 0x80, 0xFF, NULL, NULL, bus_read_open, bus_write_rom);
+  } else {
+    for (int page = 0x80; page <= 0xFF; page += prg_pages) {
+      int last = page + prg_pages - 1 < 0xFF ? page + prg_pages - 1 : 0xFF;
+      cpu_bus_map(cpu, page, last, cpu->prg_rom, NULL, NULL, bus_write_rom);
+    }
+  }
+  cpu_cdl_map(cpu);
+}
+
+inline void memory_write(Cpu6502 *cpu, uint16_t addr, uint8_t value) {
+  const BusPage *page = &cpu->bus[addr >> 8];
+
+  if (page->write_ptr)
+    page->write_ptr[addr & 0xFF] = value;
+  else
+    page->write(cpu, addr, value);
+}
+
+inline uint8_t read_instr(Cpu6502 *cpu, uint16_t addr) {
+  const BusPage *page = &cpu->bus[addr >> 8];
+
+  if (page->read_ptr)
+    return page->read_ptr[addr & 0xFF];
+
+  return page->read(cpu, addr);
+}
+
+// Read-modify-write through the bus. Pages backed by host memory are
+// modified in place, everything else goes through the page handlers. The
+// cycle-accurate core always takes the bus, which sees the unmodified value
+// written back before the result.
+#define BUS_MODIFY(cpu, addr, fn)                                              \
+  do {                                                                         \
+    uint16_t rmw_addr = (addr);                                                \
+    const BusPage *rmw_page = &(cpu)->bus[rmw_addr >> 8];                      \
+    if (!CPU_CYCLE_ACCURATE && rmw_page->write_ptr &&                          \
+        rmw_page->write_ptr == rmw_page->read_ptr && !BUS_WATCHED(rmw_page)) { \
+      fn((cpu), &rmw_page->write_ptr[rmw_addr & 0xFF]);                        \
+    } else {                                                                   \
+      uint8_t rmw_val = CPU_READ((cpu), rmw_addr);                             \
+      CPU_DUMMY_WRITE((cpu), rmw_addr, rmw_val);                               \
+      fn((cpu), &rmw_val);                                                     \
+      CPU_WRITE((cpu), rmw_addr, rmw_val);                                     \
+    }                                                                          \
+  } while (0)
+
+/* Scheduled events */
+
+// VBlank starts, take the NMI if PPUCTRL enabled it
+static int cpu_on_vblank(void *ctx, uint64_t time) {
+  Cpu6502 *cpu = ctx;
+  (void)time;
+
+  cpu_ppu_sync(cpu);
+  sched_schedule(&cpu->sched, SCHED_VBLANK,
+                 cpu->ppu_time + ppu_dots_until(cpu->ppu, 241, 1));
+
+  if (!cpu->ppu->nmi_flag)
+    return 0;
+
+  cpu_nmi_triggered(cpu);
+  cpu->ppu->nmi_flag = 0;
+  return 1;
+}
+
+// Bring the PPU up to date so the finished frame can be shown
+static int cpu_on_frame_end(void *ctx, uint64_t time) {
+  Cpu6502 *cpu = ctx;
+  (void)time;
+
+  cpu_ppu_sync(cpu);
+  sched_schedule(&cpu->sched, SCHED_FRAME_END,
+                 cpu->ppu_time + ppu_dots_until(cpu->ppu, 260, NUM_DOTS - 1));
+  return 0;
+}
+
+// Level-triggered: taken whenever the line is high and I is clear
+static int cpu_on_irq(void *ctx, uint64_t time) {
+  Cpu6502 *cpu = ctx;
+  (void)time;
+
+  if (!cpu->irq.sources || (cpu->P & FLAG_I))
+    return 0;
+
+  cpu_irq_triggered(cpu);
+  return 1;
+}
+
+// I was cleared, an IRQ held off until now is taken after this instruction
+static void cpu_irq_poll(Cpu6502 *cpu) {
+  if (cpu->irq.sources && !(cpu->P & FLAG_I))
+    sched_schedule(&cpu->sched, SCHED_IRQ, cpu->sched.now);
+}
+
+static int cpu_on_dma_end(void *ctx, uint64_t time) {
+  Cpu6502 *cpu = ctx;
+  (void)time;
+
+  cpu->dma_active_flag = 0;
+  cpu->dma_cycles = 0;
+  return 0;
 }
 
 // Core functions
@@ -147,101 +496,115 @@ void cpu_init(Cpu6502 *cpu) {
   cpu->Y = 0x0;
 
   cpu->nmi_state = 0;
-  cpu->PC = (memory[0xFFFD] << 8) | memory[0xFFFC];
-
-  // #if NES_TEST_ROM == 1
-  //   cpu->PC = 0xC000;
-  // #endif
+  cpu->PC = (read_instr(cpu, 0xFFFD) << 8) | read_instr(cpu, 0xFFFC);
 
   printf("ADDR: %X\n", cpu->PC);
-  cpu->instr = memory[cpu->PC];
+  cpu->instr = read_instr(cpu, cpu->PC);
   cpu->cycles = 7;
 
-  cpu->P[0] = 0;
-  cpu->P[1] = 0;
-  cpu->P[2] = 1;
-  cpu->P[3] = 0;
-  cpu->P[4] = 1;
-  cpu->P[5] = 0;
-  cpu->P[6] = 0;
-  cpu->P[7] = 0;
+  cpu_set_status(cpu, FLAG_I | FLAG_B);
 
   // memset(memory, 0, sizeof(memory));
 
-  for (int i = 0; i < 25; i++) {
-    ppu_exec(cpu);
-  }
+  // Set up the clock. OAM DMA takes its parity from the cycle count, so it
+  // counts from power-on.
+  sched_init(&cpu->sched);
+  cpu->bus_cycles = 0;
+  cpu->cpu_cycle_count = 0;
+  cpu->dma_active_flag = 0;
+  cpu->dma_cycles = 0;
+  sched_set_handler(&cpu->sched, SCHED_VBLANK, cpu_on_vblank, cpu);
+  sched_set_handler(&cpu->sched, SCHED_FRAME_END, cpu_on_frame_end, cpu);
+  sched_set_handler(&cpu->sched, SCHED_DMA_END, cpu_on_dma_end, cpu);
+  sched_set_handler(&cpu->sched, SCHED_IRQ, cpu_on_irq, cpu);
 
-  log_file = fopen("log.txt", "w");
-  fclose(log_file);
-  log_file = fopen("log.txt", "a");
+  cpu->irq.sources = 0;
+  cpu->irq.sched = &cpu->sched;
 
-#if NES_TEST_ROM
-  push_stack(0100 | cpu->S, 0x70);
-  cpu->S--;
+  // The PPU starts 25 CPU cycles ahead
+  cpu->ppu_time = 0;
+  cpu->sched.now = 25 * 3;
+  cpu_ppu_sync(cpu);
 
-  push_stack(0100 | cpu->S, 0x00);
-  cpu->S--;
-#endif
+  sched_schedule(&cpu->sched, SCHED_VBLANK,
+                 cpu->ppu_time + ppu_dots_until(cpu->ppu, 241, 1));
+  sched_schedule(&cpu->sched, SCHED_FRAME_END,
+                 cpu->ppu_time + ppu_dots_until(cpu->ppu, 260, NUM_DOTS - 1));
+
+  // Boards that count scanlines run on the same clock
+  mapper_start(cpu);
 }
 
-void load_cpu_memory(Cpu6502 *cpu, unsigned char *prg_rom, int prg_size) {
-  // Clear memory
-  memset(memory, 0, CPU_MEMORY_SIZE);
+void load_cpu_memory(Cpu6502 *cpu, const uint8_t *prg_rom, int prg_size) {
+  // Frontends keep the CPU on the stack: every field, RAM and the
+  // attachments (trace, JIT, debugger...) starts out zero
+  memset(cpu, 0, sizeof(Cpu6502));
 
-  // Load PRG ROM into 0x8000 - 0xBFFF
-  memcpy(&memory[0x8000], prg_rom, prg_size);
+  cpu->block_cache = block_cache_create();
+  idle_loop_reset(cpu);
 
-  // If PRG ROM is 16KB, mirror it into $C000-$FFFF (NROM-128 behavior)
-  if (prg_size == 16384) {
-    memcpy(&memory[0xC000], prg_rom, 16384);
-  }
+  // 16 KB (NROM-128) or 32 KB of PRG ROM at $8000, mapped where it is
+  cpu->prg_rom = prg_rom;
+  cpu->prg_size = prg_size;
+
+  cpu_bus_init(cpu);
 }
 
-void dump_log_file(Cpu6502 *cpu) {
-  fprintf(log_file, "PC: %x ", cpu->PC);
-  fprintf(log_file, " %x ", cpu->instr);
-
-  fprintf(log_file, "A: %x ", cpu->A);
-  fprintf(log_file, "X: %x ", cpu->X);
-  fprintf(log_file, "Y: %x ", cpu->Y);
-  join_char_array(&status, cpu->P);
-  fprintf(log_file, "SP: %x ", cpu->S);
-  fprintf(log_file, "P: %x (%b) ", status, status);
-  fprintf(log_file, "Cycle: %d ", cpu->cycles);
-  fprintf(log_file, "I #: %d\n", instr_num);
-  fprintf(log_file, "\n");
-}
-uint8_t read_instr(Cpu6502 *cpu, uint16_t addr) {
-  if (addr >= 0x2000 && addr <= 0x3FFF) {
-    uint16_t reg_addr = 0x2000 + (addr % 8);
-    return cpu_ppu_read(cpu, reg_addr);
-  } else if (addr == 0x4016) {
-    return ctrl1_read(cpu);
-  } else {
-    return memory[addr];
-  }
+// Push the state before the instruction at PC runs to the trace
+static void cpu_trace(Cpu6502 *cpu) {
+  const BusPage *page1 = &cpu->bus[(uint16_t)(cpu->PC + 1) >> 8];
+  const BusPage *page2 = &cpu->bus[(uint16_t)(cpu->PC + 2) >> 8];
+
+  cpu_ppu_sync(cpu);
+
+  // Operand bytes are only read where that has no side effects
+  TraceRecord record = {
+      .cycle = cpu->cpu_cycle_count,
+      .pc = cpu->PC,
+      .opcode = cpu->instr,
+      .operand = {page1->read_ptr ? page1->read_ptr[(cpu->PC + 1) & 0xFF] : 0,
+                  page2->read_ptr ? page2->read_ptr[(cpu->PC + 2) & 0xFF] : 0},
+      .a = cpu->A,
+      .x = cpu->X,
+      .y = cpu->Y,
+      .s = cpu->S,
+      .p = cpu_get_status(cpu),
+      .scanline = cpu->ppu->scanline,
+      .dot = cpu->ppu->current_scanline_cycle,
+  };
+
+  trace_push(cpu->trace, &record);
 }
+
+void cpu_cleanup(Cpu6502 *cpu) {
+  jit_destroy(cpu->jit);
+  cpu->jit = NULL;
+
+  block_cache_destroy(cpu->block_cache);
+  cpu->block_cache = NULL;
+  cpu->uop = NULL;
+
+  cheat_clear(cpu);
+  mapper_detach(cpu);
+}
+
 // access
 void instr_LDA(Cpu6502 *cpu, uint16_t addr) {
-  cpu->A = read_instr(cpu, addr);
+  cpu->A = CPU_READ(cpu, addr);
   cpu->PC++;
-  cpu->P[1] = cpu->A == 0;
-  cpu->P[7] = (cpu->A & 0x80) == 0x80;
+  cpu->nz = cpu->A;
 }
 
 void instr_LDX(Cpu6502 *cpu, uint16_t addr) {
-  cpu->X = read_instr(cpu, addr);
+  cpu->X = CPU_READ(cpu, addr);
   cpu->PC++;
-  cpu->P[1] = cpu->X == 0;
-  cpu->P[7] = (cpu->X & 0x80) == 0x80;
+  cpu->nz = cpu->X;
 }
 
 void instr_LDY(Cpu6502 *cpu, uint16_t addr) {
-  cpu->Y = read_instr(cpu, addr);
+  cpu->Y = CPU_READ(cpu, addr);
   cpu->PC++;
-  cpu->P[1] = cpu->Y == 0;
-  cpu->P[7] = (cpu->Y & 0x80) == 0x80;
+  cpu->nz = cpu->Y;
 }
 
 void instr_STA(Cpu6502 *cpu, uint16_t addr) {
@@ -251,27 +614,27 @@ void instr_STA(Cpu6502 *cpu, uint16_t addr) {
   //    addr = reg_addr;
   //    cpu_ppu_write(cpu, reg_addr, cpu->A);
   //  } else if (addr == 0x4014) {
-  //    dma_active_flag = 1;
-  //    dma_cycles = cpu->cycles % 2 == 0 ? 513 : 514;
+  //    cpu->dma_active_flag = 1;
+  //    cpu->dma_cycles = cpu->cycles % 2 == 0 ? 513 : 514;
   //    uint8_t page_mem[0x100];
-  //    memcpy(page_mem, &memory[cpu->A << 8], 0x100);
+  //    memcpy(page_mem, &cpu->memory[cpu->A << 8], 0x100);
   //    load_ppu_oam_mem(cpu->ppu, page_mem);
   //  } else if (addr == 0x4016) {
   //    ctrl1_write(cpu, cpu->A);
   //  }
   //
-  memory_write(cpu, addr, cpu->A);
-  // memory[addr] = cpu->A;
+  CPU_WRITE(cpu, addr, cpu->A);
+  // cpu->memory[addr] = cpu->A;
   cpu->PC++;
 }
 
 void instr_STX(Cpu6502 *cpu, uint16_t addr) {
-  memory_write(cpu, addr, cpu->X);
+  CPU_WRITE(cpu, addr, cpu->X);
   cpu->PC++;
 }
 
 void instr_STY(Cpu6502 *cpu, uint16_t addr) {
-  memory_write(cpu, addr, cpu->Y);
+  CPU_WRITE(cpu, addr, cpu->Y);
   cpu->PC++;
 }
 
@@ -279,30 +642,26 @@ void instr_STY(Cpu6502 *cpu, uint16_t addr) {
 void instr_TAX(Cpu6502 *cpu) {
   cpu->X = cpu->A;
 
-  cpu->P[1] = cpu->X == 0;
-  cpu->P[7] = (cpu->X & 0x80) == 0x80;
+  cpu->nz = cpu->X;
   cpu->PC++;
 }
 
 void instr_TXA(Cpu6502 *cpu) {
   cpu->A = cpu->X;
 
-  cpu->P[1] = cpu->A == 0;
-  cpu->P[7] = (cpu->A & 0x80) == 0x80;
+  cpu->nz = cpu->A;
   cpu->PC++;
 }
 void instr_TAY(Cpu6502 *cpu) {
   cpu->Y = cpu->A;
 
-  cpu->P[1] = cpu->Y == 0;
-  cpu->P[7] = (cpu->Y & 0x80) == 0x80;
+  cpu->nz = cpu->Y;
   cpu->PC++;
 }
 void instr_TYA(Cpu6502 *cpu) {
   cpu->A = cpu->Y;
 
-  cpu->P[1] = cpu->A == 0;
-  cpu->P[7] = (cpu->A & 0x80) == 0x80;
+  cpu->nz = cpu->A;
   cpu->PC++;
 }
 
@@ -312,19 +671,18 @@ void instr_ADC(Cpu6502 *cpu, uint8_t oper) {
   uint16_t result = 0;
   uint8_t new_A = cpu->A;
 
-  result = (uint16_t)(cpu->A + oper + cpu->P[0]);
+  result = (uint16_t)(cpu->A + oper + (cpu->P & FLAG_C));
 
   // Use lower byte for A
   new_A = result & 0xFF;
 
   // Set carry bit if upper byte is 1
-  cpu->P[0] = result > 0xFF;
+  set_flag(cpu, FLAG_C, result > 0xFF);
 
   // Set zero flag and negative flag
-  cpu->P[1] = new_A == 0;
-  cpu->P[7] = new_A >> 7;
+  cpu->nz = new_A;
 
-  cpu->P[6] = ((cpu->A ^ new_A) & (new_A ^ oper) & 0x80) == 0x80;
+  set_flag(cpu, FLAG_V, ((cpu->A ^ new_A) & (new_A ^ oper) & 0x80) == 0x80);
   cpu->A = new_A;
 
   cpu->PC++;
@@ -333,23 +691,20 @@ void instr_SBC(Cpu6502 *cpu, uint8_t oper) {
   uint16_t result = 0;
   uint8_t new_A = cpu->A;
 
-  result = (uint16_t)(cpu->A - oper - (1 - cpu->P[0]));
+  result = (uint16_t)(cpu->A - oper - (1 - (cpu->P & FLAG_C)));
 
   new_A = result & 0xFF;
 
   // If  M < old A value, it underflows.
   // Carry is cleared if it underflows
-  char new_carry = cpu->A >= (oper + (1 - cpu->P[0]));
-  cpu->P[0] = new_carry;
-
-  // Zero flag
-  cpu->P[1] = new_A == 0;
+  char new_carry = cpu->A >= (oper + (1 - (cpu->P & FLAG_C)));
+  set_flag(cpu, FLAG_C, new_carry);
 
-  // Negative flag
-  cpu->P[7] = new_A >> 7;
+  // Zero flag and negative flag
+  cpu->nz = new_A;
 
   // Overflow flag
-  cpu->P[6] = (((cpu->A ^ new_A) & (oper ^ cpu->A)) & 0x80) != 0;
+  set_flag(cpu, FLAG_V, (((cpu->A ^ new_A) & (oper ^ cpu->A)) & 0x80) != 0);
   cpu->A = new_A;
 
   cpu->PC++;
@@ -358,74 +713,66 @@ void instr_SBC(Cpu6502 *cpu, uint8_t oper) {
 void instr_INC(Cpu6502 *cpu, uint8_t *M) {
   *M = *M + 1;
 
-  cpu->P[1] = *M == 0;
-  cpu->P[7] = (*M & 0x80) == 0x80;
+  cpu->nz = *M;
   cpu->PC++;
 }
 
 void instr_DEC(Cpu6502 *cpu, uint8_t *M) {
   *M = *M - 1;
 
-  cpu->P[1] = *M == 0;
-  cpu->P[7] = (*M & 0x80) == 0x80;
+  cpu->nz = *M;
   cpu->PC++;
 }
 
 void instr_INX(Cpu6502 *cpu) {
   cpu->X++;
 
-  cpu->P[1] = cpu->X == 0;
-  cpu->P[7] = (cpu->X & 0x80) == 0x80;
+  cpu->nz = cpu->X;
   cpu->PC++;
 }
 
 void instr_DEX(Cpu6502 *cpu) {
   cpu->X--;
 
-  cpu->P[1] = cpu->X == 0;
-  cpu->P[7] = (cpu->X & 0x80) == 0x80;
+  cpu->nz = cpu->X;
   cpu->PC++;
 }
 
 void instr_INY(Cpu6502 *cpu) {
   cpu->Y++;
 
-  cpu->P[1] = cpu->Y == 0;
-  cpu->P[7] = (cpu->Y & 0x80) == 0x80;
+  cpu->nz = cpu->Y;
   cpu->PC++;
 }
 
 void instr_DEY(Cpu6502 *cpu) {
   cpu->Y--;
 
-  cpu->P[1] = cpu->Y == 0;
-  cpu->P[7] = (cpu->Y & 0x80) == 0x80;
+  cpu->nz = cpu->Y;
   cpu->PC++;
 }
 
 // Shift
 void instr_ASL(Cpu6502 *cpu, uint8_t *M) {
   // Set the carry flag to the 7th bit of Accumulator.
-  cpu->P[0] = (*M & 0x80) >> 7;
+  set_flag(cpu, FLAG_C, (*M & 0x80) >> 7);
   *M = *M << 1;
 
   // Set zero flag and negative flag
-  cpu->P[1] = *M == 0;
-  cpu->P[7] = *M >> 7;
+  cpu->nz = *M;
 
   cpu->PC++;
 }
 void instr_LSR(Cpu6502 *cpu, uint8_t *M) {
 
   // Store 7th bit of memory as new carry value
-  cpu->P[0] = *M & 0x01;
+  set_flag(cpu, FLAG_C, *M & 0x01);
 
   *M = *M >> 1;
 
   // Set zero flag and negative flag
-  cpu->P[1] = *M == 0;
   // Inserting 0, so it cannot be negative
-  cpu->P[7] = 0;
+  cpu->nz = *M;
 
   cpu->PC++;
 }
@@ -437,40 +784,34 @@ void instr_ROL(Cpu6502 *cpu, uint8_t *M) {
   *M = *M << 1;
 
   // change last bit to value of old carry
-  *M = (*M & ~1) | (cpu->P[0] & 1);
+  *M = (*M & ~1) | (cpu->P & FLAG_C);
 
   // Set carry bit to the 7th bit of the old value of memory
-  cpu->P[0] = new_carry;
+  set_flag(cpu, FLAG_C, new_carry);
 
   // Set zero flag and negative flag
-  cpu->P[1] = *M == 0;
-  cpu->P[7] = *M >> 7;
+  cpu->nz = *M;
 
   cpu->PC++;
 }
 void instr_ROR(Cpu6502 *cpu, uint8_t *M) {
 
   // Store 0th bit of memory as new carry value
-  new_carry = *M & 0x01;
+  char new_carry = *M & 0x01;
   *M = *M >> 1;
 
   // Old carry bit becomes MSB
   // Set MSB to 1 to carry flag is 1
-  if (cpu->P[0]) {
+  if (cpu->P & FLAG_C) {
     *M |= 0x80;
-
-    // MSB is 1 so it is negative
-    cpu->P[7] = 1;
-  } else {
-    // Inserting 0, so it cannot be negative
-    cpu->P[7] = 0;
   }
 
   // Set carry flag to LSB of M
-  cpu->P[0] = new_carry;
+  set_flag(cpu, FLAG_C, new_carry);
 
   // Set zero flag and negative flag
-  cpu->P[1] = *M == 0;
+  // MSB is the old carry, so it is negative if carry was set
+  cpu->nz = *M;
 
   cpu->PC++;
 }
@@ -480,8 +821,7 @@ void instr_AND(Cpu6502 *cpu, uint8_t M) {
   cpu->A &= M;
 
   // Set zero flag and negative flag
-  cpu->P[1] = cpu->A == 0;
-  cpu->P[7] = cpu->A >> 7;
+  cpu->nz = cpu->A;
 
   cpu->PC++;
 }
@@ -490,8 +830,7 @@ void instr_ORA(Cpu6502 *cpu, uint8_t M) {
   cpu->A |= M;
 
   // Set zero flag and negative flag
-  cpu->P[1] = cpu->A == 0;
-  cpu->P[7] = cpu->A >> 7;
+  cpu->nz = cpu->A;
 
   cpu->PC++;
 }
@@ -499,21 +838,17 @@ void instr_EOR(Cpu6502 *cpu, uint8_t M) {
   cpu->A ^= M;
 
   // Set zero flag and negative flag
-  cpu->P[1] = cpu->A == 0;
-  cpu->P[7] = cpu->A >> 7;
+  cpu->nz = cpu->A;
 
   cpu->PC++;
 }
 void instr_BIT(Cpu6502 *cpu, uint8_t M) {
 
-  // Negative flag set to 7 bit of memory
-  cpu->P[7] = M >> 7;
-
   // Overflow flag set to 6th bit of memory
-  cpu->P[6] = (M >> 6) & 0x1;
+  set_flag(cpu, FLAG_V, (M >> 6) & 0x1);
 
-  // Zero flag
-  cpu->P[1] = (cpu->A & M) == 0;
+  // Zero flag from A & M, negative flag set to 7 bit of memory
+  cpu->nz = (cpu->A & M) | ((M & 0x80) << 8);
 
   cpu->PC++;
 }
@@ -522,13 +857,10 @@ void instr_BIT(Cpu6502 *cpu, uint8_t M) {
 void instr_CMP(Cpu6502 *cpu, uint8_t M) {
 
   // Carry Flag
-  cpu->P[0] = cpu->A >= M;
-
-  // Zero flag
-  cpu->P[1] = cpu->A == M;
+  set_flag(cpu, FLAG_C, cpu->A >= M);
 
-  // Negative Flag
-  cpu->P[7] = ((cpu->A - M) & 0x80) == 0x80;
+  // Zero flag and negative flag
+  cpu->nz = (uint8_t)(cpu->A - M);
 
   cpu->PC++;
 }
@@ -536,13 +868,10 @@ void instr_CMP(Cpu6502 *cpu, uint8_t M) {
 void instr_CPX(Cpu6502 *cpu, uint8_t M) {
 
   // Carry Flag
-  cpu->P[0] = cpu->X >= M;
+  set_flag(cpu, FLAG_C, cpu->X >= M);
 
-  // Zero flag
-  cpu->P[1] = cpu->X == M;
-
-  // Negative Flag
-  cpu->P[7] = ((cpu->X - M) & 0x80) == 0x80;
+  // Zero flag and negative flag
+  cpu->nz = (uint8_t)(cpu->X - M);
 
   cpu->PC++;
 }
@@ -550,13 +879,10 @@ void instr_CPX(Cpu6502 *cpu, uint8_t M) {
 void instr_CPY(Cpu6502 *cpu, uint8_t M) {
 
   // Carry Flag
-  cpu->P[0] = cpu->Y >= M;
-
-  // Zero flag
-  cpu->P[1] = cpu->Y == M;
+  set_flag(cpu, FLAG_C, cpu->Y >= M);
 
-  // Negative Flag
-  cpu->P[7] = ((cpu->Y - M) & 0x80) == 0x80;
+  // Zero flag and negative flag
+  cpu->nz = (uint8_t)(cpu->Y - M);
 
   cpu->PC++;
 }
@@ -564,11 +890,11 @@ void instr_CPY(Cpu6502 *cpu, uint8_t M) {
 // Branch
 
 void instr_branch(Cpu6502 *cpu, char flag) {
-  branch_instr = 1;
+  cpu->branch_instr = 1;
 
   // Increment PC by to get signed offset
   cpu->PC += 1;
-  uint8_t signed_offset = memory[cpu->PC];
+  uint8_t signed_offset = read_instr(cpu, cpu->PC);
 
   uint16_t old_addr = cpu->PC;
 
@@ -583,67 +909,68 @@ void instr_branch(Cpu6502 *cpu, char flag) {
       cpu->PC += 1 + signed_offset;
     }
 
-    if ((cpu->PC & 0xFF00) != ((old_addr + 2) & 0xFF00)) {
+    // The next opcode is read while the offset is added to the low byte,
+    // and the wrong page is read while a carry fixes the high byte
+    CPU_DUMMY_READ(cpu, old_addr + 1);
+    if ((cpu->PC & 0xFF00) != ((old_addr + 1) & 0xFF00)) {
+      CPU_DUMMY_READ(cpu, ((old_addr + 1) & 0xFF00) | (cpu->PC & 0xFF));
       emulate_6502_cycle(4);
-      branch_cycles = 4;
+      cpu->branch_cycles = 4;
     } else {
       emulate_6502_cycle(3);
-      branch_cycles = 3;
-    }
-
-    if (old_addr - 1 == cpu->PC) {
-      // printf("\nCAUGHT IN A TRAP!\n");
-      exit(0);
+      cpu->branch_cycles = 3;
     }
 
   } else {
     cpu->PC++;
     emulate_6502_cycle(2);
-    branch_cycles = 2;
+    cpu->branch_cycles = 2;
   }
 }
 
-void instr_BCC(Cpu6502 *cpu) { instr_branch(cpu, !cpu->P[0]); }
+void instr_BCC(Cpu6502 *cpu) { instr_branch(cpu, !(cpu->P & FLAG_C)); }
 
-void instr_BCS(Cpu6502 *cpu) { instr_branch(cpu, cpu->P[0]); }
+void instr_BCS(Cpu6502 *cpu) { instr_branch(cpu, cpu->P & FLAG_C); }
 
-void instr_BEQ(Cpu6502 *cpu) { instr_branch(cpu, cpu->P[1]); }
+void instr_BEQ(Cpu6502 *cpu) { instr_branch(cpu, flag_Z(cpu)); }
 
-void instr_BNE(Cpu6502 *cpu) { instr_branch(cpu, !cpu->P[1]); }
+void instr_BNE(Cpu6502 *cpu) { instr_branch(cpu, !flag_Z(cpu)); }
 
-void instr_BPL(Cpu6502 *cpu) { instr_branch(cpu, !cpu->P[7]); }
+void instr_BPL(Cpu6502 *cpu) { instr_branch(cpu, !flag_N(cpu)); }
 
-void instr_BMI(Cpu6502 *cpu) { instr_branch(cpu, cpu->P[7]); }
+void instr_BMI(Cpu6502 *cpu) { instr_branch(cpu, flag_N(cpu)); }
 
-void instr_BVC(Cpu6502 *cpu) { instr_branch(cpu, !cpu->P[6]); }
+void instr_BVC(Cpu6502 *cpu) { instr_branch(cpu, !(cpu->P & FLAG_V)); }
 
-void instr_BVS(Cpu6502 *cpu) { instr_branch(cpu, cpu->P[6]); }
+void instr_BVS(Cpu6502 *cpu) { instr_branch(cpu, cpu->P & FLAG_V); }
 
 void instr_JMP(Cpu6502 *cpu, uint16_t addr) { cpu->PC = addr; }
 
+// The return address is already pushed (see addr_jsr)
 void instr_JSR(Cpu6502 *cpu, uint16_t addr) {
-  push_stack(cpu->S, cpu->PC >> 8);
-  cpu->S--;
-
-  push_stack(cpu->S, cpu->PC & 0xFF);
-  cpu->S--;
-
   cpu->PC = addr;
+  PROFILE(cpu, profile_call(cpu->profile, PROFILE_CALL, addr, cpu->S + 2));
 }
 
 void instr_RTS(Cpu6502 *cpu) {
 
+  // The stack is read before S moves
+  CPU_DUMMY_READ(cpu, 0x100 | cpu->S);
+
   // LIFO stack, push LB last so LB comes out first
   cpu->S++;
-  LB = memory[0x100 | cpu->S];
+  uint8_t LB = CPU_READ(cpu, 0x100 | cpu->S);
 
   // HB pushed first so comes out last
   cpu->S++;
 
   // Using address variable, but this is the PC value
-  address = memory[0x100 | cpu->S] << 8 | LB;
+  uint16_t address = CPU_READ(cpu, 0x100 | cpu->S) << 8 | LB;
 
+  // Read again while it is incremented
+  CPU_DUMMY_READ(cpu, address);
   cpu->PC = address + 1;
+  PROFILE(cpu, profile_return(cpu->profile, cpu->S));
 }
 
 void instr_BRK(Cpu6502 *cpu) {
@@ -652,56 +979,61 @@ void instr_BRK(Cpu6502 *cpu) {
   cpu->PC += 2;
 
   // Push first half of PC
-  push_stack(cpu->S, cpu->PC >> 8);
+  push_stack(cpu, cpu->S, cpu->PC >> 8);
   // Decrement Stack Pointer by 1
   cpu->S -= 1;
 
   // Push second half of PC
-  push_stack(cpu->S, cpu->PC & 0x00FF);
+  push_stack(cpu, cpu->S, cpu->PC & 0x00FF);
   cpu->S -= 1;
 
   // Set Break flag to 1
-  cpu->P[4] = 1;
+  cpu->P |= FLAG_B;
 
   // Reserve bit must be 1 as wel
-  cpu->P[5] = 1;
+  cpu->P |= FLAG_U;
 
   // Merging Status flags to save it on stack
-  join_char_array(&status, cpu->P);
+  uint8_t status = cpu_get_status(cpu);
 
   // Set interrupt disable to 1 after pushing to stack
-  cpu->P[2] = 1;
+  cpu->P |= FLAG_I;
 
-  push_stack(cpu->S, status);
+  push_stack(cpu, cpu->S, status);
   cpu->S -= 1;
 
-  cpu->PC = memory[0xFFFF] << 8 | memory[0xFFFE];
+  uint8_t LB = CPU_READ(cpu, 0xFFFE);
+  cpu->PC = CPU_READ(cpu, 0xFFFF) << 8 | LB;
+  PROFILE(cpu, profile_call(cpu->profile, PROFILE_BRK, cpu->PC, cpu->S + 3));
 }
 
 void instr_RTI(Cpu6502 *cpu) {
 
   // Return from Interrupt
   // Pull S, then pull PC
+  CPU_DUMMY_READ(cpu, 0x100 | cpu->S);
   cpu->S++;
-  uint8_to_char_array(memory[0x0100 | cpu->S], cpu->P);
+  cpu_set_status(cpu, CPU_READ(cpu, 0x0100 | cpu->S));
 
   // LIFO stack, push LB last so LB comes out first
   cpu->S++;
-  LB = memory[0x100 | cpu->S];
+  uint8_t LB = CPU_READ(cpu, 0x100 | cpu->S);
 
   // HB pushed first so comes out last
   cpu->S++;
   // Using address variable, but this is the PC value
-  address = memory[0x0100 | cpu->S] << 8 | LB;
+  uint16_t address = CPU_READ(cpu, 0x0100 | cpu->S) << 8 | LB;
 
   cpu->PC = address;
+  PROFILE(cpu, profile_return(cpu->profile, cpu->S));
+  cpu_irq_poll(cpu);
 }
 
 // Stack
 void instr_PHA(Cpu6502 *cpu) {
 
   // Push accumulator on stack
-  push_stack(cpu->S, cpu->A);
+  push_stack(cpu, cpu->S, cpu->A);
 
   cpu->S--;
   cpu->PC++;
@@ -710,23 +1042,23 @@ void instr_PHA(Cpu6502 *cpu) {
 void instr_PLA(Cpu6502 *cpu) {
 
   // Pull accumulator from stack
+  CPU_DUMMY_READ(cpu, 0x100 | cpu->S);
   cpu->S++;
-  cpu->A = memory[0x100 | cpu->S];
+  cpu->A = CPU_READ(cpu, 0x100 | cpu->S);
   cpu->PC++;
 
-  cpu->P[1] = cpu->A == 0;
-  cpu->P[7] = (cpu->A & 0x80) == 0x80;
+  cpu->nz = cpu->A;
 }
 
 void instr_PHP(Cpu6502 *cpu) {
 
   // Push Status Flags to stack, with B flag set
-  cpu->P[4] = 1;
+  cpu->P |= FLAG_B;
   // Reserve bit set to 1
-  cpu->P[5] = 1;
+  cpu->P |= FLAG_U;
 
-  join_char_array(&status, cpu->P);
-  push_stack(cpu->S, status);
+  uint8_t status = cpu_get_status(cpu);
+  push_stack(cpu, cpu->S, status);
   cpu->S--;
 
   cpu->PC++;
@@ -734,15 +1066,17 @@ void instr_PHP(Cpu6502 *cpu) {
 
 void instr_PLP(Cpu6502 *cpu) {
   // Pull Processor Status from Stack
+  CPU_DUMMY_READ(cpu, 0x100 | cpu->S);
   cpu->S++;
 
-  uint8_to_char_array(memory[0x0100 | cpu->S], cpu->P);
+  cpu_set_status(cpu, CPU_READ(cpu, 0x0100 | cpu->S));
 
   // These bits are ignored, just set to 1
-  cpu->P[5] = 1;
-  cpu->P[4] = 1;
+  cpu->P |= FLAG_U;
+  cpu->P |= FLAG_B;
 
   cpu->PC++;
+  cpu_irq_poll(cpu);
 }
 
 void instr_TXS(Cpu6502 *cpu) {
@@ -754,52 +1088,52 @@ void instr_TSX(Cpu6502 *cpu) {
   cpu->X = cpu->S;
   cpu->PC++;
 
-  cpu->P[1] = cpu->X == 0;
-  cpu->P[7] = (cpu->X & 0x80) == 0x80;
+  cpu->nz = cpu->X;
 }
 
 // Flags
 void instr_CLC(Cpu6502 *cpu) {
   // clear carry flag
-  cpu->P[0] = 0;
+  cpu->P &= ~FLAG_C;
 
   cpu->PC++;
 }
 
 void instr_SEC(Cpu6502 *cpu) {
   // set carry flag
-  cpu->P[0] = 1;
+  cpu->P |= FLAG_C;
 
   cpu->PC++;
 }
 
 void instr_CLI(Cpu6502 *cpu) {
   // clear interrupt flag
-  cpu->P[2] = 0;
+  cpu->P &= ~FLAG_I;
 
   cpu->PC++;
+  cpu_irq_poll(cpu);
 }
 
 void instr_SEI(Cpu6502 *cpu) {
-  cpu->P[2] = 1;
+  cpu->P |= FLAG_I;
 
   cpu->PC++;
 }
 
 void instr_CLD(Cpu6502 *cpu) {
-  cpu->P[3] = 0;
+  cpu->P &= ~FLAG_D;
 
   cpu->PC++;
 }
 
 void instr_SED(Cpu6502 *cpu) {
-  cpu->P[3] = 1;
+  cpu->P |= FLAG_D;
 
   cpu->PC++;
 }
 
 void instr_CLV(Cpu6502 *cpu) {
-  cpu->P[6] = 0;
+  cpu->P &= ~FLAG_V;
 
   cpu->PC++;
 }
@@ -807,18 +1141,23 @@ void instr_CLV(Cpu6502 *cpu) {
 // Other
 void instr_NOP(Cpu6502 *cpu) { cpu->PC++; }
 
+// Unofficial NOPs that fetch an operand and ignore it
+void instr_IGN(Cpu6502 *cpu, uint16_t addr) {
+  CPU_DUMMY_READ(cpu, addr);
+  cpu->PC++;
+}
+
 // Illegal opcodes
 
 void instr_LAX(Cpu6502 *cpu, uint8_t val) {
   cpu->A = val;
   cpu->X = val;
   cpu->PC++;
-  cpu->P[1] = cpu->X == 0;
-  cpu->P[7] = (cpu->X & 0x80) == 0x80;
+  cpu->nz = cpu->X;
 }
 
 void instr_SAX(Cpu6502 *cpu, uint16_t addr) {
-  memory[addr] = cpu->A & cpu->X;
+  CPU_WRITE(cpu, addr, cpu->A & cpu->X);
   cpu->PC++;
 }
 
@@ -826,13 +1165,10 @@ void instr_DCP(Cpu6502 *cpu, uint8_t *M) {
   *M = *M - 1;
 
   // Carry Flag
-  cpu->P[0] = cpu->A >= *M;
-
-  // Zero flag
-  cpu->P[1] = cpu->A == *M;
+  set_flag(cpu, FLAG_C, cpu->A >= *M);
 
-  // Negative Flag
-  cpu->P[7] = ((cpu->A - *M) & 0x80) == 0x80;
+  // Zero flag and negative flag
+  cpu->nz = (uint8_t)(cpu->A - *M);
 
   cpu->PC++;
 }
@@ -843,23 +1179,20 @@ void instr_ISC(Cpu6502 *cpu, uint8_t *M) {
   uint16_t result = 0;
   uint8_t new_A = cpu->A;
 
-  result = (uint16_t)(cpu->A - *M - (1 - cpu->P[0]));
+  result = (uint16_t)(cpu->A - *M - (1 - (cpu->P & FLAG_C)));
 
   new_A = result & 0xFF;
 
   // If  M < old A value, it underflows.
   // Carry is cleared if it underflows
-  char new_carry = cpu->A >= (*M + (1 - cpu->P[0]));
-  cpu->P[0] = new_carry;
-
-  // Zero flag
-  cpu->P[1] = new_A == 0;
+  char new_carry = cpu->A >= (*M + (1 - (cpu->P & FLAG_C)));
+  set_flag(cpu, FLAG_C, new_carry);
 
-  // Negative flag
-  cpu->P[7] = new_A >> 7;
+  // Zero flag and negative flag
+  cpu->nz = new_A;
 
   // Overflow flag
-  cpu->P[6] = (((cpu->A ^ new_A) & (*M ^ cpu->A)) & 0x80) != 0;
+  set_flag(cpu, FLAG_V, (((cpu->A ^ new_A) & (*M ^ cpu->A)) & 0x80) != 0);
   cpu->A = new_A;
 
   cpu->PC++;
@@ -872,59 +1205,52 @@ void instr_RLA(Cpu6502 *cpu, uint8_t *M) {
   *M = *M << 1;
 
   // change last bit to value of old carry
-  *M = (*M & ~1) | (cpu->P[0] & 1);
+  *M = (*M & ~1) | (cpu->P & FLAG_C);
 
   cpu->A &= *M;
   // Set carry bit to the 7th bit of the old value of memory
-  cpu->P[0] = new_carry;
+  set_flag(cpu, FLAG_C, new_carry);
 
   // Set zero flag and negative flag
-  cpu->P[1] = cpu->A == 0;
-  cpu->P[7] = cpu->A >> 7;
+  cpu->nz = cpu->A;
 
   cpu->PC++;
 }
 
 void instr_RRA(Cpu6502 *cpu, uint8_t *M) {
   // Store 0th bit of memory as new carry value
-  new_carry = *M & 0x01;
+  char new_carry = *M & 0x01;
   *M = *M >> 1;
 
   // Old carry bit becomes MSB
   // Set MSB to 1 to carry flag is 1
-  if (cpu->P[0]) {
+  if (cpu->P & FLAG_C) {
     *M |= 0x80;
-
-    // MSB is 1 so it is negative
-    cpu->P[7] = 1;
-  } else {
-    // Inserting 0, so it cannot be negative
-    cpu->P[7] = 0;
   }
 
   // Set carry flag to LSB of M
-  cpu->P[0] = new_carry;
+  set_flag(cpu, FLAG_C, new_carry);
 
   // Set zero flag and negative flag
-  cpu->P[1] = *M == 0;
+  // MSB is the old carry, so it is negative if carry was set
+  cpu->nz = *M;
 
   uint16_t result = 0;
   uint8_t new_A = cpu->A;
 
   // Reuse zpg variable (in case it overflows)
-  result = (uint16_t)(cpu->A + *M + cpu->P[0]);
+  result = (uint16_t)(cpu->A + *M + (cpu->P & FLAG_C));
 
   // Use lower byte for A
   new_A = result & 0xFF;
 
   // Set carry bit if upper byte is 1
-  cpu->P[0] = result > 0xFF;
+  set_flag(cpu, FLAG_C, result > 0xFF);
 
   // Set zero flag and negative flag
-  cpu->P[1] = new_A == 0;
-  cpu->P[7] = new_A >> 7;
+  cpu->nz = new_A;
 
-  cpu->P[6] = ((cpu->A ^ new_A) & (new_A ^ *M) & 0x80) == 0x80;
+  set_flag(cpu, FLAG_V, ((cpu->A ^ new_A) & (new_A ^ *M) & 0x80) == 0x80);
   cpu->A = new_A;
 
   cpu->PC++;
@@ -932,85 +1258,216 @@ void instr_RRA(Cpu6502 *cpu, uint8_t *M) {
 
 void instr_SLO(Cpu6502 *cpu, uint8_t *M) {
   // Set the carry flag to the 7th bit of Accumulator.
-  cpu->P[0] = (*M & 0x80) >> 7;
+  set_flag(cpu, FLAG_C, (*M & 0x80) >> 7);
 
   *M = *M << 1;
 
   cpu->A |= *M;
 
   // Set zero flag and negative flag
-  cpu->P[1] = cpu->A == 0;
-  cpu->P[7] = cpu->A >> 7;
+  cpu->nz = cpu->A;
 
   cpu->PC++;
 }
 
 void instr_SRE(Cpu6502 *cpu, uint8_t *M) {
   // Store 7th bit of memory as new carry value
-  cpu->P[0] = *M & 0x01;
+  set_flag(cpu, FLAG_C, *M & 0x01);
 
   *M = *M >> 1;
 
   cpu->A ^= *M;
   // Set zero flag and negative flag
-  cpu->P[1] = cpu->A == 0;
-  cpu->P[7] = cpu->A >> 7;
+  cpu->nz = cpu->A;
 
   cpu->PC++;
 }
 
-void cpu_nmi_triggered(Cpu6502 *cpu) {
-  // Push PC and jump to $FFFA
-  push_stack(cpu->S, cpu->PC >> 8);
+// Push PC and status and jump through the vector. The interrupt sequence
+// runs between instructions. The cycle-accurate core puts its 7 bus cycles
+// on the clock, the other takes none.
+static void cpu_interrupt(Cpu6502 *cpu, uint16_t vector) {
+  // The next opcode is fetched twice and dropped
+  CPU_DUMMY_READ(cpu, cpu->PC);
+  CPU_DUMMY_READ(cpu, cpu->PC);
+
+  CPU_TICK(cpu, 1);
+  memory_write(cpu, 0x0100 | cpu->S, cpu->PC >> 8);
   cpu->S--;
 
-  push_stack(cpu->S, cpu->PC & 0xFF);
+  CPU_TICK(cpu, 1);
+  memory_write(cpu, 0x0100 | cpu->S, cpu->PC & 0xFF);
   cpu->S--;
 
-  cpu->P[4] = 0;
-  cpu->P[5] = 1;
+  cpu->P &= ~FLAG_B;
+  cpu->P |= FLAG_U;
 
   // Merging Status flags to save it on stack
-  join_char_array(&status, cpu->P);
+  uint8_t status = cpu_get_status(cpu);
 
   // Set interrupt disable to 1 after pushing to stack
-  cpu->P[2] = 1;
+  cpu->P |= FLAG_I;
 
-  push_stack(cpu->S, status);
+  CPU_TICK(cpu, 1);
+  memory_write(cpu, 0x0100 | cpu->S, status);
   cpu->S -= 1;
 
-  cpu->PC = (memory[0xFFFB] << 8) | memory[0xFFFA];
+  CPU_TICK(cpu, 1);
+  uint8_t LB = read_instr(cpu, vector);
+  CPU_TICK(cpu, 1);
+  cpu->PC = (read_instr(cpu, vector + 1) << 8) | LB;
+
+#if CPU_CYCLE_ACCURATE
+  // Counted here, the instruction before has already retired
+  cpu->cpu_cycle_count += cpu->bus_cycles;
+  cpu->bus_cycles = 0;
+#endif
+  PROFILE(cpu, profile_interrupt(cpu->profile,
+                                 vector == 0xFFFA ? PROFILE_NMI : PROFILE_IRQ,
+                                 cpu->PC, cpu->S + 3));
+}
+
+void cpu_nmi_triggered(Cpu6502 *cpu) { cpu_interrupt(cpu, 0xFFFA); }
+
+void cpu_irq_triggered(Cpu6502 *cpu) { cpu_interrupt(cpu, 0xFFFE); }
+
+// The reset button: the interrupt sequence with its stack writes suppressed.
+// RAM and the other registers keep their values.
+void cpu_reset(Cpu6502 *cpu) {
+  cpu->S -= 3;
+  cpu->P |= FLAG_I;
+  cpu->PC = (read_instr(cpu, 0xFFFD) << 8) | read_instr(cpu, 0xFFFC);
+  idle_loop_reset(cpu);
 }
 // Addresing modes
 
+#if CPU_CYCLE_ACCURATE
+// Operand bytes fetched ahead of the instruction's own accesses. An
+// immediate operand is fetched by the instruction's read of it.
+#define FETCH_BYTES_NULL 0
+#define FETCH_BYTES_addr_imm 0
+#define FETCH_BYTES_addr_zpg 1
+#define FETCH_BYTES_addr_zpg_X 1
+#define FETCH_BYTES_addr_zpg_Y 1
+#define FETCH_BYTES_addr_X_ind 1
+#define FETCH_BYTES_addr_ind_Y 1
+#define FETCH_BYTES_addr_abs 2
+#define FETCH_BYTES_addr_abs_X 2
+#define FETCH_BYTES_addr_abs_Y 2
+#define FETCH_BYTES_addr_ind 2
+#define FETCH_BYTES_addr_ind_jmp 2
+#define FETCH_BYTES_addr_jsr 1 // The high byte comes after the stack writes
+
+// Bus cycles each opcode spends fetching itself and its operand. Relative
+// branches fetch their offset themselves.
+#define X(op, type, mode, fn, cyc, pcyc, mn)                                   \
+  [op] = 1 + FETCH_BYTES_##mode + (((op) & 0x1F) == 0x10),
+
+static const uint8_t fetch_cycles[256] = {CPU_OPCODES(X)};
+
+#undef X
+
+// One-byte opcodes, which read the byte after them and drop it
+#define X(op, type, mode, fn, cyc, pcyc, mn)                                   \
+  [op] = !UOP_BYTES_##mode && ((op) & 0x1F) != 0x10,
+
+static const uint8_t fetch_padding[256] = {CPU_OPCODES(X)};
+
+#undef X
+
+// Indexed reads, which only pay for a page crossing when there is one
+#define X(op, type, mode, fn, cyc, pcyc, mn) [op] = (pcyc) != 0,
+
+static const uint8_t read_only[256] = {CPU_OPCODES(X)};
+
+#undef X
+#endif
+
+// Effective address helpers, shared with the pre-decoded block path
+static inline uint16_t ea_indexed(Cpu6502 *cpu, uint16_t base, uint8_t index) {
+  uint16_t addr = base + index;
+  cpu->page_crossed = (addr & 0xFF00) != (base & 0xFF00);
+
+#if CPU_CYCLE_ACCURATE
+  // The index is added to the low byte first and that address is read. A
+  // carry costs a cycle to fix the high byte, which stores and
+  // read-modify-writes always take.
+  if (cpu->page_crossed || !read_only[cpu->instr])
+    CPU_DUMMY_READ(cpu, (base & 0xFF00) | (addr & 0xFF));
+#endif
+  return addr;
+}
+
+static inline uint16_t ea_ind_jmp(Cpu6502 *cpu, uint16_t addr) {
+  uint8_t LB = CPU_READ(cpu, addr);
+
+  // The pointer doesn't carry into its high byte
+  return CPU_READ(cpu, (addr & 0xFF00) | ((addr + 1) & 0xFF)) << 8 | LB;
+}
+
+// JSR pushes the address of its last byte before it fetches that byte
+static inline void jsr_push(Cpu6502 *cpu) {
+  CPU_DUMMY_READ(cpu, 0x100 | cpu->S);
+  push_stack(cpu, cpu->S, cpu->PC >> 8);
+  cpu->S--;
+
+  push_stack(cpu, cpu->S, cpu->PC & 0xFF);
+  cpu->S--;
+}
+
+static inline uint16_t ea_X_ind(Cpu6502 *cpu, uint8_t oper) {
+  // Read before X is added
+  CPU_DUMMY_READ(cpu, oper);
+
+  // Ignore carry if it exists
+  uint8_t BB = (oper + cpu->X) & 0xFF;
+
+  uint8_t LB = CPU_READ(cpu, BB);
+  uint8_t HB = CPU_READ(cpu, page_crossing(cpu, BB, 1));
+
+  return HB << 8 | LB;
+}
+
+static inline uint16_t ea_ind_Y(Cpu6502 *cpu, uint8_t BB) {
+  uint8_t LB = CPU_READ(cpu, BB);
+  uint8_t HB = CPU_READ(cpu, page_crossing(cpu, BB, 1));
+
+  return ea_indexed(cpu, HB << 8 | LB, cpu->Y);
+}
+
 uint16_t addr_abs(Cpu6502 *cpu) {
 
   // Increment to get the lower byte
   cpu->PC += 1;
   uint16_t addr;
-  uint8_t LB = memory[cpu->PC];
+  uint8_t LB = read_instr(cpu, cpu->PC);
 
   // Increment to get the upper byte
   cpu->PC += 1;
-  addr = memory[cpu->PC] << 8 | LB;
+  addr = read_instr(cpu, cpu->PC) << 8 | LB;
 
   return addr;
 }
 
-uint16_t addr_ind_jmp(Cpu6502 *cpu) {
+uint16_t addr_jsr(Cpu6502 *cpu) {
   cpu->PC++;
-  uint8_t LB = memory[cpu->PC];
+  uint8_t LB = read_instr(cpu, cpu->PC);
 
   cpu->PC++;
-  uint8_t HB = memory[cpu->PC];
+  jsr_push(cpu);
 
-  uint16_t addr = (HB << 8) | LB;
+  CPU_TICK(cpu, 1);
+  return read_instr(cpu, cpu->PC) << 8 | LB;
+}
 
-  if (LB == 0xFF) {
-    return (memory[addr & 0xFF00] << 8) | memory[addr];
-  } else {
-    return (memory[addr + 1] << 8) | memory[addr];
-  }
+uint16_t addr_ind_jmp(Cpu6502 *cpu) {
+  cpu->PC++;
+  uint8_t LB = read_instr(cpu, cpu->PC);
+
+  cpu->PC++;
+  uint8_t HB = read_instr(cpu, cpu->PC);
+
+  return ea_ind_jmp(cpu, (HB << 8) | LB);
 }
 
 uint16_t addr_abs_X(Cpu6502 *cpu) {
@@ -1018,18 +1475,11 @@ uint16_t addr_abs_X(Cpu6502 *cpu) {
   cpu->PC++;
   uint16_t addr;
 
-  uint8_t LB = memory[cpu->PC];
+  uint8_t LB = read_instr(cpu, cpu->PC);
   cpu->PC++;
-  uint8_t HB = memory[cpu->PC];
-
-  // addr = (memory[cpu->PC] << 8 | LB) + cpu->X;
-  addr = (HB << 8 | LB) + cpu->X;
-  if ((addr & 0xFF00) != ((addr - cpu->X) & 0xFF00)) {
-    page_crossed = 1;
-  } else {
-    page_crossed = 0;
-  }
+  uint8_t HB = read_instr(cpu, cpu->PC);
 
+  addr = ea_indexed(cpu, HB << 8 | LB, cpu->X);
   return addr;
 }
 
@@ -1038,16 +1488,11 @@ uint16_t addr_abs_Y(Cpu6502 *cpu) {
   // Increment to get the lower byte
   cpu->PC += 1;
   uint16_t addr;
-  LB = memory[cpu->PC];
+  uint8_t LB = read_instr(cpu, cpu->PC);
 
   // Increment to get the upper byte
   cpu->PC += 1;
-  addr = (memory[cpu->PC] << 8 | LB) + cpu->Y;
-  if ((addr & 0xFF00) != ((addr - cpu->Y) & 0xFF00)) {
-    page_crossed = 1;
-  } else {
-    page_crossed = 0;
-  }
+  addr = ea_indexed(cpu, read_instr(cpu, cpu->PC) << 8 | LB, cpu->Y);
 
   return addr;
 }
@@ -1064,11 +1509,11 @@ uint16_t addr_ind(Cpu6502 *cpu) {
 
   cpu->PC++;
   uint16_t addr;
-  uint8_t LB = memory[cpu->PC];
+  uint8_t LB = read_instr(cpu, cpu->PC);
 
   cpu->PC++;
   // Address of the location of new address
-  addr = memory[cpu->PC] << 8 | LB;
+  addr = read_instr(cpu, cpu->PC) << 8 | LB;
 
   // If address crosses boundary, bug occurs
   // For example, address = 0x2ff, this is the lower byte
@@ -1076,51 +1521,32 @@ uint16_t addr_ind(Cpu6502 *cpu) {
   // instead, 6502 wraps the address around to 0x200
 
   if (LB == 0xFF) {
-    return memory[addr & 0xF00] << 8 | memory[addr];
+    return CPU_READ(cpu, addr & 0xF00) << 8 | CPU_READ(cpu, addr);
   } else {
-    return memory[addr + 1] << 8 | memory[addr];
+    return CPU_READ(cpu, addr + 1) << 8 | CPU_READ(cpu, addr);
   }
 }
 
 uint16_t addr_X_ind(Cpu6502 *cpu) {
   // Increment to get the lower byte
   cpu->PC++;
-  uint16_t addr;
-
-  // Ignore carry if it exists
-  uint8_t BB = (memory[cpu->PC] + cpu->X) & 0xFF;
 
-  uint8_t LB = memory[BB];
-  uint8_t HB = memory[page_crossing(BB, 1)];
-
-  addr = HB << 8 | LB;
-  return addr;
+  return ea_X_ind(cpu, read_instr(cpu, cpu->PC));
 }
 
 uint16_t addr_ind_Y(Cpu6502 *cpu) {
 
   // Increment to get the lower byte
   cpu->PC++;
-  uint16_t addr;
-  uint8_t BB = memory[cpu->PC];
-
-  uint8_t LB = memory[BB];
-  uint8_t HB = memory[page_crossing(BB, 1)];
+  uint8_t BB = read_instr(cpu, cpu->PC);
 
-  // addr = page_crossing(HB << 8 | LB, cpu->Y);
-  addr = (HB << 8 | LB) + cpu->Y;
-  if ((addr & 0xFF00) != ((addr - cpu->Y) & 0xFF00)) {
-    page_crossed = 1;
-  } else {
-    page_crossed = 0;
-  }
-  return addr;
+  return ea_ind_Y(cpu, BB);
 }
 
 uint16_t addr_zpg(Cpu6502 *cpu) {
   cpu->PC++;
   uint16_t addr;
-  LB = memory[cpu->PC];
+  uint8_t LB = read_instr(cpu, cpu->PC);
 
   addr = (uint16_t)LB;
   return addr;
@@ -1129,7 +1555,10 @@ uint16_t addr_zpg(Cpu6502 *cpu) {
 uint16_t addr_zpg_X(Cpu6502 *cpu) {
   cpu->PC++;
   uint16_t addr;
-  LB = memory[cpu->PC];
+  uint8_t LB = read_instr(cpu, cpu->PC);
+
+  // Read before X is added
+  CPU_DUMMY_READ(cpu, LB);
 
   // Discard carry, zpg should not exceed 0x00FF
   addr = (uint16_t)((LB + cpu->X) & 0xFF);
@@ -1139,2207 +1568,384 @@ uint16_t addr_zpg_X(Cpu6502 *cpu) {
 uint16_t addr_zpg_Y(Cpu6502 *cpu) {
   cpu->PC++;
   uint16_t addr;
-  LB = memory[cpu->PC];
+  uint8_t LB = read_instr(cpu, cpu->PC);
 
+  CPU_DUMMY_READ(cpu, LB);
   addr = (LB + cpu->Y) & 0xFF;
   return addr;
 }
-Opcode lookup_table[256] =
-    {
-        [0x00] =
-            {
-                .addr_mode = NULL,
-                .instr_none = instr_BRK,
-                .cycles = 7,
-                .page_cycles = 0,
-                .mnemonic = "BRK",
-                INSTR_NONE,
-            },
-        [0x01] =
-            {
-                .addr_mode = addr_X_ind,
-                .instr_val = instr_ORA,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "ORA ind,X",
-                INSTR_VAL,
-            },
-        [0x03] =
-            {
-                .addr_mode = addr_X_ind,
-                .instr_mem = instr_SLO,
-                .cycles = 8,
-                .page_cycles = 0,
-                .mnemonic = "SLO ind,X",
-                INSTR_MEM,
-            },
-        [0x04] =
-            {
-                .addr_mode = addr_zpg,
-                .instr_addr = NULL,
-                .cycles = 3,
-                .page_cycles = 0,
-                .mnemonic = "NOP zpg",
-                INSTR_ADDR,
-            },
-        [0x05] =
-            {
-                .addr_mode = addr_zpg,
-                .instr_val = instr_ORA,
-                .cycles = 3,
-                .page_cycles = 0,
-                .mnemonic = "ORA zpg",
-                INSTR_VAL,
-            },
-        [0x06] =
-            {
-                .addr_mode = addr_zpg,
-                .instr_mem = instr_ASL,
-                .cycles = 5,
-                .page_cycles = 0,
-                .mnemonic = "ASL zpg",
-                INSTR_MEM,
-            },
-        [0x07] =
-            {
-                .addr_mode = addr_zpg,
-                .instr_mem = instr_SLO,
-                .cycles = 5,
-                .page_cycles = 0,
-                .mnemonic = "SLO zpg",
-                INSTR_MEM,
-            },
-        [0x08] =
-            {
-                .addr_mode = NULL,
-                .instr_none = instr_PHP,
-                .cycles = 3,
-                .page_cycles = 0,
-                .mnemonic = "PHP impl",
-                INSTR_NONE,
-            },
-        [0x09] =
-            {
-                .addr_mode = addr_imm,
-                .instr_val = instr_ORA,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "ORA #",
-                INSTR_VAL,
-            },
-        [0x0A] =
-            {
-                .addr_mode = NULL,
-                .instr_mem = instr_ASL,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "ASL A",
-                .instr_type = INSTR_ACC,
-            },
-        [0x0C] =
-            {
-                .addr_mode = addr_abs,
-                .instr_addr = NULL,
-                .cycles = 4,
-                .page_cycles = 0,
-                .mnemonic = "NOP abs",
-                INSTR_ADDR,
-            },
-        [0x0D] =
-            {
-                .addr_mode = addr_abs,
-                .instr_val = instr_ORA,
-                .cycles = 4,
-                .page_cycles = 0,
-                .mnemonic = "ORA abs",
-                INSTR_VAL,
-            },
-        [0x0E] =
-            {
-                .addr_mode = addr_abs,
-                .instr_mem = instr_ASL,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "ASL abs",
-                INSTR_MEM,
-            },
-        [0x0F] =
-            {
-                .addr_mode = addr_abs,
-                .instr_mem = instr_SLO,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "SLO abs",
-                INSTR_MEM,
-            },
-
-        [0x10] =
-            {
-                .addr_mode = NULL,
-                .instr_none = instr_BPL,
-                .cycles = 2,
-                .page_cycles = 1,
-                .mnemonic = "BPL rel",
-                INSTR_NONE,
-            },
-        [0x11] =
-            {
-                .addr_mode = addr_ind_Y,
-                .instr_val = instr_ORA,
-                .cycles = 5,
-                .page_cycles = 1,
-                .mnemonic = "ORA (ind),Y",
-                INSTR_VAL,
-            },
-        [0x13] =
-            {
-                .addr_mode = addr_ind_Y,
-                .instr_mem = instr_SLO,
-                .cycles = 8,
-                .page_cycles = 0,
-                .mnemonic = "SLO (ind),Y",
-                INSTR_MEM,
-            },
-        [0x14] =
-            {
-                .addr_mode = addr_zpg_X,
-                .instr_addr = NULL,
-                .cycles = 4,
-                .page_cycles = 0,
-                .mnemonic = "NOP zpg,X",
-                INSTR_ADDR,
-            },
-        [0x15] =
-            {
-                .addr_mode = addr_zpg_X,
-                .instr_val = instr_ORA,
-                .cycles = 4,
-                .page_cycles = 0,
-                .mnemonic = "ORA zpg,X",
-                INSTR_VAL,
-            },
-        [0x16] =
-            {
-                .addr_mode = addr_zpg_X,
-                .instr_mem = instr_ASL,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "ASL zpg,X",
-                INSTR_MEM,
-            },
-        [0x17] =
-            {
-                .addr_mode = addr_zpg_X,
-                .instr_mem = instr_SLO,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "SLO zpg,X",
-                INSTR_MEM,
-            },
-        [0x18] =
-            {
-                .addr_mode = NULL,
-                .instr_none = instr_CLC,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "CLC",
-                INSTR_NONE,
-            },
-        [0x19] =
-            {
-                .addr_mode = addr_abs_Y,
-                .instr_val = instr_ORA,
-                .cycles = 4,
-                .page_cycles = 1,
-                .mnemonic = "ORA abs,Y",
-                INSTR_VAL,
-            },
-        [0x1A] =
-            {
-                .addr_mode = NULL,
-                .instr_none = instr_NOP,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "NOP",
-                INSTR_NONE,
-            },
-        [0x1B] =
-            {
-                .addr_mode = addr_abs_Y,
-                .instr_mem = instr_SLO,
-                .cycles = 7,
-                .page_cycles = 0,
-                .mnemonic = "SLO abs,Y",
-                INSTR_MEM,
-            },
-        [0x1C] =
-            {
-                .addr_mode = addr_abs_X,
-                .instr_addr = NULL,
-                .cycles = 4,
-                .page_cycles = 1,
-                .mnemonic = "NOP abs,X",
-                INSTR_ADDR,
-            },
-        [0x1D] =
-            {
-                .addr_mode = addr_abs_X,
-                .instr_val = instr_ORA,
-                .cycles = 4,
-                .page_cycles = 1,
-                .mnemonic = "ORA abs,X",
-                INSTR_VAL,
-            },
-        [0x1E] =
-            {
-                .addr_mode = addr_abs_X,
-                .instr_mem = instr_ASL,
-                .cycles = 7,
-                .page_cycles = 0,
-                .mnemonic = "ASL abs,X",
-                INSTR_MEM,
-            },
-        [0x1F] =
-            {
-                .addr_mode = addr_abs_X,
-                .instr_mem = instr_SLO,
-                .cycles = 7,
-                .page_cycles = 0,
-                .mnemonic = "SLO abs,X",
-                INSTR_MEM,
-            },
-        [0x20] =
-            {
-                .addr_mode = addr_abs,
-                .instr_addr = instr_JSR,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "JSR",
-                INSTR_ADDR,
-            },
-        [0x21] =
-            {
-                .addr_mode = addr_X_ind,
-                .instr_val = instr_AND,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "AND",
-                INSTR_VAL,
-            },
-        [0x23] =
-            {
-                .addr_mode = addr_X_ind,
-                .instr_mem = instr_RLA,
-                .cycles = 8,
-                .page_cycles = 0,
-                .mnemonic = "RLA",
-                INSTR_MEM,
-            },
-        [0x24] =
-            {
-                .addr_mode = addr_zpg,
-                .instr_val = instr_BIT,
-                .cycles = 3,
-                .page_cycles = 0,
-                .mnemonic = "BIT",
-                INSTR_VAL,
-            },
-        [0x25] =
-            {
-                .addr_mode = addr_zpg,
-                .instr_val = instr_AND,
-                .cycles = 3,
-                .page_cycles = 0,
-                .mnemonic = "AND",
-                INSTR_VAL,
-            },
-        [0x26] =
-            {
-                .addr_mode = addr_zpg,
-                .instr_mem = instr_ROL,
-                .cycles = 5,
-                .page_cycles = 0,
-                .mnemonic = "ROL",
-                INSTR_MEM,
-            },
-        [0x27] =
-            {
-                .addr_mode = addr_zpg,
-                .instr_mem = instr_RLA,
-                .cycles = 5,
-                .page_cycles = 0,
-                .mnemonic = "RLA",
-                INSTR_MEM,
-            },
-        [0x28] =
-            {
-                .addr_mode = NULL,
-                .instr_none = instr_PLP,
-                .cycles = 4,
-                .page_cycles = 0,
-                .mnemonic = "PLP",
-                INSTR_NONE,
-            },
-        [0x29] =
-            {
-                .addr_mode = addr_imm,
-                .instr_val = instr_AND,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "AND",
-                INSTR_VAL,
-            },
-        [0x2A] =
-            {
-                .addr_mode = NULL,
-                .instr_mem = instr_ROL,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "ROL A",
-                INSTR_ACC,
-            },
-        [0x2C] =
-            {
-                .addr_mode = addr_abs,
-                .instr_val = instr_BIT,
-                .cycles = 4,
-                .page_cycles = 0,
-                .mnemonic = "BIT",
-                INSTR_VAL,
-            },
-        [0x2D] =
-            {
-                .addr_mode = addr_abs,
-                .instr_val = instr_AND,
-                .cycles = 4,
-                .page_cycles = 0,
-                .mnemonic = "AND",
-                INSTR_VAL,
-            },
-        [0x2E] =
-            {
-                .addr_mode = addr_abs,
-                .instr_mem = instr_ROL,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "ROL",
-                INSTR_MEM,
-            },
-        [0x2F] =
-            {
-                .addr_mode = addr_abs,
-                .instr_mem = instr_RLA,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "RLA",
-                INSTR_MEM,
-            },
-
-        [0x30] =
-            {
-                .addr_mode = NULL,
-                .instr_none = instr_BMI,
-                .cycles = 2,
-                .page_cycles = 1,
-                .mnemonic = "BMI rel",
-                INSTR_NONE,
-            },
-        [0x31] =
-            {
-                .addr_mode = addr_ind_Y,
-                .instr_val = instr_AND,
-                .cycles = 5,
-                .page_cycles = 1,
-                .mnemonic = "AND (ind),Y",
-                INSTR_VAL,
-            },
-        [0x33] =
-            {
-                .addr_mode = addr_ind_Y,
-                .instr_mem = instr_RLA,
-                .cycles = 8,
-                .page_cycles = 0,
-                .mnemonic = "RLA (ind),Y",
-                INSTR_MEM,
-            },
-        [0x34] =
-            {
-                .addr_mode = addr_zpg_X,
-                .instr_addr = NULL,
-                .cycles = 4,
-                .page_cycles = 0,
-                .mnemonic = "NOP zpg,X",
-                INSTR_ADDR,
-            },
-        [0x35] =
-            {
-                .addr_mode = addr_zpg_X,
-                .instr_val = instr_AND,
-                .cycles = 4,
-                .page_cycles = 0,
-                .mnemonic = "AND zpg,X",
-                INSTR_VAL,
-            },
-        [0x36] =
-            {
-                .addr_mode = addr_zpg_X,
-                .instr_mem = instr_ROL,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "ROL zpg,X",
-                INSTR_MEM,
-            },
-        [0x37] =
-            {
-                .addr_mode = addr_zpg_X,
-                .instr_mem = instr_RLA,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "RLA zpg",
-                INSTR_MEM,
-            },
-        [0x38] =
-            {
-                .addr_mode = NULL,
-                .instr_none = instr_SEC,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "SEC",
-                INSTR_NONE,
-            },
-        [0x39] =
-            {
-                .addr_mode = addr_abs_Y,
-                .instr_val = instr_AND,
-                .cycles = 4,
-                .page_cycles = 1,
-                .mnemonic = "AND abs,Y",
-                INSTR_VAL,
-            },
-        [0x3A] =
-            {
-                .addr_mode = NULL,
-                .instr_none = instr_NOP,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "NOP",
-                INSTR_NONE,
-            },
-        [0x3B] =
-            {
-                .addr_mode = addr_abs_Y,
-                .instr_mem = instr_RLA,
-                .cycles = 7,
-                .page_cycles = 0,
-                .mnemonic = "RLA abs,Y",
-                INSTR_MEM,
-            },
-        [0x3C] =
-            {
-                .addr_mode = addr_abs_X,
-                .instr_addr = NULL,
-                .cycles = 4,
-                .page_cycles = 1,
-                .mnemonic = "NOP abs,X",
-                INSTR_ADDR,
-            },
-        [0x3D] =
-            {
-                .addr_mode = addr_abs_X,
-                .instr_val = instr_AND,
-                .cycles = 4,
-                .page_cycles = 1,
-                .mnemonic = "AND abs,X",
-                INSTR_VAL,
-            },
-        [0x3E] =
-            {
-                .addr_mode = addr_abs_X,
-                .instr_mem = instr_ROL,
-                .cycles = 7,
-                .page_cycles = 0,
-                .mnemonic = "ROL abs,X",
-                INSTR_MEM,
-            },
-        [0x3F] =
-            {
-                .addr_mode = addr_abs_X,
-                .instr_mem = instr_RLA,
-                .cycles = 7,
-                .page_cycles = 0,
-                .mnemonic = "RLA abs,X",
-                INSTR_MEM,
-            },
-
-        [0x40] =
-            {
-                .addr_mode = NULL,
-                .instr_none = instr_RTI,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "RTI",
-                INSTR_NONE,
-            },
-        [0x41] =
-            {
-                .addr_mode = addr_X_ind,
-                .instr_val = instr_EOR,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "EOR",
-                INSTR_VAL,
-            },
-        [0x43] =
-            {
-                .addr_mode = addr_X_ind,
-                .instr_mem = instr_SRE,
-                .cycles = 8,
-                .page_cycles = 0,
-                .mnemonic = "SRE",
-                INSTR_MEM,
-            },
-        [0x44] =
-            {
-                .addr_mode = addr_zpg,
-                .instr_addr = NULL,
-                .cycles = 3,
-                .page_cycles = 0,
-                .mnemonic = "NOP",
-                INSTR_ADDR,
-            },
-        [0x45] =
-            {
-                .addr_mode = addr_zpg,
-                .instr_val = instr_EOR,
-                .cycles = 3,
-                .page_cycles = 0,
-                .mnemonic = "EOR",
-                INSTR_VAL,
-            },
-        [0x46] =
-            {
-                .addr_mode = addr_zpg,
-                .instr_mem = instr_LSR,
-                .cycles = 5,
-                .page_cycles = 0,
-                .mnemonic = "LSR",
-                INSTR_MEM,
-            },
-        [0x47] =
-            {
-                .addr_mode = addr_zpg,
-                .instr_mem = instr_SRE,
-                .cycles = 5,
-                .page_cycles = 0,
-                .mnemonic = "SRE",
-                INSTR_MEM,
-            },
-        [0x48] =
-            {
-                .addr_mode = NULL,
-                .instr_none = instr_PHA,
-                .cycles = 3,
-                .page_cycles = 0,
-                .mnemonic = "PHA",
-                INSTR_NONE,
-            },
-        [0x49] =
-            {
-                .addr_mode = addr_imm,
-                .instr_val = instr_EOR,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "EOR",
-                INSTR_VAL,
-            },
-        [0x4A] =
-            {
-                .addr_mode = NULL,
-                .instr_mem = instr_LSR,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "LSR A",
-                .instr_type = INSTR_ACC, // Pass accumulator to *M
-            },
-        [0x4B] =
-            {
-                .addr_mode = addr_abs_Y,
-                .instr_mem = instr_SRE,
-                .cycles = 7,
-                .page_cycles = 0,
-                .mnemonic = "SRE",
-                INSTR_MEM,
-            },
-        [0x4C] =
-            {
-                .addr_mode = addr_abs,
-                .instr_addr = instr_JMP,
-                .cycles = 3,
-                .page_cycles = 0,
-                .mnemonic = "JMP",
-                INSTR_ADDR,
-            },
-        [0x4D] =
-            {
-                .addr_mode = addr_abs,
-                .instr_val = instr_EOR,
-                .cycles = 4,
-                .page_cycles = 0,
-                .mnemonic = "EOR",
-                INSTR_VAL,
-            },
-        [0x4E] =
-            {
-                .addr_mode = addr_abs,
-                .instr_mem = instr_LSR,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "LSR",
-                INSTR_MEM,
-            },
-        [0x4F] =
-            {
-                .addr_mode = addr_abs,
-                .instr_mem = instr_SRE,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "SRE",
-                INSTR_MEM,
-            },
-
-        [0x50] =
-            {
-                .addr_mode = NULL,
-                .instr_none = instr_BVC,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "BVC",
-                INSTR_NONE,
-            },
-        [0x51] =
-            {
-                .addr_mode = addr_ind_Y,
-                .instr_val = instr_EOR,
-                .cycles = 5,
-                .page_cycles = 1,
-                .mnemonic = "EOR",
-                INSTR_VAL,
-            },
-        [0x53] =
-            {
-                .addr_mode = addr_ind_Y,
-                .instr_mem = instr_SRE,
-                .cycles = 8,
-                .page_cycles = 0,
-                .mnemonic = "SRE",
-                INSTR_MEM,
-            },
-        [0x54] =
-            {
-                .addr_mode = addr_zpg_X,
-                .instr_addr = NULL,
-                .cycles = 4,
-                .page_cycles = 0,
-                .mnemonic = "NOP zpg,X",
-                INSTR_ADDR,
-            },
-        [0x55] =
-            {
-                .addr_mode = addr_zpg_X,
-                .instr_val = instr_EOR,
-                .cycles = 4,
-                .page_cycles = 0,
-                .mnemonic = "EOR",
-                INSTR_VAL,
-            },
-        [0x56] =
-            {
-                .addr_mode = addr_zpg_X,
-                .instr_mem = instr_LSR,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "LSR",
-                INSTR_MEM,
-            },
-        [0x57] =
-            {
-                .addr_mode = addr_zpg_X,
-                .instr_mem = instr_SRE,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "SRE",
-                INSTR_MEM,
-            },
-        [0x58] =
-            {
-                .addr_mode = NULL,
-                .instr_none = instr_CLI,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "CLI",
-                INSTR_NONE,
-            },
-        [0x59] =
-            {
-                .addr_mode = addr_abs_Y,
-                .instr_val = instr_EOR,
-                .cycles = 4,
-                .page_cycles = 1,
-                .mnemonic = "EOR",
-                INSTR_VAL,
-            },
-        [0x5A] =
-            {
-                .addr_mode = NULL,
-                .instr_none = instr_NOP,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "NOP",
-                INSTR_NONE,
-            }, // NOP implied, PC increment externally
-        [0x5B] =
-            {
-                .addr_mode = addr_abs_Y,
-                .instr_mem = instr_SRE,
-                .cycles = 7,
-                .page_cycles = 0,
-                .mnemonic = "SRE",
-                INSTR_MEM,
-            },
-        [0x5C] =
-            {
-                .addr_mode = addr_abs_X,
-                .instr_addr = NULL,
-                .cycles = 4,
-                .page_cycles = 1,
-                .mnemonic = "NOP abs,X",
-                INSTR_ADDR,
-            },
-        [0x5D] =
-            {
-                .addr_mode = addr_abs_X,
-                .instr_val = instr_EOR,
-                .cycles = 4,
-                .page_cycles = 1,
-                .mnemonic = "EOR",
-                INSTR_VAL,
-            },
-        [0x5E] =
-            {
-                .addr_mode = addr_abs_X,
-                .instr_mem = instr_LSR,
-                .cycles = 7,
-                .page_cycles = 0,
-                .mnemonic = "LSR",
-                INSTR_MEM,
-            },
-        [0x5F] =
-            {
-                .addr_mode = addr_abs_X,
-                .instr_mem = instr_SRE,
-                .cycles = 7,
-                .page_cycles = 0,
-                .mnemonic = "SRE",
-                INSTR_MEM,
-            },
-
-        [0x60] =
-            {
-                .addr_mode = NULL,
-                .instr_none = instr_RTS,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "RTS",
-                INSTR_NONE,
-            },
-        [0x61] =
-            {
-                .addr_mode = addr_X_ind,
-                .instr_val = instr_ADC,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "ADC",
-                INSTR_VAL,
-            },
-        [0x63] =
-            {
-                .addr_mode = addr_X_ind,
-                .instr_mem = instr_RRA,
-                .cycles = 8,
-                .page_cycles = 0,
-                .mnemonic = "RRA",
-                INSTR_MEM,
-            },
-        [0x64] =
-            {
-                .addr_mode = addr_zpg,
-                .instr_addr = NULL,
-                .cycles = 3,
-                .page_cycles = 0,
-                .mnemonic = "NOP",
-                INSTR_ADDR,
-            }, // NOP zpg, PC increment handled externally
-        [0x65] =
-            {
-                .addr_mode = addr_zpg,
-                .instr_val = instr_ADC,
-                .cycles = 3,
-                .page_cycles = 0,
-                .mnemonic = "ADC",
-                INSTR_VAL,
-            },
-        [0x66] =
-            {
-                .addr_mode = addr_zpg,
-                .instr_mem = instr_ROR,
-                .cycles = 5,
-                .page_cycles = 0,
-                .mnemonic = "ROR",
-                INSTR_MEM,
-            },
-        [0x67] =
-            {
-                .addr_mode = addr_zpg,
-                .instr_mem = instr_RRA,
-                .cycles = 5,
-                .page_cycles = 0,
-                .mnemonic = "RRA",
-                INSTR_MEM,
-            },
-        [0x68] =
-            {
-                .addr_mode = NULL,
-                .instr_none = instr_PLA,
-                .cycles = 4,
-                .page_cycles = 0,
-                .mnemonic = "PLA",
-                INSTR_NONE,
-            },
-        [0x69] =
-            {
-                .addr_mode = addr_imm,
-                .instr_val = instr_ADC,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "ADC",
-                INSTR_VAL,
-            },
-        [0x6A] =
-            {
-                .addr_mode = NULL,
-                .instr_mem = instr_ROR,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "ROR",
-                INSTR_ACC,
-            },
-        [0x6C] =
-            {
-                .addr_mode = addr_ind_jmp,
-                .instr_addr = instr_JMP,
-                .cycles = 5,
-                .page_cycles = 0,
-                .mnemonic = "JMP",
-                INSTR_ADDR,
-            }, // JMP indirect, PC handled in switch
-        [0x6D] =
-            {
-                .addr_mode = addr_abs,
-                .instr_val = instr_ADC,
-                .cycles = 4,
-                .page_cycles = 0,
-                .mnemonic = "ADC",
-                INSTR_VAL,
-            },
-        [0x6E] =
-            {
-                .addr_mode = addr_abs,
-                .instr_mem = instr_ROR,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "ROR",
-                INSTR_MEM,
-            },
-        [0x6F] =
-            {
-                .addr_mode = addr_abs,
-                .instr_mem = instr_RRA,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "RRA",
-                INSTR_MEM,
-            },
-
-        [0x70] =
-            {
-                .addr_mode = NULL,
-                .instr_none = instr_BVS,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "BVS",
-                INSTR_NONE,
-            },
-        [0x71] =
-            {
-                .addr_mode = addr_ind_Y,
-                .instr_val = instr_ADC,
-                .cycles = 5,
-                .page_cycles = 1,
-                .mnemonic = "ADC",
-                INSTR_VAL,
-            },
-        [0x73] =
-            {
-                .addr_mode = addr_ind_Y,
-                .instr_mem = instr_RRA,
-                .cycles = 8,
-                .page_cycles = 0,
-                .mnemonic = "RRA",
-                INSTR_MEM,
-            },
-        [0x74] =
-            {
-                .addr_mode = addr_zpg_X,
-                .instr_addr = NULL,
-                .cycles = 4,
-                .page_cycles = 0,
-                .mnemonic = "NOP",
-                INSTR_ADDR,
-            }, // NOP zpg,X, PC increment done in switch
-        [0x75] =
-            {
-                .addr_mode = addr_zpg_X,
-                .instr_val = instr_ADC,
-                .cycles = 4,
-                .page_cycles = 0,
-                .mnemonic = "ADC",
-                INSTR_VAL,
-            },
-        [0x76] =
-            {
-                .addr_mode = addr_zpg_X,
-                .instr_mem = instr_ROR,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "ROR",
-                INSTR_MEM,
-            },
-        [0x77] =
-            {
-                .addr_mode = addr_zpg_X,
-                .instr_mem = instr_RRA,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "RRA",
-                INSTR_MEM,
-            },
-        [0x78] =
-            {
-                .addr_mode = NULL,
-                .instr_none = instr_SEI,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "SEI",
-                INSTR_NONE,
-            },
-        [0x79] =
-            {
-                .addr_mode = addr_abs_Y,
-                .instr_val = instr_ADC,
-                .cycles = 4,
-                .page_cycles = 1,
-                .mnemonic = "ADC",
-                INSTR_VAL,
-            },
-        [0x7A] =
-            {
-                .addr_mode = NULL,
-                .instr_none = instr_NOP,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "NOP",
-                INSTR_NONE,
-            }, // NOP implied, PC increment handled externally
-        [0x7B] =
-            {
-                .addr_mode = addr_abs_X,
-                .instr_mem = instr_RRA,
-                .cycles = 7,
-                .page_cycles = 0,
-                .mnemonic = "RRA",
-                INSTR_MEM,
-            },
-        [0x7C] =
-            {
-                .addr_mode = addr_abs_X,
-                .instr_addr = NULL,
-                .cycles = 4,
-                .page_cycles = 1,
-                .mnemonic = "NOP",
-                INSTR_ADDR,
-            }, // Unofficial NOP or placeholder
-        [0x7D] =
-            {
-                .addr_mode = addr_abs_X,
-                .instr_val = instr_ADC,
-                .cycles = 4,
-                .page_cycles = 1,
-                .mnemonic = "ADC",
-                INSTR_VAL,
-            },
-        [0x7E] =
-            {
-                .addr_mode = addr_abs_X,
-                .instr_mem = instr_ROR,
-                .cycles = 7,
-                .page_cycles = 0,
-                .mnemonic = "ROR",
-                INSTR_MEM,
-            },
-        [0x7F] =
-            {
-                .addr_mode = addr_abs_X,
-                .instr_mem = instr_RRA,
-                .cycles = 7,
-                .page_cycles = 0,
-                .mnemonic = "RRA",
-                INSTR_MEM,
-            },
-
-        [0x80] =
-            {
-                .addr_mode = addr_imm,
-                .instr_addr = NULL,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "NOP",
-                INSTR_ADDR,
-            },
-        [0x81] =
-            {
-                .addr_mode = addr_X_ind,
-                .instr_addr = instr_STA,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "STA",
-                .instr_type = INSTR_ADDR,
-            },
-        [0x82] =
-            {
-                .addr_mode = addr_imm,
-                .instr_none = NULL,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "NOP",
-                INSTR_NONE,
-            },
-        [0x83] =
-            {
-                .addr_mode = addr_X_ind,
-                .instr_addr = instr_SAX,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "SAX",
-                INSTR_ADDR,
-            },
-        [0x84] =
-            {
-                .addr_mode = addr_zpg,
-                .instr_addr = instr_STY,
-                .cycles = 3,
-                .page_cycles = 0,
-                .mnemonic = "STY",
-                .instr_type = INSTR_ADDR,
-            },
-        [0x85] =
-            {
-                .addr_mode = addr_zpg,
-                .instr_addr = instr_STA,
-                .cycles = 3,
-                .page_cycles = 0,
-                .mnemonic = "STA",
-                INSTR_ADDR,
-            },
-        [0x86] =
-            {
-                .addr_mode = addr_zpg,
-                .instr_addr = instr_STX,
-                .cycles = 3,
-                .page_cycles = 0,
-                .mnemonic = "STX",
-                INSTR_ADDR,
-            },
-        [0x87] =
-            {
-                .addr_mode = addr_zpg,
-                .instr_addr = instr_SAX,
-                .cycles = 3,
-                .page_cycles = 0,
-                .mnemonic = "SAX",
-                INSTR_ADDR,
-            },
-        [0x88] =
-            {
-                .addr_mode = NULL,
-                .instr_none = instr_DEY,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "DEY",
-                INSTR_NONE,
-            },
-        [0x89] =
-            {
-                .addr_mode = addr_imm,
-                .instr_none = NULL,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "NOP #",
-                INSTR_NONE,
-            },
-        [0x8A] =
-            {
-                .addr_mode = NULL,
-                .instr_none = instr_TXA,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "TXA",
-                INSTR_NONE,
-            },
-        [0x8C] =
-            {
-                .addr_mode = addr_abs,
-                .instr_addr = instr_STY,
-                .cycles = 4,
-                .page_cycles = 0,
-                .mnemonic = "STY abs",
-                INSTR_ADDR,
-            },
-        [0x8D] =
-            {
-                .addr_mode = addr_abs,
-                .instr_addr = instr_STA,
-                .cycles = 4,
-                .page_cycles = 0,
-                .mnemonic = "STA abs",
-                INSTR_ADDR,
-            },
-        [0x8E] =
-            {
-                .addr_mode = addr_abs,
-                .instr_addr = instr_STX,
-                .cycles = 4,
-                .page_cycles = 0,
-                .mnemonic = "STX abs",
-                INSTR_ADDR,
-            },
-        [0x8F] =
-            {
-                .addr_mode = addr_abs,
-                .instr_addr = instr_SAX,
-                .cycles = 4,
-                .page_cycles = 0,
-                .mnemonic = "SAX abs",
-                INSTR_ADDR,
-            },
-
-        [0x90] =
-            {
-                .addr_mode = NULL,
-                .instr_none = instr_BCC,
-                .cycles = 2,
-                .page_cycles = 1,
-                .mnemonic = "BCC rel",
-                INSTR_NONE,
-            },
-        [0x91] =
-            {
-                .addr_mode = addr_ind_Y,
-                .instr_addr = instr_STA,
-                .cycles = 6,
-                .page_cycles = 0,
-                .mnemonic = "STA ind,Y",
-                INSTR_ADDR,
-            },
-        [0x94] =
-            {
-                .addr_mode = addr_zpg_X,
-                .instr_addr = instr_STY,
-                .cycles = 4,
-                .page_cycles = 0,
-                .mnemonic = "STY zpg,X",
-                INSTR_ADDR,
-            },
-        [0x95] =
-            {
-                .addr_mode = addr_zpg_X,
-                .instr_addr = instr_STA,
-                .cycles = 4,
-                .page_cycles = 0,
-                .mnemonic = "STA zpg,X",
-                INSTR_ADDR,
-            },
-        [0x96] =
-            {
-                .addr_mode = addr_zpg_Y,
-                .instr_addr = instr_STX,
-                .cycles = 4,
-                .page_cycles = 0,
-                .mnemonic = "STX zpg,Y",
-                INSTR_ADDR,
-            },
-        [0x97] =
-            {
-                .addr_mode = addr_zpg_Y,
-                .instr_addr = instr_SAX,
-                .cycles = 4,
-                .page_cycles = 0,
-                .mnemonic = "SAX zpg,Y",
-                INSTR_ADDR,
-            },
-        [0x98] =
-            {
-                .addr_mode = NULL,
-                .instr_none = instr_TYA,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "TYA",
-                INSTR_NONE,
-            },
-        [0x99] =
-            {
-                .addr_mode = addr_abs_Y,
-                .instr_addr = instr_STA,
-                .cycles = 5,
-                .page_cycles = 0,
-                .mnemonic = "STA abs,Y",
-                INSTR_ADDR,
-            },
-        [0x9A] =
-            {
-                .addr_mode = NULL,
-                .instr_none = instr_TXS,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "TXS",
-                INSTR_NONE,
-            },
-        [0x9D] =
-            {
-                .addr_mode = addr_abs_X,
-                .instr_addr = instr_STA,
-                .cycles = 5,
-                .page_cycles = 0,
-                .mnemonic = "STA abs,X",
-                INSTR_ADDR,
-            },
-        [0xA0] =
-            {
-                addr_imm,
-                .instr_addr = instr_LDY,
-                2,
-                0,
-                "LDY #",
-                INSTR_ADDR,
-            },
-        [0xA1] =
-            {
-                addr_X_ind,
-                .instr_addr = instr_LDA,
-                6,
-                0,
-                "LDA ind,X",
-                INSTR_ADDR,
-            },
-        [0xA2] =
-            {
-                addr_imm,
-                .instr_addr = instr_LDX,
-                2,
-                0,
-                "LDX #",
-                INSTR_ADDR,
-            },
-        [0xA3] =
-            {
-                addr_X_ind,
-                .instr_val = instr_LAX,
-                6,
-                0,
-                "LAX ind,X",
-                INSTR_VAL,
-            },
-        [0xA4] =
-            {
-                addr_zpg,
-                .instr_addr = instr_LDY,
-                3,
-                0,
-                "LDY zpg",
-                INSTR_ADDR,
-            },
-        [0xA5] =
-            {
-                addr_zpg,
-                .instr_addr = instr_LDA,
-                3,
-                0,
-                "LDA zpg",
-                INSTR_ADDR,
-            },
-        [0xA6] =
-            {
-                addr_zpg,
-                .instr_addr = instr_LDX,
-                3,
-                0,
-                "LDX zpg",
-                INSTR_ADDR,
-            },
-        [0xA7] =
-            {
-                addr_zpg,
-                .instr_val = instr_LAX,
-                3,
-                0,
-                "LAX zpg",
-                INSTR_VAL,
-            },
-        [0xA8] =
-            {
-                NULL,
-                .instr_none = instr_TAY,
-                2,
-                0,
-                "TAY impl",
-                INSTR_NONE,
-            },
-        [0xA9] =
-            {
-                addr_imm,
-                .instr_addr = instr_LDA,
-                2,
-                0,
-                "LDA #",
-                INSTR_ADDR,
-            },
-        [0xAA] =
-            {
-                NULL,
-                .instr_none = instr_TAX,
-                2,
-                0,
-                "TAX impl",
-                INSTR_NONE,
-            },
-        [0xAC] =
-            {
-                addr_abs,
-                .instr_addr = instr_LDY,
-                4,
-                1,
-                "LDY abs",
-                INSTR_ADDR,
-            },
-        [0xAD] =
-            {
-                addr_abs,
-                .instr_addr = instr_LDA,
-                4,
-                1,
-                "LDA abs",
-                INSTR_ADDR,
-            },
-        [0xAE] =
-            {
-                addr_abs,
-                .instr_addr = instr_LDX,
-                4,
-                1,
-                "LDX abs",
-                INSTR_ADDR,
-            },
-        [0xAF] =
-            {
-                addr_abs,
-                .instr_val = instr_LAX,
-                4,
-                1,
-                "LAX abs",
-                INSTR_VAL,
-            },
-        [0xB0] =
-            {
-                NULL,
-                .instr_none = instr_BCS,
-                2,
-                0,
-                "BCS",
-                INSTR_NONE,
-            },
-        [0xB1] =
-            {
-                addr_ind_Y,
-                .instr_addr = instr_LDA,
-                5,
-                1,
-                "LDA (ind),Y",
-                INSTR_ADDR,
-            },
-        [0xB3] =
-            {
-                addr_ind_Y,
-                .instr_val = instr_LAX,
-                5,
-                1,
-                "LAX (ind),Y",
-                INSTR_VAL,
-            },
-        [0xB4] =
-            {
-                addr_zpg_X,
-                .instr_addr = instr_LDY,
-                4,
-                0,
-                "LDY zpg,X",
-                INSTR_ADDR,
-            },
-        [0xB5] =
-            {
-                addr_zpg_X,
-                .instr_addr = instr_LDA,
-                4,
-                0,
-                "LDA zpg,X",
-                INSTR_ADDR,
-            },
-        [0xB6] =
-            {
-                addr_zpg_Y,
-                .instr_addr = instr_LDX,
-                4,
-                0,
-                "LDX zpg,Y",
-                INSTR_ADDR,
-            },
-        [0xB7] =
-            {
-                addr_zpg_Y,
-                .instr_val = instr_LAX,
-                4,
-                0,
-                "LAX zpg,Y",
-                INSTR_VAL,
-            },
-        [0xB8] =
-            {
-                NULL,
-                .instr_none = instr_CLV,
-                2,
-                0,
-                "CLV",
-                INSTR_NONE,
-            },
-        [0xB9] =
-            {
-                addr_abs_Y,
-                .instr_addr = instr_LDA,
-                4,
-                1,
-                "LDA abs,Y",
-                INSTR_ADDR,
-            },
-        [0xBA] =
-            {
-                NULL,
-                .instr_none = instr_TSX,
-                2,
-                0,
-                "TSX",
-                INSTR_NONE,
-            },
-        [0xBC] =
-            {
-                addr_abs_X,
-                .instr_addr = instr_LDY,
-                4,
-                1,
-                "LDY abs,X",
-                INSTR_ADDR,
-            },
-        [0xBD] =
-            {
-                addr_abs_X,
-                .instr_addr = instr_LDA,
-                4,
-                1,
-                "LDA abs,X",
-                INSTR_ADDR,
-            },
-        [0xBE] =
-            {
-                addr_abs_Y,
-                .instr_addr = instr_LDX,
-                4,
-                1,
-                "LDX abs,Y",
-                INSTR_ADDR,
-            },
-        [0xBF] =
-            {
-                addr_abs_Y,
-                .instr_val = instr_LAX,
-                4,
-                1,
-                "LAX abs,Y",
-                INSTR_VAL,
-            },
-        [0xC0] =
-            {
-                addr_imm,
-                .instr_val = instr_CPY,
-                2,
-                0,
-                "CPY #",
-                INSTR_VAL,
-            },
-        [0xC1] =
-            {
-                addr_X_ind,
-                .instr_val = instr_CMP,
-                6,
-                0,
-                "CMP X,ind",
-                INSTR_VAL,
-            },
-        [0xC2] =
-            {
-                addr_imm,
-                .instr_none = instr_NOP,
-                2,
-                0,
-                "NOP #",
-                INSTR_NONE,
-            },
-        [0xC3] =
-            {
-                addr_X_ind,
-                .instr_mem = instr_DCP,
-                8,
-                0,
-                "DCP X,ind",
-                INSTR_MEM,
-            },
-        [0xC4] =
-            {
-                addr_zpg,
-                .instr_val = instr_CPY,
-                3,
-                0,
-                "CPY zpg",
-                INSTR_VAL,
-            },
-        [0xC5] =
-            {
-                addr_zpg,
-                .instr_val = instr_CMP,
-                3,
-                0,
-                "CMP zpg",
-                INSTR_VAL,
-            },
-        [0xC6] =
-            {
-                addr_zpg,
-                .instr_mem = instr_DEC,
-                5,
-                0,
-                "DEC zpg",
-                INSTR_MEM,
-            },
-        [0xC7] =
-            {
-                addr_zpg,
-                .instr_mem = instr_DCP,
-                5,
-                0,
-                "DCP zpg",
-                INSTR_MEM,
-            },
-        [0xC8] =
-            {
-                NULL,
-                .instr_none = instr_INY,
-                2,
-                0,
-                "INY",
-                INSTR_NONE,
-            },
-        [0xC9] =
-            {
-                addr_imm,
-                .instr_val = instr_CMP,
-                2,
-                0,
-                "CMP #",
-                INSTR_VAL,
-            },
-        [0xCA] =
-            {
-                NULL,
-                .instr_none = instr_DEX,
-                2,
-                0,
-                "DEX",
-                INSTR_NONE,
-            },
-        [0xCC] =
-            {
-                addr_abs,
-                .instr_val = instr_CPY,
-                4,
-                0,
-                "CPY abs",
-                INSTR_VAL,
-            },
-        [0xCD] =
-            {
-                addr_abs,
-                .instr_val = instr_CMP,
-                4,
-                0,
-                "CMP abs",
-                INSTR_VAL,
-            },
-        [0xCE] =
-            {
-                addr_abs,
-                .instr_mem = instr_DEC,
-                6,
-                0,
-                "DEC abs",
-                INSTR_MEM,
-            },
-        [0xCF] =
-            {
-                addr_abs,
-                .instr_mem = instr_DCP,
-                6,
-                0,
-                "DCP abs",
-                INSTR_MEM,
-            },
-
-        [0xD0] =
-            {
-                NULL,
-                .instr_none = instr_BNE,
-                2,
-                0,
-                "BNE rel",
-                INSTR_NONE,
-            },
-        [0xD1] =
-            {
-                addr_ind_Y,
-                .instr_val = instr_CMP,
-                5,
-                1,
-                "CMP ind,Y",
-                INSTR_VAL,
-            },
-        [0xD3] =
-            {
-                addr_ind_Y,
-                .instr_mem = instr_DCP,
-                8,
-                0,
-                "DCP ind,Y",
-                INSTR_MEM,
-            },
-        [0xD4] =
-            {
-                .addr_mode = addr_zpg_X,
-                .instr_addr = NULL,
-                .cycles = 4,
-                .page_cycles = 0,
-                .mnemonic = "NOP",
-                INSTR_ADDR,
-            }, // NOP zpg,X, PC increment done in switch
-        [0xD5] =
-            {
-                addr_zpg_X,
-                .instr_val = instr_CMP,
-                4,
-                0,
-                "CMP zpg,X",
-                INSTR_VAL,
-            },
-        [0xD6] =
-            {
-                addr_zpg_X,
-                .instr_mem = instr_DEC,
-                6,
-                0,
-                "DEC zpg,X",
-                INSTR_MEM,
-            },
-        [0xD7] =
-            {
-                addr_zpg_X,
-                .instr_mem = instr_DCP,
-                6,
-                0,
-                "DCP zpg,X",
-                INSTR_MEM,
-            },
-        [0xD8] =
-            {
-                NULL,
-                .instr_none = instr_CLD,
-                2,
-                0,
-                "CLD",
-                INSTR_NONE,
-            },
-        [0xD9] =
-            {
-                addr_abs_Y,
-                .instr_val = instr_CMP,
-                4,
-                1,
-                "CMP abs,Y",
-                INSTR_VAL,
-            },
-        [0xDA] =
-            {
-                .addr_mode = NULL,
-                .instr_none = instr_NOP,
-                .cycles = 2,
-                .page_cycles = 0,
-                .mnemonic = "NOP",
-                INSTR_NONE,
-            }, // NOP implied, PC increment handled externally
-        [0xDB] =
-            {
-                addr_abs_Y,
-                .instr_mem = instr_DCP,
-                7,
-                0,
-                "DCP abs,Y",
-                INSTR_MEM,
-            },
-        [0xDC] =
-            {
-                addr_abs_X,
-                .instr_addr = NULL,
-                4,
-                1,
-                "NOP abs,X",
-                INSTR_ADDR,
-            }, // This one exists in your code: cpu->PC++;
-               // emulate_6502_cycle(cyc);
-        [0xDD] =
-            {
-                addr_abs_X,
-                .instr_val = instr_CMP,
-                4,
-                1,
-                "CMP abs,X",
-                INSTR_VAL,
-            },
-        [0xDE] =
-            {
-                addr_abs_X,
-                .instr_mem = instr_DEC,
-                7,
-                0,
-                "DEC abs,X",
-                INSTR_MEM,
-            },
-        [0xDF] =
-            {
-                addr_abs_X,
-                .instr_mem = instr_DCP,
-                7,
-                0,
-                "DCP abs,X",
-                INSTR_MEM,
-            },
-
-        [0xE0] =
-            {
-                addr_imm,
-                .instr_val = instr_CPX,
-                2,
-                0,
-                "CPX #",
-                INSTR_VAL,
-            },
-        [0xE1] =
-            {
-                addr_X_ind,
-                .instr_val = instr_SBC,
-                6,
-                0,
-                "SBC X,ind",
-                INSTR_VAL,
-            },
-        [0xE2] =
-            {
-                NULL,
-                .instr_none = NULL,
-                2,
-                0,
-                "NOP imm",
-                INSTR_NONE,
-            },
-        [0xE3] =
-            {
-                addr_X_ind,
-                .instr_mem = instr_ISC,
-                8,
-                0,
-                "ISC X,ind",
-                INSTR_MEM,
-            },
-        [0xE4] =
-            {
-                addr_zpg,
-                .instr_val = instr_CPX,
-                3,
-                0,
-                "CPX zpg",
-                INSTR_VAL,
-            },
-        [0xE5] =
-            {
-                addr_zpg,
-                .instr_val = instr_SBC,
-                3,
-                0,
-                "SBC zpg",
-                INSTR_VAL,
-            },
-        [0xE6] =
-            {
-                addr_zpg,
-                .instr_mem = instr_INC,
-                5,
-                0,
-                "INC zpg",
-                INSTR_MEM,
-            },
-        [0xE7] =
-            {
-                addr_zpg,
-                .instr_mem = instr_ISC,
-                5,
-                0,
-                "ISC zpg",
-                INSTR_MEM,
-            },
-        [0xE8] =
-            {
-                NULL,
-                .instr_none = instr_INX,
-                2,
-                0,
-                "INX",
-                INSTR_NONE,
-            },
-        [0xE9] =
-            {
-                addr_imm,
-                .instr_val = instr_SBC,
-                2,
-                0,
-                "SBC #",
-                INSTR_VAL,
-            },
-        [0xEA] =
-            {
-                NULL,
-                .instr_none = instr_NOP,
-                2,
-                0,
-                "NOP",
-                INSTR_NONE,
-            },
-        [0xEB] =
-            {
-                addr_imm,
-                .instr_val = instr_SBC,
-                2,
-                0,
-                "USBC #",
-                INSTR_VAL,
-            },
-        [0xEC] =
-            {
-                addr_abs,
-                .instr_val = instr_CPX,
-                4,
-                0,
-                "CPX abs",
-                INSTR_VAL,
-            },
-        [0xED] =
-            {
-                addr_abs,
-                .instr_val = instr_SBC,
-                4,
-                0,
-                "SBC abs",
-                INSTR_VAL,
-            },
-        [0xEE] =
-            {
-                addr_abs,
-                .instr_mem = instr_INC,
-                6,
-                0,
-                "INC abs",
-                INSTR_MEM,
-            },
-        [0xEF] =
-            {
-                addr_abs,
-                .instr_mem = instr_ISC,
-                6,
-                0,
-                "ISC abs",
-                INSTR_MEM,
-            },
-
-        [0xF0] =
-            {
-                NULL,
-                .instr_none = instr_BEQ,
-                2,
-                0,
-                "BEQ rel",
-                INSTR_NONE,
-            },
-        [0xF1] =
-            {
-                addr_ind_Y,
-                .instr_val = instr_SBC,
-                5,
-                1,
-                "SBC ind,Y",
-                INSTR_VAL,
-            },
-        [0xF3] =
-            {
-                addr_ind_Y,
-                .instr_mem = instr_ISC,
-                8,
-                0,
-                "ISC ind,Y",
-                INSTR_MEM,
-            },
-        [0xF4] =
-            {
-                addr_zpg_X,
-                .instr_addr = NULL,
-                4,
-                0,
-                "NOP zpg,X",
-                INSTR_ADDR,
-            },
-        [0xF5] =
-            {
-                addr_zpg_X,
-                .instr_val = instr_SBC,
-                4,
-                0,
-                "SBC zpg,X",
-                INSTR_VAL,
-            },
-        [0xF6] =
-            {
-                addr_zpg_X,
-                .instr_mem = instr_INC,
-                6,
-                0,
-                "INC zpg,X",
-                INSTR_MEM,
-            },
-        [0xF7] =
-            {
-                addr_zpg_X,
-                .instr_mem = instr_ISC,
-                6,
-                0,
-                "ISC zpg,X",
-                INSTR_MEM,
-            },
-        [0xF8] =
-            {
-                NULL,
-                .instr_none = instr_SED,
-                2,
-                0,
-                "SED",
-                INSTR_NONE,
-            },
-        [0xF9] =
-            {
-                addr_abs_Y,
-                .instr_val = instr_SBC,
-                4,
-                1,
-                "SBC abs,Y",
-                INSTR_VAL,
-            },
-        [0xFA] =
-            {
-                NULL,
-                .instr_none = instr_NOP,
-                2,
-                0,
-                "NOP imp",
-                INSTR_NONE,
-            },
-        [0xFB] =
-            {
-                addr_abs_Y,
-                .instr_mem = instr_ISC,
-                7,
-                0,
-                "ISC abs,Y",
-                INSTR_MEM,
-            },
-        [0xFC] =
-            {
-                addr_abs_X,
-                .instr_addr = NULL,
-                4,
-                1,
-                "NOP abs,X",
-                INSTR_ADDR,
-            },
-        [0xFD] =
-            {
-                addr_abs_X,
-                .instr_val = instr_SBC,
-                4,
-                1,
-                "SBC abs,X",
-                INSTR_VAL,
-            },
-        [0xFE] =
-            {
-                addr_abs_X,
-                .instr_mem = instr_INC,
-                7,
-                0,
-                "INC abs,X",
-                INSTR_MEM,
-            },
-        [0xFF] =
-            {
-                addr_abs_X,
-                .instr_mem = instr_ISC,
-                7,
-                0,
-                "ISC abs,X",
-                INSTR_MEM,
-            },
-};
+#define OPCODE_FN_NONE instr_none
+#define OPCODE_FN_ADDR instr_addr
+#define OPCODE_FN_VAL instr_val
+#define OPCODE_FN_MEM instr_mem
+#define OPCODE_FN_ACC instr_mem
+#define OPCODE_FN(type) OPCODE_FN_##type
+
+#define X(op, type, mode, fn, cyc, pcyc, mn)                                   \
+  [op] = {                                                                     \
+      .addr_mode = mode,                                                       \
+      .OPCODE_FN(type) = fn,                                                   \
+      .cycles = cyc,                                                           \
+      .page_cycles = pcyc,                                                     \
+      .mnemonic = mn,                                                          \
+      .instr_type = INSTR_##type,                                              \
+  },
+
+const Opcode lookup_table[256] = {CPU_OPCODES(X)};
+
+#undef X
+
+/* Table-driven dispatch through lookup_table */
+static void cpu_dispatch_table(Cpu6502 *cpu, uint8_t instr) {
+  const Opcode *opcode = &lookup_table[instr];
+  cpu->cycles = opcode->cycles;
+
+  switch (opcode->instr_type) {
+  case INSTR_NONE:
+    opcode->instr_none(cpu);
+    break;
+  case INSTR_VAL:
+    opcode->instr_val(cpu, CPU_READ(cpu, opcode->addr_mode(cpu)));
+    break;
+  case INSTR_MEM:
+    BUS_MODIFY(cpu, opcode->addr_mode(cpu), opcode->instr_mem);
+    break;
+  case INSTR_ADDR:
+    opcode->instr_addr(cpu, opcode->addr_mode(cpu));
+    break;
+  case INSTR_ACC:
+    opcode->instr_mem(cpu, &cpu->A);
+  }
+
+  if (cpu->page_crossed)
+    cpu->cycles += opcode->page_cycles;
+}
+
+#if CPU_FUSED_DISPATCH
+
+/*
+ * Fused dispatch: one handler per opcode with the addressing mode and the
+ * operation inlined together, generated from CPU_OPCODES. Cycle counts are
+ * constants in each handler, so opcodes without a page-cross penalty skip the
+ * check entirely.
+ */
+#define FUSED_NONE(mode, fn) fn(cpu)
+#define FUSED_ADDR(mode, fn) fn(cpu, mode(cpu))
+#define FUSED_VAL(mode, fn) fn(cpu, CPU_READ(cpu, mode(cpu)))
+#define FUSED_MEM(mode, fn) BUS_MODIFY(cpu, mode(cpu), fn)
+#define FUSED_ACC(mode, fn) fn(cpu, &cpu->A)
+
+#define FUSED_HANDLER(op, type, mode, fn, cyc, pcyc, mn)                       \
+  FUSED_LABEL(op) : cpu->cycles = cyc;                                         \
+  FUSED_##type(mode, fn);                                                      \
+  if (pcyc && cpu->page_crossed)                                               \
+    cpu->cycles += pcyc;                                                       \
+  return;
+
+#if defined(__GNUC__)
+#define FUSED_LABEL(op) op_##op
+#define FUSED_TARGET(op, type, mode, fn, cyc, pcyc, mn) [op] = &&op_##op,
+
+__attribute__((flatten)) static void cpu_dispatch_fused(Cpu6502 *cpu,
+                                                         uint8_t instr) {
+  // Unimplemented opcodes fall back to the table path
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Woverride-init"
+  static const void *const dispatch[256] = {
+      [0 ... 255] = &&op_undefined,
+      CPU_OPCODES(FUSED_TARGET)};
+#pragma GCC diagnostic pop
+
+  goto *dispatch[instr];
+
+  CPU_OPCODES(FUSED_HANDLER)
+
+op_undefined:
+  cpu_dispatch_table(cpu, instr);
+}
+#else
+#define FUSED_LABEL(op) case op
+
+static void cpu_dispatch_fused(Cpu6502 *cpu, uint8_t instr) {
+  switch (instr) {
+    CPU_OPCODES(FUSED_HANDLER)
+
+  default:
+    cpu_dispatch_table(cpu, instr);
+  }
+}
+#endif
+
+#endif // CPU_FUSED_DISPATCH
+
+#if CPU_BLOCK_CACHE
+
+/*
+ * Micro-op dispatch for pre-decoded blocks. Same per-opcode handlers as the
+ * fused core, but the effective address is computed from the decoded operand
+ * instead of fetching it through the bus. PC is set to where the addressing
+ * mode would have left it, so the instructions themselves are unchanged.
+ */
+#define UOP_EA_addr_imm(u) ((u)->pc + 1)
+#define UOP_EA_addr_zpg(u) ((u)->operand)
+#define UOP_EA_addr_zpg_X(u)                                                   \
+  (CPU_DUMMY_READ(cpu, (u)->operand), (uint8_t)((u)->operand + cpu->X))
+#define UOP_EA_addr_zpg_Y(u)                                                   \
+  (CPU_DUMMY_READ(cpu, (u)->operand), (uint8_t)((u)->operand + cpu->Y))
+#define UOP_EA_addr_abs(u) ((u)->operand)
+#define UOP_EA_addr_abs_X(u) ea_indexed(cpu, (u)->operand, cpu->X)
+#define UOP_EA_addr_abs_Y(u) ea_indexed(cpu, (u)->operand, cpu->Y)
+#define UOP_EA_addr_X_ind(u) ea_X_ind(cpu, (u)->operand)
+#define UOP_EA_addr_ind_Y(u) ea_ind_Y(cpu, (u)->operand)
+#define UOP_EA_addr_ind_jmp(u) ea_ind_jmp(cpu, (u)->operand)
+#define UOP_EA_addr_jsr(u) (jsr_push(cpu), CPU_TICK(cpu, 1), (u)->operand)
+
+// Immediate operands are already in the micro-op
+// Counts as the read addr_imm makes in the interpreter
+#define UOP_RD_addr_imm(u) (CPU_TICK(cpu, 1), (uint8_t)(u)->operand)
+#define UOP_RD_addr_zpg(u) CPU_READ(cpu, UOP_EA_addr_zpg(u))
+#define UOP_RD_addr_zpg_X(u) CPU_READ(cpu, UOP_EA_addr_zpg_X(u))
+#define UOP_RD_addr_zpg_Y(u) CPU_READ(cpu, UOP_EA_addr_zpg_Y(u))
+#define UOP_RD_addr_abs(u) CPU_READ(cpu, UOP_EA_addr_abs(u))
+#define UOP_RD_addr_abs_X(u) CPU_READ(cpu, UOP_EA_addr_abs_X(u))
+#define UOP_RD_addr_abs_Y(u) CPU_READ(cpu, UOP_EA_addr_abs_Y(u))
+#define UOP_RD_addr_X_ind(u) CPU_READ(cpu, UOP_EA_addr_X_ind(u))
+#define UOP_RD_addr_ind_Y(u) CPU_READ(cpu, UOP_EA_addr_ind_Y(u))
+
+#define UOP_NONE(ea, rd, fn) fn(cpu)
+#define UOP_ADDR(ea, rd, fn) fn(cpu, ea(uop))
+#define UOP_VAL(ea, rd, fn) fn(cpu, rd(uop))
+#define UOP_MEM(ea, rd, fn) BUS_MODIFY(cpu, ea(uop), fn)
+#define UOP_ACC(ea, rd, fn) fn(cpu, &cpu->A)
+
+#define UOP_HANDLER(op, type, mode, fn, cyc, pcyc, mn)                         \
+  UOP_LABEL(op) : cpu->PC = uop->pc + UOP_BYTES_##mode;                        \
+  cpu->cycles = cyc;                                                           \
+  UOP_##type(UOP_EA_##mode, UOP_RD_##mode, fn);                                \
+  if (pcyc && cpu->page_crossed)                                               \
+    cpu->cycles += pcyc;                                                       \
+  return;
+
+#if defined(__GNUC__)
+#define UOP_LABEL(op) uop_##op
+#define UOP_TARGET(op, type, mode, fn, cyc, pcyc, mn) [op] = &&uop_##op,
+
+__attribute__((flatten)) static void cpu_dispatch_uop(Cpu6502 *cpu,
+                                                       const Uop *uop) {
+  // Blocks only hold opcodes from CPU_OPCODES
+  static const void *const dispatch[256] = {CPU_OPCODES(UOP_TARGET)};
+
+  goto *dispatch[uop->opcode];
+
+  CPU_OPCODES(UOP_HANDLER)
+}
+#else
+#define UOP_LABEL(op) case op
+
+static void cpu_dispatch_uop(Cpu6502 *cpu, const Uop *uop) {
+  switch (uop->opcode) {
+    CPU_OPCODES(UOP_HANDLER)
+  }
+}
+#endif
+
+#endif // CPU_BLOCK_CACHE
+
+// Finish the instruction that just ran: settle its cycle count, move the
+// master clock and run the events that came due. Returns 1 if one of them
+// took an interrupt.
+static inline int cpu_retire(Cpu6502 *cpu) {
+  if (cpu->branch_instr) {
+    cpu->cycles = cpu->branch_cycles;
+    cpu->branch_instr = 0;
+  }
+
+  cpu->cpu_cycle_count += cpu->cycles;
+  cpu->page_crossed = 0;
+
+  PROFILE(cpu, profile_retire(cpu->profile, cpu->cycles));
+
+  // The PPU catches up lazily, nothing else needs attention before the next
+  // event
+#if CPU_CYCLE_ACCURATE
+  // Bus accesses already took their cycles, add the internal ones
+  cpu->sched.now += (cpu->cycles - cpu->bus_cycles) * 3;
+  cpu->bus_cycles = 0;
+#else
+  cpu->sched.now += cpu->cycles * 3;
+#endif
+  if (sched_due(&cpu->sched))
+    return sched_run(&cpu->sched);
+
+  return 0;
+}
+
+#if CPU_JIT
+/* Entry points for translated blocks */
+
+void cpu_jit_exec_uop(Cpu6502 *cpu, const Uop *uop) {
+  cpu_dispatch_uop(cpu, uop);
+}
+
+// Returns nonzero when the translated block has to hand back control: an
+// NMI was taken, OAM DMA started, or a write invalidated the block
+int cpu_jit_retire(Cpu6502 *cpu) {
+  STATS_COUNT(cpu);
+  if (cpu_retire(cpu))
+    return 1;
+
+  return cpu->dma_active_flag || !cpu->uop;
+}
+#endif
+
+/* Entry points for statically recompiled code (tools/recompile.c) */
+
+// Run one instruction from its decoded form
+void cpu_exec_decoded(Cpu6502 *cpu, uint8_t opcode, uint16_t pc,
+                      uint16_t operand) {
+#if CPU_BLOCK_CACHE
+  Uop uop = {.pc = pc, .operand = operand, .opcode = opcode};
+  cpu_dispatch_uop(cpu, &uop);
+#else
+  // Without uops the operand is fetched again from the PC
+  (void)operand;
+  cpu->PC = pc;
+#if CPU_FUSED_DISPATCH
+  cpu_dispatch_fused(cpu, opcode);
+#else
+  cpu_dispatch_table(cpu, opcode);
+#endif
+#endif
+}
+
+void cpu_bus_modify(Cpu6502 *cpu, uint16_t addr, InstrMem fn) {
+  BUS_MODIFY(cpu, addr, fn);
+}
+
+// Returns nonzero when recompiled code has to hand back control: an NMI was
+// taken or OAM DMA started
+int cpu_retire_instr(Cpu6502 *cpu) {
+  STATS_COUNT(cpu);
+  if (cpu_retire(cpu))
+    return 1;
+
+  return cpu->dma_active_flag;
+}
 
 void cpu_execute(Cpu6502 *cpu) {
 
+#if CPU_BLOCK_CACHE
+  const Uop *uop = block_cache_fetch(cpu);
+  uint8_t instr = uop ? uop->opcode : read_instr(cpu, cpu->PC);
+#else
   // Placeholder for instruction
-  uint8_t instr = memory[cpu->PC];
-  instr_num++;
+  uint8_t instr = read_instr(cpu, cpu->PC);
+#endif
+  cpu->instr_num++;
 
   cpu->instr = instr;
   LOG("****CPU******\n");
   LOG("\nPC Value: %x\n", cpu->PC);
   LOG("Instruction: %x\n", instr);
   LOG("Stack Pointer: %x\n", cpu->S);
-  join_char_array(&status, cpu->P);
-  LOG("Status: %b\n", status);
+  LOG("Status: %b\n", cpu_get_status(cpu));
   LOG("A: %x\n", cpu->A);
   LOG("X: %x\n", cpu->X);
   LOG("Y: %x\n", cpu->Y);
   LOG("Cycle: %d\n\n", cpu->cycles);
 
-  // dump_log_file(cpu);
-
-#if NES_TEST_ROM == 1
-  if (cpu->PC == 0x7001) {
-    printf("Reached addressed originally pushed to stack!");
-    exit(0);
+  if (cpu->dma_active_flag) {
+    // The whole stall passes at once, SCHED_DMA_END clears the flag
+    sched_schedule(&cpu->sched, SCHED_DMA_END,
+                   cpu->sched.now + cpu->dma_cycles * 3);
+    cpu->cycles = cpu->dma_cycles;
+    cpu_retire(cpu);
+    return;
   }
-#endif
 
-  if (dma_active_flag) {
-    if (dma_cycles > 0) {
-      dma_cycles--;
-      cpu->cycles = 1;
-      cpu->cpu_cycle_count++;
-      ppu_exec(cpu);
+#if NES_DEBUGGER
+  // Debugged runs interpret every instruction, unless it is a breakpoint
+  if (cpu->debug) {
+    if (debug_exec(cpu)) {
+      // Stopped before the instruction, it runs on a later call
+      cpu->instr_num--;
       return;
-    } else {
-      dma_active_flag = 0;
     }
+    if (cpu->trace)
+      cpu_trace(cpu);
+    goto interpret;
   }
-  Opcode opcode = lookup_table[instr];
-  cpu->cycles = opcode.cycles;
-  uint8_t val;
-  uint16_t addr;
+#endif
 
-  switch (opcode.instr_type) {
-  case INSTR_NONE:
-    opcode.instr_none(cpu);
-    break;
-  case INSTR_VAL:
-    val = memory[opcode.addr_mode(cpu)];
-    opcode.instr_val(cpu, val);
-    break;
-  case INSTR_MEM:
-    addr = opcode.addr_mode(cpu);
-    opcode.instr_mem(cpu, &memory[addr]);
-    break;
-  case INSTR_ADDR:
-    addr = opcode.addr_mode(cpu);
-    if (opcode.instr_addr == NULL) {
-      cpu->PC++;
-    } else {
-      opcode.instr_addr(cpu, addr);
-    }
-    break;
-  case INSTR_ACC:
-    opcode.instr_mem(cpu, &cpu->A);
+  // Traced runs interpret every instruction
+  if (cpu->trace) {
+    cpu_trace(cpu);
+    goto interpret;
   }
 
-  if (page_crossed)
-    cpu->cycles += opcode.page_cycles;
+#if CPU_PROFILE
+  // So do profiled ones, each is charged to its own PC
+  if (cpu->profile)
+    goto interpret;
+#endif
 
-  if (branch_instr) {
-    cpu->cycles = branch_cycles;
-    branch_instr = 0;
-  }
+#if NES_CDL
+  // And logged ones, so every instruction is seen
+  if (cpu->cdl)
+    goto interpret;
+#endif
+
+#if CPU_IDLE_SKIP
+  // Jump over wait loops up to the next PPU event
+  if (idle_loop_skip(cpu))
+    return;
+#endif
 
-  for (int i = 0; i < cpu->cycles; i++) {
-    ppu_exec(cpu);
+#if CPU_RECOMP
+  // Ahead-of-time translated PRG, falls back here for anything it can't run.
+  // It was translated from the ROM without cheats.
+  if (cpu->recomp && !cpu->cheats && cpu->recomp(cpu)) {
+#if CPU_IDLE_SKIP
+    // Translated slices can't be followed instruction by instruction
+    idle_loop_reset(cpu);
+#endif
+    return;
   }
+#endif
 
-  cpu->cpu_cycle_count += cpu->cycles;
-  page_crossed = 0;
+#if CPU_JIT
+  // Hot blocks run as native code, which retires every instruction itself
+  if (uop && cpu->jit && jit_execute(cpu, uop))
+    return;
+#endif
 
-  // PPU set NMI flag
-  if (cpu->ppu->nmi_flag) {
+interpret:
+  PROFILE(cpu, profile_begin(cpu->profile, cpu->PC));
+#if NES_CDL
+  cdl_exec(cpu, cpu->PC, instr);
+#endif
 
-    // Execute NMI subroutine
-    cpu_nmi_triggered(cpu);
+  // Opcode and operand fetches come first
+  CPU_TICK(cpu, fetch_cycles[instr]);
+#if CPU_CYCLE_ACCURATE
+  if (fetch_padding[instr])
+    CPU_DUMMY_READ(cpu, cpu->PC + 1);
+#endif
 
-    // Reset nmi flag
-    cpu->ppu->nmi_flag = 0;
-    return;
-  }
+#if CPU_BLOCK_CACHE
+  // Advance first, a write to the block's page clears the cursor
+  cpu->uop = uop ? uop + 1 : NULL;
+
+  if (uop)
+    cpu_dispatch_uop(cpu, uop);
+  else
+#endif
+#if CPU_FUSED_DISPATCH
+    cpu_dispatch_fused(cpu, instr);
+#else
+    cpu_dispatch_table(cpu, instr);
+#endif
 
-  // print("}\n");
+  STATS_COUNT(cpu);
+  cpu_retire(cpu);
 }
@@ -0,0 +1,496 @@
+#include "cpu/debug.h"
+#include "cpu/block_cache.h"
+#include "cpu/cpu.h"
+#include "cpu/opcodes.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum PointKind {
+  POINT_FREE,
+  POINT_CPU, // Address range on the CPU bus
+  POINT_PPU, // Address range on the PPU bus
+  POINT_DOT, // Scanline and dot
+} PointKind;
+
+typedef struct DebugPoint {
+  PointKind kind;
+  uint8_t flags;
+  uint16_t first, last;
+  int scanline, dot;
+  uint64_t hits;
+} DebugPoint;
+
+struct Debugger {
+  DebugPoint points[DEBUG_MAX_POINTS];
+
+  // Flags of every address, folded from the points. The CPU's page flags
+  // live in its bus table.
+  uint8_t cpu_flags[0x10000];
+  uint8_t ppu_flags[0x4000];
+  uint8_t ppu_pages[0x40];
+
+  int stopped;
+  char reason[96];
+  uint16_t pc; // Instruction being executed
+
+  int steps; // Instructions left to step, 0 when running freely
+
+  // Execution points at resume_pc don't stop the instruction resumed from
+  int resuming;
+  uint16_t resume_pc;
+};
+
+// Instruction length by opcode. Relative branches are the only opcodes of
+// the form xxx10000.
+#define X(op, type, mode, fn, cyc, pcyc, mn)                                   \
+  [op] = 1 + UOP_BYTES_##mode + (((op) & 0x1F) == 0x10),
+
+static const uint8_t instr_bytes[256] = {CPU_OPCODES(X)};
+
+#undef X
+
+static void debug_stop(struct Debugger *dbg, const char *fmt, int a, int b) {
+  // The first point hit by an instruction is the one reported
+  if (dbg->stopped)
+    return;
+
+  dbg->stopped = 1;
+  snprintf(dbg->reason, sizeof(dbg->reason), fmt, a, b);
+}
+
+/* Points */
+
+static int debug_on_dot(void *ctx, uint64_t time);
+
+// Next scanline/dot point the PPU reaches
+static void schedule_dots(Cpu6502 *cpu) {
+  struct Debugger *dbg = cpu->debug;
+  int dots = 0;
+
+  cpu_ppu_sync(cpu);
+  for (int i = 0; i < DEBUG_MAX_POINTS; i++) {
+    DebugPoint *point = &dbg->points[i];
+    if (point->kind != POINT_DOT)
+      continue;
+
+    int until = ppu_dots_until(cpu->ppu, point->scanline, point->dot);
+    if (!dots || until < dots)
+      dots = until;
+  }
+
+  if (dots)
+    sched_schedule(&cpu->sched, SCHED_BREAK, cpu->ppu_time + dots);
+  else
+    sched_cancel(&cpu->sched, SCHED_BREAK);
+}
+
+// Folds the points back into the address and page flags
+static void rebuild(Cpu6502 *cpu) {
+  struct Debugger *dbg = cpu->debug;
+
+  memset(dbg->cpu_flags, 0, sizeof(dbg->cpu_flags));
+  memset(dbg->ppu_flags, 0, sizeof(dbg->ppu_flags));
+  memset(dbg->ppu_pages, 0, sizeof(dbg->ppu_pages));
+
+  for (int i = 0; i < DEBUG_MAX_POINTS; i++) {
+    DebugPoint *point = &dbg->points[i];
+    if (point->kind != POINT_CPU && point->kind != POINT_PPU)
+      continue;
+
+    for (int addr = point->first; addr <= point->last; addr++) {
+      if (point->kind == POINT_CPU) {
+        dbg->cpu_flags[addr] |= point->flags;
+      } else if (point->kind == POINT_PPU) {
+        dbg->ppu_flags[addr] |= point->flags;
+        dbg->ppu_pages[addr >> 8] |= point->flags;
+      }
+    }
+  }
+
+  for (int page = 0; page < 0x100; page++) {
+    uint8_t flags = 0;
+    for (int i = 0; i < 0x100; i++)
+      flags |= dbg->cpu_flags[page << 8 | i];
+    cpu->bus[page].watch = flags;
+  }
+
+  schedule_dots(cpu);
+}
+
+static int add_point(Cpu6502 *cpu, DebugPoint point) {
+  struct Debugger *dbg = cpu->debug;
+
+  for (int i = 0; i < DEBUG_MAX_POINTS; i++) {
+    if (dbg->points[i].kind == POINT_FREE) {
+      dbg->points[i] = point;
+      rebuild(cpu);
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+int debug_watch(Cpu6502 *cpu, uint16_t first, uint16_t last, uint8_t flags) {
+  return add_point(cpu, (DebugPoint){.kind = POINT_CPU,
+                                     .flags = flags,
+                                     .first = first,
+                                     .last = last < first ? first : last});
+}
+
+int debug_watch_ppu(Cpu6502 *cpu, uint16_t first, uint16_t last,
+                    uint8_t flags) {
+  first &= 0x3FFF;
+  last &= 0x3FFF;
+  return add_point(cpu, (DebugPoint){.kind = POINT_PPU,
+                                     .flags = flags,
+                                     .first = first,
+                                     .last = last < first ? first : last});
+}
+
+int debug_break_dot(Cpu6502 *cpu, int scanline, int dot) {
+  if (scanline < -1 || scanline >= NUM_SCANLINES - 1 || dot < 0 ||
+      dot >= NUM_DOTS)
+    return -1;
+
+  return add_point(cpu, (DebugPoint){.kind = POINT_DOT,
+                                     .scanline = scanline,
+                                     .dot = dot});
+}
+
+void debug_delete(Cpu6502 *cpu, int point) {
+  if (point < 0 || point >= DEBUG_MAX_POINTS)
+    return;
+
+  cpu->debug->points[point].kind = POINT_FREE;
+  rebuild(cpu);
+}
+
+/* Hooks */
+
+struct Debugger *debug_attach(Cpu6502 *cpu) {
+  struct Debugger *dbg = calloc(1, sizeof(struct Debugger));
+  if (!dbg)
+    return NULL;
+
+  cpu->debug = dbg;
+  sched_set_handler(&cpu->sched, SCHED_BREAK, debug_on_dot, cpu);
+  rebuild(cpu);
+
+  dbg->stopped = 1;
+  snprintf(dbg->reason, sizeof(dbg->reason), "reset");
+  return dbg;
+}
+
+void debug_detach(Cpu6502 *cpu) {
+  if (!cpu->debug)
+    return;
+
+  for (int page = 0; page < 0x100; page++)
+    cpu->bus[page].watch = 0;
+
+  sched_cancel(&cpu->sched, SCHED_BREAK);
+  free(cpu->debug);
+  cpu->debug = NULL;
+}
+
+int debug_exec(Cpu6502 *cpu) {
+  struct Debugger *dbg = cpu->debug;
+  int resumed = dbg->resuming && dbg->resume_pc == cpu->PC;
+
+  // Still at the prompt, as right after attaching
+  if (dbg->stopped)
+    return 1;
+
+  dbg->pc = cpu->PC;
+  dbg->resuming = 0;
+
+  if (resumed || !(cpu->bus[cpu->PC >> 8].watch & WATCH_EXEC) ||
+      !(dbg->cpu_flags[cpu->PC] & WATCH_EXEC))
+    return 0;
+
+  for (int i = 0; i < DEBUG_MAX_POINTS; i++) {
+    DebugPoint *point = &dbg->points[i];
+    if (point->kind == POINT_CPU && point->flags & WATCH_EXEC &&
+        point->first <= cpu->PC && cpu->PC <= point->last) {
+      point->hits++;
+      debug_stop(dbg, "point %d: exec $%04X", i, cpu->PC);
+      break;
+    }
+  }
+
+  return 1;
+}
+
+// The instruction runs to the end, the prompt comes after it retires
+static void watch_hit(struct Debugger *dbg, PointKind kind, uint16_t addr,
+                      uint8_t val, uint8_t flag) {
+  static const char *const formats[2][2] = {
+      {"point %d: read $%04X", "point %d: write $%04X"},
+      {"point %d: PPU read $%04X", "point %d: PPU write $%04X"},
+  };
+
+  for (int i = 0; i < DEBUG_MAX_POINTS; i++) {
+    DebugPoint *point = &dbg->points[i];
+    if (point->kind == kind && point->flags & flag && point->first <= addr &&
+        addr <= point->last) {
+      point->hits++;
+      debug_stop(dbg, formats[kind == POINT_PPU][flag == WATCH_WRITE], i,
+                 addr);
+
+      int len = strlen(dbg->reason);
+      snprintf(dbg->reason + len, sizeof(dbg->reason) - len,
+               " = $%02X by $%04X", val, dbg->pc);
+      return;
+    }
+  }
+}
+
+void debug_access(Cpu6502 *cpu, uint16_t addr, uint8_t val, uint8_t flag) {
+  struct Debugger *dbg = cpu->debug;
+
+  if (!dbg->stopped && dbg->cpu_flags[addr] & flag)
+    watch_hit(dbg, POINT_CPU, addr, val, flag);
+}
+
+void debug_ppu_access(Cpu6502 *cpu, uint8_t val, uint8_t flag) {
+  struct Debugger *dbg = cpu->debug;
+  uint16_t addr;
+
+  // Rendering moves v, catch up to the access first
+  cpu_ppu_sync(cpu);
+  addr = cpu->ppu->v & 0x3FFF;
+
+  if (dbg->stopped || !(dbg->ppu_pages[addr >> 8] & flag) ||
+      !(dbg->ppu_flags[addr] & flag))
+    return;
+
+  // A read returns the buffered byte, report the one at the address
+  if (flag == WATCH_READ)
+    val = read_mem(cpu->ppu, addr);
+
+  watch_hit(dbg, POINT_PPU, addr, val, flag);
+}
+
+// The PPU reached a scanline/dot point during the last instruction
+static int debug_on_dot(void *ctx, uint64_t time) {
+  Cpu6502 *cpu = ctx;
+  (void)time;
+  struct Debugger *dbg = cpu->debug;
+  int passed = -1, longest = 0;
+
+  cpu_ppu_sync(cpu);
+
+  // The one passed most recently is furthest away now
+  for (int i = 0; i < DEBUG_MAX_POINTS; i++) {
+    DebugPoint *point = &dbg->points[i];
+    if (point->kind != POINT_DOT)
+      continue;
+
+    int until = ppu_dots_until(cpu->ppu, point->scanline, point->dot);
+    if (until > longest) {
+      longest = until;
+      passed = i;
+    }
+  }
+
+  if (passed >= 0) {
+    DebugPoint *point = &dbg->points[passed];
+    point->hits++;
+    debug_stop(dbg, "point %d: scanline %d", passed, point->scanline);
+
+    int len = strlen(dbg->reason);
+    snprintf(dbg->reason + len, sizeof(dbg->reason) - len, " dot %d",
+             point->dot);
+  }
+
+  schedule_dots(cpu);
+  return 0;
+}
+
+int debug_stopped(Cpu6502 *cpu) {
+  struct Debugger *dbg = cpu->debug;
+
+  if (!dbg->stopped && dbg->steps && --dbg->steps == 0) {
+    dbg->stopped = 1;
+    snprintf(dbg->reason, sizeof(dbg->reason), "step");
+  }
+
+  return dbg->stopped;
+}
+
+/* Prompt */
+
+// Bytes only host-backed pages can give without side effects, -1 otherwise
+static int peek(Cpu6502 *cpu, uint16_t addr) {
+  const BusPage *page = &cpu->bus[addr >> 8];
+  return page->read_ptr ? page->read_ptr[addr & 0xFF] : -1;
+}
+
+static void print_state(Cpu6502 *cpu, FILE *out) {
+  uint16_t pc = cpu->PC;
+  int opcode = peek(cpu, pc);
+  int len = opcode >= 0 ? instr_bytes[opcode] : 1;
+  const char *mnemonic =
+      opcode >= 0 && lookup_table[opcode].mnemonic
+          ? lookup_table[opcode].mnemonic
+          : "???";
+
+  cpu_ppu_sync(cpu);
+
+  fprintf(out, "%04X ", pc);
+  for (int i = 0; i < 3; i++) {
+    int byte = i < len ? peek(cpu, pc + i) : -2;
+    if (byte >= 0)
+      fprintf(out, " %02X", byte);
+    else
+      fprintf(out, byte == -1 ? " ??" : "   ");
+  }
+
+  fprintf(out,
+          "  %-4.3s A:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%llu SL:%d DOT:%d\n",
+          mnemonic, cpu->A, cpu->X, cpu->Y, cpu_get_status(cpu), cpu->S,
+          (unsigned long long)cpu->cpu_cycle_count, cpu->ppu->scanline,
+          cpu->ppu->current_scanline_cycle);
+}
+
+static void list_points(struct Debugger *dbg, FILE *out) {
+  for (int i = 0; i < DEBUG_MAX_POINTS; i++) {
+    DebugPoint *point = &dbg->points[i];
+    if (point->kind == POINT_FREE)
+      continue;
+
+    fprintf(out, "  %2d  ", i);
+    if (point->kind == POINT_DOT) {
+      fprintf(out, "scanline %d dot %d", point->scanline, point->dot);
+    } else {
+      fprintf(out, "%s %c%c%c $%04X", point->kind == POINT_PPU ? "PPU" : "CPU",
+              point->flags & WATCH_READ ? 'r' : '-',
+              point->flags & WATCH_WRITE ? 'w' : '-',
+              point->flags & WATCH_EXEC ? 'x' : '-', point->first);
+      if (point->last != point->first)
+        fprintf(out, "-$%04X", point->last);
+    }
+    fprintf(out, "  hits %llu\n", (unsigned long long)point->hits);
+  }
+}
+
+static void dump(Cpu6502 *cpu, int ppu, uint16_t addr, int len, FILE *out) {
+  for (int i = 0; i < len; i++) {
+    uint16_t a = ppu ? (addr + i) & 0x3FFF : addr + i;
+    int byte = ppu ? read_mem(cpu->ppu, a) : peek(cpu, a);
+
+    if (i % 16 == 0)
+      fprintf(out, "%s%04X:", i ? "\n" : "", a);
+    if (byte >= 0)
+      fprintf(out, " %02X", byte);
+    else
+      fprintf(out, " ??");
+  }
+  fprintf(out, "\n");
+}
+
+static const char help[] =
+    "  c                 continue\n"
+    "  s [n]             step n instructions (empty line steps one)\n"
+    "  b ADDR            break at PC\n"
+    "  wr|ww|wx|wa ADDR [END]\n"
+    "                    watch CPU reads, writes, execution or all three\n"
+    "  pr|pw ADDR [END]  watch PPU reads or writes through $2007\n"
+    "  sl LINE [DOT]     break when the PPU reaches the scanline and dot\n"
+    "  l                 list points\n"
+    "  d [N]             delete point N, or all of them\n"
+    "  i                 registers and PPU position\n"
+    "  m ADDR [LEN]      dump CPU memory, ?? where reading has side effects\n"
+    "  pm ADDR [LEN]     dump PPU memory\n"
+    "  q                 quit\n";
+
+static void resume(Cpu6502 *cpu, int steps) {
+  struct Debugger *dbg = cpu->debug;
+
+  dbg->stopped = 0;
+  dbg->steps = steps;
+  dbg->resuming = 1;
+  dbg->resume_pc = cpu->PC;
+}
+
+// Addresses are hex, bare or with a $ or 0x prefix
+static unsigned hex(const char *arg) {
+  return strtoul(arg + (arg[0] == '$'), NULL, 16);
+}
+
+int debug_prompt(Cpu6502 *cpu, FILE *in, FILE *out) {
+  struct Debugger *dbg = cpu->debug;
+  char line[128];
+
+  fprintf(out, "%s\n", dbg->reason);
+  print_state(cpu, out);
+
+  for (;;) {
+    fprintf(out, "(nes) ");
+    fflush(out);
+
+    if (!fgets(line, sizeof(line), in))
+      return 0;
+
+    char *args[3];
+    int n = 0;
+    for (char *arg = strtok(line, " \t\r\n"); arg && n < 3;
+         arg = strtok(NULL, " \t\r\n"))
+      args[n++] = arg;
+
+    if (!n) {
+      resume(cpu, 1);
+      return 1;
+    }
+
+    const char *cmd = args[0];
+    int point = -2;
+
+    if (!strcmp(cmd, "c")) {
+      resume(cpu, 0);
+      return 1;
+    } else if (!strcmp(cmd, "s")) {
+      int steps = n > 1 ? atoi(args[1]) : 1;
+      resume(cpu, steps > 0 ? steps : 1);
+      return 1;
+    } else if (!strcmp(cmd, "q")) {
+      return 0;
+    } else if (!strcmp(cmd, "b") && n > 1) {
+      point = debug_watch(cpu, hex(args[1]), hex(args[1]), WATCH_EXEC);
+    } else if (cmd[0] == 'w' && cmd[1] && strchr("rwxa", cmd[1]) && n > 1) {
+      uint8_t flags = cmd[1] == 'r'   ? WATCH_READ
+                      : cmd[1] == 'w' ? WATCH_WRITE
+                      : cmd[1] == 'x' ? WATCH_EXEC
+                                      : WATCH_READ | WATCH_WRITE | WATCH_EXEC;
+      point = debug_watch(cpu, hex(args[1]), hex(args[n - 1]), flags);
+    } else if ((!strcmp(cmd, "pr") || !strcmp(cmd, "pw")) && n > 1) {
+      point = debug_watch_ppu(cpu, hex(args[1]), hex(args[n - 1]),
+                              cmd[1] == 'r' ? WATCH_READ : WATCH_WRITE);
+    } else if (!strcmp(cmd, "sl") && n > 1) {
+      point = debug_break_dot(cpu, atoi(args[1]), n > 2 ? atoi(args[2]) : 0);
+    } else if (!strcmp(cmd, "l")) {
+      list_points(dbg, out);
+    } else if (!strcmp(cmd, "d")) {
+      if (n > 1) {
+        debug_delete(cpu, atoi(args[1]));
+      } else {
+        for (int i = 0; i < DEBUG_MAX_POINTS; i++)
+          dbg->points[i].kind = POINT_FREE;
+        rebuild(cpu);
+      }
+    } else if (!strcmp(cmd, "i")) {
+      print_state(cpu, out);
+    } else if ((!strcmp(cmd, "m") || !strcmp(cmd, "pm")) && n > 1) {
+      dump(cpu, cmd[0] == 'p', hex(args[1]), n > 2 ? atoi(args[2]) : 16, out);
+    } else {
+      fprintf(out, "%s", help);
+    }
+
+    if (point >= 0)
+      fprintf(out, "point %d\n", point);
+    else if (point == -1)
+      fprintf(out, "no free points\n");
+  }
+}
@@ -0,0 +1,294 @@
+#include "cpu/idle.h"
+#include "config.h"
+#include "cpu/block_cache.h"
+#include "cpu/opcodes.h"
+#include "cpu/stats.h"
+
+#include <stdint.h>
+
+#define X(op, type, mode, fn, cyc, pcyc, mn) [op] = UOP_BYTES_##mode,
+
+static const uint8_t operand_bytes[256] = {CPU_OPCODES(X)};
+
+#undef X
+
+static int is_branch(const Opcode *op) {
+  if (op->instr_type != INSTR_NONE)
+    return 0;
+
+  InstrNone fn = op->instr_none;
+  return fn == instr_BCC || fn == instr_BCS || fn == instr_BEQ ||
+         fn == instr_BNE || fn == instr_BPL || fn == instr_BMI ||
+         fn == instr_BVC || fn == instr_BVS;
+}
+
+// Code bytes are only scanned from pages backed by host memory
+static int code_byte(Cpu6502 *cpu, uint16_t addr, uint8_t *out) {
+  const uint8_t *page = cpu->bus[addr >> 8].read_ptr;
+
+  if (!page)
+    return 0;
+
+  *out = page[addr & 0xFF];
+  return 1;
+}
+
+// Reading PPUSTATUS only has an effect the first time after VBlank
+static int is_ppu_status(uint16_t addr) {
+  return addr >= 0x2000 && addr < 0x4000 && (addr & 7) == 2;
+}
+
+// Whether every address the operand can reach is safe to read repeatedly
+static int reads_safely(Cpu6502 *cpu, AddrMode mode, uint16_t operand) {
+  if (mode == addr_imm)
+    return 1;
+
+  if (mode == addr_zpg || mode == addr_zpg_X || mode == addr_zpg_Y)
+    return cpu->bus[0x00].read_ptr != NULL;
+
+  if (mode == addr_abs)
+    return cpu->bus[operand >> 8].read_ptr || is_ppu_status(operand);
+
+  if (mode == addr_abs_X || mode == addr_abs_Y)
+    return cpu->bus[operand >> 8].read_ptr &&
+           cpu->bus[(uint16_t)(operand + 0xFF) >> 8].read_ptr;
+
+  return 0;
+}
+
+// Instructions that neither write memory nor leave the loop
+static int is_pure(Cpu6502 *cpu, const Opcode *op, uint16_t operand) {
+  switch (op->instr_type) {
+  case INSTR_ACC:
+    return 1;
+
+  case INSTR_VAL:
+    return reads_safely(cpu, op->addr_mode, operand);
+
+  case INSTR_ADDR:
+    if (op->instr_addr != instr_LDA && op->instr_addr != instr_LDX &&
+        op->instr_addr != instr_LDY && op->instr_addr != instr_IGN)
+      return 0;
+    return reads_safely(cpu, op->addr_mode, operand);
+
+  case INSTR_NONE: {
+    InstrNone fn = op->instr_none;
+    return fn != instr_BRK && fn != instr_RTS && fn != instr_RTI &&
+           fn != instr_PHA && fn != instr_PHP && fn != instr_PLA &&
+           fn != instr_PLP;
+  }
+
+  default:
+    return 0;
+  }
+}
+
+// Find the loop that starts at head and ends with a branch or JMP back to it
+static int idle_scan(Cpu6502 *cpu, uint16_t head) {
+  IdleLoop *idle = &cpu->idle;
+  uint16_t exits[IDLE_MAX_INSTRS];
+  int num_exits = 0;
+  int polls_ppu = 0;
+  uint16_t pc = head;
+
+  for (int n = 1; n <= IDLE_MAX_INSTRS; n++) {
+    uint8_t opcode, lo = 0, hi = 0;
+
+    if ((uint16_t)(pc - head) >= IDLE_MAX_BYTES || !code_byte(cpu, pc, &opcode))
+      return 0;
+
+    const Opcode *op = &lookup_table[opcode];
+    if (!op->mnemonic)
+      return 0;
+
+    int len = 1 + operand_bytes[opcode] + is_branch(op);
+    if ((len > 1 && !code_byte(cpu, pc + 1, &lo)) ||
+        (len > 2 && !code_byte(cpu, pc + 2, &hi)))
+      return 0;
+
+    uint16_t operand = lo | hi << 8;
+    uint16_t target;
+
+    if (is_branch(op)) {
+      target = pc + 2 + (int8_t)lo;
+    } else if (op->instr_type == INSTR_ADDR && op->instr_addr == instr_JMP &&
+               op->addr_mode == addr_abs) {
+      target = operand;
+      if (target != head)
+        return 0;
+    } else {
+      if (!is_pure(cpu, op, operand))
+        return 0;
+      if (op->addr_mode == addr_abs && is_ppu_status(operand))
+        polls_ppu = 1;
+
+      pc += len;
+      continue;
+    }
+
+    if (target == head) {
+      // Every other branch has to leave the loop
+      for (int i = 0; i < num_exits; i++) {
+        if (exits[i] >= head && exits[i] <= pc)
+          return 0;
+      }
+
+      idle->head = head;
+      idle->end = pc;
+      idle->length = n;
+      idle->polls_ppu = polls_ppu;
+      idle->valid = 0;
+      return 1;
+    }
+
+    exits[num_exits++] = target;
+    pc += len;
+  }
+
+  return 0;
+}
+
+// Machine state at the top of the loop, compared between iterations
+static void idle_snapshot(Cpu6502 *cpu, int event_dots) {
+  IdleLoop *idle = &cpu->idle;
+
+  idle->A = cpu->A;
+  idle->X = cpu->X;
+  idle->Y = cpu->Y;
+  idle->S = cpu->S;
+  idle->P = cpu->P;
+  idle->nz = cpu->nz;
+  idle->ppu_status = cpu->ppu->PPUSTATUS;
+  idle->event_dots = event_dots;
+  idle->cycle = cpu->cpu_cycle_count;
+  idle->instr_num = cpu->instr_num;
+  idle->valid = 1;
+}
+
+// The last iteration ran only the loop body, saw no PPU event and left
+// everything it depends on as it found it
+static int idle_repeats(Cpu6502 *cpu) {
+  IdleLoop *idle = &cpu->idle;
+
+  return idle->valid && cpu->instr_num - idle->instr_num == idle->length &&
+         (int)(cpu->cpu_cycle_count - idle->cycle) * 3 < idle->event_dots &&
+         idle->ppu_status == cpu->ppu->PPUSTATUS && idle->A == cpu->A &&
+         idle->X == cpu->X && idle->Y == cpu->Y && idle->S == cpu->S &&
+         idle->P == cpu->P && idle->nz == cpu->nz;
+}
+
+// Dots until the next scheduled event, at most a frame since VBlank and the
+// end of the frame are always pending
+static int idle_horizon(Cpu6502 *cpu) {
+  const PPU *ppu = cpu->ppu;
+
+  // Sprite overflow is set during sprite evaluation on the visible lines,
+  // with no event behind it. A loop polling PPUSTATUS can't be skipped while
+  // that may still happen this frame.
+  if (cpu->idle.polls_ppu && (ppu->PPUMASK & 0x18) &&
+      !(ppu->PPUSTATUS & 0x20) && ppu->scanline <= 239)
+    return 0;
+
+  return cpu->sched.next - cpu->sched.now;
+}
+
+#if CPU_STATS
+// Count the skipped iterations: every instruction of the body runs once per
+// iteration, and a closing branch is taken each time
+static void idle_count(Cpu6502 *cpu, int iters) {
+  IdleLoop *idle = &cpu->idle;
+  int len;
+
+  for (int pc = idle->head; pc <= idle->end; pc += len) {
+    uint8_t opcode;
+    if (!code_byte(cpu, pc, &opcode))
+      return;
+
+    const Opcode *op = &lookup_table[opcode];
+    cpu->stats->executed[opcode] += iters;
+    len = 1 + operand_bytes[opcode] + is_branch(op);
+
+    if (pc == idle->end && is_branch(op)) {
+      cpu->stats->branch_taken[opcode] += iters;
+      if ((idle->head & 0xFF00) != ((pc + 2) & 0xFF00))
+        cpu->stats->page_crossed[opcode] += iters;
+    }
+  }
+}
+#endif
+
+void idle_loop_reset(Cpu6502 *cpu) {
+  IdleLoop *idle = &cpu->idle;
+
+  idle->head = -1;
+  idle->end = -1;
+  idle->rejected = -1;
+  idle->last_pc = -1;
+  idle->valid = 0;
+}
+
+int idle_loop_skip(Cpu6502 *cpu) {
+  IdleLoop *idle = &cpu->idle;
+  int pc = cpu->PC;
+  int last_pc = idle->last_pc;
+
+  idle->last_pc = pc;
+
+  if (pc != idle->head) {
+    // Still inside the current loop's body
+    if (pc > idle->head && pc <= idle->end)
+      return 0;
+
+    // Anywhere else (an exit, an interrupt handler) drops the loop. A short
+    // jump backwards may close a new one.
+    idle->head = -1;
+    idle->end = -1;
+    if (pc > last_pc || last_pc - pc >= IDLE_MAX_BYTES || pc == idle->rejected)
+      return 0;
+
+    if (!idle_scan(cpu, pc)) {
+      idle->rejected = pc;
+      return 0;
+    }
+
+    cpu_ppu_sync(cpu);
+    idle_snapshot(cpu, idle_horizon(cpu));
+    return 0;
+  }
+
+  // The snapshot compares PPUSTATUS
+  cpu_ppu_sync(cpu);
+  int event_dots = idle_horizon(cpu);
+
+  if (!idle_repeats(cpu)) {
+    idle_snapshot(cpu, event_dots);
+    return 0;
+  }
+
+  // One iteration changed nothing, so the next ones won't either until the
+  // next event. Skip the iterations that end before it; the PPU catches up
+  // whenever it is next looked at.
+  int iter_cycles = cpu->cpu_cycle_count - idle->cycle;
+  int iters = (event_dots - 1) / (iter_cycles * 3);
+
+  idle_snapshot(cpu, event_dots);
+  if (iters < 1)
+    return 0;
+
+  int cycles = iters * iter_cycles;
+
+  cpu->cycles = cycles;
+  cpu->cpu_cycle_count += cycles;
+  cpu->sched.now += cycles * 3;
+
+  // cpu_execute already counted the instruction at the top of the loop
+  cpu->instr_num += iters * idle->length - 1;
+
+#if CPU_STATS
+  if (cpu->stats)
+    idle_count(cpu, iters);
+#endif
+
+  idle->valid = 0;
+  return 1;
+}
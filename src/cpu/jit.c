@@ -0,0 +1,379 @@
+#include "cpu/jit.h"
+#include "config.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if CPU_JIT && defined(__x86_64__)
+
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Worst case per instruction is a call-out plus the retire sequence
+#define JIT_MAX_BLOCK_BYTES (BLOCK_MAX_UOPS * 96 + 32)
+
+#define CPU_OFF(field) ((int32_t)offsetof(Cpu6502, field))
+
+// x86 register numbers used in ModRM.reg
+#define REG_RAX 0
+
+struct Jit {
+  uint8_t *code;
+  size_t used;
+};
+
+typedef struct Emitter {
+  uint8_t *p;
+} Emitter;
+
+/* Encoding helpers. rbx holds the Cpu6502 pointer for the whole block. */
+
+static void emit8(Emitter *e, uint8_t b) { *e->p++ = b; }
+
+static void emit16(Emitter *e, uint16_t v) {
+  memcpy(e->p, &v, 2);
+  e->p += 2;
+}
+
+static void emit32(Emitter *e, uint32_t v) {
+  memcpy(e->p, &v, 4);
+  e->p += 4;
+}
+
+static void emit64(Emitter *e, uint64_t v) {
+  memcpy(e->p, &v, 8);
+  e->p += 8;
+}
+
+// ModRM for [rbx + disp32]
+static void emit_rbx_disp(Emitter *e, uint8_t reg, int32_t disp) {
+  emit8(e, 0x80 | (reg << 3) | 3);
+  emit32(e, disp);
+}
+
+// mov byte [rbx + off], imm8
+static void emit_store8_imm(Emitter *e, int32_t off, uint8_t v) {
+  emit8(e, 0xC6);
+  emit_rbx_disp(e, 0, off);
+  emit8(e, v);
+}
+
+// mov word [rbx + off], imm16
+static void emit_store16_imm(Emitter *e, int32_t off, uint16_t v) {
+  emit8(e, 0x66);
+  emit8(e, 0xC7);
+  emit_rbx_disp(e, 0, off);
+  emit16(e, v);
+}
+
+// mov dword [rbx + off], imm32
+static void emit_store32_imm(Emitter *e, int32_t off, uint32_t v) {
+  emit8(e, 0xC7);
+  emit_rbx_disp(e, 0, off);
+  emit32(e, v);
+}
+
+// mov rax, imm64; mov qword [rbx + off], rax
+static void emit_store64_imm(Emitter *e, int32_t off, uint64_t v) {
+  emit8(e, 0x48);
+  emit8(e, 0xB8);
+  emit64(e, v);
+  emit8(e, 0x48);
+  emit8(e, 0x89);
+  emit_rbx_disp(e, REG_RAX, off);
+}
+
+// movzx eax, byte [rbx + off]
+static void emit_load8(Emitter *e, int32_t off) {
+  emit8(e, 0x0F);
+  emit8(e, 0xB6);
+  emit_rbx_disp(e, REG_RAX, off);
+}
+
+// mov byte [rbx + off], al
+static void emit_store8_al(Emitter *e, int32_t off) {
+  emit8(e, 0x88);
+  emit_rbx_disp(e, REG_RAX, off);
+}
+
+// mov word [rbx + off], ax
+static void emit_store16_ax(Emitter *e, int32_t off) {
+  emit8(e, 0x66);
+  emit8(e, 0x89);
+  emit_rbx_disp(e, REG_RAX, off);
+}
+
+// inc/dec byte [rbx + off]
+static void emit_step8(Emitter *e, int32_t off, int dec) {
+  emit8(e, 0xFE);
+  emit_rbx_disp(e, dec ? 1 : 0, off);
+}
+
+// inc dword [rbx + off]
+static void emit_inc32(Emitter *e, int32_t off) {
+  emit8(e, 0xFF);
+  emit_rbx_disp(e, 0, off);
+}
+
+// or/and byte [rbx + off], imm8
+static void emit_or8(Emitter *e, int32_t off, uint8_t v) {
+  emit8(e, 0x80);
+  emit_rbx_disp(e, 1, off);
+  emit8(e, v);
+}
+
+static void emit_and8(Emitter *e, int32_t off, uint8_t v) {
+  emit8(e, 0x80);
+  emit_rbx_disp(e, 4, off);
+  emit8(e, v);
+}
+
+// fn(cpu) or fn(cpu, arg)
+static void emit_call(Emitter *e, const void *fn, const void *arg) {
+  // mov rdi, rbx
+  emit8(e, 0x48);
+  emit8(e, 0x89);
+  emit8(e, 0xDF);
+
+  if (arg) {
+    // mov rsi, imm64
+    emit8(e, 0x48);
+    emit8(e, 0xBE);
+    emit64(e, (uint64_t)(uintptr_t)arg);
+  }
+
+  // mov rax, imm64; call rax
+  emit8(e, 0x48);
+  emit8(e, 0xB8);
+  emit64(e, (uint64_t)(uintptr_t)fn);
+  emit8(e, 0xFF);
+  emit8(e, 0xD0);
+}
+
+/* Instruction translation */
+
+// reg = src, nz = reg
+static void emit_transfer(Emitter *e, int32_t dst, int32_t src) {
+  emit_load8(e, src);
+  emit_store8_al(e, dst);
+  emit_store16_ax(e, CPU_OFF(nz));
+}
+
+// reg += 1 or reg -= 1, nz = reg
+static void emit_step(Emitter *e, int32_t reg, int dec) {
+  emit_step8(e, reg, dec);
+  emit_load8(e, reg);
+  emit_store16_ax(e, CPU_OFF(nz));
+}
+
+// Emit the instruction natively if it only touches registers and flags.
+// Returns 0 if it has to go through the interpreter handler.
+static int emit_inline(Emitter *e, const Opcode *op, const Uop *uop) {
+  if (op->instr_type == INSTR_ADDR && op->addr_mode == addr_imm) {
+    int32_t reg;
+    if (op->instr_addr == instr_LDA)
+      reg = CPU_OFF(A);
+    else if (op->instr_addr == instr_LDX)
+      reg = CPU_OFF(X);
+    else if (op->instr_addr == instr_LDY)
+      reg = CPU_OFF(Y);
+    else
+      return 0;
+
+    uint8_t val = uop->operand;
+    emit_store8_imm(e, reg, val);
+    emit_store16_imm(e, CPU_OFF(nz), val);
+    return 1;
+  }
+
+  if (op->instr_type != INSTR_NONE)
+    return 0;
+
+  InstrNone fn = op->instr_none;
+  if (fn == instr_TAX)
+    emit_transfer(e, CPU_OFF(X), CPU_OFF(A));
+  else if (fn == instr_TAY)
+    emit_transfer(e, CPU_OFF(Y), CPU_OFF(A));
+  else if (fn == instr_TXA)
+    emit_transfer(e, CPU_OFF(A), CPU_OFF(X));
+  else if (fn == instr_TYA)
+    emit_transfer(e, CPU_OFF(A), CPU_OFF(Y));
+  else if (fn == instr_TSX)
+    emit_transfer(e, CPU_OFF(X), CPU_OFF(S));
+  else if (fn == instr_TXS) {
+    emit_load8(e, CPU_OFF(X));
+    emit_store8_al(e, CPU_OFF(S));
+  } else if (fn == instr_INX)
+    emit_step(e, CPU_OFF(X), 0);
+  else if (fn == instr_DEX)
+    emit_step(e, CPU_OFF(X), 1);
+  else if (fn == instr_INY)
+    emit_step(e, CPU_OFF(Y), 0);
+  else if (fn == instr_DEY)
+    emit_step(e, CPU_OFF(Y), 1);
+  else if (fn == instr_CLC)
+    emit_and8(e, CPU_OFF(P), (uint8_t)~FLAG_C);
+  else if (fn == instr_SEC)
+    emit_or8(e, CPU_OFF(P), FLAG_C);
+  // CLI is left to its handler, it may let a pending IRQ in
+  else if (fn == instr_SEI)
+    emit_or8(e, CPU_OFF(P), FLAG_I);
+  else if (fn == instr_CLD)
+    emit_and8(e, CPU_OFF(P), (uint8_t)~FLAG_D);
+  else if (fn == instr_SED)
+    emit_or8(e, CPU_OFF(P), FLAG_D);
+  else if (fn == instr_CLV)
+    emit_and8(e, CPU_OFF(P), (uint8_t)~FLAG_V);
+  else if (fn != instr_NOP)
+    return 0;
+
+  return 1;
+}
+
+static JitBlockFn jit_compile(struct Jit *jit, const Block *block) {
+  Emitter e = {jit->code + jit->used};
+  uint8_t *start = e.p;
+  uint8_t *exits[BLOCK_MAX_UOPS];
+  int num_exits = 0;
+
+  // push rbx; mov rbx, rdi
+  emit8(&e, 0x53);
+  emit8(&e, 0x48);
+  emit8(&e, 0x89);
+  emit8(&e, 0xFB);
+
+  for (int i = 0; i < block->count; i++) {
+    const Uop *uop = &block->uops[i];
+    const Opcode *op = &lookup_table[uop->opcode];
+
+    // cpu_execute already fetched the first instruction
+    if (i > 0) {
+      emit_store8_imm(&e, CPU_OFF(instr), uop->opcode);
+      emit_inc32(&e, CPU_OFF(instr_num));
+    }
+    emit_store64_imm(&e, CPU_OFF(uop), (uint64_t)(uintptr_t)(uop + 1));
+
+    if (emit_inline(&e, op, uop)) {
+      emit_store16_imm(&e, CPU_OFF(PC), uop->pc + uop->len);
+      emit_store32_imm(&e, CPU_OFF(cycles), op->cycles);
+    } else {
+      emit_call(&e, (const void *)cpu_jit_exec_uop, uop);
+    }
+
+    emit_call(&e, (const void *)cpu_jit_retire, NULL);
+
+    // test eax, eax; jnz exit
+    emit8(&e, 0x85);
+    emit8(&e, 0xC0);
+    emit8(&e, 0x0F);
+    emit8(&e, 0x85);
+    exits[num_exits++] = e.p;
+    emit32(&e, 0);
+  }
+
+  for (int i = 0; i < num_exits; i++) {
+    int32_t rel = (int32_t)(e.p - (exits[i] + 4));
+    memcpy(exits[i], &rel, 4);
+  }
+
+  // pop rbx; ret
+  emit8(&e, 0x5B);
+  emit8(&e, 0xC3);
+
+  jit->used += e.p - start;
+  return (JitBlockFn)(void *)start;
+}
+
+// Drop every translation and start the code buffer over
+static void jit_flush(Cpu6502 *cpu) {
+  for (int i = 0; i < BLOCK_CACHE_SLOTS; i++)
+    cpu->block_cache->blocks[i].native = NULL;
+
+  cpu->jit->used = 0;
+}
+
+// Makes the pages the next block can be emitted into writable and not
+// executable, or executable again. Returns 0 if that isn't allowed.
+static int jit_unlock(struct Jit *jit, int writable) {
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t start = jit->used & ~(page - 1);
+  size_t end = jit->used + JIT_MAX_BLOCK_BYTES;
+
+  if (end > JIT_CODE_SIZE)
+    end = JIT_CODE_SIZE;
+  return mprotect(jit->code + start, end - start,
+                  writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC) ==
+         0;
+}
+
+struct Jit *jit_create(void) {
+  struct Jit *jit = calloc(1, sizeof(struct Jit));
+  if (!jit)
+    return NULL;
+
+  // Never writable and executable at once: the buffer is only executable,
+  // and the pages a block is emitted into are writable while it is (W^X)
+  jit->code = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_EXEC,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (jit->code == MAP_FAILED) {
+    free(jit);
+    return NULL;
+  }
+
+  return jit;
+}
+
+void jit_destroy(struct Jit *jit) {
+  if (!jit)
+    return;
+
+  munmap(jit->code, JIT_CODE_SIZE);
+  free(jit);
+}
+
+int jit_execute(Cpu6502 *cpu, const Uop *uop) {
+  Block *block = &cpu->block_cache->blocks[uop->pc & (BLOCK_CACHE_SLOTS - 1)];
+
+  // Only enter at the top of a block
+  if (block->uops != uop)
+    return 0;
+
+  if (!block->native) {
+    if (++block->hits < JIT_HOT_THRESHOLD)
+      return 0;
+
+    if (cpu->jit->used + JIT_MAX_BLOCK_BYTES > JIT_CODE_SIZE)
+      jit_flush(cpu);
+
+    if (!jit_unlock(cpu->jit, 1))
+      return 0;
+    block->native = (void *)jit_compile(cpu->jit, block);
+    if (!jit_unlock(cpu->jit, 0)) {
+      block->native = NULL;
+      return 0;
+    }
+  }
+
+  uint64_t start = cpu->cpu_cycle_count;
+  ((JitBlockFn)block->native)(cpu);
+
+  // Callers step the APU by the cycles of the whole block
+  cpu->cycles = cpu->cpu_cycle_count - start;
+  return 1;
+}
+
+#else
+
+struct Jit *jit_create(void) { return NULL; }
+
+void jit_destroy(struct Jit *jit) { (void)jit; }
+
+int jit_execute(Cpu6502 *cpu, const Uop *uop) {
+  (void)cpu;
+  (void)uop;
+  return 0;
+}
+
+#endif
@@ -0,0 +1,358 @@
+#include "cpu/profile.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Entries listed in each table of the report
+#define PROFILE_REPORT_ROWS 32
+
+// One distinct call stack, a node in a tree rooted at the entry point
+typedef struct ProfileNode {
+  uint16_t addr;
+  uint8_t kind;
+  int parent;
+  int child;   // First child
+  int sibling; // Next child of the same parent
+  uint64_t cycles;
+} ProfileNode;
+
+typedef struct ProfileFrame {
+  int node;
+  uint16_t entry;
+  uint16_t site; // PC of the JSR that made the call
+  uint8_t kind;
+  uint8_t sp;
+  uint64_t start; // Cycles retired when the frame was entered
+} ProfileFrame;
+
+struct Profile {
+  FILE *file;
+  int per_frame;
+  int frame;
+
+  uint64_t total; // Cycles retired since profiling started
+  uint16_t pc;    // Instruction being retired
+
+  // Call or return made by the instruction being retired
+  enum { PENDING_NONE, PENDING_CALL, PENDING_RETURN } pending;
+  uint8_t pending_kind;
+  uint16_t pending_target;
+  uint8_t pending_sp;
+
+  // Shadow call stack, stack[0] is the entry point and never returns
+  ProfileFrame stack[PROFILE_MAX_DEPTH];
+  int depth;
+
+  ProfileNode *nodes;
+  int num_nodes;
+  int max_nodes;
+
+  // Frames of each subroutine, and of calls from each JSR, on the stack.
+  // Recursion is only counted once.
+  uint16_t active[0x10000];
+  uint16_t site_active[0x10000];
+
+  uint64_t self[0x10000];
+  uint64_t incl[0x10000];
+  uint64_t sub_self[0x10000];
+  uint64_t sub_incl[0x10000];
+  uint32_t sub_calls[0x10000];
+};
+
+/* Call stack */
+
+static int node_child(struct Profile *profile, int parent, uint16_t addr,
+                      uint8_t kind) {
+  int first = parent >= 0 ? profile->nodes[parent].child : -1;
+
+  for (int i = first; i >= 0; i = profile->nodes[i].sibling) {
+    if (profile->nodes[i].addr == addr && profile->nodes[i].kind == kind)
+      return i;
+  }
+
+  if (profile->num_nodes == profile->max_nodes) {
+    int max_nodes = profile->max_nodes ? profile->max_nodes * 2 : 1024;
+    ProfileNode *nodes =
+        realloc(profile->nodes, max_nodes * sizeof(ProfileNode));
+    if (!nodes)
+      return parent;
+
+    profile->nodes = nodes;
+    profile->max_nodes = max_nodes;
+  }
+
+  int i = profile->num_nodes++;
+  profile->nodes[i] = (ProfileNode){
+      .addr = addr,
+      .kind = kind,
+      .parent = parent,
+      .child = -1,
+      .sibling = first,
+  };
+
+  if (parent >= 0)
+    profile->nodes[parent].child = i;
+
+  return i;
+}
+
+static void push_frame(struct Profile *profile, uint8_t kind, uint16_t target,
+                       uint8_t sp) {
+  // Too deep to be real calls, most likely code that never returns
+  if (profile->depth == PROFILE_MAX_DEPTH)
+    return;
+
+  ProfileFrame *top = &profile->stack[profile->depth - 1];
+  profile->stack[profile->depth++] = (ProfileFrame){
+      .node = node_child(profile, top->node, target, kind),
+      .entry = target,
+      .site = profile->pc,
+      .kind = kind,
+      .sp = sp,
+      .start = profile->total,
+  };
+
+  profile->active[target]++;
+  profile->sub_calls[target]++;
+
+  // Interrupts don't belong to the instruction they cut in after
+  if (kind == PROFILE_CALL)
+    profile->site_active[profile->pc]++;
+}
+
+static void pop_frames(struct Profile *profile, uint8_t sp) {
+  while (profile->depth > 1 && profile->stack[profile->depth - 1].sp <= sp) {
+    ProfileFrame *frame = &profile->stack[--profile->depth];
+    uint64_t cycles = profile->total - frame->start;
+
+    if (--profile->active[frame->entry] == 0)
+      profile->sub_incl[frame->entry] += cycles;
+
+    if (frame->kind == PROFILE_CALL && --profile->site_active[frame->site] == 0)
+      profile->incl[frame->site] += cycles;
+  }
+}
+
+/* Hooks */
+
+struct Profile *profile_open(const char *filename, uint16_t entry,
+                             int per_frame) {
+  struct Profile *profile = calloc(1, sizeof(struct Profile));
+  if (!profile)
+    return NULL;
+
+  profile->file = fopen(filename, "w");
+  if (!profile->file) {
+    free(profile);
+    return NULL;
+  }
+
+  profile->per_frame = per_frame;
+
+  int root = node_child(profile, -1, entry, PROFILE_RESET);
+  if (root < 0) {
+    fclose(profile->file);
+    free(profile);
+    return NULL;
+  }
+
+  profile->stack[0] = (ProfileFrame){
+      .node = root,
+      .entry = entry,
+      .kind = PROFILE_RESET,
+  };
+  profile->depth = 1;
+  profile->active[entry] = 1;
+  profile->sub_calls[entry] = 1;
+
+  return profile;
+}
+
+void profile_begin(struct Profile *profile, uint16_t pc) { profile->pc = pc; }
+
+void profile_retire(struct Profile *profile, int cycles) {
+  ProfileFrame *top = &profile->stack[profile->depth - 1];
+
+  profile->total += cycles;
+  profile->self[profile->pc] += cycles;
+  profile->incl[profile->pc] += cycles;
+  profile->sub_self[top->entry] += cycles;
+  profile->nodes[top->node].cycles += cycles;
+
+  if (profile->pending == PENDING_CALL)
+    push_frame(profile, profile->pending_kind, profile->pending_target,
+               profile->pending_sp);
+  else if (profile->pending == PENDING_RETURN)
+    pop_frames(profile, profile->pending_sp);
+
+  profile->pending = PENDING_NONE;
+}
+
+void profile_call(struct Profile *profile, ProfileKind kind, uint16_t target,
+                  uint8_t sp) {
+  profile->pending = PENDING_CALL;
+  profile->pending_kind = kind;
+  profile->pending_target = target;
+  profile->pending_sp = sp;
+}
+
+void profile_return(struct Profile *profile, uint8_t sp) {
+  profile->pending = PENDING_RETURN;
+  profile->pending_sp = sp;
+}
+
+void profile_interrupt(struct Profile *profile, ProfileKind kind,
+                       uint16_t target, uint8_t sp) {
+  push_frame(profile, kind, target, sp);
+}
+
+/* Folded stacks */
+
+static void write_name(FILE *out, const ProfileNode *node) {
+  static const char *prefix[] = {
+      [PROFILE_RESET] = "reset", [PROFILE_CALL] = "sub",
+      [PROFILE_NMI] = "nmi",     [PROFILE_IRQ] = "irq",
+      [PROFILE_BRK] = "brk",
+  };
+
+  fprintf(out, "%s_%04X", prefix[node->kind], node->addr);
+}
+
+// One line per call stack that retired cycles, then clears the counts
+static void write_folded(struct Profile *profile, const char *root) {
+  int path[PROFILE_MAX_DEPTH + 1];
+
+  for (int i = 0; i < profile->num_nodes; i++) {
+    ProfileNode *node = &profile->nodes[i];
+    if (!node->cycles)
+      continue;
+
+    int len = 0;
+    for (int n = i; n >= 0 && len <= PROFILE_MAX_DEPTH;
+         n = profile->nodes[n].parent)
+      path[len++] = n;
+
+    if (root)
+      fprintf(profile->file, "%s;", root);
+
+    while (len--) {
+      write_name(profile->file, &profile->nodes[path[len]]);
+      fputc(len ? ';' : ' ', profile->file);
+    }
+    fprintf(profile->file, "%llu\n", (unsigned long long)node->cycles);
+
+    node->cycles = 0;
+  }
+}
+
+void profile_frame(struct Profile *profile) {
+  if (profile->per_frame) {
+    char root[32];
+    snprintf(root, sizeof(root), "frame_%d", profile->frame);
+    write_folded(profile, root);
+  }
+
+  profile->frame++;
+}
+
+void profile_close(struct Profile *profile) {
+  if (!profile)
+    return;
+
+  // The last frame is cut short
+  if (profile->per_frame)
+    profile_frame(profile);
+  else
+    write_folded(profile, NULL);
+
+  fclose(profile->file);
+  free(profile->nodes);
+  free(profile);
+}
+
+/* Report */
+
+typedef struct ProfileRow {
+  uint16_t addr;
+  uint64_t key;
+} ProfileRow;
+
+static int row_cmp(const void *a, const void *b) {
+  const ProfileRow *x = a, *y = b;
+  if (x->key != y->key)
+    return x->key < y->key ? 1 : -1;
+  return x->addr - y->addr;
+}
+
+// Nonzero entries of values, largest first. Returns how many there are.
+static int top_rows(const uint64_t *values, ProfileRow *rows) {
+  int n = 0;
+
+  for (int addr = 0; addr < 0x10000; addr++) {
+    if (values[addr])
+      rows[n++] = (ProfileRow){addr, values[addr]};
+  }
+
+  qsort(rows, n, sizeof(ProfileRow), row_cmp);
+  return n < PROFILE_REPORT_ROWS ? n : PROFILE_REPORT_ROWS;
+}
+
+static double percent(uint64_t cycles, uint64_t total) {
+  return total ? 100.0 * cycles / total : 0.0;
+}
+
+void profile_write_report(struct Profile *profile, FILE *out) {
+  uint64_t *sub_incl = malloc(0x10000 * sizeof(uint64_t));
+  ProfileRow *rows = malloc(0x10000 * sizeof(ProfileRow));
+  uint64_t total = profile->total;
+
+  if (!sub_incl || !rows) {
+    fprintf(out, "Not enough memory for the profile report\n");
+    free(sub_incl);
+    free(rows);
+    return;
+  }
+
+  // Frames still on the stack count up to now, each subroutine once
+  memcpy(sub_incl, profile->sub_incl, 0x10000 * sizeof(uint64_t));
+  for (int i = 0; i < profile->depth; i++) {
+    ProfileFrame *frame = &profile->stack[i];
+    int outermost = 1;
+
+    for (int j = 0; j < i; j++) {
+      if (profile->stack[j].entry == frame->entry)
+        outermost = 0;
+    }
+
+    if (outermost)
+      sub_incl[frame->entry] += total - frame->start;
+  }
+
+  fprintf(out, "%llu cycles over %d frames\n\n", (unsigned long long)total,
+          profile->frame);
+
+  fprintf(out, "  PC    self cycles   self%%   incl cycles   incl%%\n");
+  int n = top_rows(profile->self, rows);
+  for (int i = 0; i < n; i++) {
+    uint16_t pc = rows[i].addr;
+    fprintf(out, "  %04X %12llu %6.2f%% %12llu %6.2f%%\n", pc,
+            (unsigned long long)profile->self[pc],
+            percent(profile->self[pc], total),
+            (unsigned long long)profile->incl[pc],
+            percent(profile->incl[pc], total));
+  }
+
+  fprintf(out, "\n  Sub   incl cycles   incl%%   self cycles   self%%      "
+               "calls\n");
+  n = top_rows(sub_incl, rows);
+  for (int i = 0; i < n; i++) {
+    uint16_t sub = rows[i].addr;
+    fprintf(out, "  %04X %12llu %6.2f%% %12llu %6.2f%% %10u\n", sub,
+            (unsigned long long)sub_incl[sub], percent(sub_incl[sub], total),
+            (unsigned long long)profile->sub_self[sub],
+            percent(profile->sub_self[sub], total), profile->sub_calls[sub]);
+  }
+
+  free(sub_incl);
+  free(rows);
+}
@@ -0,0 +1,107 @@
+#include "cpu/stats.h"
+#include "cpu/cpu.h"
+#include "cpu/opcodes.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Width of the longest bar in the histograms
+#define STATS_BAR_WIDTH 40
+
+#define X(op, type, mode, fn, cyc, pcyc, mn) [op] = #type "/" #mode,
+
+// Operand kind and addressing mode of each opcode, "VAL/addr_abs_X"
+static const char *const mode_keys[256] = {CPU_OPCODES(X)};
+
+#undef X
+
+// Short name for a mode key: "abs_X", or "acc" and "impl" when there is no
+// addressing mode (branches and BRK fetch their own operand)
+static const char *mode_name(const char *key, char *buf, size_t size) {
+  const char *mode = strchr(key, '/') + 1;
+
+  if (!strncmp(mode, "addr_", 5)) {
+    snprintf(buf, size, "%s", mode + 5);
+    return buf;
+  }
+
+  return !strncmp(key, "ACC", 3) ? "acc" : "impl";
+}
+
+typedef struct StatsRow {
+  char name[16];
+  uint64_t executed;
+  uint64_t page_crossed;
+  uint64_t branch_taken;
+} StatsRow;
+
+static int row_cmp(const void *a, const void *b) {
+  const StatsRow *x = a, *y = b;
+  if (x->executed != y->executed)
+    return x->executed < y->executed ? 1 : -1;
+  return strcmp(x->name, y->name);
+}
+
+static void write_rows(StatsRow *rows, int n, uint64_t total, FILE *out) {
+  qsort(rows, n, sizeof(StatsRow), row_cmp);
+
+  for (int i = 0; i < n; i++) {
+    StatsRow *row = &rows[i];
+    int bar = rows[0].executed
+                  ? (int)(row->executed * STATS_BAR_WIDTH / rows[0].executed)
+                  : 0;
+
+    fprintf(out, "  %-12s %14llu %6.2f%% %12llu %12llu  %.*s\n", row->name,
+            (unsigned long long)row->executed, 100.0 * row->executed / total,
+            (unsigned long long)row->page_crossed,
+            (unsigned long long)row->branch_taken, bar,
+            "########################################");
+  }
+}
+
+void cpu_stats_write(const CpuStats *stats, FILE *out) {
+  StatsRow ops[256], modes[256];
+  int num_ops = 0, num_modes = 0;
+  uint64_t total = 0;
+
+  for (int op = 0; op < 256; op++) {
+    if (!stats->executed[op])
+      continue;
+
+    total += stats->executed[op];
+    StatsRow *row = &ops[num_ops++];
+    *row = (StatsRow){
+        .executed = stats->executed[op],
+        .page_crossed = stats->page_crossed[op],
+        .branch_taken = stats->branch_taken[op],
+    };
+    snprintf(row->name, sizeof(row->name), "%s", lookup_table[op].mnemonic);
+
+    char buf[16];
+    const char *name = mode_name(mode_keys[op], buf, sizeof(buf));
+    int i;
+    for (i = 0; i < num_modes && strcmp(modes[i].name, name); i++)
+      ;
+
+    if (i == num_modes) {
+      modes[num_modes++] = (StatsRow){0};
+      snprintf(modes[i].name, sizeof(modes[i].name), "%s", name);
+    }
+
+    modes[i].executed += stats->executed[op];
+    modes[i].page_crossed += stats->page_crossed[op];
+    modes[i].branch_taken += stats->branch_taken[op];
+  }
+
+  fprintf(out, "%llu instructions\n\n", (unsigned long long)total);
+  if (!total)
+    return;
+
+  fprintf(out, "  %-12s %14s %7s %12s %12s\n", "Opcode", "executed", "",
+          "page cross", "taken");
+  write_rows(ops, num_ops, total, out);
+
+  fprintf(out, "\n  %-12s %14s %7s %12s %12s\n", "Mode", "executed", "",
+          "page cross", "taken");
+  write_rows(modes, num_modes, total, out);
+}
@@ -0,0 +1,332 @@
+#include "cpu/trace.h"
+#include "ppu.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Encoded output is written once this much has built up
+#define TRACE_OUT_SIZE (1 << 20)
+
+// Longest encoded record: mask, two varints, code, registers, position
+#define TRACE_MAX_ENCODED (1 + 3 + 5 + 3 + 5 + 4)
+
+struct Trace {
+  TraceRecord ring[TRACE_RING_SIZE];
+
+  // head is only written by the CPU thread, tail only by the writer
+  atomic_uint head;
+  atomic_uint tail;
+
+  pthread_mutex_t lock;
+  pthread_cond_t ready; // Records to drain, or closing
+  pthread_cond_t space; // The writer freed slots
+  int closing;
+  pthread_t thread;
+
+  FILE *file;
+
+  // Encoder state, owned by the writer thread
+  TraceRecord prev;
+  uint8_t code[0x10000][3];
+  uint8_t out[TRACE_OUT_SIZE];
+  size_t out_len;
+};
+
+/* Encoding, shared by the writer and the reader */
+
+// Where the PPU would be after the given number of CPU cycles
+static void advance_pos(const TraceRecord *prev, uint32_t cycles,
+                        int16_t *scanline, uint16_t *dot) {
+  uint64_t frame_dots = NUM_SCANLINES * NUM_DOTS;
+  uint64_t pos = (uint64_t)(prev->scanline + 1) * NUM_DOTS + prev->dot;
+
+  pos = (pos + (uint64_t)cycles * 3) % frame_dots;
+  *scanline = pos / NUM_DOTS - 1;
+  *dot = pos % NUM_DOTS;
+}
+
+static uint8_t *put_varint(uint8_t *p, uint32_t v) {
+  while (v >= 0x80) {
+    *p++ = (v & 0x7F) | 0x80;
+    v >>= 7;
+  }
+  *p++ = v;
+  return p;
+}
+
+static size_t encode(struct Trace *trace, const TraceRecord *r, uint8_t *out) {
+  TraceRecord *prev = &trace->prev;
+  uint8_t *code = trace->code[r->pc];
+  uint8_t *p = out + 1;
+  uint8_t mask = 0;
+
+  int16_t pc_delta = r->pc - prev->pc;
+  uint32_t cycles = r->cycle - prev->cycle;
+
+  // Zigzag so short backward jumps stay small
+  uint16_t zigzag = (uint16_t)pc_delta << 1;
+  p = put_varint(p, pc_delta < 0 ? (uint16_t)~zigzag : zigzag);
+  p = put_varint(p, cycles);
+
+  if (code[0] != r->opcode || code[1] != r->operand[0] ||
+      code[2] != r->operand[1]) {
+    mask |= TRACE_CODE;
+    code[0] = *p++ = r->opcode;
+    code[1] = *p++ = r->operand[0];
+    code[2] = *p++ = r->operand[1];
+  }
+
+  if (r->a != prev->a) {
+    mask |= TRACE_A;
+    *p++ = r->a;
+  }
+  if (r->x != prev->x) {
+    mask |= TRACE_X;
+    *p++ = r->x;
+  }
+  if (r->y != prev->y) {
+    mask |= TRACE_Y;
+    *p++ = r->y;
+  }
+  if (r->s != prev->s) {
+    mask |= TRACE_S;
+    *p++ = r->s;
+  }
+  if (r->p != prev->p) {
+    mask |= TRACE_P;
+    *p++ = r->p;
+  }
+
+  int16_t scanline;
+  uint16_t dot;
+  advance_pos(prev, cycles, &scanline, &dot);
+  if (scanline != r->scanline || dot != r->dot) {
+    mask |= TRACE_POS;
+    *p++ = r->scanline & 0xFF;
+    *p++ = (uint16_t)r->scanline >> 8;
+    *p++ = r->dot & 0xFF;
+    *p++ = r->dot >> 8;
+  }
+
+  out[0] = mask;
+  *prev = *r;
+  return p - out;
+}
+
+/* Writer thread */
+
+static void flush_out(struct Trace *trace) {
+  fwrite(trace->out, 1, trace->out_len, trace->file);
+  trace->out_len = 0;
+}
+
+static void *writer_main(void *arg) {
+  struct Trace *trace = arg;
+
+  for (;;) {
+    pthread_mutex_lock(&trace->lock);
+    while (!trace->closing &&
+           atomic_load(&trace->head) - atomic_load(&trace->tail) < TRACE_BATCH)
+      pthread_cond_wait(&trace->ready, &trace->lock);
+    int closing = trace->closing;
+    pthread_mutex_unlock(&trace->lock);
+
+    unsigned head = atomic_load_explicit(&trace->head, memory_order_acquire);
+    unsigned tail = atomic_load_explicit(&trace->tail, memory_order_relaxed);
+
+    for (; tail != head; tail++) {
+      if (trace->out_len + TRACE_MAX_ENCODED > TRACE_OUT_SIZE)
+        flush_out(trace);
+
+      const TraceRecord *r = &trace->ring[tail & (TRACE_RING_SIZE - 1)];
+      trace->out_len += encode(trace, r, trace->out + trace->out_len);
+    }
+
+    atomic_store_explicit(&trace->tail, tail, memory_order_release);
+
+    pthread_mutex_lock(&trace->lock);
+    pthread_cond_signal(&trace->space);
+    pthread_mutex_unlock(&trace->lock);
+
+    if (closing)
+      break;
+  }
+
+  flush_out(trace);
+  return NULL;
+}
+
+struct Trace *trace_open(const char *filename) {
+  struct Trace *trace = calloc(1, sizeof(struct Trace));
+  if (!trace)
+    return NULL;
+
+  trace->file = fopen(filename, "wb");
+  if (!trace->file) {
+    free(trace);
+    return NULL;
+  }
+
+  fwrite(TRACE_MAGIC, 1, TRACE_MAGIC_SIZE, trace->file);
+
+  pthread_mutex_init(&trace->lock, NULL);
+  pthread_cond_init(&trace->ready, NULL);
+  pthread_cond_init(&trace->space, NULL);
+
+  if (pthread_create(&trace->thread, NULL, writer_main, trace) != 0) {
+    fclose(trace->file);
+    free(trace);
+    return NULL;
+  }
+
+  return trace;
+}
+
+void trace_close(struct Trace *trace) {
+  if (!trace)
+    return;
+
+  pthread_mutex_lock(&trace->lock);
+  trace->closing = 1;
+  pthread_cond_signal(&trace->ready);
+  pthread_mutex_unlock(&trace->lock);
+
+  pthread_join(trace->thread, NULL);
+  fclose(trace->file);
+
+  pthread_mutex_destroy(&trace->lock);
+  pthread_cond_destroy(&trace->ready);
+  pthread_cond_destroy(&trace->space);
+  free(trace);
+}
+
+/* CPU side */
+
+void trace_push(struct Trace *trace, const TraceRecord *record) {
+  unsigned head = atomic_load_explicit(&trace->head, memory_order_relaxed);
+
+  if (head - atomic_load_explicit(&trace->tail, memory_order_acquire) ==
+      TRACE_RING_SIZE) {
+    // Ring full, wait for the writer to catch up
+    pthread_mutex_lock(&trace->lock);
+    while (head - atomic_load(&trace->tail) == TRACE_RING_SIZE) {
+      pthread_cond_signal(&trace->ready);
+      pthread_cond_wait(&trace->space, &trace->lock);
+    }
+    pthread_mutex_unlock(&trace->lock);
+  }
+
+  trace->ring[head & (TRACE_RING_SIZE - 1)] = *record;
+  atomic_store_explicit(&trace->head, head + 1, memory_order_release);
+
+  if ((head + 1) % TRACE_BATCH == 0) {
+    pthread_mutex_lock(&trace->lock);
+    pthread_cond_signal(&trace->ready);
+    pthread_mutex_unlock(&trace->lock);
+  }
+}
+
+/* Reader */
+
+int trace_reader_open(TraceReader *reader, const char *filename) {
+  char magic[TRACE_MAGIC_SIZE];
+
+  memset(reader, 0, sizeof(TraceReader));
+  reader->file = fopen(filename, "rb");
+  if (!reader->file)
+    return 0;
+
+  if (fread(magic, 1, TRACE_MAGIC_SIZE, reader->file) != TRACE_MAGIC_SIZE ||
+      memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_SIZE) != 0) {
+    fclose(reader->file);
+    reader->file = NULL;
+    return 0;
+  }
+
+  return 1;
+}
+
+void trace_reader_close(TraceReader *reader) {
+  if (reader->file)
+    fclose(reader->file);
+  reader->file = NULL;
+}
+
+static int get_byte(TraceReader *reader, uint8_t *out) {
+  int c = getc(reader->file);
+  if (c == EOF)
+    return 0;
+
+  *out = c;
+  return 1;
+}
+
+static int get_varint(TraceReader *reader, uint32_t *out) {
+  uint32_t v = 0;
+  uint8_t b;
+
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (!get_byte(reader, &b))
+      return 0;
+
+    v |= (uint32_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) {
+      *out = v;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+int trace_read(TraceReader *reader, TraceRecord *record) {
+  TraceRecord *prev = &reader->prev;
+  uint8_t mask;
+  uint32_t zigzag, cycles;
+
+  if (!get_byte(reader, &mask) || !get_varint(reader, &zigzag) ||
+      !get_varint(reader, &cycles))
+    return 0;
+
+  *record = *prev;
+  record->pc = prev->pc + (int16_t)((zigzag >> 1) ^ -(zigzag & 1));
+  record->cycle = prev->cycle + cycles;
+
+  uint8_t *code = reader->code[record->pc];
+  if (mask & TRACE_CODE) {
+    if (!get_byte(reader, &code[0]) || !get_byte(reader, &code[1]) ||
+        !get_byte(reader, &code[2]))
+      return 0;
+  }
+  record->opcode = code[0];
+  record->operand[0] = code[1];
+  record->operand[1] = code[2];
+
+  if ((mask & TRACE_A) && !get_byte(reader, &record->a))
+    return 0;
+  if ((mask & TRACE_X) && !get_byte(reader, &record->x))
+    return 0;
+  if ((mask & TRACE_Y) && !get_byte(reader, &record->y))
+    return 0;
+  if ((mask & TRACE_S) && !get_byte(reader, &record->s))
+    return 0;
+  if ((mask & TRACE_P) && !get_byte(reader, &record->p))
+    return 0;
+
+  if (mask & TRACE_POS) {
+    uint8_t b[4];
+    for (int i = 0; i < 4; i++) {
+      if (!get_byte(reader, &b[i]))
+        return 0;
+    }
+    record->scanline = (int16_t)(b[0] | b[1] << 8);
+    record->dot = b[2] | b[3] << 8;
+  } else {
+    advance_pos(prev, cycles, &record->scanline, &record->dot);
+  }
+
+  *prev = *record;
+  return 1;
+}
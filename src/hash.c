@@ -0,0 +1,144 @@
+#include "hash.h"
+
+#include <pthread.h>
+#include <string.h>
+
+/* CRC-32 */
+
+// Slicing-by-8: crc_table[k][b] is the CRC of byte b followed by k zero
+// bytes, so eight bytes are folded in with eight independent lookups
+// instead of eight dependent ones
+static uint32_t crc_table[8][256];
+static pthread_once_t crc_table_once = PTHREAD_ONCE_INIT;
+
+static void crc_table_init(void) {
+  for (int b = 0; b < 256; b++) {
+    uint32_t crc = b;
+    for (int bit = 0; bit < 8; bit++)
+      crc = crc & 1 ? crc >> 1 ^ 0xEDB88320 : crc >> 1;
+    crc_table[0][b] = crc;
+  }
+
+  for (int k = 1; k < 8; k++) {
+    for (int b = 0; b < 256; b++) {
+      uint32_t crc = crc_table[k - 1][b];
+      crc_table[k][b] = crc >> 8 ^ crc_table[0][crc & 0xFF];
+    }
+  }
+}
+
+static uint32_t load_le32(const uint8_t *p) {
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+uint32_t crc32_update(uint32_t crc, const void *data, size_t size) {
+  const uint8_t *p = data;
+
+  pthread_once(&crc_table_once, crc_table_init);
+
+  crc = ~crc;
+  for (; size >= 8; p += 8, size -= 8) {
+    uint32_t lo = crc ^ load_le32(p);
+    uint32_t hi = load_le32(p + 4);
+
+    crc = crc_table[7][lo & 0xFF] ^ crc_table[6][lo >> 8 & 0xFF] ^
+          crc_table[5][lo >> 16 & 0xFF] ^ crc_table[4][lo >> 24] ^
+          crc_table[3][hi & 0xFF] ^ crc_table[2][hi >> 8 & 0xFF] ^
+          crc_table[1][hi >> 16 & 0xFF] ^ crc_table[0][hi >> 24];
+  }
+  for (; size; p++, size--)
+    crc = crc >> 8 ^ crc_table[0][(crc ^ *p) & 0xFF];
+  return ~crc;
+}
+
+/* SHA-1 */
+
+static uint32_t rol(uint32_t x, int n) { return x << n | x >> (32 - n); }
+
+static void sha1_block(Sha1 *sha1, const uint8_t *block) {
+  uint32_t w[80];
+
+  for (int i = 0; i < 16; i++)
+    w[i] = (uint32_t)block[i * 4] << 24 | block[i * 4 + 1] << 16 |
+           block[i * 4 + 2] << 8 | block[i * 4 + 3];
+  for (int i = 16; i < 80; i++)
+    w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+  uint32_t a = sha1->h[0], b = sha1->h[1], c = sha1->h[2], d = sha1->h[3],
+           e = sha1->h[4];
+
+  for (int i = 0; i < 80; i++) {
+    uint32_t f, k;
+    if (i < 20) {
+      f = (b & c) | (~b & d);
+      k = 0x5A827999;
+    } else if (i < 40) {
+      f = b ^ c ^ d;
+      k = 0x6ED9EBA1;
+    } else if (i < 60) {
+      f = (b & c) | (b & d) | (c & d);
+      k = 0x8F1BBCDC;
+    } else {
+      f = b ^ c ^ d;
+      k = 0xCA62C1D6;
+    }
+
+    uint32_t t = rol(a, 5) + f + e + k + w[i];
+    e = d;
+    d = c;
+    c = rol(b, 30);
+    b = a;
+    a = t;
+  }
+
+  sha1->h[0] += a;
+  sha1->h[1] += b;
+  sha1->h[2] += c;
+  sha1->h[3] += d;
+  sha1->h[4] += e;
+}
+
+void sha1_init(Sha1 *sha1) {
+  sha1->h[0] = 0x67452301;
+  sha1->h[1] = 0xEFCDAB89;
+  sha1->h[2] = 0x98BADCFE;
+  sha1->h[3] = 0x10325476;
+  sha1->h[4] = 0xC3D2E1F0;
+  sha1->size = 0;
+}
+
+void sha1_update(Sha1 *sha1, const void *data, size_t size) {
+  const uint8_t *p = data;
+  size_t used = sha1->size % 64;
+
+  sha1->size += size;
+
+  // Top up a partial block first, then hash whole blocks where they are
+  if (used) {
+    size_t n = size < 64 - used ? size : 64 - used;
+    memcpy(sha1->block + used, p, n);
+    p += n;
+    size -= n;
+    if (used + n < 64)
+      return;
+    sha1_block(sha1, sha1->block);
+  }
+
+  for (; size >= 64; p += 64, size -= 64)
+    sha1_block(sha1, p);
+  memcpy(sha1->block, p, size);
+}
+
+void sha1_final(Sha1 *sha1, uint8_t digest[SHA1_SIZE]) {
+  uint64_t bits = sha1->size * 8;
+  uint8_t pad[72] = {0x80};
+
+  // A 1 bit, zeros up to 8 bytes short of a block, then the length in bits
+  size_t pad_size = (sha1->size % 64 < 56 ? 56 : 120) - sha1->size % 64;
+  for (int i = 0; i < 8; i++)
+    pad[pad_size + i] = bits >> (56 - i * 8);
+  sha1_update(sha1, pad, pad_size + 8);
+
+  for (int i = 0; i < SHA1_SIZE; i++)
+    digest[i] = sha1->h[i / 4] >> (24 - i % 4 * 8);
+}
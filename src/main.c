@@ -1,22 +1,35 @@
 #include <SDL2/SDL.h>
+#include <signal.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "apu/apu.h"
 #include "apu/apu_mmio.h"
+#include "cdl.h"
 #include "config.h"
+#include "cpu/cheat.h"
 #include "cpu/cpu.h"
+#include "cpu/debug.h"
+#include "cpu/jit.h"
+#include "cpu/profile.h"
+#include "cpu/recomp.h"
+#include "cpu/stats.h"
+#include "cpu/trace.h"
 #include "frontend.h"
+#include "mapper/mapper.h"
 #include "ppu.h"
 #include "rom.h"
+#include "scheduler.h"
 
 #define CPU_CLOCK_HZ 1789773.0
 #define APU_CLOCK_HZ (CPU_CLOCK_HZ / 2.0) // APU ticks at half CPU rate
 #define AUDIO_SAMPLE_RATE 44100.0
 
-void load_ppu_palette(char *filename) {
+void load_ppu_palette(PPU *ppu, char *filename) {
   FILE *pal = fopen(filename, "rb");
 
   if (!pal) {
@@ -29,7 +42,86 @@ void load_ppu_palette(char *filename) {
   fread(palette, 1, 192, pal);
   fclose(pal);
 
-  load_palette(palette);
+  load_palette(ppu, palette);
+}
+
+// The APU runs behind the CPU and is brought up to the master clock in
+// batches: before a register write, at frame counter steps and once a frame
+typedef struct ApuClock {
+  APU *apu;
+  Scheduler *sched;
+  uint64_t time; // Master clock the APU has been run up to
+
+  double apu_accumulator;
+  double sample_accumulator;
+} ApuClock;
+
+static void apu_sync(void *ctx) {
+  ApuClock *clock = ctx;
+  double apu_ticks_per_sample = CPU_CLOCK_HZ / AUDIO_SAMPLE_RATE;
+
+  // One APU step per CPU cycle
+  for (; clock->time < clock->sched->now; clock->time += 3) {
+    apu_execute(clock->apu);
+
+    clock->sample_accumulator += apu_output(clock->apu);
+    clock->apu_accumulator += 1.0;
+
+    if (clock->apu_accumulator >= apu_ticks_per_sample) {
+      clock->apu_accumulator -= apu_ticks_per_sample;
+
+      int16_t sample =
+          ((int)(clock->sample_accumulator / apu_ticks_per_sample) - 8) * 4096;
+
+      audio_buffer_add(sample);
+
+      clock->sample_accumulator = 0.0;
+    }
+  }
+
+  int cycles = apu_cycles_until_frame_step(clock->apu);
+  if (cycles > 0)
+    sched_schedule(clock->sched, SCHED_APU_FRAME, clock->time + cycles * 3);
+  else
+    sched_cancel(clock->sched, SCHED_APU_FRAME);
+
+  // The CPU only hears the IRQ once the APU has been run up to it
+  cycles = apu_cycles_until_frame_irq(clock->apu);
+  if (cycles > 0)
+    sched_schedule(clock->sched, SCHED_APU_IRQ, clock->time + cycles * 3);
+  else
+    sched_cancel(clock->sched, SCHED_APU_IRQ);
+}
+
+static int apu_on_frame_step(void *ctx, uint64_t time) {
+  (void)time;
+  apu_sync(ctx);
+  return 0;
+}
+
+#if CPU_STATS
+// Set by SIGUSR1, the opcode counters are printed at the end of the frame
+static volatile sig_atomic_t stats_requested;
+
+static void request_stats(int sig) {
+  (void)sig;
+  stats_requested = 1;
+}
+#endif
+
+// Only lists the options this build has
+static void usage(const char *prog) {
+  printf("Usage: %s <path-to-rom> [--trace trace-file]", prog);
+#if CPU_PROFILE
+  printf(" [--profile|--profile-frames out.folded]");
+#endif
+#if NES_CDL
+  printf(" [--cdl game.cdl]");
+#endif
+#if NES_DEBUGGER
+  printf(" [--debug]");
+#endif
+  printf(" [--cheat CODE] [--cheats file]\n");
 }
 
 int main(int argc, char *argv[]) {
@@ -44,62 +136,162 @@ int main(int argc, char *argv[]) {
 
   Frontend_Init(&frontend, SCREEN_WIDTH_VIS, SCREEN_HEIGHT_VIS, SCALE);
 
-#if NES_TEST_ROM == 1
-  rom_load_cartridge(&rom, "rom/nestest.nes");
-#elif NES_TEST_ROM == 2
-  if (rom_load_cartridge(&rom, "rom/official.nes") != 0) {
-    printf("ROM LOAD FAILED\n");
-  }
-#else
   if (argc < 2) {
-    printf("No ROM file specified. Usage: %s <path-to-rom>\n", argv[0]);
+    printf("No ROM file specified. ");
+    usage(argv[0]);
+    return 1;
+  }
+  if (rom_load_cartridge(&rom, argv[1]) != ROM_OK) {
+    printf("Failed to load %s\n", argv[1]);
     return 1;
   }
-  rom_load_cartridge(&rom, argv[1]);
+  if (rom.title)
+    printf("%s\n", rom.title);
   // rom_load_cartridge(&rom, "rom/Donkey Kong.nes");
   //  rom_load_cartridge(&rom, "rom/Ice_Climber.nes");
-#endif
   load_cpu_memory(&cpu, rom.prg_data, rom.prg_size);
 
-  load_ppu_ines_header(rom.header);
+  load_ppu_ines_header(&ppu, rom.header);
   load_ppu_memory(&ppu, rom.chr_data, rom.chr_size);
-  load_ppu_palette("palette/2C02G_wiki.pal");
+  load_ppu_palette(&ppu, "palette/2C02G_wiki.pal");
 
   ppu_init(&ppu);
   cpu.ppu = &ppu;
+  if (!mapper_attach(&cpu, &rom)) {
+    char error[64];
+    mapper_error(&rom, error, sizeof(error));
+    printf("%s\n", error);
+    return 1;
+  }
   cpu_init(&cpu);
+#if CPU_JIT
+  cpu.jit = jit_create();
+#endif
+#if CPU_RECOMP
+  if (!recomp_attach(&cpu))
+    printf("Recompiled code was built from a different ROM, ignoring it\n");
+#endif
+#if NES_CDL
+  Cdl *cdl = NULL;
+  const char *cdl_file = NULL;
+#endif
+  for (int i = 2; i < argc; i++) {
+#if NES_DEBUGGER
+    // Stops at the reset vector with a prompt, h lists the commands
+    if (!strcmp(argv[i], "--debug")) {
+      if (!cpu.debug && !debug_attach(&cpu))
+        printf("Failed to start the debugger\n");
+      continue;
+    }
+#endif
+#if NES_CDL
+    // Code/Data Log, merged into the file if it already exists. The last
+    // --cdl given is the one logged to.
+    if (!strcmp(argv[i], "--cdl") && i + 1 < argc) {
+      const char *file = argv[++i];
+      Cdl *next = cdl_create(rom.prg_size, rom.chr_size);
+      if (!next)
+        continue;
+      if (!cdl_load(next, file) && access(file, F_OK) == 0)
+        printf("%s was logged from a different ROM, starting over\n", file);
+      cpu_cdl_attach(&cpu, next);
+      cdl_destroy(cdl);
+      cdl = next;
+      cdl_file = file;
+      continue;
+    }
+#endif
+    // Game Genie code, or AAAA:VV[:CC] to patch or freeze an address
+    if (!strcmp(argv[i], "--cheat") && i + 1 < argc) {
+      if (cheat_add(&cpu, argv[++i]) < 0)
+        printf("Invalid cheat %s\n", argv[i]);
+      continue;
+    }
+    // One code per line, see cpu/cheat.h
+    if (!strcmp(argv[i], "--cheats") && i + 1 < argc) {
+      FILE *file = fopen(argv[++i], "r");
+      int bad_line;
+      if (!file) {
+        printf("Failed to open cheat file %s\n", argv[i]);
+        continue;
+      }
+      cheat_load(&cpu, file, &bad_line);
+      if (bad_line)
+        printf("%s:%d: invalid cheat\n", argv[i], bad_line);
+      fclose(file);
+      continue;
+    }
+#if CPU_PROFILE
+    // Cycle profile as folded stacks, for the session or one set per frame
+    if ((!strcmp(argv[i], "--profile") ||
+         !strcmp(argv[i], "--profile-frames")) &&
+        i + 1 < argc) {
+      int per_frame = !strcmp(argv[i], "--profile-frames");
+      profile_close(cpu.profile);
+      cpu.profile = profile_open(argv[++i], cpu.PC, per_frame);
+      if (!cpu.profile)
+        printf("Failed to open profile file %s\n", argv[i]);
+      continue;
+    }
+#endif
+    // Binary instruction trace, decode with bin/trace_decode
+    if (!strcmp(argv[i], "--trace") && i + 1 < argc) {
+      trace_close(cpu.trace);
+      cpu.trace = trace_open(argv[++i]);
+      if (!cpu.trace)
+        printf("Failed to open trace file %s\n", argv[i]);
+      continue;
+    }
+
+    printf("Unknown option or missing argument: %s\n", argv[i]);
+    usage(argv[0]);
+    return 1;
+  }
+#if CPU_STATS
+  cpu.stats = calloc(1, sizeof(CpuStats));
+  signal(SIGUSR1, request_stats);
+#endif
+  apu_mmio_init(&apu_mmio);
   apu_init(&apu, &apu_mmio);
 
   cpu.apu_mmio = &apu_mmio;
 
-  double apu_accumulator = 0.;
-  double sample_accumulator = 0.;
-  double apu_ticks_per_sample = CPU_CLOCK_HZ / AUDIO_SAMPLE_RATE;
+  ApuClock apu_clock = {.apu = &apu, .sched = &cpu.sched};
+  apu_clock.time = cpu.sched.now;
+
+  apu_mmio.sync = apu_sync;
+  apu_mmio.sync_ctx = &apu_clock;
+  apu_mmio.irq = &cpu.irq;
+  sched_set_handler(&cpu.sched, SCHED_APU_FRAME, apu_on_frame_step,
+                    &apu_clock);
+  sched_set_handler(&cpu.sched, SCHED_APU_IRQ, apu_on_frame_step, &apu_clock);
+  apu_sync(&apu_clock);
 
   while (1) {
     // Execute cpu cycle
     cpu_execute(&cpu);
 
-    for (int i = 0; i < cpu.cycles; i++) {
-      apu_execute(&apu);
-
-      sample_accumulator += apu_output(&apu);
-      apu_accumulator += 1.0;
-
-      if (apu_accumulator >= apu_ticks_per_sample) {
-        apu_accumulator -= apu_ticks_per_sample;
+#if NES_DEBUGGER
+    if (cpu.debug && debug_stopped(&cpu) && !debug_prompt(&cpu, stdin, stdout))
+      break;
+#endif
 
-        int16_t sample =
-            ((int)(sample_accumulator / apu_ticks_per_sample) - 8) * 4096;
+    if (ppu.update_graphics) {
+      ppu.update_graphics = 0;
 
-        audio_buffer_add(sample);
+      // Audio for the rest of the frame
+      apu_sync(&apu_clock);
 
-        sample_accumulator = 0.0;
+#if CPU_PROFILE
+      if (cpu.profile)
+        profile_frame(cpu.profile);
+#endif
+#if CPU_STATS
+      if (stats_requested && cpu.stats) {
+        stats_requested = 0;
+        cpu_stats_write(cpu.stats, stdout);
       }
-    }
-
-    if (ppu.update_graphics) {
-      ppu.update_graphics = 0;
+#endif
 
       Frontend_DrawFrame(&frontend, ppu.frame_buffer);
       Frontend_SetFrameTickStart(&frontend);
@@ -116,5 +308,30 @@ int main(int argc, char *argv[]) {
 
   Frontend_Destroy(&frontend);
   apu_destroy(&apu);
+  trace_close(cpu.trace);
+#if CPU_PROFILE
+  if (cpu.profile) {
+    profile_write_report(cpu.profile, stdout);
+    profile_close(cpu.profile);
+  }
+#endif
+#if NES_CDL
+  if (cdl) {
+    if (!cdl_save(cdl, cdl_file))
+      printf("Failed to write %s\n", cdl_file);
+    cdl_destroy(cdl);
+  }
+#endif
+#if CPU_STATS
+  if (cpu.stats) {
+    cpu_stats_write(cpu.stats, stdout);
+    free(cpu.stats);
+  }
+#endif
+#if NES_DEBUGGER
+  debug_detach(&cpu);
+#endif
+  cpu_cleanup(&cpu);
+  rom_unload(&rom);
   return 0;
 }
@@ -0,0 +1,64 @@
+#include "mapper/mapper.h"
+#include "ppu.h"
+
+/*
+ * Boards built from a latch and discrete logic. Any write to $8000-$FFFF
+ * stores the value in the latch, which selects the bank. Bus conflicts
+ * (the ROM driving the bus during the write) aren't modelled.
+ */
+
+static void latch_power(Mapper *mapper) { mapper->state.latch = 0; }
+
+static void latch_write(Mapper *mapper, uint16_t addr, uint8_t val) {
+  (void)addr;
+  mapper->state.latch = val;
+}
+
+/* UxROM: 16 KB switchable at $8000, the last 16 KB fixed at $C000 */
+
+static void uxrom_update(Mapper *mapper) {
+  mapper_map_prg(mapper, 0x8000, 0x4000, mapper->state.latch);
+  mapper_map_prg(mapper, 0xC000, 0x4000, -1);
+  mapper_map_chr(mapper, 0x0000, 0x2000, 0);
+}
+
+const MapperBoard mapper_uxrom = {
+    .number = 2,
+    .name = "UxROM",
+    .power = latch_power,
+    .update = uxrom_update,
+    .write = latch_write,
+};
+
+/* CNROM: fixed PRG, 8 KB switchable CHR */
+
+static void cnrom_update(Mapper *mapper) {
+  mapper_map_prg(mapper, 0x8000, 0x8000, 0);
+  mapper_map_chr(mapper, 0x0000, 0x2000, mapper->state.latch);
+}
+
+const MapperBoard mapper_cnrom = {
+    .number = 3,
+    .name = "CNROM",
+    .power = latch_power,
+    .update = cnrom_update,
+    .write = latch_write,
+};
+
+/* AxROM: 32 KB switchable PRG, bit 4 picks the single-screen nametable */
+
+static void axrom_update(Mapper *mapper) {
+  mapper_map_prg(mapper, 0x8000, 0x8000, mapper->state.latch & 0x07);
+  mapper_map_chr(mapper, 0x0000, 0x2000, 0);
+  mapper_set_mirroring(mapper, (mapper->state.latch & 0x10)
+                                   ? MIRROR_SINGLE_HIGH
+                                   : MIRROR_SINGLE_LOW);
+}
+
+const MapperBoard mapper_axrom = {
+    .number = 7,
+    .name = "AxROM",
+    .power = latch_power,
+    .update = axrom_update,
+    .write = latch_write,
+};
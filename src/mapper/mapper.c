@@ -0,0 +1,194 @@
+#include "mapper/mapper.h"
+#include "cdl.h"
+#include "ppu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PRG_BANK_SIZE 0x2000
+
+static const MapperBoard *const boards[] = {
+    &mapper_nrom,  &mapper_mmc1, &mapper_uxrom,
+    &mapper_cnrom, &mapper_mmc3, &mapper_axrom,
+};
+
+// Every write to $8000-$FFFF
+static void mapper_write(Cpu6502 *cpu, uint16_t addr, uint8_t val) {
+  Mapper *mapper = cpu->mapper;
+
+  // The PPU has to draw up to here with the old CHR banks and mirroring
+  cpu_ppu_sync(cpu);
+
+  mapper->board->write(mapper, addr, val);
+  mapper->board->update(mapper);
+}
+
+// Offset of bank in a memory of the given size, negative banks from the end
+static int bank_offset(int bank, int bank_size, int offset, int mem_size) {
+  int pos = (int)(((long)bank * bank_size + offset) % mem_size);
+  return pos < 0 ? pos + mem_size : pos;
+}
+
+void mapper_map_prg(Mapper *mapper, uint16_t addr, int size, int bank) {
+  Cpu6502 *cpu = mapper->cpu;
+  Cdl *cdl = cpu->cdl;
+
+  for (int i = 0; i < size; i += PRG_BANK_SIZE) {
+    int slot = ((addr + i) >> 13) & 3;
+    int offset = bank_offset(bank, size, i, mapper->prg_size);
+
+    // Remapping a page throws away the blocks decoded from it, so only
+    // banks that changed are mapped
+    if (mapper->prg_offset[slot] == offset)
+      continue;
+    mapper->prg_offset[slot] = offset;
+
+    int first = 0x80 + (slot << 5);
+    cpu_bus_map(cpu, first, first + 0x1F, mapper->prg + offset, NULL, NULL,
+                mapper_write);
+
+    for (int page = 0; cdl && cdl->prg_size && page < 0x20; page++)
+      cpu->bus[first + page].cdl = cdl->prg + offset + (page << 8);
+  }
+}
+
+void mapper_map_chr(Mapper *mapper, uint16_t addr, int size, int bank) {
+  PPU *ppu = mapper->cpu->ppu;
+  Cdl *cdl = mapper->cpu->cdl;
+
+  for (int i = 0; i < size; i += PPU_CHR_BANK_SIZE) {
+    int slot = ((addr + i) / PPU_CHR_BANK_SIZE) % PPU_CHR_BANKS;
+    int offset = bank_offset(bank, size, i, mapper->chr_size);
+
+    ppu->chr[slot] = mapper->chr + offset;
+    ppu->chr_write[slot] = mapper->chr_ram ? mapper->chr_ram + offset : NULL;
+
+    // Only CHR ROM is logged
+    if (cdl && cdl->chr_size && !mapper->chr_ram)
+      ppu->chr_cdl[slot] = cdl->chr + offset;
+    else
+      ppu->chr_cdl[slot] = ppu->chr_cdl_scratch;
+  }
+}
+
+void mapper_set_mirroring(Mapper *mapper, int mirroring) {
+  mapper->cpu->ppu->nametable_mirror_flag = mirroring;
+}
+
+static const MapperBoard *find_board(int number) {
+  for (size_t i = 0; i < sizeof(boards) / sizeof(boards[0]); i++) {
+    if (boards[i]->number == number)
+      return boards[i];
+  }
+  return NULL;
+}
+
+int mapper_attach(Cpu6502 *cpu, const Rom *rom) {
+  const MapperBoard *board = find_board(rom->mapper);
+
+  // Four-screen boards add 2 KB of nametable VRAM that the PPU doesn't have
+  if (!board || !rom->prg_size || rom->four_screen)
+    return 0;
+
+  Mapper *mapper = calloc(1, sizeof(Mapper));
+  if (!mapper)
+    return 0;
+
+  mapper->board = board;
+  mapper->cpu = cpu;
+  mapper->prg = rom->prg_data;
+  mapper->prg_size = rom->prg_size;
+
+  if (rom->chr_size) {
+    mapper->chr = rom->chr_data;
+    mapper->chr_size = rom->chr_size;
+  } else {
+    // Boards without CHR ROM have CHR RAM instead, at least 8 KB of it
+    int size = rom->chr_ram_size + rom->chr_nvram_size;
+    if (size < PPU_CHR_SIZE)
+      size = PPU_CHR_SIZE;
+
+    mapper->chr_ram = calloc(1, size);
+    if (!mapper->chr_ram) {
+      free(mapper);
+      return 0;
+    }
+    mapper->chr = mapper->chr_ram;
+    mapper->chr_size = size;
+  }
+
+  mapper_detach(cpu);
+  cpu->mapper = mapper;
+
+  // A trainer goes to $7000, in cartridge RAM
+  if (rom->trainer)
+    memcpy(cpu->prg_ram + 0x1000, rom->trainer, ROM_TRAINER_SIZE);
+
+  // Boards that switch mirroring set it again in update
+  mapper_set_mirroring(mapper, rom->mirroring);
+  board->power(mapper);
+  mapper_remap(cpu);
+  return 1;
+}
+
+void mapper_error(const Rom *rom, char *buf, size_t size) {
+  if (!find_board(rom->mapper))
+    snprintf(buf, size, "Unsupported mapper %d", rom->mapper);
+  else if (!rom->prg_size)
+    snprintf(buf, size, "No PRG ROM");
+  else if (rom->four_screen)
+    snprintf(buf, size, "Four-screen nametables aren't supported");
+  else
+    snprintf(buf, size, "Out of memory for mapper %d", rom->mapper);
+}
+
+void mapper_detach(Cpu6502 *cpu) {
+  Mapper *mapper = cpu->mapper;
+
+  if (!mapper)
+    return;
+
+  free(mapper->chr_ram);
+  free(mapper);
+  cpu->mapper = NULL;
+}
+
+void mapper_remap(Cpu6502 *cpu) {
+  Mapper *mapper = cpu->mapper;
+
+  for (int slot = 0; slot < 4; slot++)
+    mapper->prg_offset[slot] = -1;
+
+  mapper->board->update(mapper);
+}
+
+void mapper_start(Cpu6502 *cpu) {
+  Mapper *mapper = cpu->mapper;
+
+  if (mapper && mapper->board->start)
+    mapper->board->start(mapper);
+}
+
+/* NROM: 16 or 32 KB of PRG and 8 KB of CHR, nothing switches */
+
+static void nrom_power(Mapper *mapper) { (void)mapper; }
+
+static void nrom_update(Mapper *mapper) {
+  mapper_map_prg(mapper, 0x8000, 0x8000, 0);
+  mapper_map_chr(mapper, 0x0000, 0x2000, 0);
+}
+
+static void nrom_write(Mapper *mapper, uint16_t addr, uint8_t val) {
+  (void)mapper;
+  (void)addr;
+  (void)val;
+}
+
+const MapperBoard mapper_nrom = {
+    .number = 0,
+    .name = "NROM",
+    .power = nrom_power,
+    .update = nrom_update,
+    .write = nrom_write,
+};
@@ -0,0 +1,93 @@
+#include "mapper/mapper.h"
+#include "ppu.h"
+
+/*
+ * MMC1 (SxROM). Registers are loaded one bit at a time through a serial
+ * port: five writes to $8000-$FFFF, bit 0 first, and the address of the
+ * fifth picks the register. A write with bit 7 set empties the port and
+ * fixes the last PRG bank at $C000.
+ *
+ *   $8000 control: mirroring (bits 0-1), PRG mode (2-3), CHR mode (4)
+ *   $A000 CHR bank 0, $C000 CHR bank 1, $E000 PRG bank
+ */
+
+static void mmc1_power(Mapper *mapper) {
+  mapper->state.mmc1 = (Mmc1State){.control = 0x0C};
+}
+
+static void mmc1_write(Mapper *mapper, uint16_t addr, uint8_t val) {
+  Mmc1State *mmc1 = &mapper->state.mmc1;
+
+  if (val & 0x80) {
+    mmc1->shift = 0;
+    mmc1->count = 0;
+    mmc1->control |= 0x0C;
+    return;
+  }
+
+  mmc1->shift |= (val & 1) << mmc1->count;
+  if (++mmc1->count < 5)
+    return;
+
+  switch ((addr >> 13) & 3) {
+  case 0:
+    mmc1->control = mmc1->shift;
+    break;
+  case 1:
+    mmc1->chr0 = mmc1->shift;
+    break;
+  case 2:
+    mmc1->chr1 = mmc1->shift;
+    break;
+  case 3:
+    mmc1->prg = mmc1->shift;
+    break;
+  }
+  mmc1->shift = 0;
+  mmc1->count = 0;
+}
+
+static void mmc1_update(Mapper *mapper) {
+  static const int mirroring[4] = {MIRROR_SINGLE_LOW, MIRROR_SINGLE_HIGH,
+                                   MIRROR_VERTICAL, MIRROR_HORIZONTAL};
+  const Mmc1State *mmc1 = &mapper->state.mmc1;
+
+  mapper_set_mirroring(mapper, mirroring[mmc1->control & 3]);
+
+  // 512 KB boards (SUROM) take the 256 KB half from bit 4 of CHR bank 0
+  int outer = mapper->prg_size > 0x40000 ? mmc1->chr0 & 0x10 : 0;
+  int bank = outer | (mmc1->prg & 0x0F);
+
+  switch ((mmc1->control >> 2) & 3) {
+  case 0:
+  case 1:
+    // 32 KB, the low bit of the bank is ignored
+    mapper_map_prg(mapper, 0x8000, 0x8000, bank >> 1);
+    break;
+  case 2:
+    // First bank fixed at $8000
+    mapper_map_prg(mapper, 0x8000, 0x4000, outer);
+    mapper_map_prg(mapper, 0xC000, 0x4000, bank);
+    break;
+  case 3:
+    // Last bank fixed at $C000
+    mapper_map_prg(mapper, 0x8000, 0x4000, bank);
+    mapper_map_prg(mapper, 0xC000, 0x4000, outer | 0x0F);
+    break;
+  }
+
+  if (mmc1->control & 0x10) {
+    mapper_map_chr(mapper, 0x0000, 0x1000, mmc1->chr0);
+    mapper_map_chr(mapper, 0x1000, 0x1000, mmc1->chr1);
+  } else {
+    mapper_map_chr(mapper, 0x0000, 0x2000, mmc1->chr0 >> 1);
+  }
+}
+
+const MapperBoard mapper_mmc1 = {
+    .number = 1,
+    .name = "MMC1",
+    .power = mmc1_power,
+    .update = mmc1_update,
+    .write = mmc1_write,
+};
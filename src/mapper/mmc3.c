@@ -0,0 +1,145 @@
+#include "mapper/mapper.h"
+#include "cpu/irq.h"
+#include "ppu.h"
+
+/*
+ * MMC3 (TxROM). Even and odd addresses in each 8 KB range are different
+ * registers:
+ *
+ *   $8000 bank select: register (bits 0-2), PRG mode (6), CHR inversion (7)
+ *   $8001 bank data, into the selected register
+ *   $A000 mirroring, $A001 PRG RAM protect (ignored, the RAM stays on)
+ *   $C000 IRQ latch, $C001 IRQ reload
+ *   $E000 IRQ disable and acknowledge, $E001 IRQ enable
+ *
+ * R0-R1 are 2 KB CHR banks, R2-R5 1 KB CHR banks, R6-R7 8 KB PRG banks. The
+ * second to last PRG bank is fixed at $C000 or at $8000, the last at $E000.
+ *
+ * The scanline counter is clocked on the PPU's A12 rising as it fetches the
+ * sprite patterns. With the usual background at $0000 and sprites at $1000
+ * that is once per rendered line at dot 260, which is where it is clocked
+ * here, from SCHED_MAPPER_IRQ.
+ */
+
+#define MMC3_IRQ_DOT 260
+
+static void mmc3_power(Mapper *mapper) {
+  mapper->state.mmc3 = (Mmc3State){0};
+
+  // Games set it before they draw, start with what the header says
+  mapper->state.mmc3.mirroring =
+      mapper->cpu->ppu->nametable_mirror_flag == MIRROR_HORIZONTAL;
+}
+
+static void mmc3_write(Mapper *mapper, uint16_t addr, uint8_t val) {
+  Mmc3State *mmc3 = &mapper->state.mmc3;
+
+  switch (addr & 0xE001) {
+  case 0x8000:
+    mmc3->select = val;
+    break;
+  case 0x8001:
+    mmc3->banks[mmc3->select & 7] = val;
+    break;
+  case 0xA000:
+    mmc3->mirroring = val & 1;
+    break;
+  case 0xC000:
+    mmc3->irq_latch = val;
+    break;
+  case 0xC001:
+    mmc3->irq_counter = 0;
+    mmc3->irq_reload = 1;
+    break;
+  case 0xE000:
+    mmc3->irq_enabled = 0;
+    irq_release(&mapper->cpu->irq, IRQ_MAPPER);
+    break;
+  case 0xE001:
+    mmc3->irq_enabled = 1;
+    break;
+  }
+}
+
+static void mmc3_update(Mapper *mapper) {
+  const Mmc3State *mmc3 = &mapper->state.mmc3;
+  uint16_t prg_swap = (mmc3->select & 0x40) ? 0x4000 : 0;
+  uint16_t chr_swap = (mmc3->select & 0x80) ? 0x1000 : 0;
+
+  mapper_map_prg(mapper, 0x8000 ^ prg_swap, 0x2000, mmc3->banks[6]);
+  mapper_map_prg(mapper, 0xA000, 0x2000, mmc3->banks[7]);
+  mapper_map_prg(mapper, 0xC000 ^ prg_swap, 0x2000, -2);
+  mapper_map_prg(mapper, 0xE000, 0x2000, -1);
+
+  // 2 KB banks ignore the low bit
+  mapper_map_chr(mapper, 0x0000 ^ chr_swap, 0x800, mmc3->banks[0] >> 1);
+  mapper_map_chr(mapper, 0x0800 ^ chr_swap, 0x800, mmc3->banks[1] >> 1);
+  for (int i = 0; i < 4; i++)
+    mapper_map_chr(mapper, (0x1000 + i * 0x400) ^ chr_swap, 0x400,
+                   mmc3->banks[2 + i]);
+
+  mapper_set_mirroring(mapper, mmc3->mirroring ? MIRROR_HORIZONTAL
+                                               : MIRROR_VERTICAL);
+}
+
+static void mmc3_clock(Mapper *mapper) {
+  Mmc3State *mmc3 = &mapper->state.mmc3;
+
+  if (!mmc3->irq_counter || mmc3->irq_reload) {
+    mmc3->irq_counter = mmc3->irq_latch;
+    mmc3->irq_reload = 0;
+  } else {
+    mmc3->irq_counter--;
+  }
+
+  if (!mmc3->irq_counter && mmc3->irq_enabled)
+    irq_assert(&mapper->cpu->irq, IRQ_MAPPER);
+}
+
+// The next line from the pre-render line to 239 that hasn't reached the dot
+static int next_line(const PPU *ppu) {
+  int line = ppu->scanline;
+
+  if (line >= -1 && line <= 239 && ppu->current_scanline_cycle <= MMC3_IRQ_DOT)
+    return line;
+  return line >= -1 && line < 239 ? line + 1 : -1;
+}
+
+static void schedule_line(Mapper *mapper) {
+  Cpu6502 *cpu = mapper->cpu;
+
+  sched_schedule(&cpu->sched, SCHED_MAPPER_IRQ,
+                 cpu->ppu_time + ppu_dots_until(cpu->ppu, next_line(cpu->ppu),
+                                                MMC3_IRQ_DOT));
+}
+
+static int mmc3_on_line(void *ctx, uint64_t time) {
+  Mapper *mapper = ctx;
+  (void)time;
+
+  cpu_ppu_sync(mapper->cpu);
+
+  // Nothing is fetched with rendering off
+  if (mapper->cpu->ppu->PPUMASK & 0x18)
+    mmc3_clock(mapper);
+
+  schedule_line(mapper);
+  return 0;
+}
+
+static void mmc3_start(Mapper *mapper) {
+  Cpu6502 *cpu = mapper->cpu;
+
+  sched_set_handler(&cpu->sched, SCHED_MAPPER_IRQ, mmc3_on_line, mapper);
+  cpu_ppu_sync(cpu);
+  schedule_line(mapper);
+}
+
+const MapperBoard mapper_mmc3 = {
+    .number = 4,
+    .name = "MMC3",
+    .power = mmc3_power,
+    .update = mmc3_update,
+    .write = mmc3_write,
+    .start = mmc3_start,
+};
@@ -7,28 +7,11 @@ Author: Kavin Gnanapandithan
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
-// Nametable mirror arrangment flag
-// 1 = h, v = 0
-unsigned char nametable_mirror_flag;
-
-// Returns bus value
-uint8_t open_bus;
-
-// Main PPU memory
-uint8_t ppu_memory[PPU_MEMORY_SIZE] = {0};
-uint8_t nes_header[NES_HEADER_SIZE] = {0};
-uint8_t ppu_palette[PALETTE_SIZE * 3];
-
-// 256 seperate memoery dedicated to OAM
-uint8_t oam_memory[OAM_SIZE] = {0};
-
-// Buffer, holds up to 8 spirtes to be rendered on the next scanline
-uint8_t oam_memory_secondary[OAM_SECONDARY_SIZE] = {0};
-
-// Internal latches, holds actual rendering data
-uint8_t oam_buffer_latches[OAM_SECONDARY_SIZE] = {0};
-
 void ppu_init(PPU *ppu) {
+  // Registers, OAM and timing start out cleared, VRAM was cleared with the
+  // CHR load
+  memset(ppu, 0, offsetof(PPU, vram));
+
   // Initial PPU MMIO Register values
   ppu->PPUCTRL = 0;
   ppu->PPUMASK = 0;
@@ -44,127 +27,104 @@ void ppu_init(PPU *ppu) {
   memset(&ppu->bg_pipeline, 0, sizeof(ppu->bg_pipeline));
   memset(&ppu->sprite_pipeline, 0, sizeof(ppu->sprite_pipeline));
   // Flag 6
-  // Bit 0 determine h/v n.t arrangment (h = 1, v = 0)
-  nametable_mirror_flag = ((nes_header[6] & 0x01) == 0x01);
+  // Bit 0 determines the n.t arrangement (vertical = 1, horizontal = 0)
+  ppu->nametable_mirror_flag =
+      (ppu->nes_header[6] & 0x01) ? MIRROR_VERTICAL : MIRROR_HORIZONTAL;
 
   ppu->sprite_render_index = -1;
   ppu->current_scanline_cycle = 0;
   ppu->scanline = 0;
   ppu->frame = 0;
 
-  memset(&oam_memory_secondary, 0xFF, OAM_SECONDARY_SIZE);
+  memset(ppu->oam_memory_secondary, 0xFF, OAM_SECONDARY_SIZE);
+
+  for (int bank = 0; bank < PPU_CHR_BANKS; bank++)
+    ppu->chr_cdl[bank] = ppu->chr_cdl_scratch;
 }
 
-void load_ppu_memory(PPU *ppu, unsigned char *chr_rom, int chr_size) {
-  // Clear ppu_memory
-  memset(ppu_memory, 0, PPU_MEMORY_SIZE);
+// Pattern tables of a cartridge without CHR ROM
+static const uint8_t chr_blank[PPU_CHR_SIZE];
 
-  // Load CHR ROM into 0x0000 - 0x1FFF
-  memcpy(&ppu_memory[0x0000], chr_rom, chr_size);
+void load_ppu_memory(PPU *ppu, const uint8_t *chr_rom, int chr_size) {
+  memset(ppu->vram, 0, PPU_VRAM_SIZE);
+  memset(ppu->palette_ram, 0, PPU_PALETTE_RAM_SIZE);
+
+  // The first 8 KB of CHR ROM stays where it was loaded, at $0000-$1FFF.
+  // Boards that switch banks or have CHR RAM map their own (see mapper.h).
+  const uint8_t *chr = chr_size >= PPU_CHR_SIZE ? chr_rom : chr_blank;
+  for (int bank = 0; bank < PPU_CHR_BANKS; bank++) {
+    ppu->chr[bank] = chr + bank * PPU_CHR_BANK_SIZE;
+    ppu->chr_write[bank] = NULL;
+  }
+}
+
+void load_ppu_ines_header(PPU *ppu, const uint8_t *header) {
+  memset(ppu->nes_header, 0, NES_HEADER_SIZE);
+  memcpy(ppu->nes_header, header, NES_HEADER_SIZE);
 }
 
-void load_ppu_ines_header(unsigned char *header) {
-  memset(&nes_header, 0, NES_HEADER_SIZE);
-  memcpy(&nes_header, header, NES_HEADER_SIZE);
+void load_palette(PPU *ppu, uint8_t *palette) {
+  memset(ppu->ppu_palette, 0, PALETTE_SIZE * 3);
+  memcpy(ppu->ppu_palette, palette, PALETTE_SIZE * 3);
 }
 
-void load_palette(uint8_t *palette) {
-  memset(&ppu_palette, 0, PALETTE_SIZE * 3);
-  memcpy(&ppu_palette, palette, PALETTE_SIZE * 3);
+void load_ppu_oam_mem(PPU *ppu, const uint8_t *dma_mem) {
+  memcpy(ppu->oam_memory, dma_mem, OAM_SIZE);
 }
 
-void load_ppu_oam_mem(PPU *ppu, uint8_t *dma_mem) {
-  memset(&oam_memory, 0, OAM_SIZE);
-  memcpy(&oam_memory, dma_mem, OAM_SIZE);
+// Two of the four nametables are backed by VRAM. Vertical mirroring pairs
+// $2000 with $2800, horizontal pairs $2000 with $2400, single screen maps
+// all four to one of them.
+static const uint16_t nametable_offset[4][4] = {
+    [MIRROR_HORIZONTAL] = {0x000, 0x000, 0x400, 0x400},
+    [MIRROR_VERTICAL] = {0x000, 0x400, 0x000, 0x400},
+    [MIRROR_SINGLE_LOW] = {0x000, 0x000, 0x000, 0x000},
+    [MIRROR_SINGLE_HIGH] = {0x400, 0x400, 0x400, 0x400},
+};
+
+static inline uint16_t nametable_index(const PPU *ppu, uint16_t addr) {
+  return nametable_offset[ppu->nametable_mirror_flag & 3][(addr >> 10) & 3] |
+         (addr & 0x3FF);
+}
+
+// $3F10/$3F14/$3F18/$3F1C are the same entries as $3F00/$3F04/$3F08/$3F0C
+static inline uint8_t palette_index(uint16_t addr) {
+  addr &= 0x1F;
+  return (addr & 0x13) == 0x10 ? addr & ~0x10 : addr;
 }
 
 inline uint8_t read_mem(PPU *ppu, uint16_t addr) {
   addr &= 0x3FFF;
 
   if (addr < 0x2000) {
-    // Pattern tables
-    uint16_t pt_base_addr = 0;
-
-    // if (ppu->drawing_bg_flag) {
-    pt_base_addr = (ppu->PPUCTRL & 0x10) ? 0x1000 : 0x0000;
-    //} else {
-    //  // TODO: Handle 8x16 sprites separately in sprite code
-    //  pt_base_addr = (ppu->PPUCTRL & 0x08) ? 0x1000 : 0x0000;
-    //}
-    return ppu_memory[pt_base_addr | (addr & 0x0FFF)];
+    // Pattern tables, the fetches pick the table themselves so $2007 can
+    // read either one
+    return ppu_chr_read(ppu, addr);
   }
 
   else if (addr < 0x3F00) {
     // Nametable region with mirroring
-    addr &= 0x2FFF;
-    uint16_t offset = addr & 0xFFF;
-
-    if (nametable_mirror_flag) { // vertical
-      return ppu_memory[offset % 0x800];
-    } else { // horizontal
-      if (offset < 0x800) {
-        // NT0 or NT1 (2000 or 2400)
-        return ppu_memory[(0x2000 | (offset % 0x400))];
-      } else {
-        if (offset < 0xC00) {
-          return ppu_memory[addr];
-        } else {
-          return ppu_memory[0x2000 | (offset - 0x400)];
-        }
-      }
-    }
+    return ppu->vram[nametable_index(ppu, addr)];
   }
 
-  else if (addr < 0x4000) {
-    // Palette memory
-    addr &= 0x1F;
-    addr ^= ((addr & 0x13) == 0x10) ? 0x10 : 0x00;
-    return ppu_memory[0x3F00 + addr];
-  }
-
-  return 0; // open bus
+  // Palette memory
+  return ppu->palette_ram[palette_index(addr)];
 }
 
 void write_mem(PPU *ppu, uint16_t addr, uint8_t val) {
   addr &= 0x3FFF; // Mirror addresses above $3FFF
 
   if (addr < 0x2000) {
-    // Pattern table / CHR RAM
-    // ppu_memory[addr] = val;
+    // Pattern table, only CHR RAM takes the write
+    uint8_t *bank = ppu->chr_write[addr / PPU_CHR_BANK_SIZE];
+    if (bank)
+      bank[addr % PPU_CHR_BANK_SIZE] = val;
   } else if (addr < 0x3F00) {
     // Nametable range with mirroring
-    // uint16_t mirrored_addr = 0x2000 + (addr & 0x0FFF); // mirror
-    // $2000–$2FFF every 4KB ppu_memory[addr] = val; ppu_memory[mirrored_addr]
-    // = val;
-
-    addr &= 0x2FFF;
-    uint16_t offset = addr & 0xFFF;
-
-    if (nametable_mirror_flag) {
-
-    } else {
-      if (offset < 0x800) {
-        // NT0 or NT1 (2000 or 2400)
-        ppu_memory[(0x2000 | (offset % 0x400))] = val;
-      } else {
-        if (offset < 0xC00) {
-          ppu_memory[addr] = val;
-        } else {
-          ppu_memory[0x2000 | (offset - 0x400)] = val;
-        }
-      }
-    }
-  } else if (addr < 0x4000) {
+    ppu->vram[nametable_index(ppu, addr)] = val;
+  } else {
     // Palette RAM with mirroring
-    uint16_t mirrored_addr = 0x3F00 + (addr & 0x1F);
-
-    // Handle mirroring of universal background color
-    // if (mirrored_addr == 0x3F10) mirrored_addr = 0x3F00;
-    // if (mirrored_addr == 0x3F14) mirrored_addr = 0x3F04;
-    // if (mirrored_addr == 0x3F18) mirrored_addr = 0x3F08;
-    // if (mirrored_addr == 0x3F1C) mirrored_addr = 0x3F0C;
-
-    ppu_memory[mirrored_addr] = val;
+    ppu->palette_ram[palette_index(addr)] = val;
   }
 }
 
@@ -208,3 +168,36 @@ void ppu_execute_cycle(PPU *ppu) {
     ppu->frame++;
   }
 }
+
+void ppu_run(PPU *ppu, int dots) {
+  while (dots > 0) {
+    // With rendering off a dot only moves the counters, except on the
+    // VBlank line and the last dot of a line
+    if (!(ppu->PPUMASK & 0x18) && ppu->scanline != 241) {
+      int n = NUM_DOTS - 1 - ppu->current_scanline_cycle;
+      if (n > dots)
+        n = dots;
+
+      if (n > 0) {
+        ppu->current_scanline_cycle += n;
+        ppu->ppu_cycle_count += n;
+        dots -= n;
+        continue;
+      }
+    }
+
+    ppu_execute_cycle(ppu);
+    dots--;
+  }
+}
+
+int ppu_dots_until(PPU *ppu, int scanline, int dot) {
+  int frame_dots = NUM_SCANLINES * NUM_DOTS;
+
+  // Dots since the start of the pre-render line, for the next dot to run and
+  // for the target
+  int pos = (ppu->scanline + 1) * NUM_DOTS + ppu->current_scanline_cycle;
+  int target = (scanline + 1) * NUM_DOTS + dot;
+
+  return (target - pos + frame_dots) % frame_dots + 1;
+}
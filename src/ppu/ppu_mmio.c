@@ -88,17 +88,17 @@ uint8_t ppu_registers_read(PPU *ppu, uint16_t addr) {
 
   // PPUCTRL
   case 0x2000:
-    return open_bus;
+    return ppu->open_bus;
     break;
 
   // PPUMASK
   case 0x2001:
-    return open_bus;
+    return ppu->open_bus;
     break;
 
   // PPUSTATUS
   case 0x2002:
-    open_bus = ppu->PPUSTATUS;
+    ppu->open_bus = ppu->PPUSTATUS;
     // Clear the 7th bit (vblank flag)
     ppu->PPUSTATUS &= 0x7F;
     ppu->vblank_flag = 0;
@@ -106,48 +106,48 @@ uint8_t ppu_registers_read(PPU *ppu, uint16_t addr) {
     // Clear w register
     ppu->w = 0;
 
-    return open_bus;
+    return ppu->open_bus;
     break;
 
   // OAMADDR
   case 0x2003:
-    return open_bus;
+    return ppu->open_bus;
     break;
 
   // OAMDATA
   case 0x2004:
-    open_bus = ppu->OAMDATA;
-    return open_bus;
+    ppu->open_bus = ppu->OAMDATA;
+    return ppu->open_bus;
     break;
 
   // PPUSCROLL
   case 0x2005:
-    return open_bus;
+    return ppu->open_bus;
     break;
 
   // PPUADDR
   case 0x2006:
-    return open_bus;
+    return ppu->open_bus;
     break;
 
   // PPUDATA
   case 0x2007:
-    open_bus = ppu->PPUDATA_READ_BUFFER;
+    ppu->open_bus = ppu->PPUDATA_READ_BUFFER;
     ppu->PPUDATA_READ_BUFFER = read_mem(ppu, ppu->v & 0x3FFF);
 
     // If data is within palette ram, do immediate return
     // Otherwise, return buffer
     if ((ppu->v & 0x3FFF) >= 0x3F00) {
-      open_bus = read_mem(ppu, ppu->v & 0x3FFF);
+      ppu->open_bus = read_mem(ppu, ppu->v & 0x3FFF);
     }
 
     // Increment v after PPUDATA read
     ppu->v += (ppu->PPUCTRL & 0x04) == 0x04 ? 32 : 1;
-    return open_bus;
+    return ppu->open_bus;
     break;
 
   default:
-    return open_bus;
+    return ppu->open_bus;
     break;
   }
 }
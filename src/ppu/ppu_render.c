@@ -1,8 +1,19 @@
 #include "ppu_render.h"
+#include "cdl.h"
+#include "config.h"
 #include "ppu.h"
 #include <string.h>
 #include <unistd.h>
 
+// Log a pattern fetch to the Code/Data Logger
+#if NES_CDL
+#define CDL_CHR(ppu, addr, flag)                                               \
+  ((ppu)->chr_cdl[((addr) & 0x1FFF) / PPU_CHR_BANK_SIZE]                       \
+                 [(addr) % PPU_CHR_BANK_SIZE] |= (flag))
+#else
+#define CDL_CHR(ppu, addr, flag) ((void)0)
+#endif
+
 uint8_t fetch_name_table_byte(PPU *ppu) {
   return read_mem(ppu, 0x2000 | (ppu->v & 0xFFF));
 }
@@ -17,7 +28,8 @@ uint8_t fetch_attr_table_byte(PPU *ppu) {
 
 uint8_t fetch_pattern_table_byte(PPU *ppu, uint8_t row_padding,
                                  uint8_t bit_plane) {
-  uint16_t base_address = ppu->bg_pipeline.name_table_byte * 16;
+  uint16_t base_address = ((ppu->PPUCTRL & 0x10) << 8) |
+                          (ppu->bg_pipeline.name_table_byte * 16);
   uint8_t row = ppu->scanline % 8;
 
   // Offset by 8 if MSB (bit_plane == 1)
@@ -26,8 +38,8 @@ uint8_t fetch_pattern_table_byte(PPU *ppu, uint8_t row_padding,
 
 void sprite_ppu_render(PPU *ppu) {
   for (int i = 0; i <= OAM_SECONDARY_SIZE - 4; i += 4) {
-    int sprite_y = oam_buffer_latches[i] + 1;
-    int sprite_x = oam_buffer_latches[i + 3];
+    int sprite_y = ppu->oam_buffer_latches[i] + 1;
+    int sprite_x = ppu->oam_buffer_latches[i + 3];
 
     if (ppu->scanline < sprite_y ||
         ppu->scanline >= sprite_y + ppu->sprite_height)
@@ -35,8 +47,8 @@ void sprite_ppu_render(PPU *ppu) {
 
     int row_in_tile = ppu->scanline - sprite_y;
 
-    uint8_t tile_index = oam_buffer_latches[i + 1];
-    uint8_t attr = oam_buffer_latches[i + 2];
+    uint8_t tile_index = ppu->oam_buffer_latches[i + 1];
+    uint8_t attr = ppu->oam_buffer_latches[i + 2];
     uint8_t palette_index = attr & 0x3;
 
     int flip_horizontal = attr & 0x40;
@@ -53,8 +65,10 @@ void sprite_ppu_render(PPU *ppu) {
     }
 
     uint16_t pattern_addr = pattern_addr_base + tile_index * 16 + row_in_tile;
-    uint8_t pattern_lsb = ppu_memory[pattern_addr & 0x1FFF];
-    uint8_t pattern_msb = ppu_memory[(pattern_addr + 8) & 0x1FFF];
+    uint8_t pattern_lsb = ppu_chr_read(ppu, pattern_addr);
+    uint8_t pattern_msb = ppu_chr_read(ppu, pattern_addr + 8);
+    CDL_CHR(ppu, pattern_addr, CDL_SPRITE);
+    CDL_CHR(ppu, pattern_addr + 8, CDL_SPRITE);
 
     for (int j = 0; j < 8; j++) {
       int bit = flip_horizontal ? j : (7 - j);
@@ -73,7 +87,7 @@ void sprite_ppu_render(PPU *ppu) {
 
       uint16_t pal_addr = 0x3F10 | (palette_index << 2) | pixel_val;
       uint8_t palette_data = read_mem(ppu, pal_addr);
-      uint8_t *color = &ppu_palette[palette_data * 3];
+      uint8_t *color = &ppu->ppu_palette[palette_data * 3];
       uint8_t r = color[0], g = color[1], b = color[2];
 
       ppu->frame_buffer[screen_y][screen_x] =
@@ -90,6 +104,8 @@ void sprite_ppu_render(PPU *ppu) {
  */
 void background_ppu_render(PPU *ppu) {
   uint8_t fine_y = (ppu->v >> 12) & 0x07;
+  // Background pattern table, $0000 or $1000
+  uint16_t bg_table = (ppu->PPUCTRL & 0x10) << 8;
   switch (ppu->current_scanline_cycle % 8) {
   // Fetch Nametable byte
   case 1:
@@ -113,8 +129,10 @@ void background_ppu_render(PPU *ppu) {
 
   // Fetch nametable low byte
   case 5:
-    ppu->bg_pipeline.pattern_table_lsb =
-        read_mem(ppu, (ppu->bg_pipeline.name_table_byte * 16) + fine_y);
+    ppu->bg_pipeline.pattern_table_lsb = read_mem(
+        ppu, bg_table | (ppu->bg_pipeline.name_table_byte * 16 + fine_y));
+    CDL_CHR(ppu, bg_table | (ppu->bg_pipeline.name_table_byte * 16 + fine_y),
+            CDL_BG);
     // ppu->bg_pipeline.pattern_table_lsb =
     //     read_mem(ppu, (ppu->bg_pipeline.name_table_byte * 16) +
     //                       ((ppu->scanline + row_padding) % 8));
@@ -122,8 +140,11 @@ void background_ppu_render(PPU *ppu) {
 
   // Fetch high byte
   case 7:
-    ppu->bg_pipeline.pattern_table_msb =
-        read_mem(ppu, (ppu->bg_pipeline.name_table_byte * 16) + 8 + fine_y);
+    ppu->bg_pipeline.pattern_table_msb = read_mem(
+        ppu, bg_table | (ppu->bg_pipeline.name_table_byte * 16 + 8 + fine_y));
+    CDL_CHR(ppu,
+            bg_table | (ppu->bg_pipeline.name_table_byte * 16 + 8 + fine_y),
+            CDL_BG);
     break;
 
   // Store value in buffer
@@ -178,7 +199,7 @@ void background_ppu_render(PPU *ppu) {
       uint8_t palette_data = read_mem(ppu, pal_addr);
       uint8_t alpha = (ppu->bg_pipeline.tile_pixel_value[i] == 0) ? 0x00 : 0xFF;
 
-      uint8_t *color = &ppu_palette[palette_data * 3];
+      uint8_t *color = &ppu->ppu_palette[palette_data * 3];
       uint8_t r = color[0], g = color[1], b = color[2];
 
       int column = column_base + i;
@@ -218,7 +239,7 @@ void ppu_exec_pre_render(PPU *ppu) {
 void sprite_detect(PPU *ppu) {
   // Reset secondary OAM memory at cycle 1
   if (ppu->current_scanline_cycle == 1) {
-    memset(oam_memory_secondary, 0xFF, OAM_SECONDARY_SIZE);
+    memset(ppu->oam_memory_secondary, 0xFF, OAM_SECONDARY_SIZE);
   }
 
   if (ppu->current_scanline_cycle == 336) {
@@ -238,16 +259,16 @@ void sprite_detect(PPU *ppu) {
       return;
     // Odd cycle; read OAM
     if (ppu->current_scanline_cycle % 2 == 1) {
-      if (ppu->scanline >= oam_memory[index] &&
-          ppu->scanline < oam_memory[index] + sprite_height) {
+      if (ppu->scanline >= ppu->oam_memory[index] &&
+          ppu->scanline < ppu->oam_memory[index] + sprite_height) {
         ppu->copy_sprite_flag = 1;
       }
     } else {
       if (ppu->copy_sprite_flag && ppu->oam_memory_top <= 31) {
-        oam_memory_secondary[ppu->oam_memory_top++] = oam_memory[index];
-        oam_memory_secondary[ppu->oam_memory_top++] = oam_memory[index + 1];
-        oam_memory_secondary[ppu->oam_memory_top++] = oam_memory[index + 2];
-        oam_memory_secondary[ppu->oam_memory_top++] = oam_memory[index + 3];
+        ppu->oam_memory_secondary[ppu->oam_memory_top++] = ppu->oam_memory[index];
+        ppu->oam_memory_secondary[ppu->oam_memory_top++] = ppu->oam_memory[index + 1];
+        ppu->oam_memory_secondary[ppu->oam_memory_top++] = ppu->oam_memory[index + 2];
+        ppu->oam_memory_secondary[ppu->oam_memory_top++] = ppu->oam_memory[index + 3];
       }
       if (ppu->sprite_evaluation_index == 64) {
         ppu->sprite_evaluation_index = -1;
@@ -273,7 +294,7 @@ void ppu_exec_visible_scanline(PPU *ppu) {
     sprite_ppu_render(ppu);
     ppu->sprite_render_index = -1;
   } else if (ppu->current_scanline_cycle == 256) {
-    memset(oam_memory_secondary, 0, 32);
+    memset(ppu->oam_memory_secondary, 0, 32);
   } else if (ppu->current_scanline_cycle >= 257 &&
              ppu->current_scanline_cycle <= 320) {
     /* HBLANK */
@@ -284,8 +305,8 @@ void ppu_exec_visible_scanline(PPU *ppu) {
 
     // Tile data for the sprites on the next scanline are loaded into rendering
     // latches
-    oam_buffer_latches[(ppu->current_scanline_cycle - 257) % 32] =
-        oam_memory_secondary[(ppu->current_scanline_cycle - 257) % 32];
+    ppu->oam_buffer_latches[(ppu->current_scanline_cycle - 257) % 32] =
+        ppu->oam_memory_secondary[(ppu->current_scanline_cycle - 257) % 32];
   } else if (ppu->current_scanline_cycle >= 321 &&
              ppu->current_scanline_cycle <= 336) {
     background_ppu_render(ppu);
@@ -1,62 +1,170 @@
 #include "rom.h"
 #include "ppu.h"
-#include <stdio.h>
-#include <stdlib.h>
+#include "romdb.h"
 
-int rom_load_cartridge(Rom *rom, char *filename) {
-  printf("%s\n", filename);
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-  if (!filename) {
-    fprintf(stderr, "Error: filename is NULL\n");
-    return ROM_ERR_NOFILE;
-  }
+#define PRG_UNIT 0x4000 // Sizes in the header are in 16 KB of PRG
+#define CHR_UNIT 0x2000 // and 8 KB of CHR
+#define RAM_UNIT 0x2000
 
-  FILE *rom_file = fopen(filename, "rb");
-  if (!rom_file) {
-    return ROM_ERR_NOFILE;
+// NES 2.0 ROM size from the LSB byte and MSB nibble. An MSB of $F packs an
+// exponent and multiplier into the LSB, 2^E * (MM * 2 + 1) bytes.
+static int rom_size(int lsb, int msb, size_t unit, size_t *size) {
+  if (msb != 0xF) {
+    *size = (size_t)(msb << 8 | lsb) * unit;
+    return 1;
   }
-  rom->header = malloc(NES_HEADER_SIZE);
 
-  if (fread(rom->header, 1, NES_HEADER_SIZE, rom_file) != NES_HEADER_SIZE) {
-    fclose(rom_file);
-    return ROM_ERR_HEADER_MISMATCH;
+  // Anything past 1 GB isn't a ROM
+  if (lsb >> 2 > 30)
+    return 0;
+  *size = ((size_t)1 << (lsb >> 2)) * ((lsb & 3) * 2 + 1);
+  return 1;
+}
+
+// NES 2.0 RAM sizes are shift counts, 64 << n bytes or none for 0
+static size_t ram_size(int shift) { return shift ? (size_t)64 << shift : 0; }
+
+static int parse_header(Rom *rom, size_t file_size) {
+  const uint8_t *h = rom->header;
+
+  rom->nes2 = (h[7] & 0x0C) == 0x08;
+  rom->mirroring = (h[6] & 0x01) ? MIRROR_VERTICAL : MIRROR_HORIZONTAL;
+  rom->battery = (h[6] & 0x02) != 0;
+  rom->four_screen = (h[6] & 0x08) != 0;
+
+  // Low nibble of the mapper in flags 6, high nibble in flags 7
+  rom->mapper = h[6] >> 4;
+
+  if (rom->nes2) {
+    rom->mapper |= (h[7] & 0xF0) | (h[8] & 0x0F) << 8;
+    rom->submapper = h[8] >> 4;
+
+    if (!rom_size(h[4], h[9] & 0x0F, PRG_UNIT, &rom->prg_size))
+      return ROM_ERR_PRG_SIZE;
+    if (!rom_size(h[5], h[9] >> 4, CHR_UNIT, &rom->chr_size))
+      return ROM_ERR_CHR_SIZE;
+
+    rom->prg_ram_size = ram_size(h[10] & 0x0F);
+    rom->prg_nvram_size = ram_size(h[10] >> 4);
+    rom->chr_ram_size = ram_size(h[11] & 0x0F);
+    rom->chr_nvram_size = ram_size(h[11] >> 4);
+    rom->region = h[12] & 0x03;
+  } else {
+    rom->submapper = 0;
+    rom->prg_size = h[4] * PRG_UNIT;
+    rom->chr_size = h[5] * CHR_UNIT;
+
+    // Old dumps have junk in bytes 7-15, the padding at 12-15 has to be
+    // clear for flags 7 to 9 to count
+    int clean = !h[12] && !h[13] && !h[14] && !h[15];
+    if (clean)
+      rom->mapper |= h[7] & 0xF0;
+
+    rom->prg_ram_size = rom->battery ? 0 : RAM_UNIT;
+    rom->prg_nvram_size = rom->battery ? RAM_UNIT : 0;
+    rom->chr_ram_size = rom->chr_size ? 0 : RAM_UNIT;
+    rom->chr_nvram_size = 0;
+    rom->region = clean && (h[9] & 0x01) ? ROM_REGION_PAL : ROM_REGION_NTSC;
   }
-  printf("test");
-  rom->prg_size = rom->header[4] * 16 * 1024;
-  rom->chr_size = rom->header[5] * 8 * 1024;
 
-  if (rom->prg_size != 16384 && rom->prg_size != 32768) {
-    printf("Unsupported PRG Size: %ld", rom->prg_size);
+  // Banks are mapped 8 KB of PRG and 1 KB of CHR at a time, odd NES 2.0
+  // sizes can't be
+  if (!rom->prg_size || rom->prg_size % 0x2000)
     return ROM_ERR_PRG_SIZE;
-  }
+  if (rom->chr_size % 0x400)
+    return ROM_ERR_CHR_SIZE;
 
-  rom->prg_data = malloc(rom->prg_size);
-  rom->chr_data = malloc(rom->chr_size);
-  if (!rom->prg_data || !rom->chr_data) {
-    fclose(rom_file);
-    return ROM_MEM_ALLOC_FAIL;
+  // Header, trainer, PRG then CHR. Anything after CHR (PlayChoice data,
+  // titles) is ignored.
+  size_t offset = NES_HEADER_SIZE;
+  if (h[6] & 0x04) {
+    rom->trainer = rom->header + offset;
+    offset += ROM_TRAINER_SIZE;
   }
 
-  if (fread(rom->prg_data, 1, rom->prg_size, rom_file) != rom->prg_size) {
-    free(rom->prg_data);
-    free(rom->chr_data);
-    fclose(rom_file);
+  if (file_size < offset || file_size - offset < rom->prg_size)
     return ROM_ERR_PRG_SIZE;
+  rom->prg_data = rom->header + offset;
+  offset += rom->prg_size;
+
+  if (file_size - offset < rom->chr_size)
+    return ROM_ERR_CHR_SIZE;
+  rom->chr_data = rom->chr_size ? rom->header + offset : NULL;
+  return ROM_OK;
+}
+
+// Hashes the image and takes what the game database knows about it
+static void identify(Rom *rom) {
+  Sha1 sha1;
+
+  rom->crc32 = crc32_update(0, rom->prg_data, rom->prg_size);
+  sha1_init(&sha1);
+  sha1_update(&sha1, rom->prg_data, rom->prg_size);
+
+  if (rom->chr_size) {
+    rom->crc32 = crc32_update(rom->crc32, rom->chr_data, rom->chr_size);
+    sha1_update(&sha1, rom->chr_data, rom->chr_size);
   }
-  if (fseek(rom_file, NES_HEADER_SIZE + rom->prg_size, SEEK_SET) != 0) {
-    free(rom->prg_data);
-    free(rom->chr_data);
-    fclose(rom_file);
-    return ROM_MEM_ALLOC_FAIL;
+  sha1_final(&sha1, rom->sha1);
+
+  const RomDbEntry *game = romdb_find(rom->crc32, rom->sha1);
+  if (!game)
+    return;
+
+  rom->title = game->title;
+  rom->mapper = game->mapper;
+  rom->submapper = game->submapper;
+  rom->mirroring = game->mirroring;
+  rom->region = game->region;
+  rom->battery = game->battery;
+}
+
+int rom_load_cartridge(Rom *rom, const char *filename) {
+  memset(rom, 0, sizeof(Rom));
+
+  if (!filename)
+    return ROM_ERR_NOFILE;
+
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    return ROM_ERR_NOFILE;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < NES_HEADER_SIZE) {
+    close(fd);
+    return ROM_ERR_HEADER_MISMATCH;
   }
 
-  if (fread(rom->chr_data, 1, rom->chr_size, rom_file) != rom->chr_size) {
-    free(rom->prg_data);
-    free(rom->chr_data);
-    fclose(rom_file);
-    return ROM_ERR_CHR_SIZE;
+  // Read-only and private: the page cache holds one copy of the file for
+  // every process that maps it
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return ROM_MEM_ALLOC_FAIL;
+
+  rom->map = map;
+  rom->map_size = st.st_size;
+  rom->header = map;
+
+  int err = memcmp(rom->header, "NES\x1A", 4) ? ROM_ERR_HEADER_MISMATCH
+                                               : parse_header(rom, st.st_size);
+  if (err != ROM_OK) {
+    rom_unload(rom);
+    return err;
   }
 
-  fclose(rom_file);
+  identify(rom);
   return ROM_OK;
 }
+
+void rom_unload(Rom *rom) {
+  if (rom->map)
+    munmap(rom->map, rom->map_size);
+  memset(rom, 0, sizeof(Rom));
+}
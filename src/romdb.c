@@ -0,0 +1,58 @@
+#include "romdb.h"
+#include "config.h"
+#include "ppu.h"
+#include "rom.h"
+
+#include <string.h>
+
+// Sorted by CRC. Rows come from bin/romdb run over verified dumps, which
+// prints this table back with them merged in.
+const RomDbEntry romdb_games[] = {
+};
+
+const size_t romdb_count = sizeof(romdb_games) / sizeof(romdb_games[0]);
+
+#if ROMDB_TEST_ROMS
+// The test ROMs that tools/fixtures.c writes to rom/tests, sorted the same
+// way and kept out of the emulator so no game can be taken for one.
+// romdb_mirroring.nes has a header that says horizontal mirroring and only
+// passes with the vertical mirroring given here.
+static const RomDbEntry romdb_tests[] = {
+    {0xAB463541,
+     {0xab, 0xd7, 0x4e, 0x52, 0x45, 0xef, 0x2d, 0x29, 0x7b, 0x18,
+      0xc8, 0x72, 0xab, 0xc7, 0x33, 0x85, 0x7f, 0xbc, 0x45, 0x5b},
+     0, 0, MIRROR_VERTICAL, ROM_REGION_NTSC, 0, "romdb_mirroring"},
+};
+#endif
+
+static const RomDbEntry *find(const RomDbEntry *table, size_t count,
+                              uint32_t crc32, const uint8_t sha1[SHA1_SIZE]) {
+  size_t lo = 0, hi = count;
+
+  // First entry with the CRC
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (table[mid].crc32 < crc32)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  // Different images can share a CRC, the SHA-1 tells them apart
+  for (; lo < count && table[lo].crc32 == crc32; lo++) {
+    if (!memcmp(table[lo].sha1, sha1, SHA1_SIZE))
+      return &table[lo];
+  }
+  return NULL;
+}
+
+const RomDbEntry *romdb_find(uint32_t crc32, const uint8_t sha1[SHA1_SIZE]) {
+  const RomDbEntry *game = find(romdb_games, romdb_count, crc32, sha1);
+
+#if ROMDB_TEST_ROMS
+  if (!game)
+    game = find(romdb_tests, sizeof(romdb_tests) / sizeof(romdb_tests[0]),
+                crc32, sha1);
+#endif
+  return game;
+}
@@ -0,0 +1,123 @@
+#include "scheduler.h"
+
+#include <string.h>
+
+static void heap_set(Scheduler *sched, int i, SchedEvent event) {
+  sched->heap[i] = event;
+  sched->slot[event.type] = i;
+}
+
+static void sift_up(Scheduler *sched, int i) {
+  SchedEvent event = sched->heap[i];
+
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (sched->heap[parent].time <= event.time)
+      break;
+
+    heap_set(sched, i, sched->heap[parent]);
+    i = parent;
+  }
+
+  heap_set(sched, i, event);
+}
+
+static void sift_down(Scheduler *sched, int i) {
+  SchedEvent event = sched->heap[i];
+
+  for (;;) {
+    int child = 2 * i + 1;
+    if (child >= sched->size)
+      break;
+
+    if (child + 1 < sched->size &&
+        sched->heap[child + 1].time < sched->heap[child].time)
+      child++;
+
+    if (event.time <= sched->heap[child].time)
+      break;
+
+    heap_set(sched, i, sched->heap[child]);
+    i = child;
+  }
+
+  heap_set(sched, i, event);
+}
+
+static void update_next(Scheduler *sched) {
+  sched->next = sched->size ? sched->heap[0].time : SCHED_NEVER;
+}
+
+void sched_init(Scheduler *sched) {
+  memset(sched, 0, sizeof(Scheduler));
+
+  for (int i = 0; i < SCHED_NUM_EVENTS; i++)
+    sched->slot[i] = -1;
+
+  sched->next = SCHED_NEVER;
+}
+
+void sched_set_handler(Scheduler *sched, SchedEventType type,
+                       SchedHandler handler, void *ctx) {
+  sched->handler[type] = handler;
+  sched->ctx[type] = ctx;
+}
+
+void sched_schedule(Scheduler *sched, SchedEventType type, uint64_t time) {
+  int i = sched->slot[type];
+
+  if (i < 0) {
+    i = sched->size++;
+    heap_set(sched, i, (SchedEvent){time, type});
+    sift_up(sched, i);
+  } else {
+    uint64_t old = sched->heap[i].time;
+    sched->heap[i].time = time;
+    if (time < old)
+      sift_up(sched, i);
+    else
+      sift_down(sched, i);
+  }
+
+  update_next(sched);
+}
+
+void sched_cancel(Scheduler *sched, SchedEventType type) {
+  int i = sched->slot[type];
+  if (i < 0)
+    return;
+
+  sched->slot[type] = -1;
+  sched->size--;
+
+  // Fill the hole with the last event and restore the heap around it
+  if (i < sched->size) {
+    heap_set(sched, i, sched->heap[sched->size]);
+    if (i > 0 && sched->heap[i].time < sched->heap[(i - 1) / 2].time)
+      sift_up(sched, i);
+    else
+      sift_down(sched, i);
+  }
+
+  update_next(sched);
+}
+
+uint64_t sched_event_time(const Scheduler *sched, SchedEventType type) {
+  int i = sched->slot[type];
+  return i < 0 ? SCHED_NEVER : sched->heap[i].time;
+}
+
+int sched_run(Scheduler *sched) {
+  int redirected = 0;
+
+  while (sched->size && sched->heap[0].time <= sched->now) {
+    SchedEvent event = sched->heap[0];
+    sched_cancel(sched, event.type);
+
+    if (sched->handler[event.type])
+      redirected |= sched->handler[event.type](sched->ctx[event.type],
+                                               event.time);
+  }
+
+  return redirected;
+}
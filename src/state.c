@@ -0,0 +1,118 @@
+#include "state.h"
+#include "cpu/block_cache.h"
+#include "cpu/idle.h"
+
+#include <string.h>
+
+_Static_assert(sizeof(MachineState) < 12 * 1024,
+               "machine state no longer fits in 12 KB");
+
+void state_save(const Cpu6502 *cpu, MachineState *state) {
+  // Padding is hashed too, it has to be the same every time
+  memset(state, 0, sizeof(MachineState));
+
+  state->PC = cpu->PC;
+  state->nz = cpu->nz;
+  state->A = cpu->A;
+  state->X = cpu->X;
+  state->Y = cpu->Y;
+  state->S = cpu->S;
+  state->P = cpu->P;
+  state->instr = cpu->instr;
+  state->nmi_state = cpu->nmi_state;
+  state->strobe = cpu->strobe;
+  state->ctrl_latch_state = cpu->ctrl_latch_state;
+  state->dma_active_flag = cpu->dma_active_flag;
+  state->irq_sources = cpu->irq.sources;
+  state->ctrl_bit_index = cpu->ctrl_bit_index;
+  state->cycles = cpu->cycles;
+  state->cpu_cycle_count = cpu->cpu_cycle_count;
+  state->dma_cycles = cpu->dma_cycles;
+  state->instr_num = cpu->instr_num;
+
+  state->now = cpu->sched.now;
+  state->ppu_time = cpu->ppu_time;
+  for (int type = 0; type < SCHED_NUM_EVENTS; type++)
+    state->events[type] = sched_event_time(&cpu->sched, type);
+
+  if (cpu->apu_mmio) {
+    state->apu_write_mask = cpu->apu_mmio->apu_mmio_write_mask;
+    memcpy(state->apu_regs, cpu->apu_mmio->regs, sizeof(state->apu_regs));
+    state->apu_frame_irq = cpu->apu_mmio->frame_interrupt_flag;
+  }
+
+  if (cpu->mapper)
+    state->mapper = cpu->mapper->state;
+
+  memcpy(state->ram, cpu->ram, CPU_RAM_SIZE);
+  memcpy(state->ppu, cpu->ppu, PPU_STATE_SIZE);
+}
+
+void state_load(Cpu6502 *cpu, const MachineState *state) {
+  cpu->PC = state->PC;
+  cpu->nz = state->nz;
+  cpu->A = state->A;
+  cpu->X = state->X;
+  cpu->Y = state->Y;
+  cpu->S = state->S;
+  cpu->P = state->P;
+  cpu->instr = state->instr;
+  cpu->nmi_state = state->nmi_state;
+  cpu->strobe = state->strobe;
+  cpu->ctrl_latch_state = state->ctrl_latch_state;
+  cpu->dma_active_flag = state->dma_active_flag;
+  cpu->irq.sources = state->irq_sources;
+  cpu->ctrl_bit_index = state->ctrl_bit_index;
+  cpu->cycles = state->cycles;
+  cpu->cpu_cycle_count = state->cpu_cycle_count;
+  cpu->dma_cycles = state->dma_cycles;
+  cpu->instr_num = state->instr_num;
+
+  // Handlers stay, only the times come from the snapshot
+  cpu->sched.now = state->now;
+  cpu->ppu_time = state->ppu_time;
+  for (int type = 0; type < SCHED_NUM_EVENTS; type++) {
+    if (state->events[type] == SCHED_NEVER)
+      sched_cancel(&cpu->sched, type);
+    else
+      sched_schedule(&cpu->sched, type, state->events[type]);
+  }
+
+  if (cpu->apu_mmio) {
+    cpu->apu_mmio->apu_mmio_write_mask = state->apu_write_mask;
+    memcpy(cpu->apu_mmio->regs, state->apu_regs, sizeof(state->apu_regs));
+    cpu->apu_mmio->frame_interrupt_flag = state->apu_frame_irq;
+  }
+
+  memcpy(cpu->ram, state->ram, CPU_RAM_SIZE);
+  memcpy(cpu->ppu, state->ppu, PPU_STATE_SIZE);
+
+  // Banks and mirroring follow the restored registers
+  if (cpu->mapper) {
+    cpu->mapper->state = state->mapper;
+    cpu->mapper->board->update(cpu->mapper);
+  }
+
+  // Code decoded from the old RAM is stale, and so is any loop being timed
+  for (int page = 0; cpu->block_cache && page < CPU_RAM_SIZE >> 8; page++)
+    block_cache_invalidate_page(cpu, page);
+  cpu->uop = NULL;
+  idle_loop_reset(cpu);
+}
+
+// FNV-1a over 64-bit words
+uint64_t state_hash(const MachineState *state) {
+  const uint8_t *bytes = (const uint8_t *)state;
+  uint64_t hash = 14695981039346656037ull;
+  size_t i = 0;
+
+  for (; i + 8 <= sizeof(MachineState); i += 8) {
+    uint64_t word;
+    memcpy(&word, bytes + i, 8);
+    hash = (hash ^ word) * 1099511628211ull;
+  }
+  for (; i < sizeof(MachineState); i++)
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+
+  return hash;
+}
@@ -0,0 +1,548 @@
+// cpu_tests: run single-instruction CPU test vectors against cpu_execute.
+//
+// Usage: cpu_tests [-j jobs] [--bus] <dir> [opcode...]
+//
+// dir holds one JSON file per opcode, 00.json to ff.json, in the format of
+// the SingleStepTests nes6502 vectors: a list of tests, each with the
+// initial and final registers and RAM and the bus activity of every cycle.
+//   {"name": "b1 28 b5",
+//    "initial": {"pc": 59082, "s": 39, "a": 57, "x": 33, "y": 174,
+//                "p": 96, "ram": [[59082, 177], [59083, 40], ...]},
+//    "final": {...},
+//    "cycles": [[59082, 177, "read"], [59083, 40, "read"], ...]}
+//
+// The CPU runs on a flat 64 KB RAM stub that logs every access. Registers,
+// RAM and the cycle count are always checked; --bus also checks the order
+// and values of the bus accesses, which needs a CPU_CYCLE_ACCURATE build.
+// Opcode files are shared out to jobs worker processes (one per core by
+// default) and the failures are reported per opcode with the field that
+// differed. Opcodes the core doesn't implement are skipped.
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "cpu/cpu.h"
+#include "cpu/idle.h"
+#include "ppu.h"
+
+#define MAX_RAM 64
+#define MAX_CYCLES 16
+
+typedef struct CpuState {
+  uint16_t pc;
+  uint8_t s, a, x, y, p;
+  int num_ram;
+  uint16_t ram_addr[MAX_RAM];
+  uint8_t ram_val[MAX_RAM];
+} CpuState;
+
+typedef struct BusCycle {
+  uint16_t addr;
+  uint8_t val;
+  uint8_t write;
+} BusCycle;
+
+typedef struct Test {
+  char name[32];
+  CpuState initial, final;
+  int num_cycles;
+  BusCycle cycles[MAX_CYCLES];
+} Test;
+
+// Results of one opcode, in memory shared with the workers
+typedef struct OpcodeResult {
+  int found; // The opcode's file exists
+  int tests;
+  int failed;
+  char first[256]; // What differed in the first failing test
+} OpcodeResult;
+
+typedef struct Shared {
+  int next_file; // Next index into the work list
+  OpcodeResult results[256];
+} Shared;
+
+static int check_bus;
+
+/* JSON */
+
+// Just enough of a parser for the test files, which are machine-written
+typedef struct Json {
+  const char *p;
+  int error;
+} Json;
+
+static void skip_space(Json *j) {
+  while (isspace((unsigned char)*j->p))
+    j->p++;
+}
+
+static int accept(Json *j, char c) {
+  skip_space(j);
+  if (*j->p != c)
+    return 0;
+  j->p++;
+  return 1;
+}
+
+static void expect(Json *j, char c) {
+  if (!accept(j, c))
+    j->error = 1;
+}
+
+static long number(Json *j) {
+  char *end;
+
+  skip_space(j);
+  long n = strtol(j->p, &end, 10);
+  if (end == j->p)
+    j->error = 1;
+  j->p = end;
+  return n;
+}
+
+// Copies the string into buf, truncated to size
+static void string(Json *j, char *buf, size_t size) {
+  size_t len = 0;
+
+  expect(j, '"');
+  while (!j->error && *j->p && *j->p != '"') {
+    if (*j->p == '\\' && j->p[1])
+      j->p++;
+    if (len + 1 < size)
+      buf[len++] = *j->p;
+    j->p++;
+  }
+  if (size)
+    buf[len] = '\0';
+  expect(j, '"');
+}
+
+static void skip_value(Json *j) {
+  char buf[1];
+
+  skip_space(j);
+  if (*j->p == '"') {
+    string(j, buf, 0);
+  } else if (accept(j, '[')) {
+    if (!accept(j, ']')) {
+      do
+        skip_value(j);
+      while (!j->error && accept(j, ','));
+      expect(j, ']');
+    }
+  } else if (accept(j, '{')) {
+    if (!accept(j, '}')) {
+      do {
+        string(j, buf, 0);
+        expect(j, ':');
+        skip_value(j);
+      } while (!j->error && accept(j, ','));
+      expect(j, '}');
+    }
+  } else {
+    // Numbers, true, false and null
+    while (*j->p && !strchr(",]} \t\r\n", *j->p))
+      j->p++;
+  }
+}
+
+static void parse_state(Json *j, CpuState *state) {
+  char key[8];
+
+  state->num_ram = 0;
+  expect(j, '{');
+  do {
+    string(j, key, sizeof(key));
+    expect(j, ':');
+
+    if (!strcmp(key, "pc")) {
+      state->pc = number(j);
+    } else if (!strcmp(key, "s")) {
+      state->s = number(j);
+    } else if (!strcmp(key, "a")) {
+      state->a = number(j);
+    } else if (!strcmp(key, "x")) {
+      state->x = number(j);
+    } else if (!strcmp(key, "y")) {
+      state->y = number(j);
+    } else if (!strcmp(key, "p")) {
+      state->p = number(j);
+    } else if (!strcmp(key, "ram")) {
+      expect(j, '[');
+      if (!accept(j, ']')) {
+        do {
+          expect(j, '[');
+          long addr = number(j);
+          expect(j, ',');
+          long val = number(j);
+          expect(j, ']');
+
+          if (state->num_ram < MAX_RAM) {
+            state->ram_addr[state->num_ram] = addr;
+            state->ram_val[state->num_ram++] = val;
+          } else {
+            j->error = 1;
+          }
+        } while (!j->error && accept(j, ','));
+        expect(j, ']');
+      }
+    } else {
+      skip_value(j);
+    }
+  } while (!j->error && accept(j, ','));
+  expect(j, '}');
+}
+
+static void parse_cycles(Json *j, Test *test) {
+  char kind[8];
+
+  test->num_cycles = 0;
+  expect(j, '[');
+  if (accept(j, ']'))
+    return;
+
+  do {
+    expect(j, '[');
+    long addr = number(j);
+    expect(j, ',');
+    long val = number(j);
+    expect(j, ',');
+    string(j, kind, sizeof(kind));
+    expect(j, ']');
+
+    if (test->num_cycles < MAX_CYCLES)
+      test->cycles[test->num_cycles++] =
+          (BusCycle){addr, val, !strcmp(kind, "write")};
+    else
+      j->error = 1;
+  } while (!j->error && accept(j, ','));
+  expect(j, ']');
+}
+
+// Parses the next test of the list. Returns 0 at the end of the list or on
+// a parse error.
+static int parse_test(Json *j, Test *test) {
+  char key[16];
+
+  if (!accept(j, '{'))
+    return 0;
+
+  memset(test, 0, sizeof(Test));
+  do {
+    string(j, key, sizeof(key));
+    expect(j, ':');
+
+    if (!strcmp(key, "name"))
+      string(j, test->name, sizeof(test->name));
+    else if (!strcmp(key, "initial"))
+      parse_state(j, &test->initial);
+    else if (!strcmp(key, "final"))
+      parse_state(j, &test->final);
+    else if (!strcmp(key, "cycles"))
+      parse_cycles(j, test);
+    else
+      skip_value(j);
+  } while (!j->error && accept(j, ','));
+  expect(j, '}');
+
+  // Past the separator to the next test
+  accept(j, ',');
+  return !j->error;
+}
+
+/* Flat RAM bus stub */
+
+static uint8_t flat_ram[0x10000];
+static BusCycle bus_log[MAX_CYCLES];
+static int bus_log_len;
+
+static void log_access(uint16_t addr, uint8_t val, int write) {
+  if (bus_log_len < MAX_CYCLES)
+    bus_log[bus_log_len] = (BusCycle){addr, val, write};
+  bus_log_len++;
+}
+
+static uint8_t stub_read(Cpu6502 *cpu, uint16_t addr) {
+  (void)cpu;
+  log_access(addr, flat_ram[addr], 0);
+  return flat_ram[addr];
+}
+
+static void stub_write(Cpu6502 *cpu, uint16_t addr, uint8_t val) {
+  (void)cpu;
+  log_access(addr, val, 1);
+  flat_ram[addr] = val;
+}
+
+/* Running */
+
+// Appends to the description of what differed, keeping it to one line
+static void mismatch(char *out, size_t size, const char *fmt, int expected,
+                     int got) {
+  size_t len = strlen(out);
+  snprintf(out + len, size - len, fmt, expected, got);
+}
+
+// Runs the test, fills out with what differed. Returns nonzero if it passed.
+static int run_test(Cpu6502 *cpu, const Test *test, char *out, size_t size) {
+  const CpuState *in = &test->initial, *want = &test->final;
+
+  for (int i = 0; i < in->num_ram; i++)
+    flat_ram[in->ram_addr[i]] = in->ram_val[i];
+
+  cpu->PC = in->pc;
+  cpu->S = in->s;
+  cpu->A = in->a;
+  cpu->X = in->x;
+  cpu->Y = in->y;
+  cpu_set_status(cpu, in->p);
+
+  // Nothing is scheduled and no wait loop carries over from the last test
+  sched_init(&cpu->sched);
+  idle_loop_reset(cpu);
+  cpu->dma_active_flag = 0;
+  cpu->uop = NULL;
+
+  uint64_t start = cpu->cpu_cycle_count;
+  bus_log_len = 0;
+  cpu_execute(cpu);
+  int cycles = cpu->cpu_cycle_count - start;
+
+  out[0] = '\0';
+  if (cpu->PC != want->pc)
+    mismatch(out, size, " pc %04X/%04X", want->pc, cpu->PC);
+  if (cpu->S != want->s)
+    mismatch(out, size, " s %02X/%02X", want->s, cpu->S);
+  if (cpu->A != want->a)
+    mismatch(out, size, " a %02X/%02X", want->a, cpu->A);
+  if (cpu->X != want->x)
+    mismatch(out, size, " x %02X/%02X", want->x, cpu->X);
+  if (cpu->Y != want->y)
+    mismatch(out, size, " y %02X/%02X", want->y, cpu->Y);
+  if (cpu_get_status(cpu) != want->p)
+    mismatch(out, size, " p %02X/%02X", want->p, cpu_get_status(cpu));
+
+  for (int i = 0; i < want->num_ram; i++) {
+    uint16_t addr = want->ram_addr[i];
+    if (flat_ram[addr] != want->ram_val[i]) {
+      size_t len = strlen(out);
+      snprintf(out + len, size - len, " ram[%04X] %02X/%02X", addr,
+               want->ram_val[i], flat_ram[addr]);
+    }
+  }
+
+  if (cycles != test->num_cycles)
+    mismatch(out, size, " cycles %d/%d", test->num_cycles, cycles);
+
+  if (check_bus) {
+    for (int i = 0; i < test->num_cycles && i < bus_log_len; i++) {
+      const BusCycle *w = &test->cycles[i], *g = &bus_log[i];
+      if (w->addr != g->addr || w->val != g->val || w->write != g->write) {
+        size_t len = strlen(out);
+        snprintf(out + len, size - len, " bus[%d] %c%04X=%02X/%c%04X=%02X", i,
+                 w->write ? 'w' : 'r', w->addr, w->val, g->write ? 'w' : 'r',
+                 g->addr, g->val);
+        break;
+      }
+    }
+    if (bus_log_len != test->num_cycles)
+      mismatch(out, size, " accesses %d/%d", test->num_cycles, bus_log_len);
+  }
+
+  // Leave the RAM clear for the next test
+  for (int i = 0; i < in->num_ram; i++)
+    flat_ram[in->ram_addr[i]] = 0;
+  for (int i = 0; i < want->num_ram; i++)
+    flat_ram[want->ram_addr[i]] = 0;
+  for (int i = 0; i < bus_log_len && i < MAX_CYCLES; i++)
+    flat_ram[bus_log[i].addr] = 0;
+
+  return out[0] == '\0';
+}
+
+static char *read_file(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (!file)
+    return NULL;
+
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  char *data = malloc(size + 1);
+  if (data && fread(data, 1, size, file) != (size_t)size) {
+    free(data);
+    data = NULL;
+  }
+  if (data)
+    data[size] = '\0';
+
+  fclose(file);
+  return data;
+}
+
+static void run_file(Cpu6502 *cpu, const char *dir, int opcode,
+                     OpcodeResult *result) {
+  char path[4096];
+  snprintf(path, sizeof(path), "%s/%02x.json", dir, opcode);
+
+  char *data = read_file(path);
+  if (!data)
+    return;
+
+  result->found = 1;
+
+  // Opcodes the core doesn't implement have nothing to test
+  if (!lookup_table[opcode].mnemonic) {
+    free(data);
+    return;
+  }
+
+  Json j = {data, 0};
+  Test test;
+  char diff[sizeof(result->first)];
+
+  expect(&j, '[');
+  while (parse_test(&j, &test)) {
+    result->tests++;
+
+    if (!run_test(cpu, &test, diff, sizeof(diff))) {
+      if (!result->failed++)
+        snprintf(result->first, sizeof(result->first), "\"%s\" (want/got)%s",
+                 test.name, diff);
+    }
+  }
+
+  if (j.error)
+    snprintf(result->first, sizeof(result->first),
+             "parse error after %d tests", result->tests);
+
+  free(data);
+}
+
+static void worker(Shared *shared, const char *dir, const int *opcodes,
+                   int num_opcodes) {
+  static Cpu6502 cpu;
+  static PPU ppu;
+  static uint8_t prg[0x8000];
+
+  load_cpu_memory(&cpu, prg, sizeof(prg));
+  ppu_init(&ppu);
+  cpu.ppu = &ppu;
+  cpu_init(&cpu);
+
+  // Every page goes through the logging stub, so nothing is cached either
+  cpu_bus_map(&cpu, 0x00, 0xFF, NULL, NULL, stub_read, stub_write);
+
+  for (;;) {
+    int i = __atomic_fetch_add(&shared->next_file, 1, __ATOMIC_RELAXED);
+    if (i >= num_opcodes)
+      break;
+
+    run_file(&cpu, dir, opcodes[i], &shared->results[opcodes[i]]);
+  }
+
+  cpu_cleanup(&cpu);
+}
+
+int main(int argc, char *argv[]) {
+  int jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  int opcodes[256], num_opcodes = 0;
+  const char *dir = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--bus"))
+      check_bus = 1;
+    else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+      jobs = atoi(argv[++i]);
+    else if (!dir)
+      dir = argv[i];
+    else if (num_opcodes < 256)
+      opcodes[num_opcodes++] = strtol(argv[i], NULL, 16) & 0xFF;
+  }
+
+  if (!dir) {
+    printf("Usage: %s [-j jobs] [--bus] <dir> [opcode...]\n", argv[0]);
+    return 2;
+  }
+
+  if (!num_opcodes) {
+    for (int op = 0; op < 256; op++)
+      opcodes[num_opcodes++] = op;
+  }
+
+  Shared *shared = mmap(NULL, sizeof(Shared), PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (shared == MAP_FAILED) {
+    perror("mmap");
+    return 2;
+  }
+  memset(shared, 0, sizeof(Shared));
+
+  // cpu_init prints as it comes up, keep it out of the report
+  fflush(stdout);
+
+  if (jobs < 1)
+    jobs = 1;
+  for (int i = 0; i < jobs; i++) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      freopen("/dev/null", "w", stdout);
+      worker(shared, dir, opcodes, num_opcodes);
+      _exit(0);
+    }
+    if (pid < 0) {
+      perror("fork");
+      return 2;
+    }
+  }
+
+  int crashed = 0, status;
+  while (wait(&status) > 0) {
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      crashed++;
+  }
+
+  int files = 0, tests = 0, failed = 0, failed_opcodes = 0;
+  for (int i = 0; i < num_opcodes; i++) {
+    int op = opcodes[i];
+    OpcodeResult *r = &shared->results[op];
+    const char *mnemonic = lookup_table[op].mnemonic;
+
+    if (!r->found)
+      continue;
+
+    files++;
+    tests += r->tests;
+    failed += r->failed;
+
+    if (!mnemonic) {
+      printf("  %02X ---     not implemented, skipped\n", op);
+      continue;
+    }
+
+    if (r->failed || r->first[0]) {
+      failed_opcodes++;
+      printf("  %02X %-7.7s %5d/%-5d failed: %s\n", op, mnemonic, r->failed,
+             r->tests, r->first);
+    }
+  }
+
+  if (!files) {
+    printf("No test files in %s\n", dir);
+    return 2;
+  }
+
+  printf("%d tests in %d files: %d failed in %d opcodes\n", tests, files,
+         failed, failed_opcodes);
+  if (crashed)
+    printf("%d workers crashed, some opcodes weren't run\n", crashed);
+
+  return failed || failed_opcodes || crashed;
+}
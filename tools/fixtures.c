@@ -0,0 +1,285 @@
+// fixtures: write the test ROMs of rom/tests that are built, not shipped.
+//
+// Usage: fixtures <dir>
+//
+// Each ROM is assembled below from a listing of 6502 instructions, so this
+// file is its source and the image comes out the same every time. The
+// database rows in src/romdb.c depend on that: change a listing and the
+// row needs the new hashes (bin/romdb prints them).
+//
+// The ROMs speak the $6000 status protocol of bin/test_roms: $80 while
+// running, then 0 for a pass or the number of the failed check, with a
+// message at $6004.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PRG_SIZE 0x4000 // One 16 KB bank, mirrored at $8000 and $C000
+#define ORG 0xC000
+#define MAX_LABELS 32
+#define MAX_FIXUPS 64
+
+/* Assembler */
+
+static uint8_t prg[PRG_SIZE];
+static int pc;
+
+static int labels[MAX_LABELS];
+static struct {
+  int at;
+  int label;
+  int relative;
+} fixups[MAX_FIXUPS];
+static int fixup_count;
+
+static void byte(int b) { prg[pc++] = b; }
+
+static void word(int w) {
+  byte(w & 0xFF);
+  byte(w >> 8);
+}
+
+static void label(int l) { labels[l] = pc; }
+
+static void fixup(int l, int relative) {
+  fixups[fixup_count].at = pc;
+  fixups[fixup_count].label = l;
+  fixups[fixup_count].relative = relative;
+  fixup_count++;
+}
+
+// Implied, immediate and absolute forms, and branches and jumps to labels
+static void op(int opcode) { byte(opcode); }
+
+static void op_imm(int opcode, int val) {
+  byte(opcode);
+  byte(val);
+}
+
+static void op_abs(int opcode, int addr) {
+  byte(opcode);
+  word(addr);
+}
+
+static void op_label(int opcode, int l, int relative) {
+  byte(opcode);
+  fixup(l, relative);
+  if (relative)
+    byte(0);
+  else
+    word(0);
+}
+
+// Returns 0 if a branch doesn't reach its label
+static int resolve(void) {
+  for (int i = 0; i < fixup_count; i++) {
+    int at = fixups[i].at, target = labels[fixups[i].label];
+
+    if (!fixups[i].relative) {
+      prg[at] = (ORG + target) & 0xFF;
+      prg[at + 1] = (ORG + target) >> 8;
+      continue;
+    }
+
+    int offset = target - (at + 1);
+    if (offset < -128 || offset > 127)
+      return 0;
+    prg[at] = offset & 0xFF;
+  }
+  return 1;
+}
+
+#define SEI() op(0x78)
+#define CLD() op(0xD8)
+#define TXS() op(0x9A)
+#define TXA() op(0x8A)
+#define TAY() op(0xA8)
+#define INY() op(0xC8)
+#define ASL_A() op(0x0A)
+#define RTI() op(0x40)
+#define LDA_IMM(v) op_imm(0xA9, v)
+#define LDX_IMM(v) op_imm(0xA2, v)
+#define LDY_IMM(v) op_imm(0xA0, v)
+#define CMP_IMM(v) op_imm(0xC9, v)
+#define STA_ZP(a) op_imm(0x85, a)
+#define LDA_IND_Y(a) op_imm(0xB1, a)
+#define LDA(a) op_abs(0xAD, a)
+#define STA(a) op_abs(0x8D, a)
+#define STX(a) op_abs(0x8E, a)
+#define STA_Y(a) op_abs(0x99, a)
+#define LDA_Y(l) op_label(0xB9, l, 0)
+#define JMP(l) op_label(0x4C, l, 0)
+#define BEQ(l) op_label(0xF0, l, 1)
+#define BNE(l) op_label(0xD0, l, 1)
+
+/* Shared parts of the ROMs */
+
+// Labels every ROM has
+enum { L_RESET, L_FAIL, L_COPY, L_DONE, L_HANG, L_RTI, L_MESSAGES, L_FIRST };
+
+static void reset(void) {
+  memset(prg, 0, sizeof(prg));
+  pc = 0;
+  fixup_count = 0;
+}
+
+static void start(void) {
+  label(L_RESET);
+  SEI();
+  CLD();
+  LDX_IMM(0xFF);
+  TXS();
+
+  // Running, then the signature that makes $6000 count
+  LDA_IMM(0x80);
+  STA(0x6000);
+  LDA_IMM(0xDE);
+  STA(0x6001);
+  LDA_IMM(0xB0);
+  STA(0x6002);
+  LDA_IMM(0x61);
+  STA(0x6003);
+}
+
+static void ppu_addr(int addr) {
+  LDA(0x2002); // Resets the $2006 latch
+  LDA_IMM(addr >> 8);
+  STA(0x2006);
+  LDA_IMM(addr & 0xFF);
+  STA(0x2006);
+}
+
+static void ppu_write(int addr, int val) {
+  ppu_addr(addr);
+  LDA_IMM(val);
+  STA(0x2007);
+}
+
+// The first $2007 read returns the old buffer
+static void ppu_read(int addr) {
+  ppu_addr(addr);
+  LDA(0x2007);
+  LDA(0x2007);
+}
+
+// Fails with check number n unless A holds val. ok is a fresh label.
+static void check(int val, int n, int ok) {
+  CMP_IMM(val);
+  BEQ(ok);
+  LDX_IMM(n);
+  JMP(L_FAIL);
+  label(ok);
+}
+
+// Pass, the fail handler and the message table. fail copies message X
+// (counting from 1) to $6004 and stores X as the status.
+static void finish(const char **messages, int count) {
+  LDA_IMM(0x00);
+  STA(0x6000);
+  label(L_HANG);
+  JMP(L_HANG);
+
+  label(L_FAIL);
+  TXA();
+  ASL_A();
+  TAY();
+  LDA_Y(L_MESSAGES); // Pointer to message X into $00-$01
+  STA_ZP(0x00);
+  INY();
+  LDA_Y(L_MESSAGES);
+  STA_ZP(0x01);
+  LDY_IMM(0);
+  label(L_COPY);
+  LDA_IND_Y(0x00);
+  STA_Y(0x6004);
+  BEQ(L_DONE);
+  INY();
+  BNE(L_COPY);
+  label(L_DONE);
+  STX(0x6000);
+  JMP(L_HANG);
+
+  label(L_RTI);
+  RTI();
+
+  // Pointers, then the text. Entry 0 is unused, so message X is at
+  // messages + X * 2.
+  label(L_MESSAGES);
+  int table = pc;
+  pc += (count + 1) * 2;
+  for (int i = 0; i < count; i++) {
+    int addr = ORG + pc;
+    prg[table + (i + 1) * 2] = addr & 0xFF;
+    prg[table + (i + 1) * 2 + 1] = addr >> 8;
+    memcpy(prg + pc, messages[i], strlen(messages[i]) + 1);
+    pc += strlen(messages[i]) + 1;
+  }
+
+  // NMI, reset and IRQ vectors
+  pc = PRG_SIZE - 6;
+  fixup(L_RTI, 0);
+  word(0);
+  fixup(L_RESET, 0);
+  word(0);
+  fixup(L_RTI, 0);
+  word(0);
+}
+
+// iNES header for NROM with one PRG bank and CHR RAM
+static int write_rom(const char *dir, const char *name, int flags6) {
+  const uint8_t header[16] = {'N', 'E', 'S', 0x1A, PRG_SIZE / 0x4000, 0,
+                              flags6};
+  char path[4096];
+
+  if (!resolve()) {
+    fprintf(stderr, "%s: branch out of range\n", name);
+    return 0;
+  }
+
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    fprintf(stderr, "Failed to write %s\n", path);
+    return 0;
+  }
+
+  int ok = fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+           fwrite(prg, 1, sizeof(prg), file) == sizeof(prg);
+  return fclose(file) == 0 && ok;
+}
+
+/* The ROMs */
+
+// Mirroring from the game database. The header says horizontal; the row
+// in src/romdb.c says vertical, and only that passes.
+static int romdb_mirroring(const char *dir) {
+  static const char *messages[] = {
+      "$2800 isn't $2000: the header's mirroring was used",
+      "$2400 is $2000: the header's mirroring was used",
+  };
+
+  reset();
+  start();
+
+  ppu_write(0x2800, 0x00);
+  ppu_write(0x2000, 0x5A);
+  ppu_read(0x2800); // Vertical: the same nametable as $2000
+  check(0x5A, 1, L_FIRST);
+
+  ppu_write(0x2400, 0xA5);
+  ppu_read(0x2000); // Vertical: $2400 is the other one
+  check(0x5A, 2, L_FIRST + 1);
+
+  finish(messages, 2);
+  return write_rom(dir, "romdb_mirroring.nes", 0x00);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    printf("Usage: %s <dir>\n", argv[0]);
+    return 2;
+  }
+
+  return romdb_mirroring(argv[1]) ? 0 : 1;
+}
@@ -0,0 +1,187 @@
+// jit_check: run the JIT and the interpreter side by side on a ROM and stop
+// at the first point where their state differs.
+//
+// Usage: jit_check <rom> [instructions]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apu/apu_mmio.h"
+#include "config.h"
+#include "cpu/cpu.h"
+#include "cpu/jit.h"
+#include "mapper/mapper.h"
+#include "ppu.h"
+#include "rom.h"
+
+#define DEFAULT_INSTRUCTIONS 10000000L
+
+// RAM is compared every this many sync points (and at the end)
+#define RAM_CHECK_INTERVAL 1024
+
+typedef struct Machine {
+  Cpu6502 cpu;
+  PPU ppu;
+  APU_MMIO apu_mmio;
+} Machine;
+
+static Machine jit_machine;
+static Machine ref_machine;
+
+// Returns 0 if the ROM's board isn't supported, see mapper_error
+static int machine_init(Machine *m, Rom *rom) {
+  memset(m, 0, sizeof(Machine));
+
+  load_cpu_memory(&m->cpu, rom->prg_data, rom->prg_size);
+  load_ppu_ines_header(&m->ppu, rom->header);
+  load_ppu_memory(&m->ppu, rom->chr_data, rom->chr_size);
+
+  ppu_init(&m->ppu);
+  m->cpu.ppu = &m->ppu;
+  if (!mapper_attach(&m->cpu, rom))
+    return 0;
+  cpu_init(&m->cpu);
+
+  apu_mmio_init(&m->apu_mmio);
+  m->cpu.apu_mmio = &m->apu_mmio;
+  return 1;
+}
+
+// Registers and timing compared at every sync point
+typedef struct State {
+  uint16_t PC;
+  uint8_t A, X, Y, S, P;
+  uint64_t cycles;
+  int instr_num;
+  int scanline;
+  int dot;
+} State;
+
+static State capture(Machine *m) {
+  Cpu6502 *cpu = &m->cpu;
+
+  // The PPU runs behind the CPU until something looks at it
+  cpu_ppu_sync(cpu);
+
+  State state = {
+      .PC = cpu->PC,
+      .A = cpu->A,
+      .X = cpu->X,
+      .Y = cpu->Y,
+      .S = cpu->S,
+      .P = cpu_get_status(cpu),
+      .cycles = cpu->cpu_cycle_count,
+      .instr_num = cpu->instr_num,
+      .scanline = m->ppu.scanline,
+      .dot = m->ppu.current_scanline_cycle,
+  };
+
+  return state;
+}
+
+static void dump_state(const char *name, State *s) {
+  printf("%-4s PC:%04X A:%02X X:%02X Y:%02X S:%02X P:%02X CYC:%llu I#:%d "
+         "SL:%d DOT:%d\n",
+         name, s->PC, s->A, s->X, s->Y, s->S, s->P,
+         (unsigned long long)s->cycles, s->instr_num, s->scanline, s->dot);
+}
+
+static int state_equal(State *a, State *b) {
+  return a->PC == b->PC && a->A == b->A && a->X == b->X && a->Y == b->Y &&
+         a->S == b->S && a->P == b->P && a->cycles == b->cycles &&
+         a->instr_num == b->instr_num && a->scanline == b->scanline &&
+         a->dot == b->dot;
+}
+
+// First differing address in internal and cartridge RAM, or -1
+static int ram_diff(Machine *a, Machine *b) {
+  for (int addr = 0; addr < 0x8000; addr++) {
+    if (addr >= 0x0800 && addr < 0x6000)
+      continue;
+
+    if (read_instr(&a->cpu, addr) != read_instr(&b->cpu, addr))
+      return addr;
+  }
+
+  return -1;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    printf("Usage: %s <rom> [instructions]\n", argv[0]);
+    return 2;
+  }
+
+  long limit = argc > 2 ? atol(argv[2]) : DEFAULT_INSTRUCTIONS;
+
+  Rom rom;
+  if (rom_load_cartridge(&rom, argv[1]) != ROM_OK) {
+    printf("Failed to load %s\n", argv[1]);
+    return 2;
+  }
+
+  if (!machine_init(&jit_machine, &rom) || !machine_init(&ref_machine, &rom)) {
+    char error[64];
+    mapper_error(&rom, error, sizeof(error));
+    printf("%s\n", error);
+    return 2;
+  }
+
+  jit_machine.cpu.jit = jit_create();
+  if (!jit_machine.cpu.jit) {
+    printf("JIT backend unavailable (build with CPU_JIT=1 on x86-64)\n");
+    return 2;
+  }
+
+  Cpu6502 *jit = &jit_machine.cpu;
+  Cpu6502 *ref = &ref_machine.cpu;
+  long syncs = 0;
+
+  while (jit->instr_num < limit) {
+    State before = capture(&jit_machine);
+
+    // One call may run a whole translated block or skip a wait loop, on
+    // either side
+    cpu_execute(jit);
+    while (ref->instr_num != jit->instr_num) {
+      if (ref->instr_num < jit->instr_num)
+        cpu_execute(ref);
+      else
+        cpu_execute(jit);
+    }
+
+    State jit_state = capture(&jit_machine);
+    State ref_state = capture(&ref_machine);
+
+    syncs++;
+    int addr = -1;
+    if (!state_equal(&jit_state, &ref_state) ||
+        (syncs % RAM_CHECK_INTERVAL == 0 &&
+         (addr = ram_diff(&jit_machine, &ref_machine)) >= 0)) {
+      printf("Mismatch after %d instructions\n", jit->instr_num);
+      if (addr >= 0)
+        printf("RAM $%04X: jit %02X ref %02X\n", addr,
+               read_instr(jit, addr), read_instr(ref, addr));
+      dump_state("prev", &before);
+      dump_state("jit", &jit_state);
+      dump_state("ref", &ref_state);
+      return 1;
+    }
+  }
+
+  int addr = ram_diff(&jit_machine, &ref_machine);
+  if (addr >= 0) {
+    printf("RAM $%04X differs at the end: jit %02X ref %02X\n", addr,
+           read_instr(jit, addr), read_instr(ref, addr));
+    return 1;
+  }
+
+  printf("OK: %d instructions, %ld sync points, %llu cycles\n",
+         jit->instr_num, syncs, (unsigned long long)jit->cpu_cycle_count);
+
+  cpu_cleanup(jit);
+  cpu_cleanup(ref);
+  rom_unload(&rom);
+  return 0;
+}
@@ -0,0 +1,342 @@
+// lockstep: run two builds of the core on the same ROMs and input logs and
+// report the first instruction where they differ.
+//
+// Usage: lockstep [-j jobs] [-f frames] [-w window] <core_a> <core_b> rom...
+//
+// The cores are lockstep_core binaries built with different flags (see the
+// lockstep target in the Makefile). Each ROM is first compared at frame
+// ends: registers, flags, cycle count, PPU position and a RAM hash. Only
+// when a frame differs are both cores run again with every instruction of
+// that frame recorded, to find the first one that differs and the ones
+// leading up to it. A ROM's input log is the file next to it with the .inp
+// extension, one controller byte per frame; without one no buttons are
+// pressed. ROMs are checked in parallel, jobs at a time.
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "lockstep.h"
+
+#define DEFAULT_FRAMES 600
+#define DEFAULT_WINDOW 16
+
+typedef struct Core {
+  pid_t pid;
+  FILE *stream;
+  LockstepRecord record;
+  int live; // record holds the next unread record
+  int status;
+} Core;
+
+static int frames = DEFAULT_FRAMES;
+static int window = DEFAULT_WINDOW;
+
+static int spawn(Core *core, const char *path, const char *rom,
+                 const char *input, int replay) {
+  int fds[2];
+  if (pipe(fds) < 0)
+    return 0;
+
+  // The other core mustn't keep this pipe open
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+
+  core->pid = fork();
+  if (core->pid < 0) {
+    close(fds[0]);
+    close(fds[1]);
+    return 0;
+  }
+
+  if (core->pid == 0) {
+    char frames_arg[16], replay_arg[16];
+    snprintf(frames_arg, sizeof(frames_arg), "%d", frames);
+    snprintf(replay_arg, sizeof(replay_arg), "%d", replay);
+
+    // Whatever the core prints would only get in the way of the report
+    int null = open("/dev/null", O_WRONLY);
+    dup2(fds[1], STDOUT_FILENO);
+    dup2(null, STDERR_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+    execl(path, path, rom, frames_arg, input, replay_arg, (char *)NULL);
+    _exit(127);
+  }
+
+  close(fds[1]);
+  core->stream = fdopen(fds[0], "rb");
+  core->live = 0;
+  return core->stream != NULL;
+}
+
+// Stops the core if it is still running, as after a mismatch
+static void reap(Core *core) {
+  if (core->stream)
+    fclose(core->stream);
+  if (core->pid > 0) {
+    kill(core->pid, SIGKILL);
+    waitpid(core->pid, &core->status, 0);
+  }
+}
+
+// lockstep_core exits with 2 when it can't load the ROM, 127 is exec
+static int failed_to_start(const Core *core) {
+  return WIFEXITED(core->status) &&
+         (WEXITSTATUS(core->status) == 2 || WEXITSTATUS(core->status) == 127);
+}
+
+static int next(Core *core) {
+  core->live = fread(&core->record, sizeof(LockstepRecord), 1, core->stream);
+  return core->live;
+}
+
+static void print_record(FILE *out, const char *name,
+                         const LockstepRecord *r) {
+  static const char *kinds[] = {"instr", "frame", "end"};
+
+  fprintf(out,
+          "  %-5s %-5s PC:%04X A:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%llu "
+          "I#:%d SL:%d DOT:%d RAM:%08X\n",
+          name, kinds[r->kind], r->PC, r->A, r->X, r->Y, r->P, r->S,
+          (unsigned long long)r->cycles, r->instr_num, r->scanline, r->dot,
+          r->ram_hash);
+}
+
+static void print_diff(FILE *out, const LockstepRecord *a,
+                       const LockstepRecord *b) {
+  fprintf(out, "  differs:");
+  if (a->kind != b->kind)
+    fprintf(out, " kind");
+  if (a->PC != b->PC)
+    fprintf(out, " PC");
+  if (a->A != b->A)
+    fprintf(out, " A");
+  if (a->X != b->X)
+    fprintf(out, " X");
+  if (a->Y != b->Y)
+    fprintf(out, " Y");
+  if (a->S != b->S)
+    fprintf(out, " SP");
+  for (int bit = 7; bit >= 0; bit--) {
+    if ((a->P ^ b->P) >> bit & 1)
+      fprintf(out, " %c", "CZIDBUVN"[bit]);
+  }
+  if (a->cycles != b->cycles)
+    fprintf(out, " cycles");
+  if (a->scanline != b->scanline || a->dot != b->dot)
+    fprintf(out, " PPU position");
+  if (a->ram_hash != b->ram_hash)
+    fprintf(out, " RAM");
+  fprintf(out, "\n");
+}
+
+static int same(const LockstepRecord *a, const LockstepRecord *b) {
+  return a->kind == b->kind && a->PC == b->PC && a->A == b->A &&
+         a->X == b->X && a->Y == b->Y && a->S == b->S && a->P == b->P &&
+         a->cycles == b->cycles && a->scanline == b->scanline &&
+         a->dot == b->dot && a->ram_hash == b->ram_hash;
+}
+
+// Runs both cores to the end or the first differing sync point. Returns 0
+// if they agree, 1 with the two records in *a and *b if not, and 2 if a
+// core couldn't run. Agreeing records go to the trace window.
+static int compare(const char *core_a, const char *core_b, const char *rom,
+                   const char *input, int replay, LockstepRecord *a,
+                   LockstepRecord *b, LockstepRecord *trace, int *traced) {
+  Core ca = {0}, cb = {0};
+  int result = 0;
+  LockstepRecord last = {0}; // Last agreeing record
+  int frame = 0;              // and the frame it leaves the cores in
+
+  if (!spawn(&ca, core_a, rom, input, replay) ||
+      !spawn(&cb, core_b, rom, input, replay)) {
+    reap(&ca);
+    reap(&cb);
+    return 2;
+  }
+
+  *traced = 0;
+  next(&ca);
+  next(&cb);
+
+  while (ca.live && cb.live) {
+    // Each side may run several instructions per sync point
+    while (ca.live && cb.live &&
+           ca.record.instr_num != cb.record.instr_num) {
+      if (ca.record.instr_num < cb.record.instr_num)
+        next(&ca);
+      else
+        next(&cb);
+    }
+
+    if (!ca.live || !cb.live)
+      break;
+
+    if (!same(&ca.record, &cb.record)) {
+      result = 1;
+      break;
+    }
+
+    last = ca.record;
+    frame = ca.record.frame + (ca.record.kind == LOCKSTEP_FRAME);
+    if (trace)
+      trace[(*traced)++ % window] = ca.record;
+
+    if (ca.record.kind == LOCKSTEP_END)
+      break;
+
+    next(&ca);
+    next(&cb);
+  }
+
+  // Cores run to the last frame and write an end record, so one that
+  // stopped without it crashed or was killed
+  if (!ca.live || !cb.live)
+    result = 1;
+
+  LockstepRecord stopped = last;
+  stopped.kind = LOCKSTEP_END;
+  stopped.frame = frame;
+  *a = ca.live ? ca.record : stopped;
+  *b = cb.live ? cb.record : stopped;
+  reap(&ca);
+  reap(&cb);
+  return failed_to_start(&ca) || failed_to_start(&cb) ? 2 : result;
+}
+
+// Checks one ROM and writes its report to out. Returns 0 if the cores
+// agree.
+static int check_rom(const char *core_a, const char *core_b, const char *rom,
+                     FILE *out) {
+  // rom.nes -> rom.inp
+  char input[4096];
+  snprintf(input, sizeof(input), "%s", rom);
+  char *ext = strrchr(input, '.');
+  if (ext && !strchr(ext, '/'))
+    *ext = '\0';
+  strncat(input, ".inp", sizeof(input) - strlen(input) - 1);
+  if (access(input, R_OK) != 0)
+    strcpy(input, "-");
+
+  LockstepRecord a, b, *trace = calloc(window, sizeof(LockstepRecord));
+  int traced;
+
+  int result = compare(core_a, core_b, rom, input, -1, &a, &b, NULL, &traced);
+  if (result == 2) {
+    fprintf(out, "ERROR %s: the cores didn't run\n", rom);
+    free(trace);
+    return 2;
+  }
+
+  if (result == 0) {
+    fprintf(out, "OK    %s: %d frames, %d instructions\n", rom, a.frame,
+            a.instr_num);
+    free(trace);
+    return 0;
+  }
+
+  // Narrow it down to an instruction of the frame that differed
+  int frame = a.frame < b.frame ? a.frame : b.frame;
+  LockstepRecord fa = a, fb = b;
+  result = compare(core_a, core_b, rom, input, frame, &a, &b, trace, &traced);
+
+  if (result != 1) {
+    // The replay agreed, fall back to the frame records
+    a = fa;
+    b = fb;
+    traced = 0;
+  }
+
+  fprintf(out, "FAIL  %s: frame %d, instruction %d\n", rom, frame,
+          a.instr_num);
+
+  int first = traced > window ? traced - window : 0;
+  for (int i = first; i < traced; i++)
+    print_record(out, "", &trace[i % window]);
+
+  print_record(out, "a", &a);
+  print_record(out, "b", &b);
+  print_diff(out, &a, &b);
+
+  free(trace);
+  return 1;
+}
+
+static int run_jobs(const char *core_a, const char *core_b, char **roms,
+                    int num_roms, int jobs) {
+  int started = 0, running = 0, failed = 0;
+
+  while (started < num_roms || running) {
+    if (started < num_roms && running < jobs) {
+      pid_t pid = fork();
+
+      if (pid == 0) {
+        // The whole report is written at once so reports don't interleave
+        char *report = NULL;
+        size_t size = 0;
+        FILE *out = open_memstream(&report, &size);
+        int result = check_rom(core_a, core_b, roms[started], out);
+        fclose(out);
+        fwrite(report, 1, size, stdout);
+        fflush(stdout);
+        _exit(result);
+      }
+
+      started++;
+      if (pid > 0)
+        running++;
+      else
+        failed++;
+      continue;
+    }
+
+    int status;
+    if (wait(&status) < 0)
+      break;
+
+    running--;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      failed++;
+  }
+
+  return failed;
+}
+
+int main(int argc, char *argv[]) {
+  int jobs = sysconf(_SC_NPROCESSORS_ONLN) / 2;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "j:f:w:")) != -1) {
+    if (opt == 'j')
+      jobs = atoi(optarg);
+    else if (opt == 'f')
+      frames = atoi(optarg);
+    else if (opt == 'w')
+      window = atoi(optarg);
+    else
+      return 2;
+  }
+
+  if (argc - optind < 3) {
+    printf("Usage: %s [-j jobs] [-f frames] [-w window] <core_a> <core_b> "
+           "rom...\n",
+           argv[0]);
+    return 2;
+  }
+
+  if (jobs < 1)
+    jobs = 1;
+  if (window < 1)
+    window = 1;
+
+  int num_roms = argc - optind - 2;
+  int failed = run_jobs(argv[optind], argv[optind + 1], &argv[optind + 2],
+                        num_roms, jobs);
+
+  printf("%d of %d ROMs match\n", num_roms - failed, num_roms);
+  return failed != 0;
+}
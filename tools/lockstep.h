@@ -0,0 +1,29 @@
+// Records lockstep_core streams to lockstep (see tools/lockstep.c)
+
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include <stdint.h>
+
+typedef enum LockstepKind {
+  LOCKSTEP_INSTR, // After a cpu_execute call in the replayed frame
+  LOCKSTEP_FRAME, // At the end of a video frame
+  LOCKSTEP_END,   // The run is over, it reached its frame count
+} LockstepKind;
+
+// CPU state at one sync point. A core may run several instructions per
+// cpu_execute call (a block, a skipped wait loop), so points are matched
+// by instr_num.
+typedef struct LockstepRecord {
+  uint8_t kind;
+  uint8_t A, X, Y, S, P;
+  uint16_t PC;
+  int32_t instr_num;
+  uint64_t cycles;
+  int32_t frame;
+  int16_t scanline;
+  int16_t dot;
+  uint32_t ram_hash; // Internal and cartridge RAM
+} LockstepRecord;
+
+#endif
@@ -0,0 +1,142 @@
+// lockstep_core: one side of a lockstep run (see tools/lockstep.c). Built
+// once per core variant, it runs a ROM and writes LockstepRecords to stdout.
+//
+// Usage: lockstep_core <rom> <frames> <input log or -> <replay frame>
+//
+// The input log holds one controller byte per frame. Every frame ends with
+// a LOCKSTEP_FRAME record; during the replay frame every cpu_execute call
+// is recorded as well, and the run stops when it ends. -1 replays nothing.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "apu/apu_mmio.h"
+#include "cpu/cpu.h"
+#include "lockstep.h"
+#include "mapper/mapper.h"
+#include "ppu.h"
+#include "rom.h"
+
+static Cpu6502 cpu;
+static PPU ppu;
+static APU_MMIO apu_mmio;
+
+// Records, stdout itself is pointed at stderr for whatever the core prints
+static FILE *out;
+
+// FNV-1a over internal RAM and cartridge RAM, the pages a game keeps its
+// state in
+static uint32_t ram_hash(Cpu6502 *cpu) {
+  uint32_t hash = 2166136261u;
+
+  for (int page = 0; page < 0x80; page++) {
+    const uint8_t *mem = cpu->bus[page].read_ptr;
+
+    if ((page >= 0x08 && page < 0x60) || !mem)
+      continue;
+
+    for (int i = 0; i < 0x100; i++)
+      hash = (hash ^ mem[i]) * 16777619u;
+  }
+
+  return hash;
+}
+
+static void record(LockstepKind kind, int frame) {
+  // The PPU runs behind the CPU until something looks at it
+  cpu_ppu_sync(&cpu);
+
+  LockstepRecord r = {
+      .kind = kind,
+      .A = cpu.A,
+      .X = cpu.X,
+      .Y = cpu.Y,
+      .S = cpu.S,
+      .P = cpu_get_status(&cpu),
+      .PC = cpu.PC,
+      .instr_num = cpu.instr_num,
+      .cycles = cpu.cpu_cycle_count,
+      .frame = frame,
+      .scanline = ppu.scanline,
+      .dot = ppu.current_scanline_cycle,
+      .ram_hash = ram_hash(&cpu),
+  };
+
+  fwrite(&r, sizeof(r), 1, out);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 5) {
+    fprintf(stderr,
+            "Usage: %s <rom> <frames> <input log or -> <replay frame>\n",
+            argv[0]);
+    return 2;
+  }
+
+  out = fdopen(dup(STDOUT_FILENO), "wb");
+  dup2(STDERR_FILENO, STDOUT_FILENO);
+  if (!out)
+    return 2;
+
+  int frames = atoi(argv[2]);
+  int replay = atoi(argv[4]);
+
+  Rom rom;
+  if (rom_load_cartridge(&rom, argv[1]) != ROM_OK) {
+    fprintf(stderr, "Failed to load %s\n", argv[1]);
+    return 2;
+  }
+
+  FILE *input = strcmp(argv[3], "-") ? fopen(argv[3], "rb") : NULL;
+
+  // Same bring-up as main, without a frontend or the APU
+  load_cpu_memory(&cpu, rom.prg_data, rom.prg_size);
+  load_ppu_ines_header(&ppu, rom.header);
+  load_ppu_memory(&ppu, rom.chr_data, rom.chr_size);
+  ppu_init(&ppu);
+  cpu.ppu = &ppu;
+  if (!mapper_attach(&cpu, &rom)) {
+    char error[64];
+    mapper_error(&rom, error, sizeof(error));
+    fprintf(stderr, "%s\n", error);
+    return 2;
+  }
+  cpu_init(&cpu);
+  apu_mmio_init(&apu_mmio);
+  cpu.apu_mmio = &apu_mmio;
+
+  int frame = 0;
+  int buttons = input ? fgetc(input) : 0;
+  cpu.ctrl_latch_state = buttons == EOF ? 0 : buttons;
+
+  while (frame < frames) {
+    cpu_execute(&cpu);
+
+    if (frame == replay)
+      record(LOCKSTEP_INSTR, frame);
+
+    if (ppu.update_graphics) {
+      ppu.update_graphics = 0;
+      record(LOCKSTEP_FRAME, frame);
+
+      if (frame++ == replay)
+        break;
+
+      // Buttons for the next frame, released once the log runs out
+      buttons = input ? fgetc(input) : 0;
+      cpu.ctrl_latch_state = buttons == EOF ? 0 : buttons;
+    }
+  }
+
+  // Only written after the last frame: a core that crashes ends without it
+  record(LOCKSTEP_END, frame);
+  fclose(out);
+
+  if (input)
+    fclose(input);
+  cpu_cleanup(&cpu);
+  rom_unload(&rom);
+  return 0;
+}
@@ -0,0 +1,347 @@
+// recompile: translate the PRG of an NROM image into a C file that links
+// against the core (see include/cpu/recomp.h).
+//
+// Usage: recompile <rom> <out.c> [targets]
+//
+// Code is discovered from the reset, NMI and IRQ vectors by following
+// branches, jumps and subroutine calls. Indirect jumps can't be followed
+// statically; pass their targets in the optional targets file, one hex
+// address per line ('$' prefix and '#' comments allowed).
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu/block_cache.h"
+#include "cpu/opcodes.h"
+#include "rom.h"
+
+#define PRG_BASE 0x8000
+#define PRG_SPAN 0x8000
+
+typedef struct OpInfo {
+  const char *type;
+  const char *mode;
+  const char *fn;
+  const char *mnemonic;
+  int cycles;
+  int page_cycles;
+  int operand_bytes;
+} OpInfo;
+
+#define X(op, type, mode, fn, cyc, pcyc, mn)                                   \
+  [op] = {#type, #mode, #fn, mn, cyc, pcyc, UOP_BYTES_##mode},
+
+static const OpInfo ops[256] = {CPU_OPCODES(X)};
+
+#undef X
+
+static uint8_t prg[PRG_SPAN];
+
+// Instruction starts reached by the walk
+static uint8_t reached[PRG_SPAN];
+
+static uint16_t worklist[PRG_SPAN];
+static int worklist_len;
+
+static uint8_t prg_byte(uint16_t addr) { return prg[addr - PRG_BASE]; }
+
+static int is_fn(const OpInfo *op, const char *name) {
+  return strcmp(op->fn, name) == 0;
+}
+
+static int is_branch(const OpInfo *op) {
+  static const char *branches[] = {"instr_BCC", "instr_BCS", "instr_BEQ",
+                                   "instr_BNE", "instr_BPL", "instr_BMI",
+                                   "instr_BVC", "instr_BVS"};
+
+  for (size_t i = 0; i < sizeof(branches) / sizeof(branches[0]); i++) {
+    if (is_fn(op, branches[i]))
+      return 1;
+  }
+  return 0;
+}
+
+// Instructions after which execution doesn't simply fall through
+static int ends_flow(const OpInfo *op) {
+  return is_branch(op) || is_fn(op, "instr_JMP") || is_fn(op, "instr_JSR") ||
+         is_fn(op, "instr_RTS") || is_fn(op, "instr_RTI") ||
+         is_fn(op, "instr_BRK");
+}
+
+static int instr_len(const OpInfo *op) {
+  return 1 + op->operand_bytes + is_branch(op);
+}
+
+// Decoded instruction at addr, or NULL if it can't be translated
+static const OpInfo *decode(uint32_t addr) {
+  if (addr < PRG_BASE || addr > 0xFFFF)
+    return NULL;
+
+  const OpInfo *op = &ops[prg_byte(addr)];
+  if (!op->fn || addr + instr_len(op) > 0x10000)
+    return NULL;
+
+  return op;
+}
+
+static uint16_t operand(uint16_t addr, const OpInfo *op) {
+  if (op->operand_bytes == 2)
+    return prg_byte(addr + 1) | prg_byte(addr + 2) << 8;
+  if (op->operand_bytes == 1 || is_branch(op))
+    return prg_byte(addr + 1);
+  return 0;
+}
+
+static uint16_t vector(uint16_t addr) {
+  return prg_byte(addr) | prg_byte(addr + 1) << 8;
+}
+
+static void add_target(uint32_t addr) {
+  if (!decode(addr) || reached[addr - PRG_BASE])
+    return;
+
+  reached[addr - PRG_BASE] = 1;
+  worklist[worklist_len++] = addr;
+}
+
+static void walk(void) {
+  while (worklist_len > 0) {
+    uint16_t addr = worklist[--worklist_len];
+    const OpInfo *op = decode(addr);
+    uint16_t oper = operand(addr, op);
+    uint16_t next = addr + instr_len(op);
+
+    if (is_branch(op)) {
+      add_target((uint16_t)(next + (int8_t)oper));
+      add_target(next);
+    } else if (is_fn(op, "instr_JMP")) {
+      if (strcmp(op->mode, "addr_abs") == 0)
+        add_target(oper);
+    } else if (is_fn(op, "instr_JSR")) {
+      add_target(oper);
+      add_target(next);
+    } else if (is_fn(op, "instr_BRK")) {
+      add_target(vector(0xFFFE));
+      add_target(next + 1);
+    } else if (!ends_flow(op)) {
+      add_target(next);
+    }
+  }
+}
+
+static int load_targets(const char *filename) {
+  FILE *f = fopen(filename, "r");
+  if (!f) {
+    perror(filename);
+    return -1;
+  }
+
+  char line[128];
+  while (fgets(line, sizeof(line), f)) {
+    char *p = line;
+    while (*p == ' ' || *p == '\t' || *p == '$')
+      p++;
+    if (*p == '#' || *p == '\n' || *p == '\0')
+      continue;
+
+    add_target(strtoul(p, NULL, 16));
+  }
+
+  fclose(f);
+  return 0;
+}
+
+static uint32_t prg_hash(void) {
+  // FNV-1a over $8000-$FFFF
+  uint32_t hash = 2166136261u;
+  for (int i = 0; i < PRG_SPAN; i++) {
+    hash ^= prg[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static void emit_instr(FILE *out, uint16_t addr) {
+  uint8_t opcode = prg_byte(addr);
+  const OpInfo *op = decode(addr);
+  const char *mode = op->mode;
+  const char *type = op->type;
+  uint16_t oper = operand(addr, op);
+  uint32_t next = addr + instr_len(op);
+
+  fprintf(out, "// %s", op->mnemonic);
+  if (op->operand_bytes > 0 || is_branch(op))
+    fprintf(out, " $%0*X", op->operand_bytes == 2 ? 4 : 2, oper);
+  fprintf(out, "\nstatic int op_%04X(Cpu6502 *cpu) {\n", addr);
+
+  int indirect = strcmp(mode, "addr_X_ind") == 0 ||
+                 strcmp(mode, "addr_ind_Y") == 0 ||
+                 strcmp(mode, "addr_ind_jmp") == 0 ||
+                 strcmp(mode, "addr_jsr") == 0;
+
+  if (indirect) {
+    // Pointer fetches and JSR's stack writes go through the interpreter's
+    // address helpers
+    fprintf(out, "  cpu_exec_decoded(cpu, 0x%02X, 0x%04X, 0x%04X);\n", opcode,
+            addr, oper);
+  } else {
+    fprintf(out, "  cpu->PC = 0x%04X;\n", addr + op->operand_bytes);
+    fprintf(out, "  cpu->cycles = %d;\n", op->cycles);
+
+    if (strcmp(type, "NONE") == 0) {
+      fprintf(out, "  %s(cpu);\n", op->fn);
+    } else if (strcmp(type, "ACC") == 0) {
+      fprintf(out, "  %s(cpu, &cpu->A);\n", op->fn);
+    } else {
+      char ea[96];
+      int indexed = 0;
+
+      if (strcmp(mode, "addr_imm") == 0) {
+        snprintf(ea, sizeof(ea), "0x%04X", addr + 1);
+      } else if (strcmp(mode, "addr_zpg_X") == 0 ||
+                 strcmp(mode, "addr_zpg_Y") == 0) {
+        snprintf(ea, sizeof(ea), "(uint8_t)(0x%02X + cpu->%c)", oper,
+                 mode[9]);
+      } else if (strcmp(mode, "addr_abs_X") == 0 ||
+                 strcmp(mode, "addr_abs_Y") == 0) {
+        fprintf(out, "  uint16_t ea = 0x%04X + cpu->%c;\n", oper, mode[9]);
+        fprintf(out, "  cpu->page_crossed = (ea & 0xFF00) != 0x%04X;\n",
+                oper & 0xFF00);
+        snprintf(ea, sizeof(ea), "ea");
+        indexed = 1;
+      } else {
+        snprintf(ea, sizeof(ea), "0x%04X", oper);
+      }
+
+      if (strcmp(type, "ADDR") == 0)
+        fprintf(out, "  %s(cpu, %s);\n", op->fn, ea);
+      else if (strcmp(type, "VAL") == 0 && strcmp(mode, "addr_imm") == 0)
+        fprintf(out, "  %s(cpu, 0x%02X);\n", op->fn, oper);
+      else if (strcmp(type, "VAL") == 0)
+        fprintf(out, "  %s(cpu, read_instr(cpu, %s));\n", op->fn, ea);
+      else
+        fprintf(out, "  cpu_bus_modify(cpu, %s, %s);\n", ea, op->fn);
+
+      if (indexed && op->page_cycles)
+        fprintf(out, "  if (cpu->page_crossed)\n    cpu->cycles += %d;\n",
+                op->page_cycles);
+    }
+  }
+
+  fprintf(out, "  if (cpu_retire_instr(cpu))\n    return RECOMP_STOP;\n");
+
+  if (ends_flow(op) || next > 0xFFFF || !reached[next - PRG_BASE]) {
+    fprintf(out, "  return RECOMP_DISPATCH;\n");
+  } else {
+    // Straight-line code continues with a tail call
+    fprintf(out, "\n  cpu->instr = 0x%02X;\n", prg_byte(next));
+    fprintf(out, "  cpu->instr_num++;\n");
+    fprintf(out, "  return op_%04X(cpu);\n", (unsigned)next);
+  }
+
+  fprintf(out, "}\n\n");
+}
+
+static void emit(FILE *out, const char *rom_name) {
+  fprintf(out, "// Generated by tools/recompile.c from %s, do not edit.\n",
+          rom_name);
+  fprintf(out, "#include \"cpu/recomp.h\"\n\n");
+  fprintf(out, "#include <stdint.h>\n\n");
+  fprintf(out, "#define PRG_HASH 0x%08Xu\n\n", prg_hash());
+  fprintf(out, "#define RECOMP_DISPATCH 0 // Continue at cpu->PC\n");
+  fprintf(out, "#define RECOMP_STOP 1 // Hand back to cpu_execute\n\n");
+
+  // Prototypes, so straight-line code can call forward
+  for (int i = 0; i < PRG_SPAN; i++) {
+    if (reached[i])
+      fprintf(out, "static int op_%04X(Cpu6502 *cpu);\n", PRG_BASE + i);
+  }
+  fprintf(out, "\n");
+
+  for (int i = 0; i < PRG_SPAN; i++) {
+    if (reached[i])
+      emit_instr(out, PRG_BASE + i);
+  }
+
+  fprintf(out, "// Translated entry point for every reached instruction\n");
+  fprintf(out, "static int (*const entries[0x8000])(Cpu6502 *cpu) = {\n");
+  for (int i = 0; i < PRG_SPAN; i++) {
+    if (reached[i])
+      fprintf(out, "    [0x%04X] = op_%04X,\n", i, PRG_BASE + i);
+  }
+  fprintf(out, "};\n\n");
+
+  fprintf(out, "static int recomp_execute(Cpu6502 *cpu) {\n");
+  fprintf(out, "  if (cpu->PC < 0x8000 || !entries[cpu->PC - 0x8000])\n");
+  fprintf(out, "    return 0;\n\n");
+  fprintf(out, "  uint64_t start = cpu->cpu_cycle_count;\n\n");
+  fprintf(out, "  // cpu_execute already counted the first instruction\n");
+  fprintf(out, "  while (entries[cpu->PC - 0x8000](cpu) == RECOMP_DISPATCH) {\n");
+  fprintf(out, "    if (cpu->PC < 0x8000 || !entries[cpu->PC - 0x8000] ||\n");
+  fprintf(out, "        cpu->cpu_cycle_count - start >= RECOMP_SLICE_CYCLES)\n");
+  fprintf(out, "      break;\n\n");
+  fprintf(out, "    cpu->instr = read_instr(cpu, cpu->PC);\n");
+  fprintf(out, "    cpu->instr_num++;\n");
+  fprintf(out, "  }\n\n");
+  fprintf(out, "  cpu->cycles = cpu->cpu_cycle_count - start;\n");
+  fprintf(out, "  return 1;\n}\n\n");
+
+  fprintf(out, "int recomp_attach(Cpu6502 *cpu) {\n");
+  fprintf(out, "  uint32_t hash = 2166136261u;\n");
+  fprintf(out, "  for (uint32_t addr = 0x8000; addr <= 0xFFFF; addr++) {\n");
+  fprintf(out, "    hash ^= read_instr(cpu, addr);\n");
+  fprintf(out, "    hash *= 16777619u;\n  }\n\n");
+  fprintf(out, "  if (hash != PRG_HASH)\n    return 0;\n\n");
+  fprintf(out, "  cpu->recomp = recomp_execute;\n");
+  fprintf(out, "  return 1;\n}\n");
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    printf("Usage: %s <rom> <out.c> [targets]\n", argv[0]);
+    return 2;
+  }
+
+  Rom rom;
+  if (rom_load_cartridge(&rom, argv[1]) != ROM_OK) {
+    printf("Failed to load %s\n", argv[1]);
+    return 2;
+  }
+
+  if (rom.mapper != 0 || rom.prg_size > PRG_SPAN) {
+    printf("Mapper %d: only NROM images can be recompiled\n", rom.mapper);
+    return 2;
+  }
+
+  // NROM-128 is mirrored into $C000-$FFFF
+  memcpy(prg, rom.prg_data, rom.prg_size);
+  if (rom.prg_size == PRG_SPAN / 2)
+    memcpy(prg + PRG_SPAN / 2, rom.prg_data, PRG_SPAN / 2);
+  rom_unload(&rom);
+
+  add_target(vector(0xFFFC));
+  add_target(vector(0xFFFA));
+  add_target(vector(0xFFFE));
+
+  if (argc > 3 && load_targets(argv[3]) != 0)
+    return 2;
+
+  walk();
+
+  FILE *out = fopen(argv[2], "w");
+  if (!out) {
+    perror(argv[2]);
+    return 2;
+  }
+
+  emit(out, argv[1]);
+  fclose(out);
+
+  int count = 0;
+  for (int i = 0; i < PRG_SPAN; i++)
+    count += reached[i];
+  printf("%s: %d instructions translated\n", argv[2], count);
+  return 0;
+}
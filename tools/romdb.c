@@ -0,0 +1,127 @@
+// romdb: print the game database (see include/romdb.h) with dumps added.
+//
+// Usage: romdb <rom>...
+//
+// Every image is hashed and given the board details the loader ends up with:
+// the database's if it already knows the dump, the header's otherwise, so
+// fix the header of a new dump first. The whole table is printed sorted by
+// CRC with the new rows merged in, ready to replace the one in src/romdb.c.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ppu.h"
+#include "rom.h"
+#include "romdb.h"
+
+typedef struct Row {
+  RomDbEntry entry;
+  char title[256];
+} Row;
+
+static int compare_rows(const void *a, const void *b) {
+  const Row *x = a, *y = b;
+
+  if (x->entry.crc32 != y->entry.crc32)
+    return x->entry.crc32 < y->entry.crc32 ? -1 : 1;
+  return memcmp(x->entry.sha1, y->entry.sha1, SHA1_SIZE);
+}
+
+// File name without the directory and extension
+static void title_from_path(const char *path, char *title, size_t size) {
+  const char *name = strrchr(path, '/');
+  name = name ? name + 1 : path;
+
+  const char *ext = strrchr(name, '.');
+  int len = ext ? ext - name : (int)strlen(name);
+  snprintf(title, size, "%.*s", len, name);
+}
+
+static void print_string(const char *s) {
+  putchar('"');
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\')
+      putchar('\\');
+    putchar(*s);
+  }
+  putchar('"');
+}
+
+static const char *mirroring_name(int mirroring) {
+  return mirroring == MIRROR_VERTICAL ? "MIRROR_VERTICAL" : "MIRROR_HORIZONTAL";
+}
+
+static const char *region_name(int region) {
+  static const char *names[] = {"ROM_REGION_NTSC", "ROM_REGION_PAL",
+                                "ROM_REGION_MULTI", "ROM_REGION_DENDY"};
+  return names[region & 3];
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    printf("Usage: %s <rom>...\n", argv[0]);
+    return 2;
+  }
+
+  Row *rows = calloc(romdb_count + argc, sizeof(Row));
+  int count = 0;
+  if (!rows)
+    return 2;
+
+  for (size_t i = 0; i < romdb_count; i++) {
+    Row *row = &rows[count++];
+    row->entry = romdb_games[i];
+    snprintf(row->title, sizeof(row->title), "%s", romdb_games[i].title);
+  }
+
+  for (int i = 1; i < argc; i++) {
+    Rom rom;
+    if (rom_load_cartridge(&rom, argv[i]) != ROM_OK) {
+      fprintf(stderr, "Failed to load %s\n", argv[i]);
+      return 2;
+    }
+
+    // Known dumps are already in the table
+    if (rom.title) {
+      fprintf(stderr, "%s: already in the database as %s\n", argv[i],
+              rom.title);
+      rom_unload(&rom);
+      continue;
+    }
+
+    Row *row = &rows[count++];
+    title_from_path(argv[i], row->title, sizeof(row->title));
+    row->entry = (RomDbEntry){.crc32 = rom.crc32,
+                              .mapper = rom.mapper,
+                              .submapper = rom.submapper,
+                              .mirroring = rom.mirroring,
+                              .region = rom.region,
+                              .battery = rom.battery};
+    memcpy(row->entry.sha1, rom.sha1, SHA1_SIZE);
+    rom_unload(&rom);
+  }
+
+  qsort(rows, count, sizeof(Row), compare_rows);
+
+  for (int i = 0; i < count; i++) {
+    const RomDbEntry *e = &rows[i].entry;
+
+    // The same dump given twice
+    if (i > 0 && !compare_rows(&rows[i - 1], &rows[i]))
+      continue;
+
+    // Ten SHA-1 bytes to a line
+    printf("    {0x%08X,\n     {", e->crc32);
+    for (int j = 0; j < SHA1_SIZE; j++)
+      printf("0x%02x%s", e->sha1[j],
+             j == SHA1_SIZE - 1 ? "},\n" : j == 9 ? ",\n      " : ", ");
+    printf("     %d, %d, %s, %s, %d, ", e->mapper, e->submapper,
+           mirroring_name(e->mirroring), region_name(e->region), e->battery);
+    print_string(rows[i].title);
+    printf("},\n");
+  }
+
+  free(rows);
+  return 0;
+}
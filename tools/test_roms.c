@@ -0,0 +1,605 @@
+// test_roms: run test ROMs headless and report which pass.
+//
+// Usage: test_roms [-j jobs] [-f frames] [-t seconds] [--junit file]
+//                  [--json file] <rom or directory>...
+//
+// Directories are searched for .nes files. Each ROM is judged by the first
+// protocol it speaks:
+//
+//   nestest log: a ROM with a .log file next to it (nestest.nes and
+//   nestest.log) runs from $C000 with a return address of $7001 on the
+//   stack, and every instruction is compared to the log's A, X, Y, P, SP
+//   and PC, and to CYC when the log has the PPU column. It passes if the
+//   whole log matches, or, with the log used up, if the ROM returns to $7001
+//   with $02 and $03 clear.
+//
+//   $6000 status: once $6001-$6003 hold DE B0 61, $6000 is the status.
+//   $80 means running, $81 asks for the reset button to be pressed at
+//   least 100 ms later, anything else is the final result code, 0 for a
+//   pass. The text at $6004 is the message.
+//
+// A ROM that does neither fails if the CPU sits in a jump or branch to
+// itself for a second of emulated time, and times out after frames frames
+// or seconds seconds of wall-clock time. ROMs run in parallel, jobs at a
+// time, each in its own process. The JUnit and JSON reports list every
+// ROM with its result, message and runtime.
+
+#include <dirent.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "apu/apu_mmio.h"
+#include "cpu/cpu.h"
+#include "mapper/mapper.h"
+#include "ppu.h"
+#include "rom.h"
+
+#define DEFAULT_FRAMES 3600
+#define DEFAULT_SECONDS 60
+#define MAX_ROMS 4096
+
+// Frames a ROM may sit in a loop to itself, or wait before its reset
+#define HALT_FRAMES 60
+#define RESET_FRAMES 6
+
+// nestest's automated mode
+#define NESTEST_START 0xC000
+#define NESTEST_RETURN 0x7001
+
+typedef enum Result {
+  RESULT_PASS,
+  RESULT_FAIL,
+  RESULT_TIMEOUT,
+  RESULT_ERROR, // Didn't load, or the process died
+} Result;
+
+static const char *result_names[] = {"pass", "fail", "timeout", "error"};
+
+// Outcome of one ROM, in memory shared with the workers
+typedef struct RomResult {
+  int done;
+  Result result;
+  int code; // $6000 result code, -1 if the ROM didn't give one
+  int frames;
+  int instructions;
+  double seconds;
+  char message[1024];
+} RomResult;
+
+static int max_frames = DEFAULT_FRAMES;
+static int max_seconds = DEFAULT_SECONDS;
+
+static Cpu6502 cpu;
+static PPU ppu;
+static APU_MMIO apu_mmio;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Reads RAM or ROM without going through the registers
+static uint8_t peek(uint16_t addr) {
+  const uint8_t *mem = cpu.bus[addr >> 8].read_ptr;
+  return mem ? mem[addr & 0xFF] : 0;
+}
+
+// Copies the text at addr, up to its NUL, onto one line
+static void peek_text(uint16_t addr, char *buf, size_t size) {
+  size_t len = 0;
+
+  while (len + 1 < size) {
+    uint8_t c = peek(addr++);
+    if (!c)
+      break;
+    buf[len++] = c == '\n' ? ' ' : c;
+  }
+
+  while (len && buf[len - 1] == ' ')
+    len--;
+  buf[len] = '\0';
+}
+
+// The instruction at PC jumps or branches to itself
+static int looping(void) {
+  uint8_t op = peek(cpu.PC);
+
+  if (op == 0x4C)
+    return (peek(cpu.PC + 1) | peek(cpu.PC + 2) << 8) == cpu.PC;
+  return (op & 0x1F) == 0x10 && peek(cpu.PC + 1) == 0xFE;
+}
+
+/* nestest log */
+
+typedef struct LogLine {
+  uint16_t pc;
+  uint8_t a, x, y, p, s;
+  int has_cycles;
+  long cycles;
+  char text[256];
+} LogLine;
+
+static int field(const char *line, const char *name, long *val, int base) {
+  const char *at = strstr(line, name);
+  if (!at)
+    return 0;
+  *val = strtol(at + strlen(name), NULL, base);
+  return 1;
+}
+
+// Returns 0 at the end of the log
+static int read_log_line(FILE *log, LogLine *line) {
+  long a, x, y, p, s;
+
+  while (fgets(line->text, sizeof(line->text), log)) {
+    line->text[strcspn(line->text, "\r\n")] = '\0';
+    if (!field(line->text, "A:", &a, 16) || !field(line->text, "X:", &x, 16) ||
+        !field(line->text, "Y:", &y, 16) || !field(line->text, "P:", &p, 16) ||
+        !field(line->text, "SP:", &s, 16))
+      continue;
+
+    line->pc = strtol(line->text, NULL, 16);
+    line->a = a;
+    line->x = x;
+    line->y = y;
+    line->p = p;
+    line->s = s;
+
+    // Older logs have CYC as the PPU dot, only newer ones count CPU cycles
+    line->has_cycles = strstr(line->text, "PPU:") &&
+                       field(line->text, "CYC:", &line->cycles, 10);
+    return 1;
+  }
+  return 0;
+}
+
+// Describes how the CPU differs from the line, returns 0 if it doesn't
+static int log_mismatch(const LogLine *line, long cycles, char *out,
+                        size_t size) {
+  uint8_t p = cpu_get_status(&cpu);
+
+  if (cpu.PC == line->pc && cpu.A == line->a && cpu.X == line->x &&
+      cpu.Y == line->y && p == line->p && cpu.S == line->s &&
+      (!line->has_cycles || cycles == line->cycles))
+    return 0;
+
+  snprintf(out, size,
+           "log differs at instruction %d: expected \"%s\", got PC:%04X "
+           "A:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%ld",
+           cpu.instr_num, line->text, cpu.PC, cpu.A, cpu.X, cpu.Y, p, cpu.S,
+           cycles);
+  return 1;
+}
+
+/* Running */
+
+static void start_nestest(void) {
+  cpu.PC = NESTEST_START;
+  cpu.S = 0xFD;
+  cpu_set_status(&cpu, FLAG_I | FLAG_U);
+
+  // The final RTS returns to NESTEST_RETURN
+  memory_write(&cpu, 0x01FF, (NESTEST_RETURN - 1) >> 8);
+  memory_write(&cpu, 0x01FE, (NESTEST_RETURN - 1) & 0xFF);
+}
+
+static void run_rom(const char *path, const char *log_path, RomResult *r) {
+  Rom rom;
+
+  r->code = -1;
+  if (rom_load_cartridge(&rom, (char *)path) != ROM_OK) {
+    r->result = RESULT_ERROR;
+    snprintf(r->message, sizeof(r->message), "failed to load");
+    return;
+  }
+
+  // Same bring-up as main, without a frontend or the APU
+  load_cpu_memory(&cpu, rom.prg_data, rom.prg_size);
+  load_ppu_ines_header(&ppu, rom.header);
+  load_ppu_memory(&ppu, rom.chr_data, rom.chr_size);
+  ppu_init(&ppu);
+  cpu.ppu = &ppu;
+  if (!mapper_attach(&cpu, &rom)) {
+    r->result = RESULT_ERROR;
+    mapper_error(&rom, r->message, sizeof(r->message));
+    rom_unload(&rom);
+    return;
+  }
+  cpu_init(&cpu);
+  apu_mmio_init(&apu_mmio);
+  cpu.apu_mmio = &apu_mmio;
+
+  FILE *log = log_path ? fopen(log_path, "r") : NULL;
+  LogLine line;
+  int line_num = -1; // Instructions retired before line's state
+  long cycle_base = 0;
+
+  if (log) {
+    start_nestest();
+    if (read_log_line(log, &line)) {
+      line_num = 0;
+      cycle_base = line.cycles - (long)cpu.cpu_cycle_count;
+    }
+  }
+
+  double deadline = now() + max_seconds;
+  int start_instr = cpu.instr_num;
+  int reset_frame = -1; // Frame the reset button is due
+  int halt_pc = -1, halt_frames = 0;
+
+  r->result = RESULT_TIMEOUT;
+  snprintf(r->message, sizeof(r->message), "no result after %d frames",
+           max_frames);
+
+  while (r->frames < max_frames) {
+    if (line_num >= 0) {
+      // A core may retire several instructions per call, the log is
+      // checked wherever the two line up
+      int retired = cpu.instr_num - start_instr;
+      while (line_num < retired && read_log_line(log, &line))
+        line_num++;
+
+      if (line_num < retired) {
+        line_num = -1;
+      } else if (line_num == retired &&
+                 log_mismatch(&line, cycle_base + (long)cpu.cpu_cycle_count,
+                              r->message, sizeof(r->message))) {
+        r->result = RESULT_FAIL;
+        break;
+      }
+    }
+
+    if (log && cpu.PC == NESTEST_RETURN) {
+      r->code = peek(0x02) | peek(0x03) << 8;
+      r->result = r->code ? RESULT_FAIL : RESULT_PASS;
+      if (r->code)
+        snprintf(r->message, sizeof(r->message),
+                 "returned with $02 = $%02X, $03 = $%02X", peek(0x02),
+                 peek(0x03));
+      else
+        r->message[0] = '\0';
+      break;
+    }
+
+    cpu_execute(&cpu);
+
+    // An interrupt got the CPU out of the loop
+    if (cpu.PC != halt_pc)
+      halt_pc = -1;
+
+    if (!ppu.update_graphics)
+      continue;
+
+    ppu.update_graphics = 0;
+    r->frames++;
+
+    if (now() > deadline) {
+      snprintf(r->message, sizeof(r->message), "no result after %d seconds",
+               max_seconds);
+      break;
+    }
+
+    if (peek(0x6001) == 0xDE && peek(0x6002) == 0xB0 && peek(0x6003) == 0x61) {
+      uint8_t status = peek(0x6000);
+
+      if (status == 0x81) {
+        if (reset_frame < 0)
+          reset_frame = r->frames + RESET_FRAMES;
+        if (r->frames >= reset_frame) {
+          cpu_reset(&cpu);
+          reset_frame = -1;
+        }
+        continue;
+      }
+
+      reset_frame = -1;
+      if (status < 0x80) {
+        r->code = status;
+        r->result = status ? RESULT_FAIL : RESULT_PASS;
+        peek_text(0x6004, r->message, sizeof(r->message));
+        break;
+      }
+      continue;
+    }
+
+    // Without a protocol, a loop to itself with nothing to interrupt it is
+    // as far as the ROM goes
+    if (halt_pc < 0) {
+      halt_pc = looping() ? cpu.PC : -1;
+      halt_frames = 0;
+    } else if (++halt_frames >= HALT_FRAMES) {
+      r->result = RESULT_FAIL;
+      snprintf(r->message, sizeof(r->message),
+               "stopped at $%04X without a result", cpu.PC);
+      break;
+    }
+  }
+
+  r->instructions = cpu.instr_num - start_instr;
+  if (log)
+    fclose(log);
+  cpu_cleanup(&cpu);
+  rom_unload(&rom);
+}
+
+// rom.nes -> rom.log, NULL if there is none
+static char *log_for(const char *rom) {
+  static char path[4096];
+
+  snprintf(path, sizeof(path), "%s", rom);
+  char *ext = strrchr(path, '.');
+  if (ext && !strchr(ext, '/'))
+    *ext = '\0';
+  strncat(path, ".log", sizeof(path) - strlen(path) - 1);
+  return access(path, R_OK) == 0 ? path : NULL;
+}
+
+static void run_jobs(char **roms, int num_roms, RomResult *results, int jobs) {
+  int started = 0, running = 0;
+  pid_t pids[MAX_ROMS];
+
+  while (started < num_roms || running) {
+    if (started < num_roms && running < jobs) {
+      int i = started++;
+      pid_t pid = fork();
+
+      if (pid == 0) {
+        // Whatever the core prints would only get in the way of the report
+        freopen("/dev/null", "w", stdout);
+
+        // The wall-clock limit is checked every frame, this is the backstop
+        alarm(max_seconds + 10);
+
+        double start = now();
+        run_rom(roms[i], log_for(roms[i]), &results[i]);
+        results[i].seconds = now() - start;
+        results[i].done = 1;
+        _exit(0);
+      }
+
+      pids[i] = pid;
+      if (pid > 0) {
+        running++;
+      } else {
+        results[i].result = RESULT_ERROR;
+        snprintf(results[i].message, sizeof(results[i].message),
+                 "couldn't start a worker");
+      }
+      continue;
+    }
+
+    int status;
+    pid_t pid = wait(&status);
+    if (pid < 0)
+      break;
+    running--;
+
+    for (int i = 0; i < started; i++) {
+      if (pids[i] != pid || results[i].done)
+        continue;
+
+      results[i].result = RESULT_ERROR;
+      results[i].code = -1;
+      if (WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM)
+        snprintf(results[i].message, sizeof(results[i].message),
+                 "stuck for over %d seconds", max_seconds);
+      else if (WIFSIGNALED(status))
+        snprintf(results[i].message, sizeof(results[i].message),
+                 "killed by signal %d", WTERMSIG(status));
+      else
+        snprintf(results[i].message, sizeof(results[i].message),
+                 "worker exited with %d", WEXITSTATUS(status));
+    }
+  }
+}
+
+/* ROM list */
+
+static int is_rom(const char *name) {
+  const char *ext = strrchr(name, '.');
+  return ext && !strcasecmp(ext, ".nes");
+}
+
+static void add_roms(const char *path, char **roms, int *num_roms) {
+  struct stat st;
+
+  if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+    if (*num_roms < MAX_ROMS)
+      roms[(*num_roms)++] = strdup(path);
+    return;
+  }
+
+  DIR *dir = opendir(path);
+  if (!dir)
+    return;
+
+  struct dirent *entry;
+  while ((entry = readdir(dir))) {
+    if (entry->d_name[0] == '.')
+      continue;
+
+    char child[4096];
+    snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+    if (stat(child, &st) == 0 && S_ISDIR(st.st_mode))
+      add_roms(child, roms, num_roms);
+    else if (is_rom(entry->d_name) && *num_roms < MAX_ROMS)
+      roms[(*num_roms)++] = strdup(child);
+  }
+  closedir(dir);
+}
+
+static int compare_paths(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* Reports */
+
+static void write_escaped(FILE *out, const char *s, int xml) {
+  for (; *s; s++) {
+    unsigned char c = *s;
+
+    if (xml && c == '&')
+      fputs("&amp;", out);
+    else if (xml && c == '<')
+      fputs("&lt;", out);
+    else if (xml && c == '>')
+      fputs("&gt;", out);
+    else if (xml && c == '"')
+      fputs("&quot;", out);
+    else if (!xml && (c == '"' || c == '\\'))
+      fprintf(out, "\\%c", c);
+    else if (c < 0x20 || c >= 0x7F)
+      fputc('?', out);
+    else
+      fputc(c, out);
+  }
+}
+
+static void write_junit(FILE *out, char **roms, const RomResult *results,
+                        int num_roms, double seconds) {
+  int failures = 0, errors = 0;
+  for (int i = 0; i < num_roms; i++) {
+    failures += results[i].result == RESULT_FAIL ||
+                results[i].result == RESULT_TIMEOUT;
+    errors += results[i].result == RESULT_ERROR;
+  }
+
+  fprintf(out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+  fprintf(out,
+          "<testsuite name=\"test_roms\" tests=\"%d\" failures=\"%d\" "
+          "errors=\"%d\" time=\"%.3f\">\n",
+          num_roms, failures, errors, seconds);
+
+  for (int i = 0; i < num_roms; i++) {
+    const RomResult *r = &results[i];
+
+    fprintf(out, "  <testcase name=\"");
+    write_escaped(out, roms[i], 1);
+    fprintf(out, "\" time=\"%.3f\"", r->seconds);
+
+    if (r->result == RESULT_PASS) {
+      fprintf(out, "/>\n");
+      continue;
+    }
+
+    fprintf(out, ">\n    <%s type=\"%s\" message=\"",
+            r->result == RESULT_ERROR ? "error" : "failure",
+            result_names[r->result]);
+    write_escaped(out, r->message, 1);
+    fprintf(out, "\"/>\n  </testcase>\n");
+  }
+
+  fprintf(out, "</testsuite>\n");
+}
+
+static void write_json(FILE *out, char **roms, const RomResult *results,
+                       int num_roms, double seconds) {
+  fprintf(out, "{\"time\": %.3f, \"roms\": [", seconds);
+
+  for (int i = 0; i < num_roms; i++) {
+    const RomResult *r = &results[i];
+
+    fprintf(out, "%s\n  {\"rom\": \"", i ? "," : "");
+    write_escaped(out, roms[i], 0);
+    fprintf(out, "\", \"result\": \"%s\", \"code\": %d, \"message\": \"",
+            result_names[r->result], r->code);
+    write_escaped(out, r->message, 0);
+    fprintf(out,
+            "\", \"frames\": %d, \"instructions\": %d, \"time\": %.3f}",
+            r->frames, r->instructions, r->seconds);
+  }
+
+  fprintf(out, "\n]}\n");
+}
+
+static int write_report(const char *path,
+                        void (*writer)(FILE *, char **, const RomResult *,
+                                       int, double),
+                        char **roms, const RomResult *results, int num_roms,
+                        double seconds) {
+  FILE *out = fopen(path, "w");
+  if (!out) {
+    printf("Failed to open report file %s\n", path);
+    return 0;
+  }
+
+  writer(out, roms, results, num_roms, seconds);
+  fclose(out);
+  return 1;
+}
+
+int main(int argc, char *argv[]) {
+  int jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  const char *junit = NULL, *json = NULL;
+  static char *roms[MAX_ROMS];
+  int num_roms = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-j") && i + 1 < argc)
+      jobs = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-f") && i + 1 < argc)
+      max_frames = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+      max_seconds = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--junit") && i + 1 < argc)
+      junit = argv[++i];
+    else if (!strcmp(argv[i], "--json") && i + 1 < argc)
+      json = argv[++i];
+    else
+      add_roms(argv[i], roms, &num_roms);
+  }
+
+  if (!num_roms) {
+    printf("Usage: %s [-j jobs] [-f frames] [-t seconds] [--junit file] "
+           "[--json file] <rom or directory>...\n",
+           argv[0]);
+    return 2;
+  }
+
+  if (jobs < 1)
+    jobs = 1;
+  if (max_seconds < 1)
+    max_seconds = 1;
+
+  qsort(roms, num_roms, sizeof(roms[0]), compare_paths);
+
+  RomResult *results = mmap(NULL, num_roms * sizeof(RomResult),
+                            PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (results == MAP_FAILED) {
+    perror("mmap");
+    return 2;
+  }
+
+  fflush(stdout);
+  double start = now();
+  run_jobs(roms, num_roms, results, jobs);
+  double seconds = now() - start;
+
+  int passed = 0;
+  for (int i = 0; i < num_roms; i++) {
+    const RomResult *r = &results[i];
+
+    passed += r->result == RESULT_PASS;
+    printf("%-7s %s (%.2fs)%s%s\n", result_names[r->result], roms[i],
+           r->seconds, r->message[0] ? ": " : "", r->message);
+  }
+  printf("%d of %d ROMs passed in %.2fs\n", passed, num_roms, seconds);
+
+  int ok = 1;
+  if (junit)
+    ok &= write_report(junit, write_junit, roms, results, num_roms, seconds);
+  if (json)
+    ok &= write_report(json, write_json, roms, results, num_roms, seconds);
+
+  return passed != num_roms || !ok;
+}
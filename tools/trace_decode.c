@@ -0,0 +1,146 @@
+// trace_decode: print a binary instruction trace (see include/cpu/trace.h)
+// in the nestest log format.
+//
+// Usage: trace_decode <trace> [first] [count]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu/block_cache.h"
+#include "cpu/opcodes.h"
+#include "cpu/trace.h"
+
+typedef struct OpInfo {
+  const char *type;
+  const char *mode;
+  const char *fn;
+  const char *mnemonic;
+  int operand_bytes;
+} OpInfo;
+
+#define X(op, type, mode, fn, cyc, pcyc, mn)                                   \
+  [op] = {#type, #mode, #fn, mn, UOP_BYTES_##mode},
+
+static const OpInfo ops[256] = {CPU_OPCODES(X)};
+
+#undef X
+
+static int is_branch(const OpInfo *op) {
+  static const char *branches[] = {"instr_BCC", "instr_BCS", "instr_BEQ",
+                                   "instr_BNE", "instr_BPL", "instr_BMI",
+                                   "instr_BVC", "instr_BVS"};
+
+  for (size_t i = 0; i < sizeof(branches) / sizeof(branches[0]); i++) {
+    if (strcmp(op->fn, branches[i]) == 0)
+      return 1;
+  }
+  return 0;
+}
+
+// Operand text for each addressing mode, %s receives the hex digits
+static const char *operand_format(const char *mode) {
+  static const struct {
+    const char *mode;
+    const char *format;
+  } formats[] = {
+      {"addr_imm", "#$%s"},       {"addr_zpg", "$%s"},
+      {"addr_zpg_X", "$%s,X"},    {"addr_zpg_Y", "$%s,Y"},
+      {"addr_abs", "$%s"},        {"addr_abs_X", "$%s,X"},
+      {"addr_abs_Y", "$%s,Y"},    {"addr_X_ind", "($%s,X)"},
+      {"addr_ind_Y", "($%s),Y"},  {"addr_ind", "($%s)"},
+      {"addr_ind_jmp", "($%s)"},  {"addr_jsr", "$%s"},
+  };
+
+  for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+    if (strcmp(mode, formats[i].mode) == 0)
+      return formats[i].format;
+  }
+  return "%s";
+}
+
+// bytes and text are both size bytes long
+static void disassemble(const TraceRecord *r, char *bytes, char *text,
+                        size_t size) {
+  const OpInfo *op = &ops[r->opcode];
+
+  if (!op->mnemonic) {
+    snprintf(bytes, size, "%02X", r->opcode);
+    snprintf(text, size, ".DB $%02X", r->opcode);
+    return;
+  }
+
+  int len = 1 + op->operand_bytes + is_branch(op);
+  char digits[8] = "";
+
+  if (len == 1)
+    snprintf(bytes, size, "%02X", r->opcode);
+  else if (len == 2)
+    snprintf(bytes, size, "%02X %02X", r->opcode, r->operand[0]);
+  else
+    snprintf(bytes, size, "%02X %02X %02X", r->opcode, r->operand[0],
+             r->operand[1]);
+
+  if (is_branch(op)) {
+    uint16_t target = r->pc + 2 + (int8_t)r->operand[0];
+    snprintf(digits, sizeof(digits), "%04X", target);
+    snprintf(text, size, "%.3s $%s", op->mnemonic, digits);
+    return;
+  }
+
+  if (strcmp(op->type, "ACC") == 0) {
+    snprintf(text, size, "%.3s A", op->mnemonic);
+    return;
+  }
+
+  if (op->operand_bytes == 0) {
+    snprintf(text, size, "%.3s", op->mnemonic);
+    return;
+  }
+
+  if (op->operand_bytes == 1)
+    snprintf(digits, sizeof(digits), "%02X", r->operand[0]);
+  else
+    snprintf(digits, sizeof(digits), "%04X",
+             r->operand[0] | r->operand[1] << 8);
+
+  char operand[16];
+  snprintf(operand, sizeof(operand), operand_format(op->mode), digits);
+  snprintf(text, size, "%.3s %s", op->mnemonic, operand);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    printf("Usage: %s <trace> [first] [count]\n", argv[0]);
+    return 2;
+  }
+
+  long first = argc > 2 ? atol(argv[2]) : 0;
+  long count = argc > 3 ? atol(argv[3]) : -1;
+
+  static TraceReader reader;
+  if (!trace_reader_open(&reader, argv[1])) {
+    printf("Failed to open trace %s\n", argv[1]);
+    return 2;
+  }
+
+  TraceRecord r;
+  for (long i = 0; count != 0 && trace_read(&reader, &r); i++) {
+    if (i < first)
+      continue;
+
+    char bytes[32], text[32];
+    disassemble(&r, bytes, text, sizeof(text));
+
+    printf("%04X  %-8s  %-32sA:%02X X:%02X Y:%02X P:%02X SP:%02X PPU:%3d,%3d "
+           "CYC:%llu\n",
+           r.pc, bytes, text, r.a, r.x, r.y, r.p, r.s, r.scanline, r.dot,
+           (unsigned long long)r.cycle);
+
+    if (count > 0)
+      count--;
+  }
+
+  trace_reader_close(&reader);
+  return 0;
+}